@@ -5,6 +5,9 @@
 #include "Engine/BinarySearchTree.h"
 #include "Engine/BitSet.h"
 #include "Engine/Dictionary.h"
+#include "Engine/GapList.h"
+#include "Engine/HashDictionary.h"
+#include "Engine/HashTable.h"
 #include "Engine/LinkedList.h"
 #include "Engine/PriorityQueue.h"
 #include "Engine/Queue.h"
@@ -23,11 +26,14 @@
 #include "Engine/Event.h"
 #include "Engine/Exceptions.h"
 #include "Engine/FPSCounter.h"
+#include "Engine/FrameArena.h"
 #include "Engine/InputElement.h"
 #include "Engine/ObjectAllocator.h"
 #include "Engine/Property.h"
 #include "Engine/Random.h"
 #include "Engine/ReferenceCounter.h"
+#include "Engine/Rope.h"
 #include "Engine/Stopwatch.h"
 #include "Engine/String.h"
+#include "Engine/ThreadPool.h"
 #include "Engine/Window.h"
@@ -8,146 +8,259 @@
 namespace DE {
 	namespace Core {
 		namespace Collections {
+			// nodes are stored in a pool and refer to each other by their indices
 			struct AABBNode {
 					friend class AABBTree;
 				public:
 					typedef Math::Rectangle AABB;
 
+					constexpr static size_t Null = static_cast<size_t>(-1);
+
 					AABBNode() = default;
 					explicit AABBNode(const AABB &c) : Region(c) {
 					}
 
-					AABBNode *Father = nullptr, *Left = nullptr, *Right = nullptr;
+					AABB Region; // for leaves, the enlarged box
+					size_t Father = Null, Left = Null, Right = Null;
 					void *Tag = nullptr;
-					AABB Region;
+
+					bool IsLeaf() const {
+						return Left == Null;
+					}
 				protected:
-					size_t _maxDep = 1;
+					size_t _maxDep = 1; // 0 for nodes in the free list, which are linked by Father
 			};
 			class AABBTree {
 				public:
 					typedef Math::Rectangle AABB;
 
+					constexpr static size_t
+						MaxHeight = 64, // queries use stacks of fixed sizes, which this is enough for
+						MaxBuildDepth = 32, // Build stops looking for good splits below this depth
+						SAHBins = 16;
+
 					AABBTree() = default;
-					AABBTree(const AABBTree &rhs) : _root(rhs._root ? CopyTree(rhs._root) : nullptr) {
+					AABBTree(const AABBTree &rhs) : _root(rhs._root), _free(rhs._free), _margin(rhs._margin) {
+						_nodes.PushBackRange(rhs._nodes);
 					}
 					AABBTree &operator =(const AABBTree &rhs) {
 						if (this == &rhs) {
 							return *this;
 						}
-						Clear();
-						if (rhs._root) {
-							_root = CopyTree(rhs._root);
-						}
+						_nodes.Clear();
+						_nodes.PushBackRange(rhs._nodes);
+						_root = rhs._root;
+						_free = rhs._free;
+						_margin = rhs._margin;
 						return *this;
 					}
-					~AABBTree() {
-						Clear();
+
+					// how much the boxes of leaves are enlarged, so that small motions don't move them in the tree
+					double &Margin() {
+						return _margin;
+					}
+					const double &Margin() const {
+						return _margin;
 					}
 
-					AABBNode *Insert(const AABB &ab) {
-						AABBNode *nd = new (GlobalAllocator::Allocate(sizeof(AABBNode))) AABBNode(ab);
-						Insert(nd);
-						return nd;
-					}
-					void Insert(AABBNode *nd) {
-						if (_root == nullptr) {
-							_root = nd;
-							_root->Father = nullptr;
-							return;
+					// returns the index of the leaf, which doesn't change until it's deleted
+					size_t Insert(const AABB &ab, void *tag = nullptr) {
+						size_t id = AllocateNode();
+						AABBNode &nd = _nodes[id];
+						nd.Region = Enlarge(ab, Math::Vector2());
+						nd.Tag = tag;
+						InsertLeaf(id);
+						return id;
+					}
+					void Delete(size_t id) {
+						RemoveLeaf(id);
+						FreeNode(id);
+					}
+					// the leaf is only moved when the box leaves its enlarged box, or when the enlarged box has become
+					// much larger than needed; it's then enlarged along the displacement as well
+					// returns whether the leaf has been moved
+					bool MoveAABB(size_t id, const AABB &ab, const Math::Vector2 &disp = Math::Vector2()) {
+						const AABB &cur = _nodes[id].Region;
+						if (cur.Contains(ab)) {
+							AABB loose(ab.Left - 4.0 * _margin, ab.Top - 4.0 * _margin, ab.Width() + 8.0 * _margin, ab.Height() + 8.0 * _margin);
+							if (loose.Contains(cur)) {
+								return false;
+							}
 						}
-						AABBNode *cur = _root;
-						while (cur->Left && cur->Right) {
-							double lv = GetCombinedEval(nd, cur->Left), rv = GetCombinedEval(nd, cur->Right);
-							cur->Region = CombineAABB(cur->Region, nd->Region);
-							cur = (lv > rv ? cur->Right : cur->Left);
+						RemoveLeaf(id);
+						_nodes[id].Region = Enlarge(ab, disp);
+						InsertLeaf(id);
+						return true;
+					}
+
+					// replaces the whole tree by one built from the boxes with binned SAH; the leaf of the i-th box is node i
+					void Build(const AABB *boxes, size_t count, void *const *tags = nullptr) {
+						Clear();
+						if (count == 0) {
+							return;
 						}
-						AABBNode *tmp = new (GlobalAllocator::Allocate(sizeof(AABBNode))) AABBNode(CombineAABB(nd->Region, cur->Region));
-						tmp->Father = cur->Father;
-						if (tmp->Father) {
-							(cur == cur->Father->Left ? cur->Father->Left : cur->Father->Right) = tmp;
-						} else {
-							_root = tmp;
+						_nodes.PushBack(AABBNode(), 2 * count - 1);
+						AABBNode *nodes = *_nodes;
+						List<BuildEntry, true> entries(BuildEntry(), count);
+						for (size_t i = 0; i < count; ++i) {
+							nodes[i].Region = Enlarge(boxes[i], Math::Vector2());
+							nodes[i].Tag = (tags ? tags[i] : nullptr);
+							entries[i].Region = nodes[i].Region;
+							entries[i].Center = nodes[i].Region.Center();
+							entries[i].Node = i;
 						}
-						tmp->Left = cur;
-						cur->Father = tmp;
-						tmp->Right = nd;
-						nd->Father = tmp;
-						FixupBottomUp(tmp);
+						size_t next = count;
+						_root = BuildRange(*entries, count, next, 0);
 					}
-					void Remove(AABBNode *abn) {
-						if (abn->Father == nullptr) {
-							_root = nullptr;
-						} else {
-							AABBNode *other = (abn == abn->Father->Left ? abn->Father->Right : abn->Father->Left);
-							if (abn->Father->Father == nullptr) {
-								_root = other;
-								other->Father = nullptr;
-							} else {
-								other->Father = abn->Father->Father;
-								(abn->Father == other->Father->Left ? other->Father->Left : other->Father->Right) = other;
-								for (AABBNode *cur = other->Father; cur; cur = cur->Father) {
-									cur->Region = CombineAABB(cur->Left->Region, cur->Right->Region);
+
+					const AABBNode &GetNode(size_t id) const {
+						return _nodes[id];
+					}
+					size_t GetRoot() const {
+						return _root;
+					}
+					size_t GetHeight() const {
+						return _root == AABBNode::Null ? 0 : _nodes[_root]._maxDep;
+					}
+
+					// the callbacks of all queries take indices of leaves, and return false to stop the query
+					template <typename Callback> void QueryRegion(const AABB &rgn, const Callback &callback) const {
+						if (_root == AABBNode::Null) {
+							return;
+						}
+						CheckHeight();
+						const AABBNode *nodes = *_nodes;
+						size_t stack[MaxHeight], top = 0;
+						stack[top++] = _root;
+						while (top > 0) {
+							size_t id = stack[--top];
+							const AABBNode &cur = nodes[id];
+							if (!Overlap(cur.Region, rgn)) {
+								continue;
+							}
+							if (cur.IsLeaf()) {
+								if (!callback(id)) {
+									return;
 								}
-								FixupBottomUp(other->Father);
+							} else {
+								stack[top++] = cur.Left;
+								stack[top++] = cur.Right;
 							}
-							abn->Father->~AABBNode();
-							GlobalAllocator::Free(abn->Father);
 						}
 					}
-					void Delete(AABBNode *abn) {
-						Remove(abn);
-						abn->~AABBNode();
-						GlobalAllocator::Free(abn);
-					}
-					void QueryRegion(const AABB &rgn, const std::function<bool(AABBNode*)> &callback) {
-						List<AABBNode*> stack;
-						if (_root) {
-							if (AABB::Intersect(_root->Region, rgn) != Math::IntersectionType::None) {
-								stack.PushBack(_root);
-							}
+					template <typename Callback> void ForEach(const Callback &callback) const {
+						if (_root == AABBNode::Null) {
+							return;
 						}
-						while (stack.Count() > 0) {
-							AABBNode *cur = stack.PopBack();
-							if (cur->Left == nullptr) {
-								if (!callback(cur)) {
+						CheckHeight();
+						const AABBNode *nodes = *_nodes;
+						size_t stack[MaxHeight], top = 0;
+						stack[top++] = _root;
+						while (top > 0) {
+							size_t id = stack[--top];
+							const AABBNode &cur = nodes[id];
+							if (cur.IsLeaf()) {
+								if (!callback(id)) {
 									return;
 								}
 							} else {
-								if (AABB::Intersect(cur->Left->Region, rgn) != Math::IntersectionType::None) {
-									stack.PushBack(cur->Left);
+								stack[top++] = cur.Left;
+								stack[top++] = cur.Right;
+							}
+						}
+					}
+					// visits the leaves hit by the segment from origin to origin + maxFraction * dir, nearer boxes first
+					// the callback also takes the fraction where the segment enters the box, and returns the fraction to
+					// clip the segment to, or a value no greater than 0 to stop
+					template <typename Callback> void RayCast(
+						const Math::Vector2 &origin, const Math::Vector2 &dir, double maxFraction, const Callback &callback
+					) const {
+						if (_root == AABBNode::Null) {
+							return;
+						}
+						CheckHeight();
+						const AABBNode *nodes = *_nodes;
+						struct Entry {
+							size_t Node;
+							double Enter;
+						} stack[MaxHeight];
+						size_t top = 0;
+						double enter;
+						if (RayHit(nodes[_root].Region, origin, dir, maxFraction, enter)) {
+							stack[top++] = Entry {_root, enter};
+						}
+						while (top > 0) {
+							Entry e = stack[--top];
+							if (e.Enter > maxFraction) {
+								continue;
+							}
+							const AABBNode &cur = nodes[e.Node];
+							if (cur.IsLeaf()) {
+								double res = callback(e.Node, e.Enter);
+								if (res <= 0.0) {
+									return;
 								}
-								if (AABB::Intersect(cur->Right->Region, rgn) != Math::IntersectionType::None) {
-									stack.PushBack(cur->Right);
+								maxFraction = Math::Min(maxFraction, res);
+								continue;
+							}
+							double el, er;
+							bool hl = RayHit(nodes[cur.Left].Region, origin, dir, maxFraction, el);
+							bool hr = RayHit(nodes[cur.Right].Region, origin, dir, maxFraction, er);
+							if (hl && hr) { // the nearer one is popped first
+								if (el < er) {
+									stack[top++] = Entry {cur.Right, er};
+									stack[top++] = Entry {cur.Left, el};
+								} else {
+									stack[top++] = Entry {cur.Left, el};
+									stack[top++] = Entry {cur.Right, er};
 								}
+							} else if (hl) {
+								stack[top++] = Entry {cur.Left, el};
+							} else if (hr) {
+								stack[top++] = Entry {cur.Right, er};
 							}
 						}
 					}
-					void ForEach(const std::function<bool(const AABBNode*)> &callback) const {
-						List<const AABBNode*> stack;
-						if (_root) {
-							stack.PushBack(_root);
+					// visits every two leaves whose boxes overlap once, by walking the tree against itself
+					template <typename Callback> void QueryPairs(const Callback &callback) const {
+						if (_root == AABBNode::Null) {
+							return;
 						}
-						while (stack.Count() > 0) {
-							const AABBNode *cur = stack.PopBack();
-							if (cur->Left == nullptr) {
-								if (!callback(cur)) {
+						CheckHeight();
+						const AABBNode *nodes = *_nodes;
+						struct Entry {
+							size_t A, B;
+						} stack[4 * MaxHeight];
+						size_t top = 0;
+						stack[top++] = Entry {_root, _root};
+						while (top > 0) {
+							Entry e = stack[--top];
+							const AABBNode &na = nodes[e.A], &nb = nodes[e.B];
+							if (e.A == e.B) {
+								if (!na.IsLeaf()) {
+									stack[top++] = Entry {na.Left, na.Left};
+									stack[top++] = Entry {na.Right, na.Right};
+									stack[top++] = Entry {na.Left, na.Right};
+								}
+								continue;
+							}
+							if (!Overlap(na.Region, nb.Region)) {
+								continue;
+							}
+							if (na.IsLeaf() && nb.IsLeaf()) {
+								if (!callback(e.A, e.B)) {
 									return;
 								}
+							} else if (nb.IsLeaf() || (!na.IsLeaf() && GetEval(na.Region) > GetEval(nb.Region))) { // split the larger one
+								stack[top++] = Entry {na.Left, e.B};
+								stack[top++] = Entry {na.Right, e.B};
 							} else {
-								stack.PushBack(cur->Left);
-								stack.PushBack(cur->Right);
+								stack[top++] = Entry {e.A, nb.Left};
+								stack[top++] = Entry {e.A, nb.Right};
 							}
 						}
 					}
-					void MoveAABB(AABBNode *node, const AABB &newRgn) {
-						Remove(node);
-						node->Region = newRgn;
-						Insert(node);
-					}
 
-					inline static double GetCombinedEval(const AABBNode *ln, const AABBNode *rn) {
-						return GetEval(CombineAABB(ln->Region, rn->Region));
-					}
 					inline static double GetEval(const AABB &ab) {
 						return 2.0 * (ab.Width() + ab.Height());
 					}
@@ -159,121 +272,293 @@ namespace DE {
 						result.Bottom = Math::Max(a.Bottom, b.Bottom);
 						return result;
 					}
+					inline static bool Overlap(const AABB &a, const AABB &b) {
+						return a.Left <= b.Right && b.Left <= a.Right && a.Top <= b.Bottom && b.Top <= a.Bottom;
+					}
 
 					void Clear() {
-						if (_root) {
-							List<AABBNode*> stack;
-							stack.PushBack(_root);
-							while (stack.Count() > 0) {
-								AABBNode *cur = stack.PopBack();
-								if (cur->Left) {
-									stack.PushBack(cur->Left);
-									stack.PushBack(cur->Right);
-								}
-								cur->~AABBNode();
-								GlobalAllocator::Free(cur);
-							}
-							_root = nullptr;
-						}
+						_nodes.Clear();
+						_root = _free = AABBNode::Null;
 					}
 
-					void Validate(AABBNode *nd) {
-						if (nd == _root) {
-							if (nd->Father != nullptr) {
+					void Validate() const {
+						if (_root != AABBNode::Null) {
+							if (_nodes[_root].Father != AABBNode::Null) {
 								throw SystemException(_TEXT("tree structure invalid"));
 							}
+							Validate(_root);
 						}
-						if (nd->Left == nullptr) {
-							if (nd->Right != nullptr) {
+					}
+					void Validate(size_t id) const {
+						const AABBNode &nd = _nodes[id];
+						if (nd.IsLeaf()) {
+							if (nd.Right != AABBNode::Null) {
 								throw SystemException(_TEXT("tree structure invalid"));
 							}
 							return;
 						}
-						if (nd->Left->Father != nd) {
-							throw SystemException(_TEXT("tree structure invalid"));
-						}
-						if (nd->Right->Father != nd) {
+						const AABBNode &l = _nodes[nd.Left], &r = _nodes[nd.Right];
+						if (l.Father != id || r.Father != id) {
 							throw SystemException(_TEXT("tree structure invalid"));
 						}
-						if (nd->_maxDep != Math::Max(nd->Left->_maxDep, nd->Right->_maxDep) + 1) {
+						if (nd._maxDep != Math::Max(l._maxDep, r._maxDep) + 1) {
 							throw SystemException(_TEXT("tree structure invalid"));
 						}
-						Validate(nd->Left);
-						Validate(nd->Right);
+						Validate(nd.Left);
+						Validate(nd.Right);
 					}
 				protected:
-					AABBNode *_root = nullptr;
+					List<AABBNode, true> _nodes;
+					size_t _root = AABBNode::Null, _free = AABBNode::Null;
+					double _margin = 0.0;
+
+					AABB Enlarge(const AABB &ab, const Math::Vector2 &disp) const {
+						AABB res(ab.Left - _margin, ab.Top - _margin, ab.Width() + 2.0 * _margin, ab.Height() + 2.0 * _margin);
+						(disp.X < 0.0 ? res.Left : res.Right) += disp.X;
+						(disp.Y < 0.0 ? res.Top : res.Bottom) += disp.Y;
+						return res;
+					}
+					inline static bool Slab(double lo, double hi, double origin, double dir, double &tmin, double &tmax) {
+						if (dir == 0.0) {
+							return lo <= origin && origin <= hi;
+						}
+						double t1 = (lo - origin) / dir, t2 = (hi - origin) / dir;
+						if (t1 > t2) {
+							Math::Swap(t1, t2);
+						}
+						tmin = Math::Max(tmin, t1);
+						tmax = Math::Min(tmax, t2);
+						return tmin <= tmax;
+					}
+					inline static bool RayHit(const AABB &ab, const Math::Vector2 &origin, const Math::Vector2 &dir, double maxFraction, double &enter) {
+						double tmin = 0.0, tmax = maxFraction;
+						if (!Slab(ab.Left, ab.Right, origin.X, dir.X, tmin, tmax) || !Slab(ab.Top, ab.Bottom, origin.Y, dir.Y, tmin, tmax)) {
+							return false;
+						}
+						enter = tmin;
+						return true;
+					}
+					void CheckHeight() const {
+						if (_nodes[_root]._maxDep > MaxHeight) {
+							throw OverflowException(_TEXT("the tree is too deep to be queried"));
+						}
+					}
 
-					inline static AABBNode *CopyTree(const AABBNode *nd) {
-						AABBNode *newnd = new (GlobalAllocator::Allocate(sizeof(AABBNode))) AABBNode(*nd);
-						if (nd->Left) {
-							newnd->Left = CopyTree(nd->Left);
-							newnd->Left->Father = newnd;
-							newnd->Right = CopyTree(nd->Right);
-							newnd->Right->Father = newnd;
+					size_t AllocateNode() {
+						if (_free == AABBNode::Null) {
+							_nodes.PushBack(AABBNode());
+							return _nodes.Count() - 1;
 						}
-						return newnd;
+						size_t id = _free;
+						_free = _nodes[id].Father;
+						_nodes[id] = AABBNode();
+						return id;
+					}
+					void FreeNode(size_t id) {
+						AABBNode &nd = _nodes[id];
+						nd.Father = _free;
+						nd.Left = nd.Right = AABBNode::Null;
+						nd._maxDep = 0;
+						_free = id;
 					}
 
-					void FixupBottomUp(AABBNode *nd) {
-						AABBNode *cur = nd;
-						if (cur->Left == nullptr) {
-							cur->_maxDep = 1;
-							cur = cur->Father;
-						}
-						for (; cur; cur = cur->Father) {
-							if (cur->Left->_maxDep + 1 < cur->Right->_maxDep) {
-								RotateLeft(cur);
-								cur = cur->Father;
-							} else if (cur->Right->_maxDep + 1 < cur->Left->_maxDep) {
-								RotateRight(cur);
-								cur = cur->Father;
-							} else {
-								cur->_maxDep = Math::Max(cur->Left->_maxDep, cur->Right->_maxDep) + 1;
+					// the boxes are split where the sum of the perimeters of the two halves, weighted by their numbers of
+					// boxes, is the smallest, among the borders of bins along the longer axis of their centers
+					struct BuildEntry { // the boxes are moved around while building, rather than indices of them
+						AABB Region;
+						Math::Vector2 Center;
+						size_t Node, Bin;
+					};
+					size_t BuildRange(BuildEntry *entries, size_t count, size_t &next, size_t depth) {
+						if (count == 1) {
+							return entries[0].Node;
+						}
+						Math::Vector2 cmin = entries[0].Center, cmax = cmin;
+						for (size_t i = 1; i < count; ++i) {
+							const Math::Vector2 &c = entries[i].Center;
+							cmin.X = Math::Min(cmin.X, c.X);
+							cmin.Y = Math::Min(cmin.Y, c.Y);
+							cmax.X = Math::Max(cmax.X, c.X);
+							cmax.Y = Math::Max(cmax.Y, c.Y);
+						}
+						bool useX = (cmax.X - cmin.X >= cmax.Y - cmin.Y);
+						double lo = (useX ? cmin.X : cmin.Y), extent = (useX ? cmax.X : cmax.Y) - lo;
+						size_t split = count / 2; // when the centers are all the same, or the tree is too deep
+						if (count > 2 && extent > 0.0 && depth < MaxBuildDepth) {
+							double scale = SAHBins / extent;
+							AABB bins[SAHBins];
+							size_t binCounts[SAHBins] = {};
+							for (size_t i = 0; i < count; ++i) {
+								BuildEntry &e = entries[i];
+								size_t b = e.Bin = Math::Min(static_cast<size_t>(((useX ? e.Center.X : e.Center.Y) - lo) * scale), SAHBins - 1);
+								bins[b] = (binCounts[b]++ > 0 ? CombineAABB(bins[b], e.Region) : e.Region);
+							}
+							double rightCost[SAHBins];
+							AABB acc;
+							size_t accCount = 0;
+							for (size_t b = SAHBins; --b > 0; ) {
+								if (binCounts[b] > 0) {
+									acc = (accCount > 0 ? CombineAABB(acc, bins[b]) : bins[b]);
+									accCount += binCounts[b];
+								}
+								rightCost[b] = accCount * GetEval(acc);
 							}
+							double bestCost = 0.0;
+							size_t bestBin = SAHBins;
+							accCount = 0;
+							for (size_t b = 0; b + 1 < SAHBins; ++b) {
+								if (binCounts[b] > 0) {
+									acc = (accCount > 0 ? CombineAABB(acc, bins[b]) : bins[b]);
+									accCount += binCounts[b];
+								}
+								if (accCount > 0 && accCount < count) {
+									double cost = accCount * GetEval(acc) + rightCost[b + 1];
+									if (bestBin == SAHBins || cost < bestCost) {
+										bestCost = cost;
+										bestBin = b;
+									}
+								}
+							}
+							size_t i = 0, j = count;
+							while (i < j) {
+								if (entries[i].Bin <= bestBin) {
+									++i;
+								} else {
+									Math::Swap(entries[i], entries[--j]);
+								}
+							}
+							split = i;
 						}
+						size_t
+							left = BuildRange(entries, split, next, depth + 1),
+							right = BuildRange(entries + split, count - split, next, depth + 1),
+							id = next++;
+						AABBNode *nodes = *_nodes;
+						AABBNode &nd = nodes[id];
+						nd.Left = left;
+						nd.Right = right;
+						nodes[left].Father = nodes[right].Father = id;
+						nd.Region = CombineAABB(nodes[left].Region, nodes[right].Region);
+						nd._maxDep = Math::Max(nodes[left]._maxDep, nodes[right]._maxDep) + 1;
+						return id;
 					}
-					void RotateLeft(AABBNode *rt) {
-						if (rt == nullptr || rt->Right == nullptr) {
+
+					void InsertLeaf(size_t leaf) {
+						if (_root == AABBNode::Null) {
+							_root = leaf;
+							_nodes[leaf].Father = AABBNode::Null;
 							return;
 						}
-						rt->Right->Father = rt->Father;
-						if (rt->Father) {
-							(rt == rt->Father->Left ? rt->Father->Left : rt->Father->Right) = rt->Right;
-						} else {
-							_root = rt->Right;
+						size_t father = AllocateNode();
+						AABBNode *nodes = *_nodes;
+						AABB ab = nodes[leaf].Region;
+						size_t cur = _root;
+						while (!nodes[cur].IsLeaf()) {
+							AABBNode &cn = nodes[cur];
+							double lv = GetEval(CombineAABB(ab, nodes[cn.Left].Region)), rv = GetEval(CombineAABB(ab, nodes[cn.Right].Region));
+							cn.Region = CombineAABB(cn.Region, ab);
+							cur = (lv > rv ? cn.Right : cn.Left);
 						}
-						rt->Father = rt->Right;
-						rt->Right = rt->Right->Left;
-						rt->Father->Left = rt;
-						rt->Father->Region = rt->Region;
-						if (rt->Right) {
-							rt->Right->Father = rt;
-							rt->Region = CombineAABB(rt->Left->Region, rt->Right->Region);
-							rt->_maxDep = Math::Max(rt->Left->_maxDep, rt->Right->_maxDep) + 1;
+						AABBNode &fn = nodes[father];
+						fn.Region = CombineAABB(ab, nodes[cur].Region);
+						fn.Father = nodes[cur].Father;
+						if (fn.Father != AABBNode::Null) {
+							AABBNode &gn = nodes[fn.Father];
+							(gn.Left == cur ? gn.Left : gn.Right) = father;
+						} else {
+							_root = father;
 						}
-						rt->Father->_maxDep = Math::Max(rt->_maxDep, rt->Father->Right->_maxDep) + 1;
+						fn.Left = cur;
+						nodes[cur].Father = father;
+						fn.Right = leaf;
+						nodes[leaf].Father = father;
+						FixupBottomUp(father);
 					}
-					void RotateRight(AABBNode *rt) {
-						if (rt == nullptr || rt->Left == nullptr) {
+					void RemoveLeaf(size_t leaf) {
+						AABBNode *nodes = *_nodes;
+						size_t father = nodes[leaf].Father;
+						if (father == AABBNode::Null) {
+							_root = AABBNode::Null;
 							return;
 						}
-						rt->Left->Father = rt->Father;
-						if (rt->Father) {
-							(rt == rt->Father->Left ? rt->Father->Left : rt->Father->Right) = rt->Left;
+						size_t other = (nodes[father].Left == leaf ? nodes[father].Right : nodes[father].Left), grand = nodes[father].Father;
+						if (grand == AABBNode::Null) {
+							_root = other;
+							nodes[other].Father = AABBNode::Null;
+						} else {
+							nodes[other].Father = grand;
+							(nodes[grand].Left == father ? nodes[grand].Left : nodes[grand].Right) = other;
+							for (size_t cur = grand; cur != AABBNode::Null; cur = nodes[cur].Father) {
+								nodes[cur].Region = CombineAABB(nodes[nodes[cur].Left].Region, nodes[nodes[cur].Right].Region);
+							}
+							FixupBottomUp(grand);
+						}
+						FreeNode(father);
+						nodes[leaf].Father = AABBNode::Null;
+					}
+
+					void FixupBottomUp(size_t nd) {
+						AABBNode *nodes = *_nodes;
+						size_t cur = nd;
+						if (nodes[cur].IsLeaf()) {
+							nodes[cur]._maxDep = 1;
+							cur = nodes[cur].Father;
+						}
+						for (; cur != AABBNode::Null; cur = nodes[cur].Father) {
+							const AABBNode &cn = nodes[cur];
+							if (nodes[cn.Left]._maxDep + 1 < nodes[cn.Right]._maxDep) {
+								RotateLeft(cur);
+								cur = nodes[cur].Father;
+							} else if (nodes[cn.Right]._maxDep + 1 < nodes[cn.Left]._maxDep) {
+								RotateRight(cur);
+								cur = nodes[cur].Father;
+							} else {
+								nodes[cur]._maxDep = Math::Max(nodes[cn.Left]._maxDep, nodes[cn.Right]._maxDep) + 1;
+							}
+						}
+					}
+					// both rotations are only done when the child that moves up is deeper than the other, and not a leaf
+					void RotateLeft(size_t rt) {
+						AABBNode *nodes = *_nodes;
+						AABBNode &rn = nodes[rt];
+						size_t up = rn.Right;
+						AABBNode &un = nodes[up];
+						un.Father = rn.Father;
+						if (rn.Father != AABBNode::Null) {
+							AABBNode &fn = nodes[rn.Father];
+							(fn.Left == rt ? fn.Left : fn.Right) = up;
+						} else {
+							_root = up;
+						}
+						rn.Father = up;
+						rn.Right = un.Left;
+						un.Left = rt;
+						un.Region = rn.Region;
+						nodes[rn.Right].Father = rt;
+						rn.Region = CombineAABB(nodes[rn.Left].Region, nodes[rn.Right].Region);
+						rn._maxDep = Math::Max(nodes[rn.Left]._maxDep, nodes[rn.Right]._maxDep) + 1;
+						un._maxDep = Math::Max(rn._maxDep, nodes[un.Right]._maxDep) + 1;
+					}
+					void RotateRight(size_t rt) {
+						AABBNode *nodes = *_nodes;
+						AABBNode &rn = nodes[rt];
+						size_t up = rn.Left;
+						AABBNode &un = nodes[up];
+						un.Father = rn.Father;
+						if (rn.Father != AABBNode::Null) {
+							AABBNode &fn = nodes[rn.Father];
+							(fn.Left == rt ? fn.Left : fn.Right) = up;
 						} else {
-							_root = rt->Left;
-						}
-						rt->Father = rt->Left;
-						rt->Left = rt->Father->Right;
-						rt->Father->Right = rt;
-						rt->Father->Region = rt->Region;
-						if (rt->Left) {
-							rt->Left->Father = rt;
-							rt->Region = CombineAABB(rt->Left->Region, rt->Right->Region);
-							rt->_maxDep = Math::Max(rt->Left->_maxDep, rt->Right->_maxDep) + 1;
-						}
-						rt->Father->_maxDep = Math::Max(rt->_maxDep, rt->Father->Left->_maxDep) + 1;
+							_root = up;
+						}
+						rn.Father = up;
+						rn.Left = un.Right;
+						un.Right = rt;
+						un.Region = rn.Region;
+						nodes[rn.Left].Father = rt;
+						rn.Region = CombineAABB(nodes[rn.Left].Region, nodes[rn.Right].Region);
+						rn._maxDep = Math::Max(nodes[rn.Left]._maxDep, nodes[rn.Right]._maxDep) + 1;
+						un._maxDep = Math::Max(rn._maxDep, nodes[un.Left]._maxDep) + 1;
 					}
 			};
 		}
@@ -20,19 +20,17 @@ namespace DE {
 					}
 
 					const CharData &GetData(TCHAR c) const override {
-						CheckForData(c);
-						return *static_cast<CharData*>(_atl.TargetAtlas->AtlasTextures()[c].Tag);
+						return GetGlyph(c).Data;
 					}
 					const AtlasTexture &GetTextureInfo(TCHAR c) const override {
-						CheckForData(c);
-						return _atl.TargetAtlas->AtlasTextures()[c];
+						return GetGlyph(c).Texture;
 					}
 					const TextureID &GetTexture(size_t pg) const override {
 						_atl.Flush();
 						return _atl.TargetAtlas->Textures()[pg];
 					}
 					bool HasData(TCHAR c) const override {
-						CheckForData(c);
+						GetGlyph(c);
 						return *Face;
 					}
 					double GetHeight() const override {
@@ -44,15 +42,22 @@ namespace DE {
 				protected:
 					mutable DynamicAtlas _atl; // NOTE usage of mutable object
 
-					void CheckForData(TCHAR c) const {
-						if (*Face) {
-							if (!_atl.TargetAtlas->AtlasTextures().ContainsKey(c)) {
-								CharCreationData data = Face->CreateChar(c, ImageBorderWidth);
-								CharData *cd = new (Core::GlobalAllocator::Allocate(sizeof(CharData))) CharData(data.Data);
-								_atl.Append(c, data.Image, cd, false);
-								delete data.Image;
-							}
+					mutable GlyphTable _glyphs;
+
+					const GlyphTable::Glyph &GetGlyph(TCHAR c) const {
+						const GlyphTable::Glyph *g = _glyphs.Find(c);
+						if (g) {
+							return *g;
+						}
+						if (!*Face) { // not cached, since the face may be set later
+							static GlyphTable::Glyph empty;
+							return empty;
 						}
+						CharCreationData data = Face->CreateChar(c, ImageBorderWidth);
+						CharData *cd = new (Core::GlobalAllocator::Allocate(sizeof(CharData))) CharData(data.Data);
+						_atl.Append(c, data.Image, cd, false);
+						delete data.Image;
+						return _glyphs.Set(c, data.Data, _atl.TargetAtlas->AtlasTextures()[c]);
 					}
 			};
 		}
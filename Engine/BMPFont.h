@@ -60,27 +60,47 @@ namespace DE {
 								Core::GlobalAllocator::Free(ptr);
 							}
 						};
+						fnt.BuildGlyphTable();
 						return fnt;
 					}
 
 					virtual const CharData &GetData(TCHAR c) const override {
-						return *static_cast<CharData*>(_al[c].Tag);
+						return GetGlyph(c).Data;
 					}
 					virtual const AtlasTexture &GetTextureInfo(TCHAR c) const override {
-						return _al[c];
+						return GetGlyph(c).Texture;
 					}
 					virtual const TextureID &GetTexture(size_t p) const override {
 						return _al.Textures()[p];
 					}
 					virtual bool HasData(TCHAR c) const override {
-						return _al.AtlasTextures().ContainsKey(c);
+						return _glyphs.Find(c) != nullptr;
 					}
 				private:
 					BMPFont(RenderingContexts::RenderingContext *ctx, Atlas atl) : Font(ctx), _al(atl) {
+						BuildGlyphTable();
 					}
 
 					Core::String _fontName;
 					Atlas _al;
+					GlyphTable _glyphs;
+
+					const GlyphTable::Glyph &GetGlyph(TCHAR c) const {
+						const GlyphTable::Glyph *g = _glyphs.Find(c);
+						if (g == nullptr) {
+							throw Core::InvalidOperationException(_TEXT("the value does not exist"));
+						}
+						return *g;
+					}
+					void BuildGlyphTable() {
+						_glyphs.Clear();
+						_al.AtlasTextures().ForEachPair([&](const Core::Collections::KeyValuePair<int, AtlasTexture> &pair) {
+							if (pair.Value().Tag) {
+								_glyphs.Set(static_cast<TCHAR>(pair.Key()), *static_cast<const CharData*>(pair.Value().Tag), pair.Value());
+							}
+							return true;
+						});
+					}
 			};
 		}
 	}
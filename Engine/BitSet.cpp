@@ -3,158 +3,272 @@
 namespace DE {
 	namespace Core {
 		namespace Collections {
-			#define DE_BS_BITMASK(X) (1<<(BitsPerChunk - 1 - (X)))
-			void BitSet::PushBack(bool v) {
-				if (_curB >= BitsPerChunk) {
-					_curB = 0;
-					Base::PushBack(0);
-				}
-				if (v) {
-					Base::At(Base::Count() - 1) |= DE_BS_BITMASK(_curB);
-				}
-				++_curB;
-			}
+			constexpr size_t BitSet::SizeOffset, BitSet::BitsPerChunk, BitSet::Mask, RankSelectIndex::BlockWords, RankSelectIndex::SelectSample;
+
 			bool BitSet::PopBack() {
-				if (Base::Count() == 0) {
+				if (_count == 0) {
 					throw InvalidOperationException(_TEXT("the BitSet is empty"));
 				}
-				unsigned char mask = DE_BS_BITMASK(--_curB);
-				bool v = Base::At(Base::Count() - 1) & mask;
-				if (_curB == 0) {
+				--_count;
+				ChunkType &w = Base::At(_count >> SizeOffset);
+				ChunkType m = ChunkType(1) << (_count & Mask);
+				bool v = (w & m) != 0;
+				w &= ~m;
+				if ((_count & Mask) == 0) {
 					Base::PopBack();
-					_curB = BitsPerChunk;
-				} else if (v) {
-					Base::At(Base::Count() - 1) &= ~mask;
 				}
 				return v;
 			}
 
 			void BitSet::PushBackBits(const void *vsV, size_t bitNum) {
-				const ChunkType *vs = (const ChunkType*)vsV, *e = vs + (bitNum >> SizeOffset);
-				for (const ChunkType *c = vs; c != e; ++c) {
-					PushBackChunk(*c);
+				if (bitNum == 0) {
+					return;
 				}
-				bitNum &= Mask;
-				for (size_t i = 0; i < bitNum; ++i) {
-					PushBack((*e) & DE_BS_BITMASK(i));
+				const unsigned char *vs = static_cast<const unsigned char*>(vsV);
+				size_t oldWords = Base::Count(), newWords = WordCount(_count + bitNum), shift = _count & Mask;
+				if (newWords > oldWords) {
+					Base::PushBack(0, newWords - oldWords);
 				}
-			}
-			void BitSet::PopBackBits(void *vsV, size_t bitNum) {
-				ChunkType *vs = (ChunkType*)vsV;
-				if (bitNum > Count()) {
-					throw InvalidOperationException(_TEXT("not enough bits"));
+				ChunkType *dst = &Base::At(0) + (_count >> SizeOffset);
+				size_t full = bitNum >> SizeOffset, rest = bitNum & Mask;
+				if (shift == 0) {
+					memcpy(dst, vs, full * sizeof(ChunkType));
+				} else {
+					for (size_t i = 0; i < full; ++i) {
+						ChunkType w;
+						memcpy(&w, vs + i * sizeof(ChunkType), sizeof(ChunkType));
+						dst[i] |= w << shift;
+						dst[i + 1] = w >> (BitsPerChunk - shift);
+					}
 				}
-				size_t addi = bitNum & Mask, al = bitNum >> SizeOffset;
-				ChunkType *e = vs + al;
-				if (addi > 0) {
-					(*e) &= (1<<(BitsPerChunk - addi)) - 1;
-					for (size_t i = addi; i > 0; --i) {
-						if (PopBack()) {
-							(*e) |= DE_BS_BITMASK(i - 1);
-						}
+				if (rest > 0) {
+					ChunkType w = 0;
+					memcpy(&w, vs + full * sizeof(ChunkType), (rest + 7) >> 3);
+					w &= (ChunkType(1) << rest) - 1;
+					dst[full] |= w << shift;
+					if (shift + rest > BitsPerChunk) {
+						dst[full + 1] = w >> (BitsPerChunk - shift);
 					}
 				}
-				--vs;
-				for (ChunkType *c = e - 1; c != vs; --c) {
-					(*c) = PopBackChunk();
+				_count += bitNum;
+			}
+			void BitSet::PopBackBits(void *vs, size_t bitNum) {
+				if (bitNum > _count) {
+					throw InvalidOperationException(_TEXT("not enough bits"));
+				}
+				Subsequence(vs, _count - bitNum, bitNum);
+				Resize(_count - bitNum);
+			}
+
+			BitSet::ChunkType BitSet::GetWord(size_t start, size_t len) const {
+				const ChunkType *ws = **this;
+				size_t id = start >> SizeOffset, shift = start & Mask;
+				ChunkType w = ws[id] >> shift;
+				if (shift > 0 && shift + len > BitsPerChunk) {
+					w |= ws[id + 1] << (BitsPerChunk - shift);
 				}
+				return len == BitsPerChunk ? w : w & ((ChunkType(1) << len) - 1);
 			}
 			void BitSet::Subsequence(void *arrV, size_t start, size_t len) const {
-				ChunkType *arr = (ChunkType*)arrV;
-				BitSet bs = Subsequence(start, len);
-				if (len == 0) {
-					return;
+				if (start > _count || len > _count - start) {
+					throw OverflowException(_TEXT("index overflow"));
 				}
-				if ((len & Mask) == 0) {
-					memcpy(arr, *bs, sizeof(ChunkType) * bs.Base::Count());
-				} else {
-					memcpy(arr, *bs, sizeof(ChunkType) * (bs.Base::Count() - 1));
-					ChunkType clrMsk = (1<<(BitsPerChunk - (bs.Count() & Mask))) - 1;
-					arr[bs.Base::Count()] &= clrMsk;
-					arr[bs.Base::Count()] |= bs.Base::At(bs.Base::Count() - 1);
+				unsigned char *arr = static_cast<unsigned char*>(arrV);
+				for (size_t i = 0; i < len; i += BitsPerChunk, arr += sizeof(ChunkType)) {
+					size_t n = Math::Min(BitsPerChunk, len - i);
+					ChunkType w = GetWord(start + i, n);
+					memcpy(arr, &w, (n + 7) >> 3);
 				}
 			}
 			BitSet BitSet::Subsequence(size_t start, size_t len) const {
-				size_t eid = start + len, c = Count();
-				if (start >= c || eid > c) {
+				if (start > _count || len > _count - start) {
 					throw OverflowException(_TEXT("index overflow"));
 				}
+				BitSet res;
 				if (len == 0) {
-					return BitSet();
+					return res;
 				}
-				BitSet res;
-				const ChunkType *s = &Base::At(start >> SizeOffset), *e = (&Base::At(0)) + (eid >> SizeOffset);
-				if (s == e) {
-					size_t te = eid & Mask;
-					if (te == 0) {
-						te = BitsPerChunk;
-					}
-					for (size_t n = (start & Mask); n < te; ++n) {
-						res.PushBack(GetAt((start & (~Mask)) | n));
-					}
+				res.Base::PushBack(0, WordCount(len));
+				ChunkType *ws = &res.Base::At(0);
+				if ((start & Mask) == 0) {
+					memcpy(ws, **this + (start >> SizeOffset), WordCount(len) * sizeof(ChunkType));
 				} else {
-					if ((start & Mask) == 0) {
-						--s;
-					} else {
-						for (size_t n = (start & Mask); n < BitsPerChunk; ++n) {
-							res.PushBack(GetAt((start & (~Mask)) | n));
-						}
-					}
-					for (const ChunkType *cc = s + 1; cc != e; ++cc) {
-						res.PushBackChunk(*cc);
-					}
-					for (size_t n = 0; n < (eid & Mask); ++n) {
-						res.PushBack(GetAt((eid & (~Mask)) | n));
+					for (size_t i = 0; i < len; i += BitsPerChunk) {
+						ws[i >> SizeOffset] = GetWord(start + i, Math::Min(BitsPerChunk, len - i));
 					}
 				}
+				res._count = len;
+				res.ClearTail();
 				return res;
 			}
 
-			bool BitSet::GetAt(size_t id) const {
-				if (Base::Count() == 0) {
-					throw OverflowException(_TEXT("index overflow"));
+			void BitSet::Resize(size_t count, bool value) {
+				size_t oldWords = Base::Count(), newWords = WordCount(count), old = _count;
+				if (newWords < oldWords) {
+					Base::Remove(newWords, oldWords - newWords);
+				} else if (newWords > oldWords) {
+					Base::PushBack(value ? ~ChunkType(0) : 0, newWords - oldWords);
 				}
-				size_t set = id >> SizeOffset, bit = id & Mask;
-				if (set >= Base::Count() || (set == Base::Count() - 1 && bit >= _curB)) {
-					throw OverflowException(_TEXT("index overflow"));
+				_count = count;
+				if (count > old && value && (old & Mask) != 0) { // the rest of the word that was last
+					Base::At(old >> SizeOffset) |= ~ChunkType(0) << (old & Mask);
 				}
-				return Base::At(set) & DE_BS_BITMASK(bit);
+				ClearTail();
 			}
-			void BitSet::SetAt(size_t id, bool v) {
-				if (Base::Count() == 0) {
+			void BitSet::Fill(size_t start, size_t count, bool value) {
+				if (start > _count || count > _count - start) {
 					throw OverflowException(_TEXT("index overflow"));
 				}
-				size_t set = id >> SizeOffset, bit = id & Mask;
-				if (set >= Base::Count() || (set == Base::Count() - 1 && bit >= _curB)) {
-					throw OverflowException(_TEXT("index overflow"));
+				if (count == 0) {
+					return;
+				}
+				ChunkType *ws = &Base::At(0);
+				size_t first = start >> SizeOffset, last = (start + count - 1) >> SizeOffset;
+				ChunkType head = ~ChunkType(0) << (start & Mask), tail = ~ChunkType(0) >> (Mask - ((start + count - 1) & Mask));
+				if (first == last) {
+					head &= tail;
 				}
-				if (v) {
-					Base::At(set) |= DE_BS_BITMASK(bit);
+				if (value) {
+					ws[first] |= head;
 				} else {
-					Base::At(set) &= ~DE_BS_BITMASK(bit);
+					ws[first] &= ~head;
+				}
+				if (first == last) {
+					return;
+				}
+				ChunkType fill = (value ? ~ChunkType(0) : 0);
+				for (size_t i = first + 1; i < last; ++i) {
+					ws[i] = fill;
+				}
+				if (value) {
+					ws[last] |= tail;
+				} else {
+					ws[last] &= ~tail;
+				}
+			}
+			void BitSet::ClearTail() {
+				if ((_count & Mask) != 0) {
+					Base::At(_count >> SizeOffset) &= (ChunkType(1) << (_count & Mask)) - 1;
 				}
 			}
 
-			void BitSet::PushBackChunk(ChunkType chunk) {
-				if (_curB == BitsPerChunk) {
-					Base::PushBack(chunk);
-				} else {
-					Base::At(Base::Count() - 1) |= (chunk>>_curB);
-					Base::PushBack(chunk<<(BitsPerChunk - _curB));
+			void BitSet::CheckSize(const BitSet &rhs) const {
+				if (rhs._count != _count) {
+					throw InvalidArgumentException(_TEXT("the sets have different sizes"));
+				}
+			}
+			BitSet &BitSet::operator &=(const BitSet &rhs) {
+				CheckSize(rhs);
+				if (_count == 0) {
+					return *this;
+				}
+				ChunkType *ws = &Base::At(0);
+				const ChunkType *rs = *rhs;
+				for (size_t i = 0, n = Base::Count(); i < n; ++i) {
+					ws[i] &= rs[i];
+				}
+				return *this;
+			}
+			BitSet &BitSet::operator |=(const BitSet &rhs) {
+				CheckSize(rhs);
+				if (_count == 0) {
+					return *this;
+				}
+				ChunkType *ws = &Base::At(0);
+				const ChunkType *rs = *rhs;
+				for (size_t i = 0, n = Base::Count(); i < n; ++i) {
+					ws[i] |= rs[i];
+				}
+				return *this;
+			}
+			BitSet &BitSet::operator ^=(const BitSet &rhs) {
+				CheckSize(rhs);
+				if (_count == 0) {
+					return *this;
+				}
+				ChunkType *ws = &Base::At(0);
+				const ChunkType *rs = *rhs;
+				for (size_t i = 0, n = Base::Count(); i < n; ++i) {
+					ws[i] ^= rs[i];
 				}
+				return *this;
 			}
-			BitSet::ChunkType BitSet::PopBackChunk() {
-				if (_curB == BitsPerChunk) {
-					if (Base::Count() == 0) {
-                        throw InvalidOperationException(_TEXT("the BitSet is empty"));
+			void BitSet::Flip() {
+				if (_count == 0) {
+					return;
+				}
+				ChunkType *ws = &Base::At(0);
+				for (size_t i = 0, n = Base::Count(); i < n; ++i) {
+					ws[i] = ~ws[i];
+				}
+				ClearTail();
+			}
+			bool BitSet::operator ==(const BitSet &rhs) const {
+				return _count == rhs._count && (_count == 0 || memcmp(**this, *rhs, Base::Count() * sizeof(ChunkType)) == 0);
+			}
+
+			size_t BitSet::PopCount() const {
+				const ChunkType *ws = **this;
+				size_t res = 0;
+				for (size_t i = 0, n = Base::Count(); i < n; ++i) {
+					res += PopCount(ws[i]);
+				}
+				return res;
+			}
+
+			RankSelectIndex::RankSelectIndex(const BitSet &bits) : _bits(bits) {
+				const BitSet::ChunkType *ws = *_bits;
+				size_t n = _bits.ChunkCount();
+				for (size_t i = 0, sample = 0; i < n; ++i) {
+					if (i % BlockWords == 0) {
+						_blocks.PushBack(_ones);
+					}
+					_ones += BitSet::PopCount(ws[i]);
+					for (; sample < _ones; sample += SelectSample) {
+						_samples.PushBack(i / BlockWords);
 					}
-                    return Base::PopBack();
 				}
-				if (Base::Count() < 2) {
-					throw InvalidOperationException(_TEXT("not enough bits"));
+			}
+			size_t RankSelectIndex::Rank(size_t pos) const {
+				if (pos > _bits.Count()) {
+					throw OverflowException(_TEXT("index overflow"));
+				}
+				if (pos == _bits.Count()) {
+					return _ones;
+				}
+				const BitSet::ChunkType *ws = *_bits;
+				size_t word = pos >> BitSet::SizeOffset, res = _blocks[word / BlockWords];
+				for (size_t i = word - word % BlockWords; i < word; ++i) {
+					res += BitSet::PopCount(ws[i]);
+				}
+				return res + BitSet::PopCount(ws[word] & ((BitSet::ChunkType(1) << (pos & BitSet::Mask)) - 1));
+			}
+			size_t RankSelectIndex::Select(size_t rank) const {
+				if (rank >= _ones) {
+					throw OverflowException(_TEXT("index overflow"));
+				}
+				// the one is in the last block with at most rank ones before it, which lies between two samples
+				const size_t *bs = *_blocks, *ss = *_samples, s = rank / SelectSample;
+				size_t lo = ss[s], hi = (s + 1 < _samples.Count() ? ss[s + 1] + 1 : _blocks.Count());
+				while (hi - lo > 1) {
+					size_t mid = (lo + hi) / 2;
+					if (bs[mid] <= rank) {
+						lo = mid;
+					} else {
+						hi = mid;
+					}
+				}
+				const BitSet::ChunkType *ws = *_bits;
+				rank -= bs[lo];
+				size_t word = lo * BlockWords;
+				for (size_t c; (c = BitSet::PopCount(ws[word])) <= rank; ++word) {
+					rank -= c;
+				}
+				BitSet::ChunkType w = ws[word];
+				for (; rank > 0; --rank) {
+					w &= w - 1;
 				}
-				ChunkType ret = Base::PopBack()>>(BitsPerChunk - _curB);
-				return ret | (Base::At(Base::Count() - 1)<<_curB);
+				return (word << BitSet::SizeOffset) + BitSet::LowestBit(w);
 			}
 		}
 	}
@@ -6,58 +6,177 @@
 namespace DE {
 	namespace Core {
 		namespace Collections {
-			class BitSet : protected List<unsigned char, false> {
+			// the bits are kept in 64-bit words, bit i being bit (i & Mask) of word (i >> SizeOffset), so that on the
+			// little-endian machines the engine runs on, bit i is also bit (i & 7) of byte (i >> 3). bits are read from and
+			// written to memory in that order. the bits of the last word past Count() are always zero
+			class BitSet : protected List<unsigned long long, true> {
 				public:
-					typedef unsigned char ChunkType;
-					constexpr static size_t SizeOffset = 3, BitsPerChunk = 1 << SizeOffset, Mask = BitsPerChunk - 1;
+					typedef unsigned long long ChunkType;
+					constexpr static size_t SizeOffset = 6, BitsPerChunk = 1 << SizeOffset, Mask = BitsPerChunk - 1;
 
-					void PushBack(bool);
+					BitSet() = default;
+					BitSet(bool value, size_t count) {
+						Resize(count, value);
+					}
+
+					void PushBack(bool v) {
+						if ((_count & Mask) == 0) {
+							Base::PushBack(0);
+						}
+						if (v) {
+							Base::At(_count >> SizeOffset) |= ChunkType(1) << (_count & Mask);
+						}
+						++_count;
+					}
 					void PushBackBits(const BitSet &rhs) {
-						PushBackBits(*rhs, rhs.Count());
+						if (&rhs == this) { // the copy keeps the words while this grows
+							BitSet copy(rhs);
+							PushBackBits(*copy, copy.Count());
+						} else {
+							PushBackBits(*rhs, rhs.Count());
+						}
 					}
 					void PushBackBits(const void*, size_t);
 
 					bool PopBack();
 					BitSet PopBackBits(size_t len) {
-						size_t csz = ((len + BitsPerChunk - 1) >> SizeOffset) * sizeof(ChunkType);
-						ChunkType *arr = (ChunkType*)GlobalAllocator::Allocate(csz);
-						memset(arr, 0, csz);
-						PopBackBits(arr, len);
-						BitSet ret;
-						ret.PushBackBits(arr, len);
-						GlobalAllocator::Free(arr);
+						if (len > _count) {
+							throw InvalidOperationException(_TEXT("not enough bits"));
+						}
+						BitSet ret = Subsequence(_count - len, len);
+						Resize(_count - len);
 						return ret;
 					}
-					void PopBackBits(void*, size_t);
+					// writes the bits to (len + 7) / 8 bytes, the bits of the last byte past them being zero
+					void PopBackBits(void*, size_t len);
 
-					void Subsequence(void*, size_t, size_t) const;
-					BitSet Subsequence(size_t, size_t) const;
+					// writes the bits to (len + 7) / 8 bytes, the bits of the last byte past them being zero
+					void Subsequence(void*, size_t start, size_t len) const;
+					BitSet Subsequence(size_t start, size_t len) const;
 
-					bool GetAt(size_t) const;
-					void SetAt(size_t, bool);
+					bool GetAt(size_t id) const {
+						if (id >= _count) {
+							throw OverflowException(_TEXT("index overflow"));
+						}
+						return (Base::At(id >> SizeOffset) >> (id & Mask)) & 1;
+					}
+					void SetAt(size_t id, bool v) {
+						if (id >= _count) {
+							throw OverflowException(_TEXT("index overflow"));
+						}
+						ChunkType &w = Base::At(id >> SizeOffset);
+						ChunkType m = ChunkType(1) << (id & Mask);
+						if (v) {
+							w |= m;
+						} else {
+							w &= ~m;
+						}
+					}
+					// new bits are set to the value
+					void Resize(size_t, bool value = false);
+					void Fill(size_t start, size_t count, bool value);
 					void Clear() {
 						Base::Clear();
-						_curB = BitsPerChunk;
+						_count = 0;
+					}
+
+					// the sets must have the same number of bits, or InvalidArgumentException is thrown
+					BitSet &operator &=(const BitSet&);
+					BitSet &operator |=(const BitSet&);
+					BitSet &operator ^=(const BitSet&);
+					BitSet operator &(const BitSet &rhs) const {
+						BitSet res(*this);
+						return res &= rhs;
+					}
+					BitSet operator |(const BitSet &rhs) const {
+						BitSet res(*this);
+						return res |= rhs;
+					}
+					BitSet operator ^(const BitSet &rhs) const {
+						BitSet res(*this);
+						return res ^= rhs;
+					}
+					BitSet operator ~() const {
+						BitSet res(*this);
+						res.Flip();
+						return res;
+					}
+					void Flip();
+					bool operator ==(const BitSet&) const;
+					bool operator !=(const BitSet &rhs) const {
+						return !(*this == rhs);
 					}
 
-					using List<unsigned char, false>::operator*;
+					using List<unsigned long long, true>::operator*;
 
 					size_t Count() const {
-						return (Base::Count() << SizeOffset) - (BitsPerChunk - _curB);
+						return _count;
 					}
+					// the number of bits that are set
+					size_t PopCount() const;
 					size_t ChunkCount() const {
 						return Base::Count();
 					}
 					size_t Capicy() const {
 						return Base::Capicy() << SizeOffset;
 					}
+
+					static size_t PopCount(ChunkType w) {
+#if defined(__GNUC__)
+						return static_cast<size_t>(__builtin_popcountll(w));
+#else
+						w -= (w >> 1) & 0x5555555555555555ULL;
+						w = (w & 0x3333333333333333ULL) + ((w >> 2) & 0x3333333333333333ULL);
+						w = (w + (w >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+						return static_cast<size_t>((w * 0x0101010101010101ULL) >> 56);
+#endif
+					}
+					// the position of the lowest bit that's set, which there must be
+					static size_t LowestBit(ChunkType w) {
+#if defined(__GNUC__)
+						return static_cast<size_t>(__builtin_ctzll(w));
+#else
+						return PopCount((w & (0 - w)) - 1);
+#endif
+					}
 				private:
-					typedef List<unsigned char, false> Base;
+					typedef List<unsigned long long, true> Base;
+
+					size_t _count = 0;
 
-					void PushBackChunk(ChunkType);
-					ChunkType PopBackChunk();
+					static size_t WordCount(size_t bits) {
+						return (bits + Mask) >> SizeOffset;
+					}
+					// the len bits from start, len being at most BitsPerChunk
+					ChunkType GetWord(size_t start, size_t len) const;
+					void ClearTail();
+					void CheckSize(const BitSet&) const;
+			};
+			// rank and select over a snapshot of a BitSet, which shares the bits of the set until the set changes. the
+			// index keeps the number of ones before every BlockWords words, an eighth of the size of the set, and the block
+			// of every SelectSample-th one, which narrows down the blocks that select searches
+			class RankSelectIndex {
+				public:
+					constexpr static size_t BlockWords = 8, SelectSample = 1<<12;
 
-					size_t _curB = BitsPerChunk;
+					RankSelectIndex() = default;
+					explicit RankSelectIndex(const BitSet&);
+
+					// the number of ones before the position, which may be the size of the set
+					size_t Rank(size_t) const;
+					// the position of the one with the given rank. throws OverflowException if there are not so many ones
+					size_t Select(size_t) const;
+
+					const BitSet &Bits() const {
+						return _bits;
+					}
+					size_t PopCount() const {
+						return _ones;
+					}
+				private:
+					BitSet _bits;
+					List<size_t, true> _blocks, _samples;
+					size_t _ones = 0;
 			};
 		}
 	}
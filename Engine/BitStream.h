@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstring>
+
+namespace DE {
+	namespace IO {
+		// the bits of a stream go from the lowest to the highest bit of each byte, and a 64-bit buffer is moved to and
+		// from memory a word at a time, in the byte order of little-endian machines
+		class BitWriter {
+			public:
+				typedef unsigned long long WordType;
+				constexpr static size_t MaxBitsBetweenFlushes = 56;
+
+				// at least 8 bytes past the last one written must be writable
+				explicit BitWriter(void *out) : _begin(static_cast<unsigned char*>(out)), _pos(_begin) {
+				}
+
+				// the bits above count must be zero; call Flush() before more than MaxBitsBetweenFlushes are written
+				void Write(WordType bits, size_t count) {
+					_buf |= bits << _count;
+					_count += count;
+				}
+				void Flush() {
+					memcpy(_pos, &_buf, sizeof(WordType));
+					_pos += _count>>3;
+					_buf >>= (_count & ~size_t(7));
+					_count &= 7;
+				}
+				// writes the last partial byte, padded with zeros, and returns the number of bytes written
+				size_t Finish() {
+					Flush();
+					if (_count > 0) {
+						++_pos;
+						_buf = 0;
+						_count = 0;
+					}
+					return _pos - _begin;
+				}
+				size_t GetBitCount() const {
+					return ((_pos - _begin)<<3) + _count;
+				}
+			private:
+				unsigned char *_begin, *_pos;
+				WordType _buf = 0;
+				size_t _count = 0;
+		};
+		// reads what a BitWriter has written. reading past the end gives zeros, which IsOverrun() tells afterwards
+		class BitReader {
+			public:
+				typedef unsigned long long WordType;
+				constexpr static size_t MinBitsAfterRefill = 56;
+
+				BitReader(const void *data, size_t size) :
+					_begin(static_cast<const unsigned char*>(data)), _pos(_begin), _end(_begin + size) {
+				}
+
+				void Refill() {
+					if (_end - _pos >= static_cast<ptrdiff_t>(sizeof(WordType))) {
+						WordType word;
+						memcpy(&word, _pos, sizeof(WordType));
+						_buf |= word << _count;
+						_pos += (63 - _count)>>3;
+						_count |= 56;
+					} else {
+						for (; _count <= 56; _count += 8) {
+							if (_pos < _end) {
+								_buf |= static_cast<WordType>(*_pos++) << _count;
+							} else {
+								++_padding;
+							}
+						}
+					}
+				}
+				// count must not be more than the bits available, which is at least MinBitsAfterRefill after Refill()
+				WordType Peek(size_t count) const {
+					return _buf & ((WordType(1) << count) - 1);
+				}
+				void Consume(size_t count) {
+					_buf >>= count;
+					_count -= count;
+				}
+				WordType Read(size_t count) {
+					Refill();
+					WordType v = Peek(count);
+					Consume(count);
+					return v;
+				}
+
+				size_t GetBitPosition() const {
+					return ((_pos - _begin + _padding)<<3) - _count;
+				}
+				bool IsOverrun() const {
+					return GetBitPosition() > static_cast<size_t>(_end - _begin)<<3;
+				}
+			private:
+				const unsigned char *_begin, *_pos, *_end;
+				WordType _buf = 0;
+				size_t _count = 0, _padding = 0;
+		};
+	}
+}
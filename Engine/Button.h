@@ -29,6 +29,7 @@ namespace DE {
 				virtual void Update(double) override {
 					if (!this->IsMouseOver() && ((int)_state & (int)ButtonState::MouseDown) && !Core::IsKeyDown(VK_LBUTTON)) {
 						_state = (ButtonState)((int)_state & (~(int)ButtonState::MouseDown));
+						this->Invalidate();
 					}
 				}
 
@@ -1,9 +1,14 @@
 #pragma once
 
+#include <cmath>
+#include <utility>
+
 #include "Math.h"
 #include "Vector2.h"
 #include "List.h"
+#include "Rectangle.h"
 #include "UtilsCommon.h"
+#include "ThreadPool.h"
 
 namespace DE {
 	namespace Utils {
@@ -33,6 +38,230 @@ namespace DE {
 				}
 			};
 
+			// buckets objects by the square cells of a uniform grid; cells are hashed into a fixed number of buckets,
+			// so the grid has no bounds, and queries may also return objects from other cells that share a bucket
+			// points are single positions that can be moved, regions are rectangles that are all set at once
+			class SpatialHash {
+				public:
+					void Reset(double cellSize, size_t pointCount) { // removes everything
+						_cell = cellSize;
+						_pointMask = GetBucketCount(pointCount) - 1;
+						Fill(_pointHead, Empty, _pointMask + 1);
+						Fill(_bucketStamp, 0, _pointMask + 1);
+						Fill(_pointNext, Empty, pointCount);
+						Fill(_pointPrev, Empty, pointCount);
+						Fill(_pointBucket, Empty, pointCount);
+						_regionMask = 0;
+						_regionStart.Clear();
+						_regionID.Clear();
+						_regionStamp.Clear();
+						_stamp = 0;
+					}
+
+					void InsertPoint(size_t id, const Core::Math::Vector2 &pos) { // id < pointCount
+						Link(id, GetBucket(GetCell(pos.X), GetCell(pos.Y), _pointMask));
+					}
+					void MovePoint(size_t id, const Core::Math::Vector2 &pos) {
+						size_t b = GetBucket(GetCell(pos.X), GetCell(pos.Y), _pointMask);
+						if (b != _pointBucket[id]) {
+							Unlink(id);
+							Link(id, b);
+						}
+					}
+					// replaces all regions, the ids are the indices in the list
+					void SetRegions(const Core::Collections::List<Core::Math::Rectangle> &rgns) {
+						const Core::Math::Rectangle *r = *rgns;
+						SetRegions(rgns.Count(), [r](size_t i) {
+							return r[i];
+						});
+					}
+					// replaces all regions with count regions whose bounds are given by bounds(id)
+					// the region ids of each bucket are stored contiguously, since they don't move
+					template <typename Bounds> void SetRegions(size_t count, const Bounds &bounds) {
+						size_t entries = 0;
+						for (size_t i = 0; i < count; ++i) {
+							Core::Math::Rectangle rgn = bounds(i);
+							entries += static_cast<size_t>(
+								(GetCell(rgn.Right) - GetCell(rgn.Left) + 1) * (GetCell(rgn.Bottom) - GetCell(rgn.Top) + 1)
+							);
+						}
+						_regionMask = GetBucketCount(entries) - 1;
+						Fill(_regionStart, 0, _regionMask + 2);
+						Fill(_regionID, 0, entries);
+						Fill(_regionStamp, 0, count);
+						size_t *start = *_regionStart;
+						ForEachRegionBucket(count, bounds, [&](size_t, size_t b) {
+							++start[b + 1];
+						});
+						for (size_t i = 1; i < _regionStart.Count(); ++i) {
+							start[i] += start[i - 1];
+						}
+						size_t *ids = *_regionID;
+						ForEachRegionBucket(count, bounds, [&](size_t id, size_t b) { // start[b] points to the next free slot of b
+							ids[start[b]++] = id;
+						});
+						for (size_t i = _regionStart.Count() - 1; i > 0; --i) {
+							start[i] = start[i - 1];
+						}
+						start[0] = 0;
+					}
+
+					// calls func(id) once for every point that may be in the region
+					template <typename Func> void QueryPoints(const Core::Math::Rectangle &rgn, const Func &func) {
+						++_stamp;
+						const size_t *head = *_pointHead, *next = *_pointNext;
+						size_t *stamps = *_bucketStamp;
+						long long x1 = GetCell(rgn.Right), y1 = GetCell(rgn.Bottom);
+						for (long long y = GetCell(rgn.Top); y <= y1; ++y) {
+							for (long long x = GetCell(rgn.Left); x <= x1; ++x) {
+								size_t b = GetBucket(x, y, _pointMask);
+								if (stamps[b] == _stamp) { // two cells of the region share this bucket
+									continue;
+								}
+								stamps[b] = _stamp;
+								for (size_t id = head[b]; id != Empty; id = next[id]) {
+									func(id);
+								}
+							}
+						}
+					}
+					// calls func(id) once for every region that may overlap the given one
+					template <typename Func> void QueryRegions(const Core::Math::Rectangle &rgn, const Func &func) {
+						if (_regionStamp.Count() == 0) {
+							return;
+						}
+						++_stamp;
+						const size_t *start = *_regionStart, *ids = *_regionID;
+						size_t *stamps = *_regionStamp;
+						long long x1 = GetCell(rgn.Right), y1 = GetCell(rgn.Bottom);
+						for (long long y = GetCell(rgn.Top); y <= y1; ++y) {
+							for (long long x = GetCell(rgn.Left); x <= x1; ++x) {
+								size_t b = GetBucket(x, y, _regionMask);
+								for (const size_t *cur = ids + start[b], *end = ids + start[b + 1]; cur != end; ++cur) {
+									if (stamps[*cur] != _stamp) {
+										stamps[*cur] = _stamp;
+										func(*cur);
+									}
+								}
+							}
+						}
+					}
+					// the same as QueryRegions, except that a region is reported once for every cell of the query it's in
+					// since nothing is modified, several threads can query at the same time
+					template <typename Func> void QueryRegionsConcurrent(const Core::Math::Rectangle &rgn, const Func &func) const {
+						if (_regionStamp.Count() == 0) {
+							return;
+						}
+						const size_t *start = *_regionStart, *ids = *_regionID;
+						size_t seen[MaxSeenBuckets], cells = 0;
+						long long x0 = GetCell(rgn.Left), y0 = GetCell(rgn.Top), x1 = GetCell(rgn.Right), y1 = GetCell(rgn.Bottom);
+						for (long long y = y0; y <= y1; ++y) {
+							for (long long x = x0; x <= x1; ++x, ++cells) {
+								size_t b = GetBucket(x, y, _regionMask);
+								if (IsBucketSeen(b, seen, cells, x0, y0, x1)) { // two cells of the query share this bucket
+									continue;
+								}
+								if (cells < MaxSeenBuckets) {
+									seen[cells] = b;
+								}
+								for (const size_t *cur = ids + start[b], *end = ids + start[b + 1]; cur != end; ++cur) {
+									func(*cur);
+								}
+							}
+						}
+					}
+				private:
+					constexpr static size_t Empty = static_cast<size_t>(-1);
+					constexpr static double MaxCell = 1e12; // keeps far away or invalid coordinates from overflowing
+					constexpr static size_t MaxSeenBuckets = 16;
+
+					double _cell = 1.0;
+					size_t _pointMask = 0, _regionMask = 0, _stamp = 0;
+					Core::Collections::List<size_t, true>
+						_pointHead, _pointNext, _pointPrev, _pointBucket, _bucketStamp,
+						_regionStart, _regionID, _regionStamp;
+
+					static size_t GetBucketCount(size_t objects) {
+						size_t buckets = 64;
+						while (buckets < 2 * objects) {
+							buckets <<= 1;
+						}
+						return buckets;
+					}
+					static void Fill(Core::Collections::List<size_t, true> &list, size_t v, size_t count) {
+						list.Clear();
+						if (count > 0) {
+							list.PushBack(v, count);
+						}
+					}
+					long long GetCell(double v) const {
+						double c = std::floor(v / _cell);
+						return static_cast<long long>(c > -MaxCell ? (c < MaxCell ? c : MaxCell) : -MaxCell);
+					}
+					static size_t GetBucket(long long x, long long y, size_t mask) {
+						unsigned long long h =
+							static_cast<unsigned long long>(x) * 0x9E3779B97F4A7C15ull ^
+							static_cast<unsigned long long>(y) * 0xC2B2AE3D27D4EB4Full;
+						return static_cast<size_t>(h ^ (h >> 32)) & mask;
+					}
+					template <typename Bounds, typename Func> void ForEachRegionBucket(size_t count, const Bounds &bounds, const Func &func) const {
+						for (size_t i = 0; i < count; ++i) {
+							Core::Math::Rectangle rgn = bounds(i);
+							long long x1 = GetCell(rgn.Right), y1 = GetCell(rgn.Bottom);
+							for (long long y = GetCell(rgn.Top); y <= y1; ++y) {
+								for (long long x = GetCell(rgn.Left); x <= x1; ++x) {
+									func(i, GetBucket(x, y, _regionMask));
+								}
+							}
+						}
+					}
+					// whether one of the first cells of a query maps to bucket b; the buckets of the first
+					// MaxSeenBuckets cells are remembered in seen, the others are computed again
+					bool IsBucketSeen(size_t b, const size_t *seen, size_t cells, long long x0, long long y0, long long x1) const {
+						for (size_t i = 0; i < cells && i < MaxSeenBuckets; ++i) {
+							if (seen[i] == b) {
+								return true;
+							}
+						}
+						if (cells > MaxSeenBuckets) {
+							long long width = x1 - x0 + 1;
+							for (size_t i = MaxSeenBuckets; i < cells; ++i) {
+								long long cell = static_cast<long long>(i);
+								if (GetBucket(x0 + cell % width, y0 + cell / width, _regionMask) == b) {
+									return true;
+								}
+							}
+						}
+						return false;
+					}
+					void Link(size_t id, size_t b) {
+						size_t &head = _pointHead[b];
+						_pointBucket[id] = b;
+						_pointPrev[id] = Empty;
+						_pointNext[id] = head;
+						if (head != Empty) {
+							_pointPrev[head] = id;
+						}
+						head = id;
+					}
+					void Unlink(size_t id) {
+						size_t prev = _pointPrev[id], next = _pointNext[id];
+						if (prev == Empty) {
+							_pointHead[_pointBucket[id]] = next;
+						} else {
+							_pointNext[prev] = next;
+						}
+						if (next != Empty) {
+							_pointPrev[next] = prev;
+						}
+					}
+			};
+
+			enum class SolverType {
+				Sequential, // pairs are separated one after another, in the order of the characters
+				Parallel // all characters are moved at once from the positions of the last iteration, on a thread pool
+			};
+
 			class Environment { // TODO: terribly incomplete & use customized speed direction
 				public:
 					constexpr static double DefaultFrequency = 60.0;
@@ -64,6 +293,28 @@ namespace DE {
 					const size_t &Iterations() const {
 						return _iters;
 					}
+					// when enabled, only nearby characters and walls are tested; the results are the same either way
+					// only used by the sequential solver
+					bool &Broadphase() {
+						return _broad;
+					}
+					const bool &Broadphase() const {
+						return _broad;
+					}
+					// the parallel solver gives the same results for any number of threads, but not the same as the sequential one
+					SolverType &Solver() {
+						return _solver;
+					}
+					const SolverType &Solver() const {
+						return _solver;
+					}
+					// the pool used by the parallel solver, ThreadPool::Default() if nullptr
+					Core::ThreadPool *&Pool() {
+						return _pool;
+					}
+					Core::ThreadPool *const &Pool() const {
+						return _pool;
+					}
 
 					void Update(double dt) {
 						_intv += dt;
@@ -75,90 +326,341 @@ namespace DE {
 				private:
 					Core::Collections::List<Wall> _walls;
 					Core::Collections::List<Character> _chars;
-					double _hz = DefaultFrequency, _intv, _oohz = 1.0 / DefaultFrequency;
+					double _hz = DefaultFrequency, _intv = 0.0, _oohz = 1.0 / DefaultFrequency;
 					size_t _iters = 10;
+					bool _broad = true;
+					SpatialHash _hash;
+					constexpr static size_t NoWall = static_cast<size_t>(-1);
+					Core::Collections::List<Core::Math::Rectangle> _wallBounds;
+					Core::Collections::List<size_t, true> _near; // only grows, the first _nearCount are used
+					size_t _nearCount = 0;
+					SolverType _solver = SolverType::Sequential;
+					Core::ThreadPool *_pool = nullptr;
+					// the characters as seen by the parallel solver, stored as structure of arrays
+					// positions are double buffered; they're copied from and back to _chars in every update
+					SpatialHash _charHash;
+					Core::Collections::List<double, true> _x, _y, _newX, _newY, _size, _speed;
+					Core::Collections::List<unsigned, true> _group, _dir;
+
+					constexpr static size_t ParallelBatch = 512; // the number of characters handled by one iteration of the pool
 
 					void DoUpdate() {
+						if (_solver == SolverType::Parallel) {
+							SolveParallel();
+							return;
+						}
 						for (size_t i = 0; i < _chars.Count(); ++i) {
 							Character &cc = _chars[i];
-							unsigned d = (unsigned)cc.GoingDirection;
-							double spd = cc.MoveSpeed;
-							Core::Math::Vector2 gdir;
-							if (d & (unsigned)Direction::Left) {
-								gdir.X -= spd;
-							}
-							if (d & (unsigned)Direction::Right) {
-								gdir.X += spd;
-							}
-							if (d & (unsigned)Direction::Up) {
-								gdir.Y -= spd;
-							}
-							if (d & (unsigned)Direction::Down) {
-								gdir.Y += spd;
-							}
-							if (Core::Math::Abs(gdir.X * gdir.Y) > 0.0) {
-								gdir *= Core::Math::OneOverSqrtTwo;
+							cc.Position += GetVelocity((unsigned)cc.GoingDirection, cc.MoveSpeed) * _oohz;
+						}
+						if (_broad) {
+							SolveWithBroadphase();
+						} else {
+							SolveAllPairs();
+						}
+					}
+
+					static Core::Math::Vector2 GetVelocity(unsigned d, double spd) {
+						Core::Math::Vector2 gdir;
+						if (d & (unsigned)Direction::Left) {
+							gdir.X -= spd;
+						}
+						if (d & (unsigned)Direction::Right) {
+							gdir.X += spd;
+						}
+						if (d & (unsigned)Direction::Up) {
+							gdir.Y -= spd;
+						}
+						if (d & (unsigned)Direction::Down) {
+							gdir.Y += spd;
+						}
+						if (Core::Math::Abs(gdir.X * gdir.Y) > 0.0) {
+							gdir *= Core::Math::OneOverSqrtTwo;
+						}
+						return gdir;
+					}
+
+					static bool SeparateCharacters(Character &cc, Character &acc) { // returns whether they've been moved
+						if (
+							(cc.Group & acc.Group) == 0 ||
+							(cc.Position - acc.Position).LengthSquared() >=
+							Core::Math::Square(cc.Size + acc.Size)
+						) {
+							return false;
+						}
+						Core::Math::Vector2 vdiff = acc.Position - cc.Position;
+						double dis = vdiff.Length();
+						if (dis == 0.0) { // any direction will do, but don't divide by zero
+							vdiff = Core::Math::Vector2(1.0, 0.0);
+							dis = 1.0;
+						}
+						Core::Math::Vector2
+							p1 = cc.Position + vdiff * (cc.Size / dis),
+							p2 = acc.Position + (-vdiff) * (acc.Size / dis),
+							pmid = (p1 + p2) / 2.0;
+						cc.Position = pmid + (cc.Position - p1);
+						acc.Position = pmid + (acc.Position - p2); // TODO: just an approximate approach
+						return true;
+					}
+					static bool IsNearerWall(double dist, size_t id, double minDist, size_t minID) { // the first wall wins ties
+						return minID == NoWall || dist < minDist || (dist == minDist && id < minID);
+					}
+					// returns whether pos has been moved; only reads the walls, so it can be called from several threads
+					bool PushOutOfWall(Core::Math::Vector2 &pos, double size, size_t wallID, double minDist) const {
+						if (wallID == NoWall || !(minDist <= size)) {
+							return false;
+						}
+						const Wall *nearest = &_walls[wallID];
+						Core::Math::Vector2 ccp, wNormal = nearest->Node2 - nearest->Node1;
+						wNormal.RotateLeft90();
+						if (
+							wNormal.LengthSquared() > 0.0 && // zero-length walls only have the end points
+							Core::Math::Vector2::Cross(pos - nearest->Node1, wNormal) *
+							Core::Math::Vector2::Cross(pos - nearest->Node2, wNormal) <= 0.0
+						) {
+							ccp = Core::Math::ProjectionY(pos - nearest->Node1, nearest->Node2 - nearest->Node1) + nearest->Node1;
+						} else {
+							if ((nearest->Node1 - pos).LengthSquared() > (nearest->Node2 - pos).LengthSquared()) {
+								ccp = nearest->Node2;
+							} else {
+								ccp = nearest->Node1;
 							}
-							cc.Position += gdir * _oohz;
 						}
+						Core::Math::Vector2 dir = pos - ccp;
+						if (dir.LengthSquared() > 1.0) {
+							dir.SetLength(size);
+						}
+						pos = ccp + dir;
+						return true;
+					}
+
+					void SolveAllPairs() {
 						for (size_t i = 0; i < _iters; ++i) {
 							for (size_t j = 0; j < _chars.Count(); ++j) {
 								Character &cc = _chars[j];
 								for (size_t k = j + 1; k < _chars.Count(); ++k) {
-									Character &acc = _chars[k];
-									if (
-										(cc.Group & acc.Group) == 0 ||
-										(cc.Position - acc.Position).LengthSquared() >=
-										Core::Math::Square(cc.Size + acc.Size)
-									) {
-										continue;
-									}
-									Core::Math::Vector2 vdiff = acc.Position - cc.Position;
-									double dis = vdiff.Length();
-									Core::Math::Vector2
-										p1 = cc.Position + vdiff * (cc.Size / dis),
-										p2 = acc.Position + (-vdiff) * (acc.Size / dis),
-										pmid = (p1 + p2) / 2.0;
-									cc.Position = pmid + (cc.Position - p1);
-									acc.Position = pmid + (acc.Position - p2); // TODO: just an approximate approach
+									SeparateCharacters(cc, _chars[k]);
 								}
-								Wall *nearest = nullptr;
+								size_t nearest = NoWall;
 								double minDist = 0.0;
 								for (size_t k = 0; k < _walls.Count(); ++k) {
-									Wall &cw = _walls[k];
+									const Wall &cw = _walls[k];
 									if ((cc.Group & cw.Group) == 0) {
 										continue;
 									}
 									double cDist = Core::Math::PointSegmentDistance(cc.Position, cw.Node1, cw.Node2);
-									if (nearest == nullptr || cDist < minDist) {
-										nearest = &cw;
+									if (IsNearerWall(cDist, k, minDist, nearest)) {
+										nearest = k;
 										minDist = cDist;
 									}
 								}
-								if (nearest && minDist <= cc.Size) {
-									Core::Math::Vector2 ccp, wNormal = nearest->Node2 - nearest->Node1;
-									wNormal.RotateLeft90();
-									if (
-										Core::Math::Vector2::Cross(cc.Position - nearest->Node1, wNormal) *
-										Core::Math::Vector2::Cross(cc.Position - nearest->Node2, wNormal) <= 0.0
-									) {
-										ccp = Core::Math::ProjectionY(cc.Position - nearest->Node1, nearest->Node2 - nearest->Node1) + nearest->Node1;
-									} else {
-										if ((nearest->Node1 - cc.Position).LengthSquared() > (nearest->Node2 - cc.Position).LengthSquared()) {
-											ccp = nearest->Node2;
-										} else {
-											ccp = nearest->Node1;
+								PushOutOfWall(cc.Position, cc.Size, nearest, minDist);
+							}
+						}
+					}
+					void SetWallRegions(SpatialHash &hash) {
+						const Wall *walls = *_walls;
+						_wallBounds.Clear();
+						for (size_t i = 0; i < _walls.Count(); ++i) {
+							_wallBounds.PushBack(Core::Math::Rectangle(
+								Core::Math::Vector2(Core::Math::Min(walls[i].Node1.X, walls[i].Node2.X), Core::Math::Min(walls[i].Node1.Y, walls[i].Node2.Y)),
+								Core::Math::Vector2(Core::Math::Max(walls[i].Node1.X, walls[i].Node2.X), Core::Math::Max(walls[i].Node1.Y, walls[i].Node2.Y))
+							));
+						}
+						hash.SetRegions(_wallBounds);
+					}
+
+					// visits exactly the pairs that SolveAllPairs separates, in the same order
+					// characters are kept in a spatial hash with cells as large as the largest character; the characters
+					// near cc are gathered once, sorted by index, and gathered again only if cc is pushed further than
+					// the margin of the query, so that characters it's pushed into aren't missed
+					// a wall can only be handled if it's within cc.Size, so only those that are near are tested
+					void SolveWithBroadphase() {
+						if (_chars.Count() == 0) {
+							return;
+						}
+						Character *chars = *_chars;
+						const Wall *walls = *_walls;
+						double maxSize = 0.0;
+						for (size_t i = 0; i < _chars.Count(); ++i) {
+							maxSize = Core::Math::Max(maxSize, chars[i].Size);
+						}
+						if (!(maxSize > 0.0)) {
+							maxSize = 1.0;
+						}
+						double margin = maxSize;
+						_hash.Reset(2.0 * maxSize, _chars.Count());
+						for (size_t i = 0; i < _chars.Count(); ++i) {
+							_hash.InsertPoint(i, chars[i].Position);
+						}
+						SetWallRegions(_hash);
+						for (size_t i = 0; i < _iters; ++i) {
+							for (size_t j = 0; j < _chars.Count(); ++j) {
+								Character &cc = chars[j];
+								double reach = cc.Size + maxSize + margin;
+								for (size_t from = j + 1; ; ) {
+									Core::Math::Vector2 origin = cc.Position;
+									_nearCount = 0;
+									_hash.QueryPoints(
+										Core::Math::Rectangle(origin - Core::Math::Vector2(reach, reach), origin + Core::Math::Vector2(reach, reach)),
+										[&](size_t id) {
+											if (id >= from) {
+												if (_nearCount == _near.Count()) {
+													_near.PushBack(id);
+												} else {
+													_near[_nearCount] = id;
+												}
+												++_nearCount;
+											}
+										}
+									);
+									if (_nearCount > 1) {
+										Core::Math::UnstableSort(*_near, _nearCount);
+									}
+									bool outside = false;
+									for (size_t n = 0; n < _nearCount; ++n) {
+										if ((cc.Position - origin).LengthSquared() > margin * margin) {
+											outside = true;
+											break;
 										}
+										size_t k = _near[n];
+										if (SeparateCharacters(cc, chars[k])) {
+											_hash.MovePoint(j, cc.Position);
+											_hash.MovePoint(k, chars[k].Position);
+										}
+										from = k + 1;
+									}
+									if (!outside && (cc.Position - origin).LengthSquared() <= margin * margin) {
+										break;
 									}
-									Core::Math::Vector2 dir = cc.Position - ccp;
-									if (dir.LengthSquared() > 1.0) {
-										dir.SetLength(cc.Size);
+								}
+								size_t nearest = NoWall;
+								double minDist = 0.0;
+								_hash.QueryRegions(
+									Core::Math::Rectangle(
+										cc.Position - Core::Math::Vector2(cc.Size, cc.Size), cc.Position + Core::Math::Vector2(cc.Size, cc.Size)
+									),
+									[&](size_t k) {
+										if ((cc.Group & walls[k].Group) == 0) {
+											return;
+										}
+										double cDist = Core::Math::PointSegmentDistance(cc.Position, walls[k].Node1, walls[k].Node2);
+										if (IsNearerWall(cDist, k, minDist, nearest)) {
+											nearest = k;
+											minDist = cDist;
+										}
 									}
-									cc.Position = ccp + dir;
+								);
+								if (PushOutOfWall(cc.Position, cc.Size, nearest, minDist)) {
+									_hash.MovePoint(j, cc.Position);
 								}
 							}
 						}
 					}
+
+					template <typename T> static T *Resize(Core::Collections::List<T, true> &list, size_t count) {
+						if (list.Count() != count) {
+							list.Clear();
+							list.PushBack(T(), count);
+						}
+						return *list;
+					}
+					// jacobi iterations: every character is pushed by half of each overlap it had at the end of the last
+					// iteration, then out of the nearest wall. each character only reads the last positions and writes its
+					// own, so the characters are split between the threads in any way without changing the results
+					// the characters are put in a spatial hash as regions, which can be queried from several threads
+					void SolveParallel() {
+						size_t n = _chars.Count();
+						if (n == 0) {
+							return;
+						}
+						Core::ThreadPool &pool = (_pool ? *_pool : Core::ThreadPool::Default());
+						size_t batches = (n + ParallelBatch - 1) / ParallelBatch;
+						// all memory is allocated here, the threads only write to it
+						Character *chars = *_chars;
+						double
+							*x = Resize(_x, n), *y = Resize(_y, n), *newX = Resize(_newX, n), *newY = Resize(_newY, n),
+							*size = Resize(_size, n), *speed = Resize(_speed, n);
+						unsigned *group = Resize(_group, n), *dir = Resize(_dir, n);
+						double maxSize = 0.0;
+						for (size_t i = 0; i < n; ++i) {
+							maxSize = Core::Math::Max(maxSize, chars[i].Size);
+						}
+						if (!(maxSize > 0.0)) {
+							maxSize = 1.0;
+						}
+						_hash.Reset(2.0 * maxSize, 0);
+						SetWallRegions(_hash);
+						const Wall *walls = *_walls;
+
+						pool.ParallelFor(batches, [&](size_t batch) {
+							for (size_t i = batch * ParallelBatch, end = Core::Math::Min(i + ParallelBatch, n); i < end; ++i) {
+								const Character &cc = chars[i];
+								size[i] = cc.Size;
+								speed[i] = cc.MoveSpeed;
+								group[i] = cc.Group;
+								dir[i] = (unsigned)cc.GoingDirection;
+								Core::Math::Vector2 pos = cc.Position + GetVelocity(dir[i], speed[i]) * _oohz;
+								x[i] = pos.X;
+								y[i] = pos.Y;
+							}
+						});
+						for (size_t it = 0; it < _iters; ++it) {
+							_charHash.Reset(2.0 * maxSize, 0);
+							_charHash.SetRegions(n, [x, y](size_t i) {
+								return Core::Math::Rectangle(Core::Math::Vector2(x[i], y[i]), Core::Math::Vector2(x[i], y[i]));
+							});
+							pool.ParallelFor(batches, [&](size_t batch) {
+								for (size_t i = batch * ParallelBatch, end = Core::Math::Min(i + ParallelBatch, n); i < end; ++i) {
+									double px = x[i], py = y[i], ps = size[i], dx = 0.0, dy = 0.0, reach = ps + maxSize;
+									unsigned pg = group[i];
+									_charHash.QueryRegionsConcurrent(
+										Core::Math::Rectangle(Core::Math::Vector2(px - reach, py - reach), Core::Math::Vector2(px + reach, py + reach)),
+										[&](size_t k) {
+											if (k == i || (pg & group[k]) == 0) {
+												return;
+											}
+											double vx = x[k] - px, vy = y[k] - py, sum = ps + size[k], sqrDist = vx * vx + vy * vy;
+											if (sqrDist >= sum * sum) {
+												return;
+											}
+											if (sqrDist == 0.0) { // push them apart horizontally, the one that comes first to the left
+												dx += (i < k ? -0.5 : 0.5) * sum;
+												return;
+											}
+											double dist = std::sqrt(sqrDist), ratio = 0.5 * (dist - sum) / dist;
+											dx += vx * ratio;
+											dy += vy * ratio;
+										}
+									);
+									Core::Math::Vector2 pos(px + dx, py + dy);
+									size_t nearest = NoWall;
+									double minDist = 0.0;
+									_hash.QueryRegionsConcurrent( // a wall may be tested more than once, which doesn't change the result
+										Core::Math::Rectangle(pos - Core::Math::Vector2(ps, ps), pos + Core::Math::Vector2(ps, ps)),
+										[&](size_t k) {
+											if ((pg & walls[k].Group) == 0) {
+												return;
+											}
+											double cDist = Core::Math::PointSegmentDistance(pos, walls[k].Node1, walls[k].Node2);
+											if (IsNearerWall(cDist, k, minDist, nearest)) {
+												nearest = k;
+												minDist = cDist;
+											}
+										}
+									);
+									PushOutOfWall(pos, ps, nearest, minDist);
+									newX[i] = pos.X;
+									newY[i] = pos.Y;
+								}
+							});
+							std::swap(x, newX);
+							std::swap(y, newY);
+						}
+						for (size_t i = 0; i < n; ++i) {
+							chars[i].Position = Core::Math::Vector2(x[i], y[i]);
+						}
+					}
 			};
 		}
 	}
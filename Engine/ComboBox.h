@@ -201,15 +201,18 @@ namespace DE {
 					}
 					if (_selection) {
 						SetDefaultBrushes(_selection->_btn);
+						_selection->_btn.Invalidate();
 					}
 					_selection = item;
 					if (_selection) {
 						SetSelectedBrushes(_selection->_btn);
+						_selection->_btn.Invalidate();
 						this->_content = _selection->Content();
 						this->_content.LayoutRectangle = this->_actualLayout;
 					} else {
 						this->_content.Content = _TEXT("");
 					}
+					this->Invalidate();
 					OnSelectionChanged(ComboBoxSelectionChangedInfo<T>(item));
 				}
 				Item *GetSelectedItem() const {
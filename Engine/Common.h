@@ -3,9 +3,14 @@
 #include <cstdio>
 #include <cstdarg>
 #include <cstddef>
-#include <windows.h>
-#include <windowsx.h>
-#include <tchar.h>
+#ifdef DE_HEADLESS
+#	define _TEXT(X) X
+typedef char TCHAR;
+#else
+#	include <windows.h>
+#	include <windowsx.h>
+#	include <tchar.h>
+#endif
 #ifdef DEBUG
 #	include <iostream>
 #	include <fstream>
@@ -15,9 +20,11 @@
 
 namespace DE {
 	namespace Core {
+#ifndef DE_HEADLESS
 		inline bool IsKeyDown(int key) {
 			return GetAsyncKeyState(key) & 0x8000;
 		}
+#endif
 
 		template <typename T> class EqualityPredicate {
 			public:
@@ -77,6 +77,7 @@ namespace DE {
  				}
  				virtual void SetCursorColor(const Core::Color &c) {
  					_cursorColor = c;
+ 					Invalidate();
  				}
 
 				virtual void Write(const Core::String &str) {
@@ -110,6 +111,7 @@ namespace DE {
 						}
 					}
 					MakeCursorVisible();
+					Invalidate();
 				}
 				virtual void WriteLine(const Core::String &str) {
 					Write(str + _TEXT("\n"));
@@ -122,6 +124,7 @@ namespace DE {
 					_buf.PushBack(ConsoleLine(), _bufSize);
 					_cFVisLine = 0;
 					_sideBar.SetValue(0.0);
+					Invalidate();
 				}
 
 				virtual void MakeCursorVisible() {
@@ -237,6 +240,7 @@ namespace DE {
 						_sideBar.StepDistanceRatio() = 1.0 / static_cast<double>(_cVisLineNum);
 					}
 					_cFVisLine = static_cast<size_t>(round(v));
+					Invalidate();
 				}
 				virtual void FinishLayoutChange() override {
 					PanelBase::FinishLayoutChange();
@@ -244,10 +248,14 @@ namespace DE {
 				}
 				virtual void Update(double dt) override {
 					PanelBase::Update(dt);
+					bool caretShown = _caretTime < DefaultCaretPhase;
 					_caretTime += dt;
 					while (_caretTime > 2.0 * DefaultCaretPhase) {
 						_caretTime -= 2.0 * DefaultCaretPhase;
 					}
+					if (caretShown != (_caretTime < DefaultCaretPhase)) {
+						Invalidate();
+					}
 				}
 				virtual void Render(Graphics::Renderer &r) override {
 					if (_fnt != nullptr) {
@@ -505,7 +513,7 @@ namespace DE {
 					_input.KeyboardText += [&](const Core::Input::TextInfo &info) {
 						if (info.Char == _TEXT('\n') || info.Char == _TEXT('\r')) {
 							if (_runner != nullptr) {
-								_runner->OnCommand(_input.Text().Content);
+								_runner->OnCommand(_input.Text().Content.ToString());
 							}
 							_input.SetText(_TEXT(""));
 						}
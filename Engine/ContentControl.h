@@ -36,8 +36,16 @@ namespace DE {
 				virtual void FinishLayoutChange() override {
 					_content.LayoutRectangle = _actualLayout;
 				}
+				virtual void DetectVisualChanges() override {
+					Control::DetectVisualChanges();
+					if (_content.FormatVersion != _drawnVersion) {
+						_drawnVersion = _content.FormatVersion;
+						Invalidate();
+					}
+				}
 
 				T _content;
+				size_t _drawnVersion = 0;
 		};
 	}
 }
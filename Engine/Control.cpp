@@ -22,6 +22,9 @@ namespace DE {
 		Control::~Control() {
 			_disposing = true;
 			if (_world) {
+				if (_drawn) {
+					_world->Invalidate(_drawnBounds);
+				}
 				if (_world->FocusedControl() == this) {
 					_world->_focus = nullptr;
 				}
@@ -154,16 +157,79 @@ namespace DE {
 
 		bool Control::OnMouseDown(const MouseButtonInfo &info) {
 			InputElement::OnMouseDown(info);
+			InvalidateOnInput();
 			if (_focusable && info.ContainsKey(SystemKey::LeftMouse)) {
 				_world->SetFocus(this);
 				return true;
 			}
 			return false;
 		}
+		void Control::OnMouseUp(const MouseButtonInfo &info) {
+			InputElement::OnMouseUp(info);
+			InvalidateOnInput();
+		}
+		void Control::OnMouseEnter(const Info &info) {
+			InputElement::OnMouseEnter(info);
+			InvalidateOnInput();
+		}
+		void Control::OnMouseLeave(const Info &info) {
+			InputElement::OnMouseLeave(info);
+			InvalidateOnInput();
+		}
 		bool Control::OnMouseScroll(const Core::Input::MouseScrollInfo &info) {
 			InputElement::OnMouseScroll(info);
 			return false;
 		}
+		void Control::OnKeyDown(const KeyInfo &info) {
+			InputElement::OnKeyDown(info);
+			InvalidateOnInput();
+		}
+		void Control::OnKeyUp(const KeyInfo &info) {
+			InputElement::OnKeyUp(info);
+			InvalidateOnInput();
+		}
+		void Control::OnText(const TextInfo &info) {
+			InputElement::OnText(info);
+			InvalidateOnInput();
+		}
+		void Control::OnGotFocus(const Info &info) {
+			InputElement::OnGotFocus(info);
+			Invalidate();
+		}
+		void Control::OnLostFocus(const Info &info) {
+			InputElement::OnLostFocus(info);
+			Invalidate();
+		}
+
+		void Control::DetectVisualChanges() {
+			bool visible = (_vis == Visibility::Visible || _vis == Visibility::Ghost);
+			const Graphics::Brush *bkg = (_background ? _background : GetDefaultBackground());
+			const Graphics::Pen *border = (_border ? _border : GetDefaultBorder());
+			Rectangle bounds = GetVisualBounds();
+			if (visible != _drawn || (visible && (
+				bounds.Left != _drawnBounds.Left || bounds.Top != _drawnBounds.Top ||
+				bounds.Right != _drawnBounds.Right || bounds.Bottom != _drawnBounds.Bottom ||
+				bkg != _drawnBackground || border != _drawnBorder
+			))) {
+				if (_drawn) {
+					Invalidate(_drawnBounds);
+				}
+				if (visible) {
+					Invalidate(bounds);
+				}
+				_drawn = visible;
+				_drawnBounds = bounds;
+				_drawnBackground = bkg;
+				_drawnBorder = border;
+			}
+		}
+		bool Control::IsInRenderRegion() const {
+			if (_world == nullptr || !_world->_redrawing) {
+				return true;
+			}
+			Rectangle dummy;
+			return Rectangle::Intersect(GetVisualBounds(), _world->_redrawRegion, dummy) == IntersectionType::Full;
+		}
 
 		void Control::SetWorld(World *w) {
 			if (!_inited) {
@@ -172,6 +238,10 @@ namespace DE {
 			if (_world != nullptr && _world->FocusedControl() == this) {
 				_world->SetFocus(nullptr);
 			}
+			if (_world != nullptr && _drawn) {
+				_world->Invalidate(_drawnBounds);
+			}
+			_drawn = false; // found by the next DetectVisualChanges() of the new world
 			_world = w;
 			OnWorldChanged(Core::Info());
 		}
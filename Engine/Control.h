@@ -154,6 +154,18 @@ namespace DE {
 					return Core::Input::Cursor();
 				}
 
+				// marks the control, or a part of it, to be drawn again when its world renders retained
+				// changes of layout, visibility, background and border are found automatically, and so are input
+				// events and text that has been cached again; other changes to the look of a control should call this
+				virtual void Invalidate() {
+					Invalidate(GetVisualBounds());
+				}
+				virtual void Invalidate(const Core::Math::Rectangle &rect) {
+					if (_world) {
+						_world->Invalidate(rect);
+					}
+				}
+
 #ifdef DEBUG
 				virtual void DumpData(std::ostream &out, Core::Collections::List<bool> &hnl) {
 					for (size_t i = 0; i + 1 < hnl.Count(); ++i) {
@@ -218,11 +230,34 @@ namespace DE {
 				virtual void FinishLayoutChange();
 
 				virtual bool OnMouseDown(const Core::Input::MouseButtonInfo&) override;
+				virtual void OnMouseUp(const Core::Input::MouseButtonInfo&) override;
+				virtual void OnMouseEnter(const Core::Info&) override;
+				virtual void OnMouseLeave(const Core::Info&) override;
 				virtual bool OnMouseScroll(const Core::Input::MouseScrollInfo&) override;
+				virtual void OnKeyDown(const Core::Input::KeyInfo&) override;
+				virtual void OnKeyUp(const Core::Input::KeyInfo&) override;
+				virtual void OnText(const Core::Input::TextInfo&) override;
+				virtual void OnGotFocus(const Core::Info&) override;
+				virtual void OnLostFocus(const Core::Info&) override;
 
 				virtual void OnWorldChanged(const Core::Info&) {
 				}
 
+				// compares the control with how it was when this was last called, and invalidates what has changed
+				// called by the world before it renders retained
+				virtual void DetectVisualChanges();
+				// false if the world is redrawing a region that doesn't overlap the control
+				bool IsInRenderRegion() const;
+				// the region the control draws on, used to find what to redraw and what to skip. controls that draw
+				// outside their layout, or have children that do, should override this
+				virtual Core::Math::Rectangle GetVisualBounds() const {
+					return _actualLayout;
+				}
+				// called on mouse and keyboard input, which changes the look of most controls
+				virtual void InvalidateOnInput() {
+					Invalidate();
+				}
+
 				bool Initialized() const {
 					return _inited;
 				}
@@ -277,6 +312,11 @@ namespace DE {
 			private:
 				bool _inited = false;
 				World *_world = nullptr;
+				// what the control looked like when DetectVisualChanges() was last called
+				Core::Math::Rectangle _drawnBounds;
+				const Graphics::Brush *_drawnBackground = nullptr;
+				const Graphics::Pen *_drawnBorder = nullptr;
+				bool _drawn = false;
 
 				virtual void SetWorld(World*);
 #ifdef DEBUG
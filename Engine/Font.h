@@ -19,6 +19,104 @@ namespace DE {
     			Gdiplus::Bitmap *Image = nullptr;
     		};
 
+    		// dense per-font glyph storage, so that text layout can look characters up without touching the atlas
+    		// characters in the BMP are stored in lazily allocated pages, others (if TCHAR is wider) in a hash table
+    		class GlyphTable {
+    			public:
+    				struct Glyph {
+    					CharData Data;
+    					AtlasTexture Texture;
+    				};
+
+    				constexpr static size_t PageBits = 8, PageSize = 1 << PageBits, PageCount = 0x10000 >> PageBits;
+
+    				GlyphTable() {
+    					memset(_pages, 0, sizeof(_pages));
+    				}
+    				GlyphTable(const GlyphTable &src) : GlyphTable() {
+    					CopyContentFrom(src);
+    				}
+    				GlyphTable &operator =(const GlyphTable &src) {
+    					if (this == &src) {
+    						return *this;
+    					}
+    					Clear();
+    					CopyContentFrom(src);
+    					return *this;
+    				}
+    				~GlyphTable() {
+    					Clear();
+    				}
+
+    				const Glyph *Find(TCHAR c) const {
+    					size_t code = GetCode(c);
+    					if (code < 0x10000) {
+    						const Page *pg = _pages[code >> PageBits];
+    						if (pg && pg->Valid[code & (PageSize - 1)]) {
+    							return pg->Glyphs + (code & (PageSize - 1));
+    						}
+    						return nullptr;
+    					}
+    					return _extra.TryGetValue(code);
+    				}
+    				const Glyph &Set(TCHAR c, const CharData &data, const AtlasTexture &tex) {
+    					size_t code = GetCode(c);
+    					Glyph *g;
+    					if (code < 0x10000) {
+    						Page *&pg = _pages[code >> PageBits];
+    						if (!pg) {
+    							pg = new (Core::GlobalAllocator::Allocate(sizeof(Page))) Page();
+    						}
+    						pg->Valid[code & (PageSize - 1)] = true;
+    						g = pg->Glyphs + (code & (PageSize - 1));
+    					} else {
+    						g = &_extra[code];
+    					}
+    					g->Data = data;
+    					g->Texture = tex;
+    					return *g;
+    				}
+    				void Clear() {
+    					for (size_t i = 0; i < PageCount; ++i) {
+    						if (_pages[i]) {
+    							_pages[i]->~Page();
+    							Core::GlobalAllocator::Free(_pages[i]);
+    							_pages[i] = nullptr;
+    						}
+    					}
+    					_extra.Clear();
+    				}
+    			protected:
+    				struct Page {
+    					Page() {
+    						memset(Valid, 0, sizeof(Valid));
+    					}
+
+    					Glyph Glyphs[PageSize];
+    					bool Valid[PageSize];
+    				};
+
+    				Page *_pages[PageCount];
+    				Core::Collections::HashDictionary<size_t, Glyph> _extra;
+
+    				inline static size_t GetCode(TCHAR c) {
+    					size_t code = static_cast<size_t>(c);
+    					if (sizeof(TCHAR) < sizeof(size_t)) {
+    						code &= (static_cast<size_t>(1) << (sizeof(TCHAR) * 8)) - 1;
+    					}
+    					return code;
+    				}
+
+    				void CopyContentFrom(const GlyphTable &src) {
+    					for (size_t i = 0; i < PageCount; ++i) {
+    						if (src._pages[i]) {
+    							_pages[i] = new (Core::GlobalAllocator::Allocate(sizeof(Page))) Page(*src._pages[i]);
+    						}
+    					}
+    					_extra = src._extra;
+    				}
+    		};
+
     		namespace FreeTypeAccess {
 				class FreeTypeInitializer {
 						friend class FontFace;
@@ -0,0 +1,55 @@
+#include "FrameArena.h"
+
+#include "Math.h"
+
+namespace DE {
+	namespace Core {
+		constexpr size_t FrameArena::DefaultBlockSize, FrameArena::Alignment, FrameArena::HeaderSize;
+
+		FrameArena::~FrameArena() {
+			for (Block *cur = _first, *next; cur; cur = next) {
+				next = cur->Next;
+				free(cur);
+			}
+		}
+
+		void *FrameArena::AllocateFromNextBlock(size_t size) {
+			// later blocks are only there after a reset or a scope; a block that's too small is left for later frames
+			Block *next = (_cur ? _cur->Next : _first);
+			if (!next || next->Size < size) {
+				size_t blockSize = Math::Max(_blockSize, size);
+				Block *block = static_cast<Block*>(malloc(HeaderSize + blockSize));
+				if (!block) {
+					throw SystemException(_TEXT("cannot allocate memory"));
+				}
+				_allocSize += HeaderSize + blockSize;
+				block->Size = blockSize;
+				block->Next = next;
+				(_cur ? _cur->Next : _first) = block;
+				next = block;
+			}
+			_cur = next;
+			_pos = _cur->Begin() + size;
+			_end = _cur->Begin() + _cur->Size;
+			return _cur->Begin();
+		}
+		void FrameArena::Rewind(void *block, char *pos) {
+			_cur = static_cast<Block*>(block);
+			_pos = pos;
+			_end = (_cur ? _cur->Begin() + _cur->Size : nullptr);
+		}
+		void FrameArena::Reset() {
+			if (_scopes > 0) {
+				throw InvalidOperationException(_TEXT("a scope of the arena is still open"));
+			}
+			_lastAllocs = _allocs;
+			_allocs = 0;
+			Rewind(nullptr, nullptr);
+		}
+
+		FrameArena &FrameArena::Current() {
+			static thread_local FrameArena _arena;
+			return _arena;
+		}
+	}
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "Common.h"
+#include "List.h"
+#include "Queue.h"
+
+namespace DE {
+	namespace Core {
+		// a bump allocator for memory that lives no longer than a frame: allocating moves a pointer forward, freeing does
+		// nothing, and Reset() takes everything back at the end of the frame. the blocks are kept, so that after the first
+		// few frames no memory is allocated from the system at all
+		class FrameArena {
+			public:
+				constexpr static size_t DefaultBlockSize = (1<<16), Alignment = 2 * sizeof(void*);
+
+				// takes back what has been allocated from the arena since the scope was made. containers made before the
+				// scope must not grow while it's open, since what they get would be taken back with it
+				class Scope {
+					public:
+						explicit Scope(FrameArena &arena = Current()) : _arena(arena), _block(arena._cur), _pos(arena._pos) {
+							++_arena._scopes;
+						}
+						Scope(const Scope&) = delete;
+						Scope &operator =(const Scope&) = delete;
+						~Scope() {
+							--_arena._scopes;
+							_arena.Rewind(_block, _pos);
+						}
+					private:
+						FrameArena &_arena;
+						void *_block;
+						char *_pos;
+				};
+
+				explicit FrameArena(size_t blockSize = DefaultBlockSize) : _blockSize(blockSize) {
+				}
+				FrameArena(const FrameArena&) = delete;
+				FrameArena &operator =(const FrameArena&) = delete;
+				~FrameArena();
+
+				void *Allocate(size_t size) {
+					size = (size + Alignment - 1) & ~(Alignment - 1);
+					++_allocs;
+					if (size <= static_cast<size_t>(_end - _pos)) {
+						void *res = _pos;
+						_pos += size;
+						return res;
+					}
+					return AllocateFromNextBlock(size);
+				}
+				// throws InvalidOperationException if a scope is open
+				void Reset();
+
+				// the number of allocations since the last reset, each of which would otherwise have been an allocation
+				// and a free from the GlobalAllocator
+				size_t GetAllocationCount() const {
+					return _allocs;
+				}
+				size_t GetLastFrameAllocationCount() const {
+					return _lastAllocs;
+				}
+				size_t AllocatedSize() const {
+					return _allocSize;
+				}
+
+				// the arena of the calling thread. threads other than the one that resets it should only use it in scopes
+				static FrameArena &Current();
+			private:
+				struct Block {
+					Block *Next;
+					size_t Size;
+
+					char *Begin() {
+						return reinterpret_cast<char*>(this) + HeaderSize;
+					}
+				};
+				constexpr static size_t HeaderSize = (sizeof(Block) + Alignment - 1) & ~(Alignment - 1);
+
+				Block *_first = nullptr, *_cur = nullptr;
+				char *_pos = nullptr, *_end = nullptr;
+				size_t _blockSize, _allocs = 0, _lastAllocs = 0, _allocSize = 0, _scopes = 0;
+
+				void *AllocateFromNextBlock(size_t);
+				void Rewind(void*, char*);
+		};
+		// lets containers take their memory from the FrameArena of the calling thread. such containers must be gone
+		// before the arena is reset, or the scope they were made in ends
+		class FrameAllocator {
+			public:
+				static void *Allocate(size_t sz) {
+					return FrameArena::Current().Allocate(sz);
+				}
+				static void *Allocate(size_t sz, size_t &actualSz) {
+					actualSz = sz;
+					return FrameArena::Current().Allocate(sz);
+				}
+				static void Free(void*) {
+				}
+		};
+
+		namespace Collections {
+			template <typename T, bool DirectMemoryAccess = !IsClass<T>::Result> using FrameList =
+				List<T, DirectMemoryAccess, FrameAllocator>;
+			template <typename T, size_t ChunkSize = 100, bool DirectMemoryAccess = !IsClass<T>::Result> using FrameQueue =
+				Queue<T, ChunkSize, DirectMemoryAccess, FrameAllocator>;
+		}
+	}
+}
@@ -416,6 +416,9 @@ namespace DE {
 					}
 
 					Core::Math::Rectangle TransformRectangle(const Core::Math::Rectangle &rect) {
+						if (_inbuf) { // the projection is already flipped in frame buffers, so the top of the box is at the bottom
+							return Core::Math::Rectangle(rect.Left - _vbox.Left, rect.Top - _vbox.Top, rect.Width(), rect.Height());
+						}
 						RECT client;
 						GetClientRect(_hWnd, &client);
 						return Core::Math::Rectangle(rect.Left, client.bottom - rect.Bottom, rect.Width(), rect.Height());
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "List.h"
+#include "Common.h"
+
+namespace DE {
+	namespace Core {
+		namespace Collections {
+			// a list that keeps its free space at the place that was last changed, so that a change only moves the
+			// elements between it and the change before it; reading an element is as fast as with a List
+			template <typename T> class GapList {
+				public:
+					constexpr static size_t MinGrowth = 16;
+
+					size_t Count() const {
+						return _data.Count() - (_gapEnd - _gapBegin);
+					}
+					// the elements before this are in front of the gap
+					size_t GetGapPosition() const {
+						return _gapBegin;
+					}
+
+					const T &operator [](size_t index) const {
+						return _data[index < _gapBegin ? index : index + (_gapEnd - _gapBegin)];
+					}
+					T &operator [](size_t index) {
+						return _data[index < _gapBegin ? index : index + (_gapEnd - _gapBegin)];
+					}
+
+					void PushBack(const T &obj) {
+						PushBack(obj, [](T&) {
+						});
+					}
+					void Clear() {
+						_data.Clear();
+						_gapBegin = _gapEnd = 0;
+					}
+
+					// replaces count elements from index with the objects
+					template <bool DMA> void Replace(size_t index, size_t count, const List<T, DMA> &objs) {
+						Replace(index, count, objs, [](T&) {
+						});
+					}
+
+					// these call onMove(obj) for every element that the gap is moved across, which lets elements behind the
+					// gap be stored differently from the ones in front of it
+					template <typename Callback> void PushBack(const T &obj, const Callback &onMove) {
+						MoveGap(Count(), onMove);
+						if (_gapBegin == _gapEnd) { // no room left at the end, let the list grow
+							_data.PushBack(obj);
+							_gapBegin = _gapEnd = _data.Count();
+						} else {
+							_data[_gapBegin++] = obj;
+						}
+					}
+					template <bool DMA, typename Callback> void Replace(
+						size_t index, size_t count, const List<T, DMA> &objs, const Callback &onMove
+					) {
+						OpenGap(index, count, objs.Count(), onMove);
+						for (size_t i = 0; i < objs.Count(); ++i) {
+							_data[_gapBegin++] = objs[i];
+						}
+					}
+				private:
+					List<T> _data;
+					size_t _gapBegin = 0, _gapEnd = 0;
+
+					// moves the gap behind the count elements from index, adds them to it, and makes it at least size long
+					template <typename Callback> void OpenGap(size_t index, size_t count, size_t size, const Callback &onMove) {
+						if (index + count > Count()) {
+							throw OverflowException(_TEXT("index overflow"));
+						}
+						MoveGap(index + count, onMove);
+						_gapBegin -= count;
+						if (_gapEnd - _gapBegin < size) {
+							size_t grow = size - (_gapEnd - _gapBegin);
+							if (grow < _data.Count() / 2 + MinGrowth) {
+								grow = _data.Count() / 2 + MinGrowth;
+							}
+							_data.Insert(_gapEnd, List<T>(T(), grow));
+							_gapEnd += grow;
+						}
+					}
+					template <typename Callback> void MoveGap(size_t index, const Callback &onMove) {
+						while (_gapBegin > index) {
+							T &obj = _data[--_gapEnd];
+							obj = _data[--_gapBegin];
+							onMove(obj);
+						}
+						while (_gapBegin < index) {
+							T &obj = _data[_gapBegin++];
+							obj = _data[_gapEnd++];
+							onMove(obj);
+						}
+					}
+			};
+		}
+	}
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "BinarySearchTree.h"
+#include "HashTable.h"
+
+namespace DE {
+	namespace Core {
+		namespace Collections {
+			template <typename KeyType, typename ValueType, class HashFunc = DefaultHashFunc<KeyType>> class KeyValuePairHashFunc {
+				public:
+					inline static size_t Hash(const KeyValuePair<KeyType, ValueType> &pair) {
+						return HashFunc::Hash(pair.Key());
+					}
+			};
+			template <typename KeyType, typename ValueType> class KeyValuePairEqualityPredicate {
+				public:
+					static bool Examine(const KeyValuePair<KeyType, ValueType> &lhs, const KeyValuePair<KeyType, ValueType> &rhs) {
+						return lhs.Key() == rhs.Key();
+					}
+					static bool Examine(const KeyType &key, const KeyValuePair<KeyType, ValueType> &rhs) {
+						return key == rhs.Key();
+					}
+			};
+			// same interface as Dictionary, but unordered
+			// lookups don't modify the table and therefore don't invalidate references to values
+			template <typename KeyType, typename ValueType, class HashFunc = DefaultHashFunc<KeyType>> class HashDictionary
+				: protected HashTable<
+					KeyValuePair<KeyType, ValueType>,
+					KeyValuePairHashFunc<KeyType, ValueType, HashFunc>,
+					KeyValuePairEqualityPredicate<KeyType, ValueType>
+				>
+			{
+				public:
+					typedef KeyValuePair<KeyType, ValueType> Pair;
+
+					virtual ~HashDictionary() {
+					}
+
+					void ForEachPair(const std::function<bool(const Pair &pair)> &func) const {
+						Base::ForEach(func);
+					}
+					void ForEachPair(const std::function<bool(Pair &pair)> &func) {
+						Base::ForEach(func);
+					}
+
+					ValueType &operator [](const KeyType &key) {
+						size_t h = Base::GetStoredHash(HashFunc::Hash(key)), id = FindKey(key, h);
+						if (id != Base::NotFound) {
+							return Base::_objs[id].Value();
+						}
+						return Base::DoInsert(Pair(key, ValueType()), h)->Value();
+					}
+					const ValueType &operator [](const KeyType &key) const {
+						return GetValue(key);
+					}
+
+					const ValueType &GetValue(const KeyType &key) const {
+						const ValueType *v = TryGetValue(key);
+						if (v == nullptr) {
+							throw InvalidOperationException(_TEXT("the value does not exist"));
+						}
+						return *v;
+					}
+					ValueType &GetValue(const KeyType &key) {
+						ValueType *v = TryGetValue(key);
+						if (v == nullptr) {
+							throw InvalidOperationException(_TEXT("the value does not exist"));
+						}
+						return *v;
+					}
+					const ValueType *TryGetValue(const KeyType &key) const {
+						size_t id = FindKey(key, Base::GetStoredHash(HashFunc::Hash(key)));
+						return id == Base::NotFound ? nullptr : &Base::_objs[id].Value();
+					}
+					ValueType *TryGetValue(const KeyType &key) {
+						size_t id = FindKey(key, Base::GetStoredHash(HashFunc::Hash(key)));
+						return id == Base::NotFound ? nullptr : &Base::_objs[id].Value();
+					}
+					void SetValue(const KeyType &key, const ValueType &value) {
+						size_t h = Base::GetStoredHash(HashFunc::Hash(key)), id = FindKey(key, h);
+						if (id != Base::NotFound) {
+							Base::_objs[id].Value() = value;
+						} else {
+							Base::DoInsert(Pair(key, value), h);
+						}
+					}
+					void DeleteValue(const KeyType &key) {
+						size_t id = FindKey(key, Base::GetStoredHash(HashFunc::Hash(key)));
+						if (id == Base::NotFound) {
+							throw InvalidOperationException(_TEXT("the value does not exist"));
+						}
+						Base::EraseAt(id);
+					}
+					bool ContainsKey(const KeyType &key) const {
+						return FindKey(key, Base::GetStoredHash(HashFunc::Hash(key))) != Base::NotFound;
+					}
+
+					size_t PairCount() const {
+						return Base::Count();
+					}
+
+					using HashTable<Pair, KeyValuePairHashFunc<KeyType, ValueType, HashFunc>, KeyValuePairEqualityPredicate<KeyType, ValueType>>::Clear;
+					using HashTable<Pair, KeyValuePairHashFunc<KeyType, ValueType, HashFunc>, KeyValuePairEqualityPredicate<KeyType, ValueType>>::Reserve;
+				private:
+					typedef HashTable<Pair, KeyValuePairHashFunc<KeyType, ValueType, HashFunc>, KeyValuePairEqualityPredicate<KeyType, ValueType>> Base;
+
+					size_t FindKey(const KeyType &key, size_t h) const {
+						return Base::template FindIndex<KeyType, KeyValuePairEqualityPredicate<KeyType, ValueType>>(key, h);
+					}
+			};
+		}
+	}
+}
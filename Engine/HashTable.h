@@ -1,10 +1,16 @@
 #pragma once
 
-#include "List.h"
+#include <cstring>
+#include <functional>
+
+#include "Common.h"
+#include "ObjectAllocator.h"
+#include "Math.h"
+#include "String.h"
 
 namespace DE {
 	namespace Core {
-		namespace Collections { // TODO not finished
+		namespace Collections {
 			template <typename T> class DirectHashFunc {
 				public:
 					inline static size_t Hash(const T &obj) {
@@ -14,27 +20,227 @@ namespace DE {
 			template <typename T> class AddressHashFunc {
 				public:
 					inline static size_t Hash(const T &obj) {
-						return static_cast<size_t>(&obj);
+						return reinterpret_cast<size_t>(&obj);
+					}
+			};
+			template <typename T> class DefaultHashFunc : public DirectHashFunc<T> {
+			};
+			template <typename T> class DefaultHashFunc<T*> {
+				public:
+					inline static size_t Hash(T *const &obj) {
+						return reinterpret_cast<size_t>(obj);
+					}
+			};
+			template <typename Char> class DefaultHashFunc<StringBase<Char>> { // FNV-1a
+				public:
+					inline static size_t Hash(const StringBase<Char> &str) {
+						size_t res = 2166136261u;
+						for (const Char *cur = *str, *end = cur + str.Length(); cur != end; ++cur) {
+							res = (res ^ static_cast<size_t>(*cur)) * 16777619u;
+						}
+						return res;
 					}
 			};
-			template <typename T, typename HashFunc> class HashTable {
+
+			// open addressing with robin hood probing and backward shift deletion
+			// all slots live in one flat array; slot hashes are stored beside it so that probing
+			// and rehashing never touch the objects unless the hashes are equal
+			template <typename T, class HashFunc = DefaultHashFunc<T>, class Predicate = EqualityPredicate<T>> class HashTable {
 				public:
-					HashTable() {
+					constexpr static size_t MinCapicy = 8, NotFound = static_cast<size_t>(-1);
+
+					HashTable() = default;
+					HashTable(const HashTable &src) {
+						CopyContentFrom(src);
+					}
+					HashTable &operator =(const HashTable &src) {
+						if (this == &src) {
+							return *this;
+						}
+						FreeSlots();
+						CopyContentFrom(src);
+						return *this;
+					}
+					virtual ~HashTable() {
+						FreeSlots();
+					}
 
+					bool Insert(const T &obj) { // returns false if an equal object is already in the table
+						size_t h = GetStoredHash(HashFunc::Hash(obj));
+						if (FindIndex<T, Predicate>(obj, h) != NotFound) {
+							return false;
+						}
+						DoInsert(obj, h);
+						return true;
+					}
+					T *Find(const T &obj) {
+						size_t id = FindIndex<T, Predicate>(obj, GetStoredHash(HashFunc::Hash(obj)));
+						return id == NotFound ? nullptr : _objs + id;
+					}
+					const T *Find(const T &obj) const {
+						size_t id = FindIndex<T, Predicate>(obj, GetStoredHash(HashFunc::Hash(obj)));
+						return id == NotFound ? nullptr : _objs + id;
+					}
+					bool Exists(const T &obj) const {
+						return FindIndex<T, Predicate>(obj, GetStoredHash(HashFunc::Hash(obj))) != NotFound;
+					}
+					bool Erase(const T &obj) {
+						size_t id = FindIndex<T, Predicate>(obj, GetStoredHash(HashFunc::Hash(obj)));
+						if (id == NotFound) {
+							return false;
+						}
+						EraseAt(id);
+						return true;
 					}
 
-					bool Exists(const T &obj) {
-						HashNode hn(obj);
+					void ForEach(const std::function<bool(T&)> &func) {
+						for (size_t i = 0; i < _cap; ++i) {
+							if (_hashes[i] && !func(_objs[i])) {
+								return;
+							}
+						}
 					}
-				protected:
-					struct HashNode {
-						HashNode(const T &obj, size_t slotn) : Obj(obj), Slot(HashFunc::Hash(obj) % slotn) {
+					void ForEach(const std::function<bool(const T&)> &func) const {
+						for (size_t i = 0; i < _cap; ++i) {
+							if (_hashes[i] && !func(_objs[i])) {
+								return;
+							}
 						}
+					}
 
-						T Obj;
-						size_t Slot = 0;
-						HashNode *Next = nullptr, *CPrev = nullptr, *CNext = nullptr;
-					};
+					void Reserve(size_t count) {
+						size_t newCap = MinCapicy;
+						while (!CanHold(count, newCap)) {
+							newCap <<= 1;
+						}
+						if (newCap > _cap) {
+							Rehash(newCap);
+						}
+					}
+					void Clear() {
+						FreeSlots();
+					}
+
+					size_t Count() const {
+						return _count;
+					}
+					size_t Capicy() const {
+						return _cap;
+					}
+				protected:
+					size_t *_hashes = nullptr; // 0 marks an empty slot
+					T *_objs = nullptr;
+					size_t _count = 0, _cap = 0, _shift = 0;
+
+					inline static bool CanHold(size_t count, size_t cap) { // maximum load factor 0.8
+						return count * 5 <= cap * 4;
+					}
+					inline static size_t GetStoredHash(size_t h) { // fibonacci hashing, spreads weak hashes (e.g. sequential ints, pointers)
+						h *= static_cast<size_t>(11400714819323198485ull);
+						return h ? h : 1;
+					}
+					size_t GetHome(size_t storedHash) const {
+						return storedHash >> _shift;
+					}
+					size_t GetDistance(size_t id) const {
+						return (id - GetHome(_hashes[id])) & (_cap - 1);
+					}
+
+					template <typename Key, class KeyPredicate> size_t FindIndex(const Key &key, size_t h) const {
+						if (_count == 0) {
+							return NotFound;
+						}
+						for (size_t id = GetHome(h), dist = 0, mask = _cap - 1; ; id = (id + 1) & mask, ++dist) {
+							if (_hashes[id] == 0 || GetDistance(id) < dist) {
+								return NotFound;
+							}
+							if (_hashes[id] == h && KeyPredicate::Examine(key, _objs[id])) {
+								return id;
+							}
+						}
+					}
+					T *DoInsert(const T &obj, size_t h) { // the object must not be in the table, returns where it's stored
+						if (!CanHold(_count + 1, _cap)) {
+							Rehash(_cap == 0 ? MinCapicy : _cap << 1);
+						}
+						++_count;
+						T *result = nullptr, carried = obj;
+						for (size_t id = GetHome(h), dist = 0, mask = _cap - 1; ; id = (id + 1) & mask, ++dist) {
+							if (_hashes[id] == 0) {
+								new (_objs + id) T(carried);
+								_hashes[id] = h;
+								return result ? result : _objs + id;
+							}
+							size_t odist = GetDistance(id);
+							if (odist < dist) { // steal the slot from the richer object
+								Math::Swap(_hashes[id], h);
+								Math::Swap(_objs[id], carried);
+								if (!result) {
+									result = _objs + id;
+								}
+								dist = odist;
+							}
+						}
+					}
+					void EraseAt(size_t id) {
+						size_t mask = _cap - 1, next = (id + 1) & mask;
+						for (; _hashes[next] && GetDistance(next) > 0; id = next, next = (next + 1) & mask) {
+							_objs[id] = _objs[next];
+							_hashes[id] = _hashes[next];
+						}
+						_objs[id].~T();
+						_hashes[id] = 0;
+						--_count;
+					}
+					void Rehash(size_t newCap) {
+						size_t *oldHashes = _hashes, oldCap = _cap;
+						T *oldObjs = _objs;
+						AllocateSlots(newCap);
+						for (size_t i = 0; i < oldCap; ++i) {
+							if (oldHashes[i]) {
+								DoInsert(oldObjs[i], oldHashes[i]);
+								oldObjs[i].~T();
+							}
+						}
+						if (oldHashes) {
+							GlobalAllocator::Free(oldHashes);
+						}
+					}
+					void AllocateSlots(size_t cap) {
+						void *mem = GlobalAllocator::Allocate((sizeof(size_t) + sizeof(T)) * cap);
+						_hashes = static_cast<size_t*>(mem);
+						_objs = reinterpret_cast<T*>(_hashes + cap);
+						memset(_hashes, 0, sizeof(size_t) * cap);
+						_cap = cap;
+						_count = 0;
+						_shift = sizeof(size_t) * 8 - Math::HighestBit(cap - 1);
+					}
+					void FreeSlots() {
+						if (_hashes) {
+							for (size_t i = 0; i < _cap; ++i) {
+								if (_hashes[i]) {
+									_objs[i].~T();
+								}
+							}
+							GlobalAllocator::Free(_hashes);
+						}
+						_hashes = nullptr;
+						_objs = nullptr;
+						_count = _cap = _shift = 0;
+					}
+					void CopyContentFrom(const HashTable &src) {
+						if (src._count == 0) {
+							return;
+						}
+						AllocateSlots(src._cap);
+						_count = src._count;
+						memcpy(_hashes, src._hashes, sizeof(size_t) * _cap);
+						for (size_t i = 0; i < _cap; ++i) {
+							if (_hashes[i]) {
+								new (_objs + i) T(src._objs[i]);
+							}
+						}
+					}
 			};
 		}
 	}
@@ -0,0 +1,186 @@
+#include "Huffman.h"
+
+#include "PriorityQueue.h"
+
+namespace DE {
+	namespace IO {
+		namespace Huffman {
+			using namespace Core;
+			using namespace Core::Collections;
+
+			constexpr size_t Decoder::TableBits;
+
+			struct HeapNode {
+				size_t Weight;
+				size_t Node;
+			};
+			class HeapNodeComparer { // the lightest first, and the first made of those, so that codes don't depend on the heap
+				public:
+					static int Compare(const HeapNode &lhs, const HeapNode &rhs) {
+						if (lhs.Weight != rhs.Weight) {
+							return lhs.Weight < rhs.Weight ? 1 : -1;
+						}
+						return lhs.Node == rhs.Node ? 0 : (lhs.Node < rhs.Node ? 1 : -1);
+					}
+			};
+			class FrequencyComparer { // the most frequent first
+				public:
+					static int Compare(const HeapNode &lhs, const HeapNode &rhs) {
+						if (lhs.Weight != rhs.Weight) {
+							return lhs.Weight > rhs.Weight ? -1 : 1;
+						}
+						return lhs.Node == rhs.Node ? 0 : (lhs.Node < rhs.Node ? -1 : 1);
+					}
+			};
+
+			// the number of codes of each length, after checking that they make a prefix code
+			void CountLengths(const unsigned char *lengths, size_t n, size_t (&counts)[MaxCodeLength + 1]) {
+				if (n > MaxSymbolCount) {
+					throw InvalidArgumentException(_TEXT("too many symbols"));
+				}
+				for (size_t i = 0; i <= MaxCodeLength; ++i) {
+					counts[i] = 0;
+				}
+				for (size_t i = 0; i < n; ++i) {
+					if (lengths[i] > MaxCodeLength) {
+						throw InvalidArgumentException(_TEXT("code too long"));
+					}
+					++counts[lengths[i]];
+				}
+				counts[0] = 0;
+				long long left = 1;
+				for (size_t i = 1; i <= MaxCodeLength; ++i) {
+					left = (left<<1) - static_cast<long long>(counts[i]);
+					if (left < 0) {
+						throw InvalidArgumentException(_TEXT("the lengths are not those of a prefix code"));
+					}
+				}
+			}
+			// the codes of the symbols, with their first bit lowest
+			void MakeCodes(const unsigned char *lengths, size_t n, const size_t (&counts)[MaxCodeLength + 1], unsigned short *codes) {
+				size_t next[MaxCodeLength + 1];
+				next[0] = 0;
+				for (size_t i = 1, code = 0; i <= MaxCodeLength; ++i) {
+					code = (code + counts[i - 1])<<1;
+					next[i] = code;
+				}
+				for (size_t i = 0; i < n; ++i) {
+					size_t len = lengths[i], code = next[len]++, rev = 0;
+					for (size_t j = 0; j < len; ++j, code >>= 1) {
+						rev = (rev<<1) | (code & 1);
+					}
+					codes[i] = static_cast<unsigned short>(rev);
+				}
+			}
+
+			void MakeCodeLengths(const size_t *freqs, size_t n, unsigned char *lengths, size_t maxLength) {
+				if (n > MaxSymbolCount || maxLength > MaxCodeLength) {
+					throw InvalidArgumentException(_TEXT("too many symbols, or the codes are too long"));
+				}
+				List<HeapNode, true> used;
+				for (size_t i = 0; i < n; ++i) {
+					lengths[i] = 0;
+					if (freqs[i] > 0) {
+						used.PushBack(HeapNode {freqs[i], i});
+					}
+				}
+				size_t un = used.Count();
+				if (un == 0) {
+					return;
+				}
+				if (un == 1) {
+					lengths[used[0].Node] = 1;
+					return;
+				}
+				if ((size_t(1)<<maxLength) < un) {
+					throw InvalidArgumentException(_TEXT("the codes are too short for all the symbols"));
+				}
+				// the leaves are nodes [0, un), and each new node has a larger index than its children
+				List<size_t, true> fathers(0, 2 * un - 1), counts(0, un);
+				size_t *fs = *fathers, *cs = *counts;
+				PriorityQueue<HeapNode, true, HeapNodeComparer> q;
+				for (size_t i = 0; i < un; ++i) {
+					q.Insert(HeapNode {used[i].Weight, i});
+				}
+				for (size_t next = un; q.Count() > 1; ++next) {
+					HeapNode a = q.ExtractMax(), b = q.ExtractMax();
+					fs[a.Node] = fs[b.Node] = next;
+					q.Insert(HeapNode {a.Weight + b.Weight, next});
+				}
+				size_t maxDepth = 0;
+				for (size_t i = 2 * un - 1; i > 0; ) { // fathers are reused as depths
+					--i;
+					fs[i] = (i == 2 * un - 2 ? 0 : fs[fs[i]] + 1);
+					if (i < un) {
+						++cs[fs[i]];
+						maxDepth = Math::Max(maxDepth, fs[i]);
+					}
+				}
+				for (size_t l = maxDepth; l > maxLength; --l) { // moves the deepest leaves up, keeping the tree full
+					while (cs[l] > 0) {
+						size_t j = l - 2;
+						while (cs[j] == 0) {
+							--j;
+						}
+						cs[l] -= 2;
+						++cs[l - 1];
+						cs[j + 1] += 2;
+						--cs[j];
+					}
+				}
+				Math::HeapSort<HeapNode, FrequencyComparer>(*used, un);
+				for (size_t l = 1, i = 0; i < un; ++l) {
+					for (size_t k = 0; k < cs[l]; ++k, ++i) {
+						lengths[used[i].Node] = static_cast<unsigned char>(l);
+					}
+				}
+			}
+
+			Encoder::Encoder(const unsigned char *lengths, size_t n) : _codes(0, n) {
+				size_t counts[MaxCodeLength + 1];
+				CountLengths(lengths, n, counts);
+				_lengths.PushBackRange(lengths, n);
+				MakeCodes(lengths, n, counts, *_codes);
+			}
+
+			Decoder::Decoder(const unsigned char *lengths, size_t n) {
+				size_t counts[MaxCodeLength + 1], maxLen = 0;
+				CountLengths(lengths, n, counts);
+				List<unsigned short, true> codes(0, n);
+				MakeCodes(lengths, n, counts, *codes);
+				for (size_t i = 1; i <= MaxCodeLength; ++i) {
+					if (counts[i] > 0) {
+						maxLen = i;
+					}
+				}
+				_bits = Math::Min(TableBits, maxLen);
+				size_t subBits = maxLen - _bits, primary = size_t(1)<<_bits;
+				_table.PushBack(Entry {0, 0, 0}, primary);
+				for (size_t i = 0; i < n; ++i) {
+					size_t len = lengths[i], code = codes[i];
+					if (len == 0) {
+						continue;
+					}
+					if (len <= _bits) {
+						for (size_t k = code; k < primary; k += size_t(1)<<len) {
+							_table[k] = Entry {static_cast<unsigned short>(i), static_cast<unsigned char>(len), 0};
+						}
+						continue;
+					}
+					size_t p = code & (primary - 1);
+					if (_table[p].SubBits == 0) {
+						_table[p] = Entry {
+							static_cast<unsigned short>(_table.Count()), static_cast<unsigned char>(_bits),
+							static_cast<unsigned char>(subBits)
+						};
+						_table.PushBack(Entry {0, 0, 0}, size_t(1)<<subBits);
+					}
+					size_t offset = _table[p].Value, rest = len - _bits;
+					for (size_t k = code>>_bits; k < (size_t(1)<<subBits); k += size_t(1)<<rest) {
+						_table[offset + k] = Entry {static_cast<unsigned short>(i), static_cast<unsigned char>(rest), 0};
+					}
+				}
+			}
+		}
+	}
+}
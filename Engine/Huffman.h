@@ -0,0 +1,90 @@
+#pragma once
+
+#include "List.h"
+#include "BitStream.h"
+
+namespace DE {
+	namespace IO {
+		// canonical Huffman codes, which are known from the lengths of the codes of the symbols alone: the codes are
+		// given out in the order of their lengths, and then of the symbols. codes are written with their first bit lowest
+		namespace Huffman {
+			constexpr size_t MaxCodeLength = 15, MaxSymbolCount = 1<<16;
+
+			// the lengths of the codes of an optimal prefix code no longer than maxLength, 0 for symbols that never occur.
+			// a symbol that's the only one to occur gets a code of length 1
+			void MakeCodeLengths(const size_t*, size_t, unsigned char*, size_t = MaxCodeLength);
+
+			class Encoder {
+				public:
+					Encoder() = default;
+					// throws InvalidArgumentException if the lengths can't be those of a prefix code
+					Encoder(const unsigned char*, size_t);
+
+					void Encode(BitWriter &writer, size_t symbol) const {
+						writer.Write(_codes[symbol], _lengths[symbol]);
+					}
+					size_t GetLength(size_t symbol) const {
+						return _lengths[symbol];
+					}
+				private:
+					Core::Collections::List<unsigned short, true> _codes;
+					Core::Collections::List<unsigned char, true> _lengths;
+			};
+			// looks codes up in a table indexed by the next TableBits bits. longer codes point to a second table that's
+			// indexed by the bits after those, so that any code is resolved in at most two lookups
+			class Decoder {
+				public:
+					constexpr static size_t TableBits = 11;
+
+					Decoder() = default;
+					// throws InvalidArgumentException if the lengths can't be those of a prefix code
+					Decoder(const unsigned char*, size_t);
+
+					// the reader must have at least MaxCodeLength bits available. throws InvalidArgumentException for bits
+					// that aren't a code, which happens only for corrupted data
+					size_t Decode(BitReader &reader) const {
+						return Decode(reader, *_table, _bits);
+					}
+					// decodes count symbols into out, refilling the reader as needed. the table and the reader are kept in
+					// locals, as writing the symbols might otherwise change them as far as the compiler knows
+					template <typename T> void Decode(BitReader &reader, T *out, size_t count) const {
+						BitReader r = reader;
+						const Entry *table = *_table;
+						size_t bits = _bits, i = 0;
+						for (; i + 3 <= count; i += 3) { // three codes are always available after a refill
+							r.Refill();
+							out[i] = static_cast<T>(Decode(r, table, bits));
+							out[i + 1] = static_cast<T>(Decode(r, table, bits));
+							out[i + 2] = static_cast<T>(Decode(r, table, bits));
+						}
+						for (; i < count; ++i) {
+							r.Refill();
+							out[i] = static_cast<T>(Decode(r, table, bits));
+						}
+						reader = r;
+					}
+				private:
+					struct Entry {
+						unsigned short Value; // the symbol, or where the second table starts if SubBits isn't 0
+						unsigned char Length, SubBits; // the bits used by this lookup, 0 if they aren't part of a code
+					};
+
+					Core::Collections::List<Entry, true> _table;
+					size_t _bits = 0;
+
+					inline static size_t Decode(BitReader &reader, const Entry *table, size_t bits) {
+						const Entry *e = table + reader.Peek(bits);
+						if (e->SubBits > 0) {
+							reader.Consume(bits);
+							e = table + e->Value + reader.Peek(e->SubBits);
+						}
+						if (e->Length == 0) {
+							throw Core::InvalidArgumentException(_TEXT("invalid code"));
+						}
+						reader.Consume(e->Length);
+						return e->Value;
+					}
+			};
+		}
+	}
+}
@@ -0,0 +1,430 @@
+#include "ImageFilters.h"
+
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#	define DE_IMAGEFILTERS_SSE2
+#	include <emmintrin.h>
+#endif
+
+#include "Math.h"
+
+namespace DE {
+	namespace Graphics {
+		using namespace Core;
+
+		const int _WeightBits = 14; // gaussian weights are fixed point and sum up to 1 << _WeightBits
+
+		// scratch memory, allocated on the calling thread so that the workers don't contend for GlobalAllocator
+		struct _Scratch {
+			explicit _Scratch(size_t size) : Data(static_cast<unsigned char*>(GlobalAllocator::Allocate(size))) {
+			}
+			_Scratch(const _Scratch&) = delete;
+			_Scratch &operator =(const _Scratch&) = delete;
+			~_Scratch() {
+				GlobalAllocator::Free(Data);
+			}
+
+			unsigned char *Data;
+		};
+
+		inline size_t _ClampRow(ptrdiff_t y, size_t height) {
+			return y < 0 ? 0 : (static_cast<size_t>(y) >= height ? height - 1 : static_cast<size_t>(y));
+		}
+		inline size_t _BandCount(size_t rows, const ThreadPool &pool) {
+			return Math::Min(rows, pool.GetThreadCount() * 4);
+		}
+		inline size_t _BandBegin(size_t band, size_t bands, size_t rows) {
+			return rows * band / bands;
+		}
+		// copies a row and repeats its edge pixels pad times on both sides
+		inline void _PadRow(unsigned char *out, const unsigned char *row, size_t width, size_t channels, size_t pad) {
+			size_t rowBytes = width * channels;
+			for (size_t i = 0; i < pad; ++i) {
+				memcpy(out + i * channels, row, channels);
+				memcpy(out + (pad + width + i) * channels, row + rowBytes - channels, channels);
+			}
+			memcpy(out + pad * channels, row, rowBytes);
+		}
+
+#ifdef DE_IMAGEFILTERS_SSE2
+		// adds ws.lo * (near0 + far0) + ws.hi * (near1 + far1) to the sums of 16-byte blocks, four sums per block
+		template <bool Far0, bool Second> inline void _AccumulateStrip(
+			__m128i *acc, size_t blocks, __m128i ws,
+			const unsigned char *near0, const unsigned char *far0, const unsigned char *near1, const unsigned char *far1
+		) {
+			const __m128i zero = _mm_setzero_si128();
+			for (size_t b = 0, o = 0; b < blocks; ++b, o += 16, acc += 4) {
+				__m128i
+					v0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(near0 + o)),
+					lo0 = _mm_unpacklo_epi8(v0, zero), hi0 = _mm_unpackhi_epi8(v0, zero), lo1 = zero, hi1 = zero;
+				if (Far0) {
+					__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(far0 + o));
+					lo0 = _mm_add_epi16(lo0, _mm_unpacklo_epi8(v, zero));
+					hi0 = _mm_add_epi16(hi0, _mm_unpackhi_epi8(v, zero));
+				}
+				if (Second) {
+					__m128i
+						v1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(near1 + o)),
+						v2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(far1 + o));
+					lo1 = _mm_add_epi16(_mm_unpacklo_epi8(v1, zero), _mm_unpacklo_epi8(v2, zero));
+					hi1 = _mm_add_epi16(_mm_unpackhi_epi8(v1, zero), _mm_unpackhi_epi8(v2, zero));
+				}
+				acc[0] = _mm_add_epi32(acc[0], _mm_madd_epi16(_mm_unpacklo_epi16(lo0, lo1), ws));
+				acc[1] = _mm_add_epi32(acc[1], _mm_madd_epi16(_mm_unpackhi_epi16(lo0, lo1), ws));
+				acc[2] = _mm_add_epi32(acc[2], _mm_madd_epi16(_mm_unpacklo_epi16(hi0, hi1), ws));
+				acc[3] = _mm_add_epi32(acc[3], _mm_madd_epi16(_mm_unpackhi_epi16(hi0, hi1), ws));
+			}
+		}
+#endif
+		// out[j] = sum(weights[|k - radius|] * taps[k][j]) >> _WeightBits for k in [0, 2 * radius], rounded
+		// the kernel is symmetric, so taps at the same distance are added together before they're weighted
+		// the row is done in strips that keep the sums in the cache, so that every tap is read sequentially
+		void _SymmetricSum(unsigned char *out, const unsigned char *const *taps, const short *weights, size_t radius, size_t bytes) {
+			size_t j = 0;
+#ifdef DE_IMAGEFILTERS_SSE2
+			const size_t strip = 1024;
+			__m128i acc[strip / 4];
+			for (; j + 16 <= bytes; ) {
+				size_t blocks = Math::Min(strip, bytes - j) / 16;
+				for (size_t b = 0; b < blocks * 4; ++b) {
+					acc[b] = _mm_set1_epi32(1 << (_WeightBits - 1));
+				}
+				const unsigned char *const *center = taps + radius;
+				// two distances per madd, the center goes with distance 1
+				if (radius == 0) {
+					_AccumulateStrip<false, false>(acc, blocks, _mm_set1_epi32(weights[0]), center[0] + j, nullptr, nullptr, nullptr);
+				} else {
+					__m128i ws = _mm_set1_epi32(weights[0] | (static_cast<int>(weights[1]) << 16));
+					_AccumulateStrip<false, true>(acc, blocks, ws, center[0] + j, nullptr, center[-1] + j, center[1] + j);
+				}
+				size_t d = 2;
+				for (; d + 1 <= radius; d += 2) {
+					__m128i ws = _mm_set1_epi32(weights[d] | (static_cast<int>(weights[d + 1]) << 16));
+					const ptrdiff_t pd = static_cast<ptrdiff_t>(d);
+					_AccumulateStrip<true, true>(acc, blocks, ws, center[-pd] + j, center[pd] + j, center[-pd - 1] + j, center[pd + 1] + j);
+				}
+				if (d == radius) {
+					const ptrdiff_t pd = static_cast<ptrdiff_t>(d);
+					_AccumulateStrip<true, false>(acc, blocks, _mm_set1_epi32(weights[d]), center[-pd] + j, center[pd] + j, nullptr, nullptr);
+				}
+				for (size_t b = 0; b < blocks; ++b, j += 16) {
+					__m128i
+						*a = acc + b * 4,
+						lo = _mm_packs_epi32(_mm_srai_epi32(a[0], _WeightBits), _mm_srai_epi32(a[1], _WeightBits)),
+						hi = _mm_packs_epi32(_mm_srai_epi32(a[2], _WeightBits), _mm_srai_epi32(a[3], _WeightBits));
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(out + j), _mm_packus_epi16(lo, hi));
+				}
+			}
+#endif
+			for (; j < bytes; ++j) {
+				int sum = (1 << (_WeightBits - 1)) + weights[0] * taps[radius][j];
+				for (size_t d = 1; d <= radius; ++d) {
+					sum += weights[d] * (taps[radius - d][j] + taps[radius + d][j]);
+				}
+				out[j] = static_cast<unsigned char>(sum >> _WeightBits);
+			}
+		}
+		// returns the radius; weights[d] is the weight of the taps at distance d from the center
+		size_t _GaussianWeights(double sigma, Collections::List<short> &weights) {
+			weights.Clear();
+			if (!(sigma > 0.0)) {
+				return 0;
+			}
+			size_t radius = static_cast<size_t>(std::ceil(3.0 * sigma));
+			Collections::List<double> exact;
+			double total = 0.0;
+			for (size_t i = 0; i <= radius; ++i) {
+				double v = std::exp(-static_cast<double>(i * i) / (2.0 * sigma * sigma));
+				exact.PushBack(v);
+				total += (i == 0 ? v : 2.0 * v);
+			}
+			int sum = 0;
+			for (size_t i = 0; i <= radius; ++i) {
+				short w = static_cast<short>(std::round(exact[i] / total * (1 << _WeightBits)));
+				weights.PushBack(w);
+				sum += (i == 0 ? w : 2 * w);
+			}
+			while (radius > 0 && weights[radius] == 0) { // the tail rounds to nothing
+				weights.PopBack();
+				--radius;
+			}
+			weights[0] = static_cast<short>(weights[0] + (1 << _WeightBits) - sum);
+			return radius;
+		}
+		// vertical gaussian from img into the tightly packed out
+		void _GaussianVertical(const ImageView &img, unsigned char *out, const short *weights, size_t radius, ThreadPool &pool) {
+			size_t taps = 2 * radius + 1, rowBytes = img.RowBytes(), bands = _BandCount(img.Height, pool);
+			_Scratch rows(sizeof(const unsigned char*) * taps * bands);
+			pool.ParallelFor(bands, [&](size_t band) {
+				const unsigned char **tapRows = reinterpret_cast<const unsigned char**>(rows.Data) + band * taps;
+				for (size_t y = _BandBegin(band, bands, img.Height), end = _BandBegin(band + 1, bands, img.Height); y < end; ++y) {
+					for (size_t k = 0; k < taps; ++k) {
+						tapRows[k] = img.Row(_ClampRow(static_cast<ptrdiff_t>(y + k) - static_cast<ptrdiff_t>(radius), img.Height));
+					}
+					_SymmetricSum(out + y * rowBytes, tapRows, weights, radius, rowBytes);
+				}
+			});
+		}
+		// horizontal gaussian from src (tightly packed, or img itself if null) into img
+		void _GaussianHorizontal(const ImageView &img, const unsigned char *src, const short *weights, size_t radius, ThreadPool &pool) {
+			size_t
+				taps = 2 * radius + 1, channels = img.Channels(), rowBytes = img.RowBytes(),
+				padBytes = (img.Width + 2 * radius) * channels, bands = _BandCount(img.Height, pool);
+			_Scratch pads(padBytes * bands), ptrs(sizeof(const unsigned char*) * taps * bands);
+			pool.ParallelFor(bands, [&](size_t band) {
+				unsigned char *pad = pads.Data + band * padBytes;
+				const unsigned char **tapCols = reinterpret_cast<const unsigned char**>(ptrs.Data) + band * taps;
+				for (size_t k = 0; k < taps; ++k) {
+					tapCols[k] = pad + k * channels;
+				}
+				for (size_t y = _BandBegin(band, bands, img.Height), end = _BandBegin(band + 1, bands, img.Height); y < end; ++y) {
+					_PadRow(pad, src ? src + y * rowBytes : img.Row(y), img.Width, channels, radius);
+					_SymmetricSum(img.Row(y), tapCols, weights, radius, rowBytes);
+				}
+			});
+		}
+
+		// sums[j] += add[j] - sub[j], sub may be null
+		void _SlideSums(int *sums, const unsigned char *add, const unsigned char *sub, size_t bytes) {
+			size_t j = 0;
+#ifdef DE_IMAGEFILTERS_SSE2
+			const __m128i zero = _mm_setzero_si128();
+			for (; j + 16 <= bytes; j += 16) {
+				__m128i
+					a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(add + j)),
+					s = (sub ? _mm_loadu_si128(reinterpret_cast<const __m128i*>(sub + j)) : zero),
+					alo = _mm_unpacklo_epi8(a, zero), ahi = _mm_unpackhi_epi8(a, zero),
+					slo = _mm_unpacklo_epi8(s, zero), shi = _mm_unpackhi_epi8(s, zero),
+					dlo = _mm_sub_epi16(alo, slo), dhi = _mm_sub_epi16(ahi, shi); // within [-255, 255]
+				__m128i *sum = reinterpret_cast<__m128i*>(sums + j);
+				// sign-extend the differences to 32 bits
+				_mm_storeu_si128(sum, _mm_add_epi32(_mm_loadu_si128(sum), _mm_srai_epi32(_mm_unpacklo_epi16(dlo, dlo), 16)));
+				_mm_storeu_si128(sum + 1, _mm_add_epi32(_mm_loadu_si128(sum + 1), _mm_srai_epi32(_mm_unpackhi_epi16(dlo, dlo), 16)));
+				_mm_storeu_si128(sum + 2, _mm_add_epi32(_mm_loadu_si128(sum + 2), _mm_srai_epi32(_mm_unpacklo_epi16(dhi, dhi), 16)));
+				_mm_storeu_si128(sum + 3, _mm_add_epi32(_mm_loadu_si128(sum + 3), _mm_srai_epi32(_mm_unpackhi_epi16(dhi, dhi), 16)));
+			}
+#endif
+			for (; j < bytes; ++j) {
+				sums[j] += add[j] - (sub ? sub[j] : 0);
+			}
+		}
+		// out[j] = sums[j] * scale, rounded
+		void _ScaleSums(unsigned char *out, const int *sums, float scale, size_t bytes) {
+			size_t j = 0;
+#ifdef DE_IMAGEFILTERS_SSE2
+			const __m128 s = _mm_set1_ps(scale);
+			for (; j + 16 <= bytes; j += 16) {
+				const __m128i *sum = reinterpret_cast<const __m128i*>(sums + j);
+				__m128i
+					v0 = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128(sum)), s)),
+					v1 = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128(sum + 1)), s)),
+					v2 = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128(sum + 2)), s)),
+					v3 = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128(sum + 3)), s));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out + j), _mm_packus_epi16(_mm_packs_epi32(v0, v1), _mm_packs_epi32(v2, v3)));
+			}
+#endif
+			for (; j < bytes; ++j) {
+				out[j] = static_cast<unsigned char>(std::nearbyint(sums[j] * scale));
+			}
+		}
+		// vertical box blur from img into the tightly packed out
+		// each band starts its own running sums, so rows only depend on the input
+		void _BoxVertical(const ImageView &img, unsigned char *out, size_t radius, ThreadPool &pool) {
+			size_t rowBytes = img.RowBytes(), bands = _BandCount(img.Height, pool);
+			float scale = 1.0f / static_cast<float>(2 * radius + 1);
+			_Scratch sumMem(sizeof(int) * rowBytes * bands);
+			pool.ParallelFor(bands, [&](size_t band) {
+				int *sums = reinterpret_cast<int*>(sumMem.Data) + band * rowBytes;
+				size_t y = _BandBegin(band, bands, img.Height), end = _BandBegin(band + 1, bands, img.Height);
+				memset(sums, 0, sizeof(int) * rowBytes);
+				for (ptrdiff_t i = -static_cast<ptrdiff_t>(radius); i <= static_cast<ptrdiff_t>(radius); ++i) {
+					_SlideSums(sums, img.Row(_ClampRow(static_cast<ptrdiff_t>(y) + i, img.Height)), nullptr, rowBytes);
+				}
+				for (; y < end; ++y) {
+					_ScaleSums(out + y * rowBytes, sums, scale, rowBytes);
+					if (y + 1 < end) {
+						_SlideSums(
+							sums,
+							img.Row(_ClampRow(static_cast<ptrdiff_t>(y + radius + 1), img.Height)),
+							img.Row(_ClampRow(static_cast<ptrdiff_t>(y) - static_cast<ptrdiff_t>(radius), img.Height)),
+							rowBytes
+						);
+					}
+				}
+			});
+		}
+		// a running sum along a padded row; the window of pixel x is pad[x, x + 2 * radius]
+		void _BoxRow(unsigned char *out, const unsigned char *pad, size_t width, size_t channels, size_t radius, float scale) {
+			size_t window = 2 * radius + 1;
+#ifdef DE_IMAGEFILTERS_SSE2
+			if (channels == 4) {
+				const __m128i zero = _mm_setzero_si128();
+				const __m128 s = _mm_set1_ps(scale);
+				const unsigned char *in = pad;
+				__m128i sum = zero;
+				for (size_t i = 0; i < window; ++i, in += 4) {
+					sum = _mm_add_epi32(sum, _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(*reinterpret_cast<const int*>(in)), zero), zero));
+				}
+				for (size_t x = 0; x < width; ++x, out += 4) {
+					__m128i v = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(sum), s));
+					v = _mm_packus_epi16(_mm_packs_epi32(v, zero), zero);
+					*reinterpret_cast<int*>(out) = _mm_cvtsi128_si32(v);
+					if (x + 1 < width) {
+						__m128i
+							a = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(*reinterpret_cast<const int*>(pad + (x + window) * 4)), zero), zero),
+							r = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(*reinterpret_cast<const int*>(pad + x * 4)), zero), zero);
+						sum = _mm_sub_epi32(_mm_add_epi32(sum, a), r);
+					}
+				}
+				return;
+			}
+#endif
+			int sum[4] {0, 0, 0, 0};
+			for (size_t i = 0; i < window; ++i) {
+				for (size_t c = 0; c < channels; ++c) {
+					sum[c] += pad[i * channels + c];
+				}
+			}
+			for (size_t x = 0; x < width; ++x) {
+				for (size_t c = 0; c < channels; ++c) {
+					out[x * channels + c] = static_cast<unsigned char>(std::nearbyint(sum[c] * scale));
+					if (x + 1 < width) {
+						sum[c] += pad[(x + window) * channels + c] - pad[x * channels + c];
+					}
+				}
+			}
+		}
+		// horizontal box blur from src (tightly packed, or img itself if null) into img
+		void _BoxHorizontal(const ImageView &img, const unsigned char *src, size_t radius, ThreadPool &pool) {
+			size_t
+				channels = img.Channels(), rowBytes = img.RowBytes(),
+				padBytes = (img.Width + 2 * radius) * channels, bands = _BandCount(img.Height, pool);
+			float scale = 1.0f / static_cast<float>(2 * radius + 1);
+			_Scratch pads(padBytes * bands);
+			pool.ParallelFor(bands, [&](size_t band) {
+				unsigned char *pad = pads.Data + band * padBytes;
+				for (size_t y = _BandBegin(band, bands, img.Height), end = _BandBegin(band + 1, bands, img.Height); y < end; ++y) {
+					_PadRow(pad, src ? src + y * rowBytes : img.Row(y), img.Width, channels, radius);
+					_BoxRow(img.Row(y), pad, img.Width, channels, radius, scale);
+				}
+			});
+		}
+		void _BoxBlur(const ImageView &img, unsigned char *temp, size_t xRadius, size_t yRadius, ThreadPool &pool) {
+			if (yRadius > 0) {
+				_BoxVertical(img, temp, yRadius, pool);
+				if (xRadius > 0) {
+					_BoxHorizontal(img, temp, xRadius, pool);
+				} else {
+					size_t rowBytes = img.RowBytes();
+					for (size_t y = 0; y < img.Height; ++y) {
+						memcpy(img.Row(y), temp + y * rowBytes, rowBytes);
+					}
+				}
+			} else if (xRadius > 0) {
+				_BoxHorizontal(img, nullptr, xRadius, pool);
+			}
+		}
+		// the radii of three box blurs that together approximate a gaussian
+		// see Kovesi, "Fast Almost-Gaussian Filtering"
+		void _BoxRadiiForGaussian(double sigma, size_t (&radii)[3]) {
+			if (!(sigma > 0.0)) {
+				radii[0] = radii[1] = radii[2] = 0;
+				return;
+			}
+			const double n = 3.0;
+			int lower = static_cast<int>(std::floor(std::sqrt(12.0 * sigma * sigma / n + 1.0)));
+			if (lower % 2 == 0) {
+				--lower;
+			}
+			double m = std::round((12.0 * sigma * sigma - n * lower * lower - 4.0 * n * lower - 3.0 * n) / (-4.0 * lower - 4.0));
+			for (size_t i = 0; i < 3; ++i) {
+				radii[i] = static_cast<size_t>((static_cast<double>(i) < m ? lower : lower + 2) - 1) / 2;
+			}
+		}
+
+		void ImageFilters::GaussianBlur(const ImageView &img, double sigmaX, double sigmaY, ThreadPool *pool) {
+			if (img.Width == 0 || img.Height == 0) {
+				return;
+			}
+			ThreadPool &p = (pool ? *pool : ThreadPool::Default());
+			Collections::List<short> xWeights, yWeights;
+			size_t xRadius = _GaussianWeights(sigmaX, xWeights), yRadius = _GaussianWeights(sigmaY, yWeights);
+			if (yRadius > 0) {
+				_Scratch temp(img.RowBytes() * img.Height);
+				short identity = 1 << _WeightBits; // with no horizontal blur the second pass only copies the result back
+				_GaussianVertical(img, temp.Data, *yWeights, yRadius, p);
+				_GaussianHorizontal(img, temp.Data, xRadius > 0 ? *xWeights : &identity, xRadius, p);
+			} else if (xRadius > 0) {
+				_GaussianHorizontal(img, nullptr, *xWeights, xRadius, p);
+			}
+		}
+		void ImageFilters::FastGaussianBlur(const ImageView &img, double sigmaX, double sigmaY, ThreadPool *pool) {
+			if (img.Width == 0 || img.Height == 0) {
+				return;
+			}
+			ThreadPool &p = (pool ? *pool : ThreadPool::Default());
+			size_t xRadii[3], yRadii[3];
+			_BoxRadiiForGaussian(sigmaX, xRadii);
+			_BoxRadiiForGaussian(sigmaY, yRadii);
+			_Scratch temp(yRadii[2] > 0 ? img.RowBytes() * img.Height : 1);
+			for (size_t i = 0; i < 3; ++i) {
+				_BoxBlur(img, temp.Data, xRadii[i], yRadii[i], p);
+			}
+		}
+		void ImageFilters::BoxBlur(const ImageView &img, size_t xRadius, size_t yRadius, ThreadPool *pool) {
+			if (img.Width == 0 || img.Height == 0) {
+				return;
+			}
+			_Scratch temp(yRadius > 0 ? img.RowBytes() * img.Height : 1);
+			_BoxBlur(img, temp.Data, xRadius, yRadius, pool ? *pool : ThreadPool::Default());
+		}
+		void ImageFilters::Pixelate(const ImageView &img, size_t blockWidth, size_t blockHeight, ThreadPool *pool) {
+			if (img.Width == 0 || img.Height == 0) {
+				return;
+			}
+			if (blockWidth == 0 || blockHeight == 0) {
+				throw InvalidArgumentException(_TEXT("the block size must not be zero"));
+			}
+			ThreadPool &p = (pool ? *pool : ThreadPool::Default());
+			size_t
+				channels = img.Channels(), rowBytes = img.RowBytes(),
+				blocksX = (img.Width + blockWidth - 1) / blockWidth, blocksY = (img.Height + blockHeight - 1) / blockHeight,
+				sumCount = blocksX * channels, bands = _BandCount(blocksY, p);
+			_Scratch sumMem(sizeof(unsigned) * sumCount * bands), rowMem(rowBytes * bands);
+			p.ParallelFor(bands, [&](size_t band) {
+				unsigned *sums = reinterpret_cast<unsigned*>(sumMem.Data) + band * sumCount;
+				unsigned char *filled = rowMem.Data + band * rowBytes;
+				for (size_t by = _BandBegin(band, bands, blocksY), end = _BandBegin(band + 1, bands, blocksY); by < end; ++by) {
+					size_t y0 = by * blockHeight, y1 = Math::Min(y0 + blockHeight, img.Height);
+					memset(sums, 0, sizeof(unsigned) * sumCount);
+					for (size_t y = y0; y < y1; ++y) {
+						const unsigned char *row = img.Row(y);
+						for (size_t x = 0, bx = 0; x < rowBytes; x += blockWidth * channels, bx += channels) {
+							for (size_t xs = x, xEnd = Math::Min(x + blockWidth * channels, rowBytes); xs < xEnd; xs += channels) {
+								for (size_t c = 0; c < channels; ++c) {
+									sums[bx + c] += row[xs + c];
+								}
+							}
+						}
+					}
+					// one row of the result, then copied to every row of the blocks
+					for (size_t x = 0, bx = 0; x < rowBytes; x += blockWidth * channels, bx += channels) {
+						size_t xEnd = Math::Min(x + blockWidth * channels, rowBytes);
+						unsigned count = static_cast<unsigned>((xEnd - x) / channels * (y1 - y0));
+						for (size_t c = 0; c < channels; ++c) {
+							filled[x + c] = static_cast<unsigned char>((sums[bx + c] + count / 2) / count);
+						}
+						for (size_t xs = x + channels; xs < xEnd; xs += channels) {
+							memcpy(filled + xs, filled + x, channels);
+						}
+					}
+					for (size_t y = y0; y < y1; ++y) {
+						memcpy(img.Row(y), filled, rowBytes);
+					}
+				}
+			});
+		}
+	}
+}
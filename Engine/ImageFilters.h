@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+
+#include "Color.h"
+#include "ThreadPool.h"
+
+namespace DE {
+	namespace Graphics {
+		enum class PixelLayout : unsigned char {
+			RGBA32, // Core::Color, SoftwareContext pixels
+			BGRA32, // PixelFormat32bppARGB in gdiplus
+			Gray8
+		};
+		// a window into pixels owned by someone else
+		// the filters treat every channel the same way, so the layout only decides the pixel size
+		struct ImageView {
+			ImageView() = default;
+			ImageView(void *data, size_t width, size_t height, ptrdiff_t stride, PixelLayout layout) :
+				Data(static_cast<unsigned char*>(data)), Width(width), Height(height), Stride(stride), Layout(layout)
+			{
+			}
+			ImageView(Core::Color *pixels, size_t width, size_t height) :
+				Data(reinterpret_cast<unsigned char*>(pixels)), Width(width), Height(height),
+				Stride(static_cast<ptrdiff_t>(width * sizeof(Core::Color))), Layout(PixelLayout::RGBA32)
+			{
+			}
+
+			unsigned char *Data = nullptr; // the first pixel of the top row
+			size_t Width = 0, Height = 0;
+			ptrdiff_t Stride = 0; // in bytes, negative for bottom-up images
+			PixelLayout Layout = PixelLayout::RGBA32;
+
+			size_t Channels() const {
+				return Layout == PixelLayout::Gray8 ? 1 : 4;
+			}
+			size_t RowBytes() const {
+				return Width * Channels();
+			}
+			unsigned char *Row(size_t y) const {
+				return Data + static_cast<ptrdiff_t>(y) * Stride;
+			}
+		};
+
+		// in-place filters on 8-bit images; out-of-range samples repeat the nearest edge pixel
+		// the filters are separable, work on 16 channels at a time with sse2 where available,
+		// and split the rows between the threads of the given pool (ThreadPool::Default() if none)
+		class ImageFilters {
+			public:
+				// true gaussian weights, the kernel reaches 3 sigma to each side
+				static void GaussianBlur(const ImageView&, double sigmaX, double sigmaY, Core::ThreadPool* = nullptr);
+				// three box blurs whose sizes approximate the gaussian; costs the same for any sigma
+				static void FastGaussianBlur(const ImageView&, double sigmaX, double sigmaY, Core::ThreadPool* = nullptr);
+				// the average of the (2 * radius + 1) pixels around each pixel in each direction
+				static void BoxBlur(const ImageView&, size_t xRadius, size_t yRadius, Core::ThreadPool* = nullptr);
+				// fills blocks aligned to the top left corner with their average, the last ones may be smaller
+				static void Pixelate(const ImageView&, size_t blockWidth, size_t blockHeight, Core::ThreadPool* = nullptr);
+		};
+	}
+}
@@ -1,6 +1,10 @@
 #include "LightCaster.h"
 
+#include <cmath>
+
 #include "Queue.h"
+#include "FrameArena.h"
+#include "RenderingContext.h"
 
 namespace DE {
 	namespace Utils {
@@ -17,24 +21,869 @@ namespace DE {
 				int _src = -1; // DEBUG
 #endif
 			};
+			constexpr static size_t NoWall = static_cast<size_t>(-1);
+
+			struct AngleEntry { // an event or a ray of NearestWallSweep
+				double Angle;
+				size_t ID;
+			};
+			// merge sort, since the entries often come nearly sorted, which is the worst case of UnstableSort
+			template <typename T, typename Less> void MergeSort(List<T, true> &entries, const Less &less) {
+				size_t n = entries.Count();
+				if (n < 2) {
+					return;
+				}
+				List<T, true> scratch;
+				scratch.PushBack(T(), n);
+				T *from = *entries, *to = *scratch;
+				for (size_t width = 1; width < n; width <<= 1) {
+					for (size_t s = 0; s < n; s += width << 1) {
+						size_t m = Min(s + width, n), e = Min(s + (width << 1), n), i = s, j = m, k = s;
+						while (i < m && j < e) {
+							to[k++] = (less(from[j], from[i]) ? from[j++] : from[i++]);
+						}
+						while (i < m) {
+							to[k++] = from[i++];
+						}
+						while (j < e) {
+							to[k++] = from[j++];
+						}
+					}
+					Swap(from, to);
+				}
+				if (from != *entries) {
+					T *dst = *entries;
+					for (size_t i = 0; i < n; ++i) {
+						dst[i] = from[i];
+					}
+				}
+			}
+			void SortByAngle(List<AngleEntry, true> &entries) {
+				MergeSort(entries, [](const AngleEntry &lhs, const AngleEntry &rhs) {
+					return lhs.Angle < rhs.Angle;
+				});
+			}
+
+			// sorts directions by decreasing angle, starting from the given angle and wrapping around
+			template <typename Directions> void SortClockwise(Directions &dirs, double start) {
+				List<AngleEntry, true> order;
+				for (size_t i = 0; i < dirs.Count(); ++i) {
+					AngleEntry e;
+					e.Angle = start - atan2(dirs[i].Y, dirs[i].X);
+					e.Angle += (e.Angle < 0.0 ? 2.0 * Pi : 0.0);
+					e.ID = i;
+					order.PushBack(e);
+				}
+				SortByAngle(order);
+				Directions sorted;
+				for (size_t i = 0; i < order.Count(); ++i) {
+					sorted.PushBack(dirs[order[i].ID]);
+				}
+				dirs = sorted;
+			}
+
+			// for every wall, the walls before it (or after it, if later is true) in the list whose bounding boxes overlap
+			// its own within the region, in ascending order: the partners of wall i are ids[start[i]] to ids[start[i + 1] - 1]
+			// the walls are put into a uniform grid over the region, and a pair is only taken from the first cell both are in
+			void FindWallPairs(
+				const List<const Wall*> &walls, const Rectangle &region, bool later,
+				List<size_t, true> &start, List<size_t, true> &ids
+			) {
+				constexpr static size_t MaxGridSize = 256, MaxCellsPerWall = 4;
+				struct CellRange {
+					double X1, Y1, X2, Y2; // relative to the region, from 0 to 1
+					size_t Left, Top, Right, Bottom;
+					bool Empty;
+				};
+				size_t n = walls.Count();
+				start.Clear();
+				ids.Clear();
+				start.PushBack(0, n + 1);
+				if (n < 2) {
+					return;
+				}
+				List<CellRange, true> ranges;
+				ranges.PushBack(CellRange(), n);
+				CellRange *rs = *ranges;
+				double sx = (region.Width() > 0.0 ? 1.0 / region.Width() : 0.0), sy = (region.Height() > 0.0 ? 1.0 / region.Height() : 0.0);
+				for (size_t i = 0; i < n; ++i) {
+					const Wall &w = *walls[i];
+					CellRange &r = rs[i];
+					r.X1 = Clamp((Min(w.Node1.X, w.Node2.X) - region.Left) * sx, 0.0, 1.0);
+					r.X2 = Clamp((Max(w.Node1.X, w.Node2.X) - region.Left) * sx, 0.0, 1.0);
+					r.Y1 = Clamp((Min(w.Node1.Y, w.Node2.Y) - region.Top) * sy, 0.0, 1.0);
+					r.Y2 = Clamp((Max(w.Node1.Y, w.Node2.Y) - region.Top) * sy, 0.0, 1.0);
+					r.Empty =
+						Max(w.Node1.X, w.Node2.X) < region.Left || Min(w.Node1.X, w.Node2.X) > region.Right ||
+						Max(w.Node1.Y, w.Node2.Y) < region.Top || Min(w.Node1.Y, w.Node2.Y) > region.Bottom;
+				}
+				// long walls are in many cells, which is worse than testing every pair, so the grid is made coarser for them
+				size_t grid = Clamp(static_cast<size_t>(sqrt(static_cast<double>(n))), static_cast<size_t>(1), MaxGridSize), entries;
+				auto getCell = [&grid](double v) {
+					return Min(static_cast<size_t>(v * grid), grid - 1);
+				};
+				for (; ; grid >>= 1) {
+					entries = 0;
+					for (size_t i = 0; i < n; ++i) {
+						if (!rs[i].Empty) {
+							entries += (getCell(rs[i].X2) - getCell(rs[i].X1) + 1) * (getCell(rs[i].Y2) - getCell(rs[i].Y1) + 1);
+						}
+					}
+					if (grid == 1 || entries <= MaxCellsPerWall * n) {
+						break;
+					}
+				}
+				List<size_t, true> cellStart, cellWalls;
+				cellStart.PushBack(0, grid * grid + 1);
+				size_t *cs = *cellStart;
+				for (size_t i = 0; i < n; ++i) {
+					CellRange &r = rs[i];
+					if (!r.Empty) {
+						r.Left = getCell(r.X1);
+						r.Right = getCell(r.X2);
+						r.Top = getCell(r.Y1);
+						r.Bottom = getCell(r.Y2);
+						for (size_t y = r.Top; y <= r.Bottom; ++y) {
+							for (size_t x = r.Left; x <= r.Right; ++x) {
+								++cs[y * grid + x + 1];
+							}
+						}
+					}
+				}
+				for (size_t i = 1; i < cellStart.Count(); ++i) {
+					cs[i] += cs[i - 1];
+				}
+				if (cs[grid * grid] == 0) {
+					return;
+				}
+				cellWalls.PushBack(0, cs[grid * grid]);
+				size_t *cw = *cellWalls;
+				for (size_t i = 0; i < n; ++i) { // cs[c] points to the next free slot of c, the walls of a cell stay sorted
+					if (!rs[i].Empty) {
+						for (size_t y = rs[i].Top; y <= rs[i].Bottom; ++y) {
+							for (size_t x = rs[i].Left; x <= rs[i].Right; ++x) {
+								cw[cs[y * grid + x]++] = i;
+							}
+						}
+					}
+				}
+				for (size_t i = grid * grid; i > 0; --i) {
+					cs[i] = cs[i - 1];
+				}
+				cs[0] = 0;
+				size_t *st = *start;
+				for (size_t i = 0; i < n; ++i) {
+					size_t first = ids.Count();
+					if (!rs[i].Empty) {
+						for (size_t y = rs[i].Top; y <= rs[i].Bottom; ++y) {
+							for (size_t x = rs[i].Left; x <= rs[i].Right; ++x) {
+								for (size_t c = cs[y * grid + x]; c < cs[y * grid + x + 1]; ++c) {
+									size_t j = cw[c];
+									if (later ? j <= i : j >= i) {
+										continue;
+									}
+									if (x == Max(rs[i].Left, rs[j].Left) && y == Max(rs[i].Top, rs[j].Top)) {
+										ids.PushBack(j);
+									}
+								}
+							}
+						}
+					}
+					size_t *found = *ids;
+					for (size_t a = first + 1; a < ids.Count(); ++a) { // there are usually only a few
+						size_t v = found[a], b = a;
+						for (; b > first && found[b - 1] > v; --b) {
+							found[b] = found[b - 1];
+						}
+						found[b] = v;
+					}
+					st[i + 1] = ids.Count();
+				}
+			}
+
+			// the bounding box of the part of a circle between two directions that are less than pi apart, slightly enlarged
+			Rectangle GetSectorBounds(const Vector2 &center, Vector2 d1, Vector2 d2, double radius) {
+				Vector2 reach(radius, radius), pad = reach * 1e-6;
+				double cross = Vector2::Cross(d1, d2);
+				if (!(cross != 0.0)) {
+					return Rectangle(center - reach - pad, center + reach + pad);
+				}
+				if (cross < 0.0) {
+					Swap(d1, d2);
+				}
+				d1.SetLength(radius);
+				d2.SetLength(radius);
+				Vector2 tl(Min(Min(0.0, d1.X), d2.X), Min(Min(0.0, d1.Y), d2.Y)), br(Max(Max(0.0, d1.X), d2.X), Max(Max(0.0, d1.Y), d2.Y));
+				Vector2 axes[4] = {Vector2(radius, 0.0), Vector2(0.0, radius), Vector2(-radius, 0.0), Vector2(0.0, -radius)};
+				for (size_t i = 0; i < 4; ++i) {
+					if (Vector2::Cross(d1, axes[i]) > 0.0 && Vector2::Cross(axes[i], d2) > 0.0) {
+						tl = Vector2(Min(tl.X, axes[i].X), Min(tl.Y, axes[i].Y));
+						br = Vector2(Max(br.X, axes[i].X), Max(br.Y, axes[i].Y));
+					}
+				}
+				return Rectangle(center + tl - pad, center + br + pad);
+			}
+
+			// finds the nearest wall that each of a set of rays from a point hits within a range, giving the same results
+			// as testing every wall: ties go to the later wall in the list if lastWins is true, and to the earlier one otherwise
+			// the rays are handled in the order of their angles. the parts of the walls within the range that cross the
+			// current ray are kept in a heap, ordered by where they cross it. two walls can only change their order where
+			// they cross each other, so every wall is taken out and put back at its ends and at its crossings. walls that
+			// are seen edge-on, that pass through the origin, or that overlap another wall on the same line can't be ordered
+			// this way, and are tested for every ray
+			class NearestWallSweep {
+				public:
+					NearestWallSweep(const Vector2 &origin, double range, const List<const Wall*> &walls, bool lastWins) :
+						_origin(origin), _rangeSq(range * range), _walls(*walls), _count(walls.Count()), _lastWins(lastWins)
+					{
+						if (_count == 0) {
+							return;
+						}
+						_sweepWalls.PushBack(SweepWall(), _count);
+						_heap.PushBack(NoWall, _count);
+						_touched.PushBack(NoWall, _count);
+						_sw = *_sweepWalls;
+						_heapData = *_heap;
+						_touchedData = *_touched;
+						for (size_t i = 0; i < _count; ++i) {
+							SweepWall &cur = _sw[i];
+							cur.Node1 = _walls[i]->Node1 - _origin;
+							cur.Dir = _walls[i]->Node2 - _walls[i]->Node1;
+							double a = cur.Dir.LengthSquared(), b = Vector2::Dot(cur.Node1, cur.Dir), c = cur.Node1.LengthSquared() - _rangeSq;
+							if (!(a > 0.0)) {
+								_unordered.PushBack(i);
+								continue;
+							}
+							double disc = b * b - a * c;
+							if (disc < 0.0) { // out of range
+								continue;
+							}
+							double sq = sqrt(disc), t1 = Max((-b - sq) / a, 0.0), t2 = Min((-b + sq) / a, 1.0);
+							if (t1 > t2) {
+								continue;
+							}
+							Vector2 p1 = cur.Node1 + cur.Dir * t1, p2 = cur.Node1 + cur.Dir * t2;
+							double cross = Vector2::Cross(p1, p2);
+							if (!(Abs(cross) > SinEpsilon * sqrt(p1.LengthSquared() * p2.LengthSquared()))) {
+								_unordered.PushBack(i);
+								continue;
+							}
+							if (cross < 0.0) {
+								Swap(p1, p2);
+							}
+							cur.Ordered = true;
+							cur.Low = atan2(p1.Y, p1.X);
+							cur.High = atan2(p2.Y, p2.X);
+						}
+					}
+
+					// hits[i] is the index of the wall hit by the ray in dirs[i], or NoWall
+					// start and partners list the pairs of walls that may cross, as given by FindWallPairs
+					void Find(
+						const List<size_t, true> &start, const List<size_t, true> &partners,
+						const List<Vector2> &dirs, List<size_t, true> &hits
+					) {
+						hits.Clear();
+						if (dirs.Count() == 0) {
+							return;
+						}
+						hits.PushBack(NoWall, dirs.Count());
+						size_t *hs = *hits;
+						if (dirs.Count() < MinSweepRays || _count < MinSweepWalls) { // not worth the setup
+							for (size_t i = 0; i < dirs.Count(); ++i) {
+								hs[i] = Scan(dirs[i]);
+							}
+							return;
+						}
+						List<AngleEntry, true> events, rays;
+						for (size_t i = 0; i < dirs.Count(); ++i) {
+							const Vector2 &d = dirs[i];
+							if (d.LengthSquared() > 0.0) {
+								AngleEntry r;
+								r.Angle = atan2(d.Y, d.X);
+								r.ID = i;
+								rays.PushBack(r);
+							} else {
+								hs[i] = Scan(d);
+							}
+						}
+						if (rays.Count() == 0) {
+							return;
+						}
+						SortByAngle(rays);
+						// angles are measured from the end of the largest gap between the rays, so that the rays span
+						// the angles from 0 to span, and nothing that happens outside of them needs to be handled
+						AngleEntry *rs = *rays;
+						double base = rs[0].Angle, gap = rs[0].Angle + 2.0 * Pi - rs[rays.Count() - 1].Angle;
+						for (size_t i = 1; i < rays.Count(); ++i) {
+							if (rs[i].Angle - rs[i - 1].Angle > gap) {
+								gap = rs[i].Angle - rs[i - 1].Angle;
+								base = rs[i].Angle;
+							}
+						}
+						double span = 0.0;
+						for (size_t i = 0; i < rays.Count(); ++i) {
+							rs[i].Angle = Normalize(rs[i].Angle, base);
+							span = Max(span, rs[i].Angle);
+						}
+						SortByAngle(rays);
+						rs = *rays;
+						for (size_t i = 0; i < _count; ++i) {
+							if (_sw[i].Ordered) {
+								_sw[i].Low = Normalize(_sw[i].Low, base);
+								_sw[i].High = Normalize(_sw[i].High, base);
+								_sw[i].Ordered = (_sw[i].Low <= span || _sw[i].Low > _sw[i].High);
+							}
+						}
+						const size_t *st = *start, *pt = *partners;
+						bool overlaps = false;
+						for (size_t i = 0; i < _count; ++i) {
+							if (!_sw[i].Ordered) {
+								continue;
+							}
+							AngleEntry e;
+							e.ID = i;
+							e.Angle = _sw[i].Low;
+							PushEvent(events, e, span);
+							e.Angle = _sw[i].High;
+							PushEvent(events, e, span);
+							for (size_t k = st[i]; k < st[i + 1]; ++k) {
+								size_t j = pt[k];
+								Vector2 isect;
+								if (!_sw[j].Ordered) {
+									continue;
+								}
+								if (IsInLine(i, j)) {
+									_sw[i].Overlaps = _sw[j].Overlaps = overlaps = true;
+									continue;
+								}
+								if (SegmentsIntersect(
+									_walls[i]->Node1, _walls[i]->Node2, _walls[j]->Node1, _walls[j]->Node2, isect
+								) == IntersectionType::None) {
+									continue;
+								}
+								isect -= _origin;
+								if (!(isect.LengthSquared() <= _rangeSq)) {
+									continue;
+								}
+								e.Angle = Normalize(atan2(isect.Y, isect.X), base);
+								PushEvent(events, e, span);
+								e.ID = j;
+								PushEvent(events, e, span);
+								e.ID = i;
+							}
+						}
+						if (overlaps) {
+							Unorder(events);
+						}
+						SortByAngle(events);
+						const AngleEntry *es = *events;
+						for (size_t w = 0; w < _count; ++w) {
+							if (_sw[w].Ordered && IsCrossing(_sw[w], rs[0].Angle)) {
+								Insert(w, dirs[rs[0].ID]);
+							}
+						}
+						hs[rs[0].ID] = Nearest(dirs[rs[0].ID]);
+						for (size_t i = 1, e = 0; i < rays.Count(); ++i) {
+							double angle = rs[i].Angle;
+							const Vector2 &d = dirs[rs[i].ID], &last = dirs[rs[i - 1].ID];
+							size_t touched = 0;
+							++_stamp;
+							for (; e < events.Count() && es[e].Angle <= angle; ++e) {
+								SweepWall &cur = _sw[es[e].ID];
+								if (cur.Stamp != _stamp) {
+									cur.Stamp = _stamp;
+									_touchedData[touched++] = es[e].ID;
+								}
+							}
+							// the walls left in the heap keep their order, so the ones that are taken out are compared
+							// along the last ray, and the ones put back along this one
+							for (size_t k = 0; k < touched; ++k) {
+								if (_sw[_touchedData[k]].HeapPos != NoWall) {
+									Erase(_touchedData[k], last);
+								}
+							}
+							for (size_t k = 0; k < touched; ++k) {
+								if (IsCrossing(_sw[_touchedData[k]], angle)) {
+									Insert(_touchedData[k], d);
+								}
+							}
+							hs[rs[i].ID] = Nearest(d);
+						}
+					}
+					// tests every wall
+					size_t Scan(const Vector2 &dir) const {
+						size_t nearest = NoWall;
+						double minSq = _rangeSq;
+						for (size_t i = 0; i < _count; ++i) {
+							TryHit(i, dir, nearest, minSq);
+						}
+						return nearest;
+					}
+				private:
+					constexpr static double SinEpsilon = 1e-9;
+					constexpr static size_t MinSweepRays = 8, MinSweepWalls = 16;
+
+					struct SweepWall {
+						Vector2 Node1, Dir; // Node1 is relative to the origin
+						double Low = 0.0, High = 0.0; // the part in range spans the angles from Low to High
+						size_t HeapPos = NoWall, Stamp = 0;
+						bool Ordered = false, Overlaps = false;
+					};
+
+					Vector2 _origin;
+					double _rangeSq;
+					const Wall *const *_walls;
+					size_t _count, _heapCount = 0, _stamp = 0;
+					bool _lastWins;
+					List<SweepWall, true> _sweepWalls;
+					List<size_t, true> _heap, _touched, _unordered;
+					SweepWall *_sw = nullptr;
+					size_t *_heapData = nullptr, *_touchedData = nullptr;
+
+					static double Normalize(double angle, double base) { // to [0, 2 pi)
+						angle -= base;
+						return (angle < 0.0 ? angle + 2.0 * Pi : angle);
+					}
+					static void PushEvent(List<AngleEntry, true> &events, const AngleEntry &e, double span) {
+						if (e.Angle > 0.0 && e.Angle <= span) { // the ones before the first ray are handled when it is
+							events.PushBack(e);
+						}
+					}
+
+					static bool IsCrossing(const SweepWall &w, double angle) {
+						return (w.Low <= w.High) ? (w.Low <= angle && angle <= w.High) : (w.Low <= angle || angle <= w.High);
+					}
+					// whether the walls are on the same line as far as rounding can tell, in which case which one a ray hits
+					// first is down to rounding too
+					bool IsInLine(size_t a, size_t b) const {
+						const SweepWall &wa = _sw[a], &wb = _sw[b];
+						Vector2 r1 = wb.Node1 - wa.Node1, r2 = r1 + wb.Dir;
+						double len = wa.Dir.Length();
+						return
+							Abs(Vector2::Cross(wa.Dir, r1)) <= SinEpsilon * len * r1.Length() &&
+							Abs(Vector2::Cross(wa.Dir, r2)) <= SinEpsilon * len * r2.Length();
+					}
+					// moves the walls that overlap others to the ones tested for every ray, keeping them sorted
+					void Unorder(List<AngleEntry, true> &events) {
+						List<size_t, true> unordered;
+						size_t k = 0;
+						for (size_t w = 0; w < _count; ++w) {
+							for (; k < _unordered.Count() && _unordered[k] < w; ++k) {
+								unordered.PushBack(_unordered[k]);
+							}
+							if (_sw[w].Overlaps) {
+								_sw[w].Ordered = false;
+								unordered.PushBack(w);
+							}
+						}
+						for (; k < _unordered.Count(); ++k) {
+							unordered.PushBack(_unordered[k]);
+						}
+						_unordered = unordered;
+						size_t kept = 0;
+						for (size_t i = 0; i < events.Count(); ++i) {
+							if (_sw[events[i].ID].Ordered) {
+								events[kept++] = events[i];
+							}
+						}
+						events.Remove(kept, events.Count() - kept);
+					}
+
+					// where the ray hits the line of the wall, worked out the same way as by RaySegmentIntersect, so that
+					// the walls are ordered exactly as TryHit() would order them
+					double DistanceSquared(size_t w, const Vector2 &dir) const {
+						const Vector2 &p1 = _walls[w]->Node1, &p2 = _walls[w]->Node2;
+						double dst1 = Vector2::Cross(p1 - _origin, dir), dst2 = Vector2::Cross(p2 - _origin, dir);
+						return (p2 + (p2 - p1) * (dst2 / (dst1 - dst2)) - _origin).LengthSquared();
+					}
+					bool IsCloser(size_t a, size_t b, const Vector2 &dir) const {
+						double da = DistanceSquared(a, dir), db = DistanceSquared(b, dir);
+						return da < db || (da == db && (_lastWins ? a > b : a < b));
+					}
+					void Place(size_t w, size_t pos) {
+						_heapData[pos] = w;
+						_sw[w].HeapPos = pos;
+					}
+					void SiftUp(size_t pos, const Vector2 &dir) {
+						size_t w = _heapData[pos];
+						for (; pos > 0 && IsCloser(w, _heapData[(pos - 1) >> 1], dir); pos = (pos - 1) >> 1) {
+							Place(_heapData[(pos - 1) >> 1], pos);
+						}
+						Place(w, pos);
+					}
+					void SiftDown(size_t pos, const Vector2 &dir) {
+						size_t w = _heapData[pos];
+						for (size_t child; (child = (pos << 1) + 1) < _heapCount; pos = child) {
+							if (child + 1 < _heapCount && IsCloser(_heapData[child + 1], _heapData[child], dir)) {
+								++child;
+							}
+							if (!IsCloser(_heapData[child], w, dir)) {
+								break;
+							}
+							Place(_heapData[child], pos);
+						}
+						Place(w, pos);
+					}
+					void Insert(size_t w, const Vector2 &dir) {
+						Place(w, _heapCount++);
+						SiftUp(_heapCount - 1, dir);
+					}
+					void Erase(size_t w, const Vector2 &dir) {
+						size_t pos = _sw[w].HeapPos, last = _heapData[--_heapCount];
+						_sw[w].HeapPos = NoWall;
+						if (pos != _heapCount) {
+							Place(last, pos);
+							SiftUp(pos, dir);
+							SiftDown(_sw[last].HeapPos, dir);
+						}
+					}
+
+					// the test of a linear scan: the hit must be within range, and nearer than the current one
+					bool TryHit(size_t w, const Vector2 &dir, size_t &nearest, double &minSq) const {
+						Vector2 jt;
+						if (RaySegmentIntersect(_origin, dir, _walls[w]->Node1, _walls[w]->Node2, jt) == IntersectionType::None) {
+							return false;
+						}
+						double lenSq = (jt - _origin).LengthSquared();
+						if (!(lenSq <= _rangeSq)) {
+							return false;
+						}
+						if (lenSq < minSq || (lenSq == minSq && (_lastWins || nearest == NoWall))) {
+							nearest = w;
+							minSq = lenSq;
+						}
+						return true;
+					}
+					// the heap only holds the nearest of the walls that can be ordered
+					size_t Nearest(const Vector2 &dir) const {
+						size_t nearest = NoWall, top = (_heapCount > 0 ? _heapData[0] : NoWall);
+						double minSq = _rangeSq;
+						bool topTested = (top == NoWall);
+						for (size_t i = 0; i < _unordered.Count(); ++i) {
+							if (!topTested && top < _unordered[i]) {
+								if (!TryHit(top, dir, nearest, minSq)) { // only when the ray is almost at the end of the wall
+									return Scan(dir);
+								}
+								topTested = true;
+							}
+							TryHit(_unordered[i], dir, nearest, minSq);
+						}
+						if (!topTested && !TryHit(top, dir, nearest, minSq)) {
+							return Scan(dir);
+						}
+						return nearest;
+					}
+			};
+
+			Rectangle GetBounds(const Wall &w) {
+				return Rectangle(
+					Vector2(Min(w.Node1.X, w.Node2.X), Min(w.Node1.Y, w.Node2.Y)),
+					Vector2(Max(w.Node1.X, w.Node2.X), Max(w.Node1.Y, w.Node2.Y))
+				);
+			}
+			bool IsSameWall(const Wall &lhs, const Wall &rhs) {
+				return
+					lhs.Node1.X == rhs.Node1.X && lhs.Node1.Y == rhs.Node1.Y &&
+					lhs.Node2.X == rhs.Node2.X && lhs.Node2.Y == rhs.Node2.Y &&
+					lhs.IsMirror == rhs.IsMirror;
+			}
+
+			void WallGrid::Build(const List<Wall> &walls) {
+				size_t n = walls.Count();
+				_cells.Clear();
+				_cellStart.Clear();
+				_cellWalls.Clear();
+				_width = _height = 0;
+				if (n == 0) {
+					return;
+				}
+				const Wall *ws = *walls;
+				_cells.PushBack(WallCells(), n);
+				WallCells *cs = *_cells;
+				for (size_t i = 0; i < n; ++i) {
+					cs[i].Bounds = GetBounds(ws[i]);
+					_bound = (i == 0 ? cs[i].Bounds : Rectangle::Union(_bound, cs[i].Bounds));
+				}
+				// about one cell for each wall, made coarser while long walls would be in too many of them
+				double w = _bound.Width(), h = _bound.Height(), cellSize;
+				if (w > 0.0 && h > 0.0) {
+					cellSize = sqrt(w * h / n);
+				} else {
+					cellSize = Max(Max(w, h) / n, 1.0);
+				}
+				for (; ; cellSize *= 2.0) {
+					_width = Clamp(static_cast<size_t>(ceil(w / cellSize)), static_cast<size_t>(1), static_cast<size_t>(MaxGridSize));
+					_height = Clamp(static_cast<size_t>(ceil(h / cellSize)), static_cast<size_t>(1), static_cast<size_t>(MaxGridSize));
+					_cellWidth = (w > 0.0 ? w / _width : 1.0);
+					_cellHeight = (h > 0.0 ? h / _height : 1.0);
+					size_t entries = 0;
+					for (size_t i = 0; i < n; ++i) {
+						WallCells &c = cs[i];
+						c.Left = GetColumn(c.Bounds.Left);
+						c.Right = GetColumn(c.Bounds.Right);
+						c.Top = GetRow(c.Bounds.Top);
+						c.Bottom = GetRow(c.Bounds.Bottom);
+						entries += (c.Right - c.Left + 1) * (c.Bottom - c.Top + 1);
+					}
+					if ((_width == 1 && _height == 1) || entries <= MaxCellsPerWall * n) {
+						break;
+					}
+				}
+				_cellStart.PushBack(0, _width * _height + 1);
+				size_t *start = *_cellStart;
+				for (size_t i = 0; i < n; ++i) {
+					for (size_t y = cs[i].Top; y <= cs[i].Bottom; ++y) {
+						for (size_t x = cs[i].Left; x <= cs[i].Right; ++x) {
+							++start[y * _width + x + 1];
+						}
+					}
+				}
+				for (size_t i = 1; i < _cellStart.Count(); ++i) {
+					start[i] += start[i - 1];
+				}
+				_cellWalls.PushBack(0, start[_width * _height]);
+				size_t *cw = *_cellWalls;
+				for (size_t i = 0; i < n; ++i) { // start[c] points to the next free slot of c for now
+					for (size_t y = cs[i].Top; y <= cs[i].Bottom; ++y) {
+						for (size_t x = cs[i].Left; x <= cs[i].Right; ++x) {
+							cw[start[y * _width + x]++] = i;
+						}
+					}
+				}
+				for (size_t i = _width * _height; i > 0; --i) {
+					start[i] = start[i - 1];
+				}
+				start[0] = 0;
+			}
+			void WallGrid::Query(const Rectangle &region, List<size_t, true> &ids) const {
+				ids.Clear();
+				if (_width == 0 || Rectangle::Intersect(region, _bound) == IntersectionType::None) {
+					return;
+				}
+				const WallCells *cs = *_cells;
+				if (region.Contains(_bound)) {
+					for (size_t i = 0; i < _cells.Count(); ++i) {
+						ids.PushBack(i);
+					}
+					return;
+				}
+				const size_t *start = *_cellStart, *cw = *_cellWalls;
+				size_t left = GetColumn(region.Left), right = GetColumn(region.Right), top = GetRow(region.Top), bottom = GetRow(region.Bottom);
+				for (size_t y = top; y <= bottom; ++y) {
+					for (size_t x = left; x <= right; ++x) {
+						for (size_t c = start[y * _width + x]; c < start[y * _width + x + 1]; ++c) {
+							const WallCells &wc = cs[cw[c]];
+							if ( // a wall is only taken from the first cell it shares with the region
+								x == Max(wc.Left, left) && y == Max(wc.Top, top) &&
+								Rectangle::Intersect(region, wc.Bounds) != IntersectionType::None
+							) {
+								ids.PushBack(cw[c]);
+							}
+						}
+					}
+				}
+				MergeSort(ids, [](size_t lhs, size_t rhs) {
+					return lhs < rhs;
+				});
+			}
+
+			void Caster::UpdateIndex() const {
+				if (_indexed && _indexedWallsVersion == _wallsVersion) {
+					return;
+				}
+				const Wall *oldWalls = *_indexedWalls, *newWalls = *_walls;
+				size_t oldCount = _indexedWalls.Count(), newCount = _walls.Count();
+				List<Rectangle> changed;
+				if (_indexed) {
+					for (size_t i = 0; i < Max(oldCount, newCount); ++i) {
+						if (i < oldCount && i < newCount && IsSameWall(oldWalls[i], newWalls[i])) {
+							continue;
+						}
+						if (i < oldCount) {
+							changed.PushBack(GetBounds(oldWalls[i]));
+						}
+						if (i < newCount) {
+							changed.PushBack(GetBounds(newWalls[i]));
+						}
+					}
+				}
+				_grid.Build(_walls);
+				_indexedWalls = _walls;
+				_indexedWallsVersion = _wallsVersion;
+				_indexed = true;
+				RecordChanges(changed);
+			}
+			void Caster::RecordChanges(List<Rectangle> &regions) const {
+				if (regions.Count() == 0) {
+					return;
+				}
+				++_version;
+				if (regions.Count() > MaxChangedRegions) {
+					for (size_t i = 1; i < regions.Count(); ++i) {
+						regions[0] = Rectangle::Union(regions[0], regions[i]);
+					}
+					regions.Remove(1, regions.Count() - 1);
+				}
+				for (size_t i = 0; i < regions.Count(); ++i) {
+					WallChange change;
+					change.Version = _version;
+					change.Region = regions[i];
+					_changes.PushBack(change);
+				}
+				size_t dropped = 0;
+				while (_changes.Count() - dropped > MaxChangeRecords) { // only whole versions are dropped
+					size_t oldest = _changes[dropped].Version;
+					while (_changes[dropped].Version == oldest) {
+						++dropped;
+					}
+				}
+				if (dropped > 0) {
+					_changes.Remove(0, dropped);
+				}
+			}
+			bool Caster::IsUpToDate(const CastCache &cache, const Light &light, size_t split) const {
+				if (
+					cache._caster != this || cache._split != split || cache._light.Strength != light.Strength ||
+					(light.Position - cache._light.Position).LengthSquared() > Square(cache._tolerance)
+				) {
+					return false;
+				}
+				if (cache._version == _version) {
+					return true;
+				}
+				if (_changes.Count() == 0 || _changes[0].Version > cache._version + 1) { // some of the changes are forgotten
+					return false;
+				}
+				for (size_t i = 0; i < _changes.Count(); ++i) {
+					const WallChange &change = _changes[i];
+					if (change.Version > cache._version && Rectangle::Intersect(cache._looked, change.Region) != IntersectionType::None) {
+						return false;
+					}
+				}
+				return true;
+			}
+
+			const List<CastResult> &Caster::Cast(const Light &light, CastCache &cache, size_t split) const {
+				UpdateIndex();
+				if (!IsUpToDate(cache, light, split)) {
+					cache._results.Clear();
+					DoCast(light, split, cache._looked, [&cache](const CastResult &result) {
+						cache._results.PushBack(result);
+					});
+					cache._caster = this;
+					cache._light = light;
+					cache._split = split;
+				}
+				cache._version = _version;
+				return cache._results;
+			}
+
 			List<CastResult> Caster::Cast(const Light &light, size_t split) const {
-				List<Vector2> poss; // RELATIVE positions
-				for (size_t i = 0; i < _walls.Count(); ++i) { // wall breaks
-					const Wall &curWall = _walls[i];
-					size_t jtN = 0;
+				List<CastResult> results;
+				Rectangle looked;
+				UpdateIndex();
+				DoCast(light, split, looked, [&results](const CastResult &result) {
+					results.PushBack(result);
+				});
+				return results;
+			}
+			void Caster::CastAll(
+				const List<Light> &lights, List<Graphics::Vertex> &vertices, List<size_t, true> &offsets,
+				const Color &color, size_t split, ThreadPool *pool
+			) const {
+				using Graphics::Vertex;
+
+				UpdateIndex();
+				size_t n = lights.Count();
+				if (_lightVertices.Count() < n) {
+					_lightVertices.PushBack(List<Vertex>(), n - _lightVertices.Count());
+				}
+				List<Vertex> *lightVertices = *_lightVertices;
+				const Light *ls = *lights;
+				ThreadPool &p = (pool ? *pool : ThreadPool::Default());
+				p.ParallelFor(n, [&](size_t i) {
+					List<Vertex> &out = lightVertices[i];
+					out.Remove(0, out.Count()); // keeps the storage, since it was at least half full
+					Rectangle looked;
+					DoCast(ls[i], split, looked, [&out, &color](const CastResult &result) {
+						if (result.Type == SplitType::FromSource) {
+							out.PushBack(Vertex(result.SourcePoint1, color));
+							out.PushBack(Vertex(result.TargetPoint1, color));
+							out.PushBack(Vertex(result.TargetPoint2, color));
+						} else {
+							out.PushBack(Vertex(result.SourcePoint1, color));
+							out.PushBack(Vertex(result.SourcePoint2, color));
+							out.PushBack(Vertex(result.TargetPoint1, color));
+							out.PushBack(Vertex(result.SourcePoint2, color));
+							out.PushBack(Vertex(result.TargetPoint1, color));
+							out.PushBack(Vertex(result.TargetPoint2, color));
+						}
+					});
+				});
+				if (offsets.Count() > n + 1) {
+					offsets.Remove(n + 1, offsets.Count() - n - 1);
+				} else if (offsets.Count() < n + 1) {
+					offsets.PushBack(0, n + 1 - offsets.Count());
+				}
+				size_t *os = *offsets;
+				os[0] = 0;
+				for (size_t i = 0; i < n; ++i) {
+					os[i + 1] = os[i] + lightVertices[i].Count();
+				}
+				if (vertices.Count() > os[n]) {
+					vertices.Remove(os[n], vertices.Count() - os[n]);
+				} else if (vertices.Count() < os[n]) {
+					vertices.PushBack(Vertex(), os[n] - vertices.Count());
+				}
+				if (os[n] == 0) {
+					return;
+				}
+				Vertex *vs = &vertices.At(0); // At() makes sure that the storage isn't shared with another list
+				p.ParallelFor(n, [&](size_t i) {
+					const Vertex *src = *static_cast<const List<Vertex>&>(lightVertices[i]);
+					for (size_t j = os[i], k = 0; j < os[i + 1]; ++j, ++k) {
+						vs[j] = src[k];
+					}
+				});
+			}
+			void Caster::DoCast(
+				const Light &light, size_t split, Rectangle &looked, const std::function<void(const CastResult&)> &output
+			) const {
+				FrameArena::Scope scope; // the temporaries below come from the arena, and go back to it on return
+				FrameList<Vector2> poss; // RELATIVE positions
+				List<const Wall*> inRange; // only these can be hit, or cross each other within range
+				FrameList<Vector2> borders; // where they cross the circle, two for each of them
+				FrameList<size_t, true> borderCounts;
+				const Wall *walls = *_indexedWalls; // the walls the grid was built with, until the next mark
+				Vector2 reach(light.Strength, light.Strength), pad = reach * 1e-6;
+				List<size_t, true> nearby;
+				looked = Rectangle(light.Position - reach - pad, light.Position + reach + pad);
+				_grid.Query(looked, nearby);
+				for (size_t k = 0; k < nearby.Count(); ++k) {
+					size_t i = nearby[k], jtN = 0;
 					Vector2 js[2];
-					if (CircleSegmentIntersect(light.Position, light.Strength, curWall.Node1, curWall.Node2, jtN, js[0], js[1]) != IntersectionType::Full) {
+					if (CircleSegmentIntersect(light.Position, light.Strength, walls[i].Node1, walls[i].Node2, jtN, js[0], js[1]) != IntersectionType::Full) {
 						continue;
 					}
+					inRange.PushBack(&walls[i]);
+					borders.PushBack(js[0]);
+					borders.PushBack(js[1]);
+					borderCounts.PushBack(jtN);
+				}
+				List<size_t, true> pairStart, pairs;
+				FindWallPairs(inRange, Rectangle(light.Position - reach - pad, light.Position + reach + pad), false, pairStart, pairs);
+				for (size_t i = 0; i < inRange.Count(); ++i) { // wall breaks
+					const Wall &curWall = *inRange[i];
 					poss.PushBack(curWall.Node1 - light.Position);
 					poss.PushBack(curWall.Node2 - light.Position);
-					for (size_t j = 0; j < jtN; ++j) {
-						poss.PushBack(js[j] - light.Position);
+					for (size_t j = 0; j < borderCounts[i]; ++j) {
+						poss.PushBack(borders[i * 2 + j] - light.Position);
 					}
-					for (size_t j = 0; j < i; ++j) {
+					for (size_t j = pairStart[i]; j < pairStart[i + 1]; ++j) {
 						Vector2 jt;
 						if (SegmentsIntersect(
-							curWall.Node1, curWall.Node2, _walls[j].Node1, _walls[j].Node2, jt
+							curWall.Node1, curWall.Node2, inRange[pairs[j]]->Node1, inRange[pairs[j]]->Node2, jt
 						) != IntersectionType::None) {
 							if ((jt - light.Position).LengthSquared() <= light.Strength * light.Strength) {
 								poss.PushBack(jt - light.Position);
@@ -49,7 +898,7 @@ namespace DE {
 					Vector2 last = poss.Last();
 					poss.PushBack(Vector2(last.X * rotVec.X - last.Y * rotVec.Y, last.X * rotVec.Y + last.Y * rotVec.X));
 				}
-				UnstableSort<List<Vector2>, Vector2, DirectionComparer>(poss);
+				SortClockwise(poss, Pi);
 				size_t rpP = 0;
 				for (size_t i = 1; i < poss.Count(); ++i) {
 					if (AngleSinSquared(poss[rpP], poss[i]) >= 1e-6) {
@@ -58,8 +907,16 @@ namespace DE {
 				}
 				++rpP;
 				poss.Remove(rpP, poss.Count() - rpP);
-				List<CastResult> results;
-				Queue<CastTempNode> mirrorCast;
+				List<Vector2> mids;
+				for (size_t i = 0; i < poss.Count(); ++i) {
+					mids.PushBack(poss[i] + poss[i + 1 == poss.Count() ? 0 : i + 1]);
+				}
+				List<size_t, true> nearest;
+				NearestWallSweep(light.Position, light.Strength, inRange, true).Find(pairStart, pairs, mids, nearest);
+#ifdef DEBUG
+				size_t resultCount = 0;
+#endif
+				FrameQueue<CastTempNode> mirrorCast;
 				for (size_t i = 0; i < poss.Count(); ++i) {
 					CastResult curResult;
 					curResult.Type = SplitType::FromSource;
@@ -70,21 +927,9 @@ namespace DE {
 						j = 0;
 					}
 					const Vector2 &posi = poss[i], posj = poss[j];
-					Vector2 mid = posi + posj, hitwallp;
-					size_t nearW = _walls.Count();
-					double minLSq = light.Strength * light.Strength;
-					for (size_t k = 0; k < _walls.Count(); ++k) {
-						Vector2 jt;
-						if (RaySegmentIntersect(light.Position, mid, _walls[k].Node1, _walls[k].Node2, jt) != IntersectionType::None) {
-							double lenSq = (jt - light.Position).LengthSquared();
-							if (lenSq <= minLSq) {
-								minLSq = lenSq;
-								nearW = k;
-								hitwallp = jt;
-							}
-						}
-					}
-					if (nearW == _walls.Count()) {
+					Vector2 mid = mids[i], hitwallp;
+					size_t nearW = nearest[i];
+					if (nearW == NoWall) {
 						Vector2 v = posi;
 						v.SetLength(light.Strength);
 						curResult.TargetPoint1 = v + light.Position;
@@ -95,7 +940,8 @@ namespace DE {
 						curResult.TargetStrength2 = 0.0;
 					} else {
 						Vector2 jt;
-						const Wall &curWall = _walls[nearW];
+						const Wall &curWall = *inRange[nearW];
+						RaySegmentIntersect(light.Position, mid, curWall.Node1, curWall.Node2, hitwallp);
 						if (RayLineIntersect(light.Position, posi, curWall.Node1, curWall.Node2 - curWall.Node1, jt) != IntersectionType::None) {
 							curResult.TargetPoint1 = jt;
 							curResult.TargetStrength1 = Max(0.0, 1.0 - sqrt((jt - light.Position).LengthSquared() / (light.Strength * light.Strength)));
@@ -122,13 +968,16 @@ namespace DE {
 							n._sd1 = curResult.TargetStrength1;
 							n._sd2 = curResult.TargetStrength2;
 #ifdef DEBUG
-							n._src = results.Count();
+							n._src = resultCount;
 #endif
 							n._pow = hitwallp;
 							mirrorCast.PushTail(n);
 						}
 					}
-					results.PushBack(curResult);
+					output(curResult);
+#ifdef DEBUG
+					++resultCount;
+#endif
 				}
 
 				// cast mirrors
@@ -142,9 +991,16 @@ namespace DE {
 						mirrorDir2 = n._isc2 - mirrorOri;
 					List<const Wall*> valWals;
 					List<Vector2> relBreaks;
-					_walls.ForEach([&](const Wall &curWall) { // filter the walls
+					// walls exactly in line with the edges of the beam can pass the filter from behind the origin
+					Rectangle beamBound = GetSectorBounds(mirrorOri, mirrorDir1, mirrorDir2, light.Strength), mirrorReach(
+						mirrorOri - reach - pad, mirrorOri + reach + pad
+					);
+					_grid.Query(mirrorReach, nearby);
+					looked = Rectangle::Union(looked, mirrorReach);
+					for (size_t k = 0; k < nearby.Count(); ++k) { // filter the walls
+						const Wall &curWall = walls[nearby[k]];
 						if ((&curWall) == (&hitWall)) {
-							return true;
+							continue;
 						}
 						double
 							detd1w1 = Vector2::Cross(mirrorDir1, curWall.Node1 - mirrorOri),
@@ -157,14 +1013,14 @@ namespace DE {
 							xD2 = detd2w1 * detd2w2 <= 0.0; // whether the current wall crosses the second direction of light
 						if ((!xD1) && (!xD2)) { // crosses no border
 							if (detd1w1 * detd2w1 > 0.0) { // out of range - 1st node is not between the two directions
-								return true;
+								continue;
 							}
 							// the wall is either completely lighten by the beam, or on the wrong side
 							Vector2 isect;
 							if (SegmentsIntersect(
 								curWall.Node1, mirrorOri, hitWall.Node1, hitWall.Node2, isect
 							) == IntersectionType::None) { // the wall is on the wrong side!
-								return true;
+								continue;
 							}
 							// NOTE one more test can be performed
 							Vector2 rel1 = curWall.Node1 - mirrorOri, rel2 = curWall.Node2 - mirrorOri;
@@ -172,7 +1028,7 @@ namespace DE {
 								out1 = rel1.LengthSquared() > Square(light.Strength),
 								out2 = rel2.LengthSquared() > Square(light.Strength);
 							if (out1 && out2) { // the wall is too faraway
-								return true;
+								continue;
 							}
 							if (!out1) {
 								relBreaks.PushBack(rel1);
@@ -186,26 +1042,26 @@ namespace DE {
 							if (RayLineIntersect(
 								midpt, midpt - mirrorOri, curWall.Node1, curWall.Node1 - curWall.Node2, testInter
 							) == IntersectionType::None) { // see if the wall is on the right side
-								return true;
+								continue;
 							}
 							Vector2 isect1, isect2;
 							if (RaySegmentIntersect(
 								mirrorOri, mirrorDir1, curWall.Node1, curWall.Node2, isect1
 							) == IntersectionType::None) {
 								// NOTE a floating point error has occurred
-								return true;
+								continue;
 							}
 							if (RaySegmentIntersect(
 								mirrorOri, mirrorDir2, curWall.Node1, curWall.Node2, isect2
 							) == IntersectionType::None) {
 								// NOTE a floating point error has occurred
-								return true;
+								continue;
 							}
 							bool
 								out1 = (isect1 - mirrorOri).LengthSquared() > Square(light.Strength),
 								out2 = (isect2 - mirrorOri).LengthSquared() > Square(light.Strength);
 							if (out1 && out2) { // too faraway
-								return true;
+								continue;
 							}
 							xBorder = (out1 != out2);
 						} else { // cross an edge
@@ -215,19 +1071,19 @@ namespace DE {
 							if (RayLineIntersect(
 								mirrorOri, testDir, curWall.Node1, curWall.Node1 - curWall.Node2, dirIs
 							) == IntersectionType::None) { // wrong side!
-								return true;
+								continue;
 							}
 							if (LineSegmentIntersect(
 								hitWall.Node1, hitWall.Node1 - hitWall.Node2, (dirIs + testNode) * 0.5, mirrorOri
 							) == IntersectionType::None) { // wrong side!
-								return true;
+								continue;
 							}
 
 							bool
 								nodeInRange = (testNode - mirrorOri).LengthSquared() < Square(light.Strength),
 								dirInRange = (dirIs - mirrorOri).LengthSquared() < Square(light.Strength);
 							if ((!nodeInRange) && (!dirInRange)) {
-								return true;
+								continue;
 							}
 							if (nodeInRange) {
 								relBreaks.PushBack(testNode - mirrorOri);
@@ -237,7 +1093,7 @@ namespace DE {
 						if (SegmentsIntersect(
 							0.5 * (n._isc1 + n._isc2), mirrorOri, curWall.Node1, curWall.Node2
 						) != IntersectionType::None) { // solves the bug when the beam is just overlapping with the wall
-							return true;
+							continue;
 						}
 						valWals.PushBack(&curWall);
 						if (xBorder) {
@@ -248,23 +1104,24 @@ namespace DE {
 								d1 + mirrorOri, d2 + mirrorOri, curWall.Node1, curWall.Node2, isect
 							) == IntersectionType::None) {
 								// NOTE a floating point error has occurred
-								return true;
+								continue;
 							}
 							relBreaks.PushBack(isect - mirrorOri);
 						}
-						return true;
-					});
+					}
+					List<size_t, true> valPairStart, valPairs; // only the crossings inside the beam are needed
+					FindWallPairs(valWals, beamBound, true, valPairStart, valPairs);
 					for (size_t i = 0; i < valWals.Count(); ++i) {
 						const Wall &walli = *(valWals[i]);
-						for (size_t j = i + 1; j < valWals.Count(); ++j) {
-							const Wall &wallj = *(valWals[j]);
+						for (size_t k = valPairStart[i]; k < valPairStart[i + 1]; ++k) {
+							const Wall &wallj = *(valWals[valPairs[k]]);
 							Vector2 isect;
 							if (SegmentsIntersect(walli.Node1, walli.Node2, wallj.Node1, wallj.Node2, isect) != IntersectionType::None) {
 								Vector2 relDir = isect - mirrorOri;
 								if (Vector2::Cross(relDir, mirrorDir1) * Vector2::Cross(relDir, mirrorDir2) > 0.0) {
 									continue;
 								}
-								if (relDir.LengthSquared() > Square(light.Strength)) {
+								if (!(relDir.LengthSquared() <= Square(light.Strength))) { // also skips collinear walls, whose crossing is nan
 									continue;
 								}
 								if (SegmentsIntersect(hitWall.Node1, hitWall.Node2, isect, mirrorOri) == IntersectionType::None) {
@@ -276,7 +1133,8 @@ namespace DE {
 					}
 					relBreaks.PushBack(mirrorDir1);
 					relBreaks.PushBack(mirrorDir2);
-					UnstableSort<List<Vector2>, Vector2, DirectionComparer>(relBreaks);
+					Vector2 behind = -(mirrorDir1 + mirrorDir2);
+					SortClockwise(relBreaks, atan2(behind.Y, behind.X)); // the beam is less than pi wide, and doesn't contain this
 					size_t rpP = 0;
 					for (size_t i = 1; i < relBreaks.Count(); ++i) {
 						if (AngleSinSquared(relBreaks[rpP], relBreaks[i]) >= 1e-6) { // NOTE magic number
@@ -285,6 +1143,12 @@ namespace DE {
 					}
 					++rpP;
 					relBreaks.Remove(rpP, relBreaks.Count() - rpP);
+					List<Vector2> relMids;
+					for (size_t i = 1; i < relBreaks.Count(); ++i) {
+						relMids.PushBack(relBreaks[i - 1] + relBreaks[i]);
+					}
+					List<size_t, true> relNearest;
+					NearestWallSweep(mirrorOri, light.Strength, valWals, false).Find(valPairStart, valPairs, relMids, relNearest);
 					Vector2 lastdir = relBreaks[0], lasthitp;
 					RayLineIntersect(mirrorOri, lastdir, hitWall.Node1, wallDir12, lasthitp);
 					for (size_t i = 1; i < relBreaks.Count(); ++i) {
@@ -297,23 +1161,10 @@ namespace DE {
 						curResult.SourceStrength1 = Max(0.0, 1.0 - (lasthitp - mirrorOri).Length() / light.Strength);
 						curResult.SourceStrength2 = Max(0.0, 1.0 - (curhitp - mirrorOri).Length() / light.Strength);
 						Vector2 hitwallp;
-						const Wall *mdw = nullptr;
-						double msqd;
-						valWals.ForEach([&](const Wall *cw) {
-							Vector2 jt;
-							if (RaySegmentIntersect(mirrorOri, dir, cw->Node1, cw->Node2, jt) != IntersectionType::None) {
-								double csqd = (jt - mirrorOri).LengthSquared();
-								if (csqd > Square(light.Strength)) {
-									return true;
-								}
-								if (mdw == nullptr || csqd < msqd) {
-									mdw = cw;
-									msqd = csqd;
-									hitwallp = jt;
-								}
-							}
-							return true;
-						});
+						const Wall *mdw = (relNearest[i - 1] == NoWall ? nullptr : valWals[relNearest[i - 1]]);
+						if (mdw) {
+							RaySegmentIntersect(mirrorOri, dir, mdw->Node1, mdw->Node2, hitwallp);
+						}
 						bool valid = true;
 						if (mdw == nullptr) { // didn't hit anything
 							curResult.TargetPoint1 = lastdir;
@@ -350,7 +1201,7 @@ namespace DE {
 									n._sd1 = curResult.TargetStrength1;
 									n._sd2 = curResult.TargetStrength2;
 #ifdef DEBUG
-									n._src = results.Count();
+									n._src = resultCount;
 #endif
 									n._pow = hitwallp;
 									mirrorCast.PushTail(n);
@@ -361,13 +1212,15 @@ namespace DE {
 #ifdef DEBUG
 							curResult.Father = n._src;
 #endif
-							results.PushBack(curResult);
+							output(curResult);
+#ifdef DEBUG
+							++resultCount;
+#endif
 						}
 						lastdir = curdir;
 						lasthitp = curhitp;
 					}
 				}
-				return results;
 			}
 		}
 	}
@@ -1,10 +1,18 @@
 #pragma once
 
+#include <functional>
+
 #include "Math.h"
 #include "Vector2.h"
+#include "Rectangle.h"
+#include "Color.h"
 #include "List.h"
+#include "ThreadPool.h"
 
 namespace DE {
+	namespace Graphics {
+		struct Vertex;
+	}
 	namespace Utils {
 		namespace LightCaster {
 			struct Light {
@@ -28,26 +36,114 @@ namespace DE {
 #endif
 			};
 
+			// a uniform grid over the walls, so that only the walls near a light are looked at
+			class WallGrid {
+				public:
+					constexpr static size_t MaxGridSize = 1024, MaxCellsPerWall = 4;
+
+					void Build(const Core::Collections::List<Wall>&);
+					// the walls whose bounding boxes overlap the region, in the order they're in the list
+					void Query(const Core::Math::Rectangle&, Core::Collections::List<size_t, true>&) const;
+				private:
+					struct WallCells {
+						Core::Math::Rectangle Bounds;
+						size_t Left, Top, Right, Bottom;
+					};
+
+					Core::Math::Rectangle _bound;
+					size_t _width = 0, _height = 0;
+					double _cellWidth = 0.0, _cellHeight = 0.0;
+					Core::Collections::List<WallCells, true> _cells;
+					Core::Collections::List<size_t, true> _cellStart, _cellWalls; // the walls of cell c are _cellWalls[_cellStart[c]..]
+
+					size_t GetColumn(double x) const {
+						return static_cast<size_t>(Core::Math::Clamp((x - _bound.Left) / _cellWidth, 0.0, _width - 1.0));
+					}
+					size_t GetRow(double y) const {
+						return static_cast<size_t>(Core::Math::Clamp((y - _bound.Top) / _cellHeight, 0.0, _height - 1.0));
+					}
+			};
+
+			class Caster;
+			// the results of the last cast of a light. they're reused until the light moves further than the tolerance,
+			// its strength changes, or a wall that may be within its reach changes
+			class CastCache {
+					friend class Caster;
+				public:
+					double &Tolerance() {
+						return _tolerance;
+					}
+					const double &Tolerance() const {
+						return _tolerance;
+					}
+
+					const Core::Collections::List<CastResult> &Results() const {
+						return _results;
+					}
+					void Invalidate() {
+						_caster = nullptr;
+					}
+				private:
+					const Caster *_caster = nullptr;
+					Light _light;
+					Core::Math::Rectangle _looked; // where the walls could change the results
+					size_t _split = 0, _version = 0;
+					double _tolerance = 0.0;
+					Core::Collections::List<CastResult> _results;
+			};
+
 			class Caster {
 				public:
+					constexpr static size_t MaxChangeRecords = 64, MaxChangedRegions = 8;
+
 					Core::Collections::List<CastResult> Cast(const Light&, size_t = 50) const;
+					// recasts only when the cache is out of date
+					const Core::Collections::List<CastResult> &Cast(const Light&, CastCache&, size_t = 50) const;
+					// casts the lights on the threads of the pool (ThreadPool::Default() if none), and writes the triangles they
+					// light up to the vertices, three for each directly lit part and six for each reflected one. the vertices of
+					// lights[i] are vertices[offsets[i]] to vertices[offsets[i + 1] - 1]. the storage of the lists, and the
+					// buffers that each light is cast into, are reused, so that there's little to allocate from frame to frame
+					// NOTE not to be called from more than one thread at once
+					void CastAll(
+						const Core::Collections::List<Light>&, Core::Collections::List<Graphics::Vertex>&,
+						Core::Collections::List<size_t, true>&, const Core::Color&, size_t = 50, Core::ThreadPool* = nullptr
+					) const;
 
+					// changes to the walls are only noticed after MarkWallsChanged(), which has the index over them rebuilt
+					// on the next cast. until then, casts still see the walls as they were when it was last built
+					// NOTE changes made through the raw pointer (*Walls()) aren't found by the caches
 					Core::Collections::List<Wall> &Walls() {
 						return _walls;
 					}
 					const Core::Collections::List<Wall> &Walls() const {
 						return _walls;
 					}
+					void MarkWallsChanged() {
+						++_wallsVersion;
+					}
 				private:
-					class DirectionComparer {
-						public:
-							static int Compare(const Core::Math::Vector2 &lhs, const Core::Math::Vector2 &rhs) {
-								// this is RIGHT because this is quick sort
-								double dv = Core::Math::Vector2::Cross(lhs, rhs);
-								return (dv > 0 ? 1 : (dv < 0 ? -1 : 0));
-							}
+					struct WallChange {
+						size_t Version;
+						Core::Math::Rectangle Region;
 					};
+
 					Core::Collections::List<Wall> _walls;
+					// the walls that the grid was built with, sharing the storage of _walls until that's changed
+					mutable Core::Collections::List<Wall> _indexedWalls;
+					mutable WallGrid _grid;
+					mutable bool _indexed = false;
+					size_t _wallsVersion = 0;
+					mutable size_t _indexedWallsVersion = 0;
+					mutable size_t _version = 0;
+					mutable Core::Collections::List<WallChange> _changes; // the regions of the last few changes
+					mutable Core::Collections::List<Core::Collections::List<Graphics::Vertex>> _lightVertices; // for CastAll
+
+					void DoCast(
+						const Light&, size_t, Core::Math::Rectangle&, const std::function<void(const CastResult&)>&
+					) const;
+					void UpdateIndex() const;
+					void RecordChanges(Core::Collections::List<Core::Math::Rectangle>&) const;
+					bool IsUpToDate(const CastCache&, const Light&, size_t) const;
 			};
 		}
 	}
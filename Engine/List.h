@@ -19,8 +19,11 @@ namespace DE {
 	namespace Core {
 		namespace Collections {
 			// NOTE list.PushBack(list.Last()) IS A TRAP!
+			// the memory comes from the Allocator, which has static Allocate(size_t) and Free(void*) like GlobalAllocator
 #ifndef TEST_KERNEL_LIST
-			template <typename T, bool DirectMemoryAccess = !IsClass<T>::Result> class List {
+			template <
+				typename T, bool DirectMemoryAccess = !IsClass<T>::Result, typename Allocator = GlobalAllocator
+			> class List {
 				public:
 					constexpr static size_t MinCapicy = 5;
 
@@ -42,7 +45,7 @@ namespace DE {
 							}
 						}
 					}
-					void PushBackRange(const List<T, DirectMemoryAccess> &range) {
+					void PushBackRange(const List &range) {
 						PushBackRange(*range, range.Count());
 					}
 					void PushBackRange(const T *range, size_t count) {
@@ -60,11 +63,8 @@ namespace DE {
 							}
 						}
 					}
-					static List<T, DirectMemoryAccess> Concat(
-						const List<T, DirectMemoryAccess> &lhs,
-						const List<T, DirectMemoryAccess> &rhs
-					) {
-						List<T, DirectMemoryAccess> result = lhs;
+					static List Concat(const List &lhs, const List &rhs) {
+						List result = lhs;
 						result.PushBackRange(rhs);
 						return result;
 					}
@@ -93,11 +93,11 @@ namespace DE {
 #endif
 						OnChanged();
 						if (DirectMemoryAccess) {
-							T *tmp = (T*)GlobalAllocator::Allocate(sizeof(T)), *aad = _data->GetArray() + a, *bad = _data->GetArray() + b;
+							alignas(T) unsigned char tmp[sizeof(T)];
+							T *aad = _data->GetArray() + a, *bad = _data->GetArray() + b;
 							memcpy(tmp, aad, sizeof(T));
 							memcpy(aad, bad, sizeof(T));
 							memcpy(bad, tmp, sizeof(T));
-							GlobalAllocator::Free(tmp);
 						} else {
 							T &aad = _data->GetArray()[a], &bad = _data->GetArray()[b], tempObj = aad;
 							aad = bad;
@@ -155,13 +155,7 @@ namespace DE {
 #endif
 						CheckShrink();
 						if (DirectMemoryAccess) {
-							size_t sz = (_data->Count - start - count) * sizeof(T);
-							if (sz > 0) {
-								T *buf = (T*)GlobalAllocator::Allocate(sz);
-								memcpy(buf, _data->GetArray() + start + count, sz);
-								memcpy(_data->GetArray() + start, buf, sz);
-								GlobalAllocator::Free(buf);
-							}
+							memmove(_data->GetArray() + start, _data->GetArray() + start + count, (_data->Count - start - count) * sizeof(T));
 						} else {
 							T *cur = _data->GetArray() + start;
 							for (T *tar = cur + count, *fin = _data->GetArray() + _data->Count; tar != fin; ++cur, ++tar) {
@@ -202,14 +196,8 @@ namespace DE {
 						size_t oc = Count();
 						IncreaseCount(count);
 						if (DirectMemoryAccess) {
-							size_t sz = (oc - index) * sizeof(T);
-							if (sz > 0) {
-								T *buf = (T*)GlobalAllocator::Allocate(sz);
-								memcpy(buf, _data->GetArray() + index, sz);
-								memcpy(_data->GetArray() + index + count, buf, sz);
-								GlobalAllocator::Free(buf);
-								memcpy(_data->GetArray() + index, objs, sizeof(T) * count);
-							}
+							memmove(_data->GetArray() + index + count, _data->GetArray() + index, (oc - index) * sizeof(T));
+							memcpy(_data->GetArray() + index, objs, sizeof(T) * count);
 						} else {
 							T *add = _data->GetArray() + index + count, *spl = _data->GetArray() + oc;
 							for (T *cur = _data->GetArray() + _data->Count, *src = spl; cur != add; ) {
@@ -232,8 +220,8 @@ namespace DE {
 					void Insert(size_t index, const T &obj) {
 						Insert(index, &obj, 1);
 					}
-					void Insert(size_t index, const List<T, DirectMemoryAccess> &objs) {
-						Insert(*objs, index, objs.Count());
+					void Insert(size_t index, const List &objs) {
+						Insert(index, *objs, objs.Count());
 					}
 
 					template <typename Predicate = EqualityPredicate<T>> bool Contains(const T &target) const {
@@ -478,7 +466,7 @@ namespace DE {
 								}
 							}
 						}
-						_data = MakeShared(nd);
+						_data = _DataPointer(nd);
 					}
 
 					struct _ListData {
@@ -497,7 +485,7 @@ namespace DE {
 							}
 						}
 
-						size_t Count = 0, Capicy = MinCapicy;
+						size_t Count = 0, Capicy = MinCapicy, References = 1;
 
 						T *GetArray() {
 							return reinterpret_cast<T*>(this + 1);
@@ -510,10 +498,51 @@ namespace DE {
 						return GetListDataSize(data->Capicy);
 					}
 					inline static _ListData *CreateListData(size_t capicy) {
-						return new (GlobalAllocator::Allocate(GetListDataSize(capicy))) _ListData(capicy);
+						return new (Allocator::Allocate(GetListDataSize(capicy))) _ListData(capicy);
 					}
+					// shares the data between copies of the list, with the reference count kept in the data itself
+					class _DataPointer {
+						public:
+							_DataPointer(_ListData *data = nullptr) : _ptr(data) {
+							}
+							_DataPointer(const _DataPointer &src) : _ptr(src._ptr) {
+								if (_ptr) {
+									++_ptr->References;
+								}
+							}
+							_DataPointer &operator =(const _DataPointer &rhs) {
+								if (rhs._ptr) {
+									++rhs._ptr->References;
+								}
+								Release();
+								_ptr = rhs._ptr;
+								return *this;
+							}
+							~_DataPointer() {
+								Release();
+							}
+
+							size_t Count() const {
+								return _ptr ? _ptr->References : 0;
+							}
+							_ListData *operator ->() const {
+								return _ptr;
+							}
+							operator _ListData*() const {
+								return _ptr;
+							}
+						private:
+							_ListData *_ptr;
+
+							void Release() {
+								if (_ptr && --_ptr->References == 0) {
+									_ptr->~_ListData();
+									Allocator::Free(_ptr);
+								}
+							}
+					};
 
-					SharedPointer<_ListData> _data;
+					_DataPointer _data;
 #ifdef STRICT_RUNTIME_CHECK
 					mutable size_t _inFE = 0;
 #endif
@@ -546,7 +575,9 @@ namespace DE {
 					typedef bool RealType;
 					typedef std::vector<WrappedBoolean> ContainerType;
 			};
-			template <typename T, bool DirectMemoryAccess = !IsClass<T>::Result> class List {
+			template <
+				typename T, bool DirectMemoryAccess = !IsClass<T>::Result, typename Allocator = GlobalAllocator
+			> class List {
 				public:
 					List() {
 					}
@@ -1,5 +1,7 @@
 #include "Math.h"
 
+#include "ThreadPool.h"
+
 namespace DE {
 	namespace Core {
 		namespace Math {
@@ -317,7 +319,7 @@ namespace DE {
 				Vector2 pt1 = p1 - pt, pt2 = p2 - pt, pdir = p2 - p1;
 				pdir.RotateRight90();
 				double dv1 = Vector2::Cross(pdir, pt1), dv2 = Vector2::Cross(pdir, pt2);
-				if (dv1 * dv2 > 0.0) {
+				if (dv1 * dv2 > 0.0 || (p2 - p1).LengthSquared() <= Epsilon) {
 					return (pt1.LengthSquared() > pt2.LengthSquared() ? pt2.Length() : pt1.Length());
 				} else {
 					return Abs(Vector2::Dot(pt2, pdir) / pdir.Length());
@@ -334,6 +336,147 @@ namespace DE {
 					return dotR * dotR / pdir.LengthSquared();
 				}
 			}
+			class HullPointComparer {
+				public:
+					static int Compare(const Vector2 &lhs, const Vector2 &rhs) {
+						if (lhs.X != rhs.X) {
+							return lhs.X < rhs.X ? -1 : 1;
+						}
+						return lhs.Y < rhs.Y ? -1 : (lhs.Y > rhs.Y ? 1 : 0);
+					}
+			};
+			size_t ConvexHull(Vector2 *points, size_t count, Vector2 *out) {
+				if (count < 2) {
+					if (count == 1) {
+						out[0] = points[0];
+					}
+					return count;
+				}
+				// points strictly inside the quadrilateral of the extreme points can't be on the hull
+				Vector2 quad[4] = {points[0], points[0], points[0], points[0]};
+				for (size_t i = 1; i < count; ++i) {
+					const Vector2 &p = points[i];
+					if (p.X < quad[0].X) {
+						quad[0] = p;
+					}
+					if (p.Y < quad[1].Y) {
+						quad[1] = p;
+					}
+					if (p.X > quad[2].X) {
+						quad[2] = p;
+					}
+					if (p.Y > quad[3].Y) {
+						quad[3] = p;
+					}
+				}
+				size_t kept = 0;
+				for (size_t i = 0; i < count; ++i) {
+					const Vector2 &p = points[i];
+					if (
+						Vector2::Cross(quad[1] - quad[0], p - quad[0]) <= 0.0 ||
+						Vector2::Cross(quad[2] - quad[1], p - quad[1]) <= 0.0 ||
+						Vector2::Cross(quad[3] - quad[2], p - quad[2]) <= 0.0 ||
+						Vector2::Cross(quad[0] - quad[3], p - quad[3]) <= 0.0
+					) {
+						Swap(points[kept++], points[i]);
+					}
+				}
+				count = kept;
+				HeapSort<Vector2, HullPointComparer>(points, count);
+				size_t k = 0;
+				for (size_t i = 0; i < count; ++i) { // lower chain
+					while (k >= 2 && Vector2::Cross(out[k - 1] - out[k - 2], points[i] - out[k - 2]) <= 0.0) {
+						--k;
+					}
+					out[k++] = points[i];
+				}
+				for (size_t i = count - 1, lower = k + 1; i > 0; ) { // upper chain
+					--i;
+					while (k >= lower && Vector2::Cross(out[k - 1] - out[k - 2], points[i] - out[k - 2]) <= 0.0) {
+						--k;
+					}
+					out[k++] = points[i];
+				}
+				if (k == 3) { // a segment, or all points are the same
+					return out[0].X == out[1].X && out[0].Y == out[1].Y ? 1 : k - 1;
+				}
+				return k - 1; // the last point is the first one
+			}
+			size_t ConvexHull(Vector2 *points, size_t count, Vector2 *out, ThreadPool &pool) {
+				const size_t MinPartSize = 16384, MaxParts = 64;
+				size_t parts = Min(Min(pool.GetThreadCount() * 2, MaxParts), count / MinPartSize), sizes[MaxParts];
+				if (parts < 2) {
+					return ConvexHull(points, count, out);
+				}
+				// part i goes to hulls[begin(i) + i, begin(i + 1) + i + 1), which leaves room for its closing point. out only
+				// holds count + 1 points, so the hulls of the parts are kept apart from it
+				Collections::List<Vector2, true> scratch(Vector2(), count + parts);
+				Vector2 *hulls = *scratch;
+				pool.ParallelFor(parts, [&](size_t i) {
+					size_t begin = count * i / parts, end = count * (i + 1) / parts;
+					sizes[i] = ConvexHull(points + begin, end - begin, hulls + begin + i);
+				});
+				// the points of the hull are among the points of the hulls of the parts
+				size_t total = 0;
+				for (size_t i = 0; i < parts; ++i) {
+					const Vector2 *hull = hulls + count * i / parts + i;
+					for (size_t j = 0; j < sizes[i]; ++j) {
+						points[total++] = hull[j];
+					}
+				}
+				return ConvexHull(points, total, out);
+			}
+
+			template <bool Negate> inline Vector2 MinkowskiPoint(const Vector2 *poly, size_t count, size_t start, size_t i) {
+				i += start;
+				if (i >= count) {
+					i -= count;
+				}
+				return Negate ? -poly[i] : poly[i];
+			}
+			template <bool Negate> inline size_t MinkowskiStart(const Vector2 *poly, size_t count) {
+				size_t res = 0;
+				for (size_t i = 1; i < count; ++i) {
+					Vector2 cur = MinkowskiPoint<Negate>(poly, count, 0, i), best = MinkowskiPoint<Negate>(poly, count, 0, res);
+					if (cur.Y < best.Y || (cur.Y == best.Y && cur.X < best.X)) {
+						res = i;
+					}
+				}
+				return res;
+			}
+			// both polygons start from their lowest points, and edges are taken in the order of their angles
+			template <bool Negate> size_t MinkowskiMerge(const Vector2 *a, size_t na, const Vector2 *b, size_t nb, Vector2 *out) {
+				if (na == 0 || nb == 0) {
+					return 0;
+				}
+				size_t sa = MinkowskiStart<false>(a, na), sb = MinkowskiStart<Negate>(b, nb), i = 0, j = 0, k = 0;
+				while (i < na || j < nb) {
+					out[k++] = MinkowskiPoint<false>(a, na, sa, i) + MinkowskiPoint<Negate>(b, nb, sb, j);
+					if (i == na) {
+						++j;
+					} else if (j == nb) {
+						++i;
+					} else {
+						double cross = Vector2::Cross(
+							MinkowskiPoint<false>(a, na, sa, i + 1) - MinkowskiPoint<false>(a, na, sa, i),
+							MinkowskiPoint<Negate>(b, nb, sb, j + 1) - MinkowskiPoint<Negate>(b, nb, sb, j)
+						);
+						if (cross >= 0.0) {
+							++i;
+						}
+						if (cross <= 0.0) { // parallel edges are merged
+							++j;
+						}
+					}
+				}
+				return k;
+			}
+			size_t MinkowskiSum(const Vector2 *a, size_t na, const Vector2 *b, size_t nb, Vector2 *out) {
+				return MinkowskiMerge<false>(a, na, b, nb, out);
+			}
+			size_t MinkowskiDifference(const Vector2 *a, size_t na, const Vector2 *b, size_t nb, Vector2 *out) {
+				return MinkowskiMerge<true>(a, na, b, nb, out);
+			}
 		}
 	}
 }
@@ -7,6 +7,8 @@
 
 namespace DE {
 	namespace Core {
+		class ThreadPool;
+
 		template <typename T> class DefaultComparer {
 			public:
 				static int Compare(const T &lhs, const T &rhs) {
@@ -106,6 +108,27 @@ namespace DE {
 			template <typename T, typename Comparer = DefaultComparer<T>> inline void UnstableSort(T *arr, size_t count) {
 				UnstableSortRange<T*, T, Comparer>(arr, 0, count - 1);
 			}
+			// in place and O(n log n) even for sorted input, which is the worst case of UnstableSort
+			template <typename T, typename Comparer = DefaultComparer<T>> inline void HeapSort(T *arr, size_t count) {
+				auto siftDown = [arr](size_t i, size_t n) {
+					for (size_t c = 2 * i + 1; c < n; i = c, c = 2 * i + 1) {
+						if (c + 1 < n && Comparer::Compare(arr[c], arr[c + 1]) < 0) {
+							++c;
+						}
+						if (Comparer::Compare(arr[i], arr[c]) >= 0) {
+							break;
+						}
+						Swap(arr[i], arr[c]);
+					}
+				};
+				for (size_t i = count / 2; i > 0; ) {
+					siftDown(--i, count);
+				}
+				for (size_t n = count; n > 1; ) {
+					Swap(arr[0], arr[--n]);
+					siftDown(0, n);
+				}
+			}
 
 			#define DE_MATH_DEFVARS				\
 				if (count == 0) {				\
@@ -231,6 +254,18 @@ namespace DE {
 			IntersectionType PolygonPointIntersect(const Core::Collections::List<Vector2>&, const Vector2&);
 
 
+			// the convex hull of the points by Andrew's monotone chain, counterclockwise (y up) from the point with the
+			// smallest x, without collinear points; the points are reordered in place, and out must hold count + 1 points
+			// returns the number of points of the hull
+			size_t ConvexHull(Vector2*, size_t, Vector2*);
+			// the same hull, with the points split into parts whose hulls are found on the threads of the pool
+			size_t ConvexHull(Vector2*, size_t, Vector2*, ThreadPool&);
+			// the minkowski sum of two convex counterclockwise polygons, found by merging their edges by angle
+			// out must hold the sum of the numbers of points, and the number of points of the result is returned
+			size_t MinkowskiSum(const Vector2*, size_t, const Vector2*, size_t, Vector2*);
+			size_t MinkowskiDifference(const Vector2*, size_t, const Vector2*, size_t, Vector2*); // the sum of the first and -second
+
+
 			void Projection(const Vector2&, const Vector2&, Vector2&, Vector2&);
 			Vector2 ProjectionX(const Vector2&, const Vector2&);
 			Vector2 ProjectionY(const Vector2&, const Vector2&);
@@ -1,5 +1,6 @@
 #include "MazeGenerator.h"
 
+#include "FileAccess.h"
 
 namespace DE {
 	using namespace Core;
@@ -23,16 +24,9 @@ namespace DE {
 				Maze finMz(w, h);
 				Random r;
 				List<BlockID> q;
-				BitSet bs;
-				List<Direction> path(Direction::Up, w * h);
 				size_t tsz = w * h;
-				unsigned char c = 0;
-				for (size_t i = 0; i < (tsz>>3); ++i) {
-					bs.PushBackBits(&c, (1<<3));
-				}
-				for (size_t i = 0; i < (tsz & BitSet::Mask); ++i) {
-					bs.PushBack(false);
-				}
+				BitSet bs(false, tsz);
+				List<unsigned char, true> path(0, (tsz + 3) / 4); // the direction each block is entered from, 2 bits each
 				for (size_t i = 0; i < disabled.Count(); ++i) {
 					BlockID id = disabled[i];
 					if (!finMz.IsValidBlockID(id)) {
@@ -43,28 +37,29 @@ namespace DE {
 				q.PushBack(start);
 				bs.SetAt(start.X + start.Y * w, true);
 				bool haveWay = false;
+				StepData avl[4];
 				while (q.Count() > 0) {
-					List<StepData> avl;
+					size_t avlCount = 0;
 					if (met == Method::BFS) {
 						q.SwapToBack(r.NextBetween(0, q.Count()));
 					}
 					BlockID cur = q.Last();
-					for (unsigned i = 1; i < (1<<5); i <<= 1) {
+					for (unsigned i = 1; i < (1<<4); i <<= 1) {
 						if (finMz.CanMove(cur, (Direction)i)) {
 							BlockID moved = cur.Go((Direction)i);
 							if (moved == finish) {
 								haveWay = true;
 							}
 							if (!bs.GetAt(moved.X + moved.Y * w)) {
-								avl.PushBack(StepData(cur, moved, (Direction)i));
+								avl[avlCount++] = StepData(cur, moved, (Direction)i);
 							}
 						}
 					}
-					if (avl.Count() > 0) {
-						StepData tar = avl[r.NextBetween(0, avl.Count())];
+					if (avlCount > 0) {
+						StepData tar = avl[r.NextBetween(0, avlCount)];
 						size_t bid = tar._tid.X + tar._tid.Y * w;
 						bs.SetAt(bid, true);
-						path[bid] = tar._dir;
+						path[bid >> 2] |= static_cast<unsigned char>((Math::HighestBit(static_cast<unsigned>(tar._dir)) - 1) << ((bid & 3) << 1));
 						finMz.SetWall(tar._fid, tar._dir, false);
 						q.PushBack(tar._tid);
 					} else {
@@ -73,7 +68,8 @@ namespace DE {
 				}
 				if (haveWay) {
 					for (BlockID cid = finish; cid != start; ) {
-						Direction d = path[cid.Y * w + cid.X];
+						size_t bid = cid.Y * w + cid.X;
+						Direction d = static_cast<Direction>(1 << ((path[bid >> 2] >> ((bid & 3) << 1)) & 3));
 						finMz._rt.PushBack(d);
 						cid = cid.Go(Reverse(d));
 					}
@@ -86,6 +82,110 @@ namespace DE {
 			Maze Generate(size_t w, size_t h, BlockID start, BlockID finish, Method met) {
 				return Generate(w, h, start, finish, met, List<BlockID>());
 			}
+
+			inline MazeRow::WordType NextWord(Random &r) { // 5 numbers of 15 bits each
+				MazeRow::WordType res = 0;
+				for (size_t i = 0; i < 5; ++i) {
+					res = (res << 15) | static_cast<MazeRow::WordType>(r.Next());
+				}
+				return res;
+			}
+			inline size_t FindSet(size_t *parent, size_t id) {
+				while (parent[id] != id) {
+					id = parent[id] = parent[parent[id]];
+				}
+				return id;
+			}
+			// each block of the current row is labeled by the set of blocks connected to it through the rows above, and
+			// labels are renumbered below the width before each row, so that all arrays are indexed by the labels
+			// in each row, neighbors in different sets are randomly joined, and then at least one block of each set is
+			// randomly opened to the next row; in the last row, all different sets are joined
+			// the random choices are whole words of random bits written over the walls, and are then fixed block by
+			// block without branches, since they're unpredictable by nature
+			void GenerateRows(size_t w, size_t h, const std::function<void(const MazeRow&)> &callback, Random rand) {
+				typedef MazeRow::WordType WordType;
+				const size_t BitsPerWord = MazeRow::BitsPerWord;
+				if (w == 0 || h == 0) {
+					throw InvalidArgumentException(_TEXT("invalid maze size"));
+				}
+				MazeRow row;
+				row.Width = w;
+				size_t words = row.WordCount();
+				List<size_t, true> state(0, 5 * w);
+				List<WordType, true> walls(0, 2 * words);
+				size_t
+					*label = *state, // the set of each block
+					*parent = label + w, // the sets joined into each set in this row
+					*lastBlock = parent + w, // the last block of each set, also the new label of each set when renumbering
+					*downMark = lastBlock + w, // the last row each set was opened downwards in
+					*renumMark = downMark + w; // the last row each set has been renumbered in
+				WordType *right = *walls, *down = right + words, border = ~static_cast<WordType>(0);
+				if (w % BitsPerWord != 0) { // bits past the width are set
+					border <<= w % BitsPerWord - 1;
+				} else {
+					border = static_cast<WordType>(1) << (BitsPerWord - 1);
+				}
+				row.Right = right;
+				row.Down = down;
+				for (size_t x = 0; x < w; ++x) {
+					label[x] = x;
+				}
+				for (size_t y = 0; y < h; ++y) {
+					bool last = (y + 1 == h);
+					size_t mark = y + 1; // the arrays of marks start out as 0
+					for (size_t i = 0; i < words; ++i) {
+						right[i] = NextWord(rand);
+						down[i] = (last ? ~static_cast<WordType>(0) : NextWord(rand));
+					}
+					right[words - 1] |= border;
+					down[words - 1] |= border << 1; // the last block may be opened
+					for (size_t x = 0; x < w; ++x) {
+						parent[label[x]] = label[x];
+					}
+					for (size_t x = 0, a = label[0]; x + 1 < w; ++x) { // a is the set of block x
+						size_t b = FindSet(parent, label[x + 1]);
+						WordType &word = right[x / BitsPerWord], bit = static_cast<WordType>(1) << (x % BitsPerWord);
+						bool join = (a != b) & (last | ((word & bit) == 0));
+						word = (join ? word & ~bit : word | bit);
+						parent[b] = (join ? a : b);
+						a = (join ? a : b);
+					}
+					if (!last) {
+						for (size_t x = 0; x < w; ++x) {
+							size_t set = label[x] = FindSet(parent, label[x]);
+							lastBlock[set] = x;
+							bool open = ((down[x / BitsPerWord] >> (x % BitsPerWord)) & 1) == 0;
+							downMark[set] = (open ? mark : downMark[set]);
+						}
+						for (size_t x = 0; x < w; ++x) {
+							size_t set = label[x];
+							if (downMark[set] != mark && lastBlock[set] == x) {
+								down[x / BitsPerWord] &= ~(static_cast<WordType>(1) << (x % BitsPerWord));
+							}
+						}
+					}
+					row.Y = y;
+					callback(row);
+					if (!last) {
+						size_t next = 0;
+						for (size_t x = 0; x < w; ++x) {
+							size_t set = label[x], fresh = next;
+							bool open = ((down[x / BitsPerWord] >> (x % BitsPerWord)) & 1) == 0, first = open & (renumMark[set] != mark);
+							next += (first | !open);
+							lastBlock[set] = (first ? fresh : lastBlock[set]);
+							renumMark[set] = (first ? mark : renumMark[set]);
+							label[x] = (open ? lastBlock[set] : fresh);
+						}
+					}
+				}
+			}
+			void GenerateRows(size_t w, size_t h, IO::FileAccess &file, Random rand) {
+				GenerateRows(w, h, [&file](const MazeRow &row) {
+					size_t words = row.WordCount();
+					file.WriteBinaryRaw(row.Right, sizeof(MazeRow::WordType) * words);
+					file.WriteBinaryRaw(row.Down, sizeof(MazeRow::WordType) * words);
+				}, rand);
+			}
 		}
 	}
 }
@@ -7,10 +7,14 @@
 #include "UtilsCommon.h"
 
 namespace DE {
+	namespace IO {
+		class FileAccess;
+	}
 	namespace Utils {
 		namespace MazeGenerator {
 			class Maze;
 			struct BlockID;
+			struct MazeRow;
 
 			enum class Method {
 				BFS,
@@ -18,6 +22,11 @@ namespace DE {
 			};
 			Maze Generate(size_t, size_t, BlockID, BlockID, Method, const Core::Collections::List<BlockID>&);
 			Maze Generate(size_t, size_t, BlockID, BlockID, Method);
+			// generates a perfect maze row by row with Eller's algorithm, keeping only O(width) memory, so that the maze
+			// can be much larger than what a Maze can hold; each row is passed to the callback once it's completed
+			void GenerateRows(size_t, size_t, const std::function<void(const MazeRow&)>&, Core::Random = Core::Random());
+			// writes the words of MazeRow::Right and then MazeRow::Down of each row to the file
+			void GenerateRows(size_t, size_t, IO::FileAccess&, Core::Random = Core::Random());
 
 			struct Block {
 				Block() = default;
@@ -93,6 +102,40 @@ namespace DE {
 
 				size_t X = 0, Y = 0;
 			};
+			// a row generated by GenerateRows, only valid in the callback; walls are packed into words, bit x being set
+			// if there's a wall to the right of, or below cell x, which is always the case at the borders
+			struct MazeRow {
+				public:
+					typedef unsigned long long WordType;
+					constexpr static size_t BitsPerWord = sizeof(WordType) * 8;
+
+					size_t Y = 0, Width = 0;
+					const WordType *Right = nullptr, *Down = nullptr;
+
+					size_t WordCount() const {
+						return (Width + BitsPerWord - 1) / BitsPerWord;
+					}
+					bool IsWall(size_t x, Direction dir) const { // walls above cells are in the last row
+						switch (dir) {
+							case Direction::Left: {
+								return x == 0 || GetBit(Right, x - 1);
+							}
+							case Direction::Right: {
+								return GetBit(Right, x);
+							}
+							case Direction::Down: {
+								return GetBit(Down, x);
+							}
+							default: {
+								throw Core::InvalidArgumentException(_TEXT("walls above are not kept in the row"));
+							}
+						}
+					}
+				private:
+					inline static bool GetBit(const WordType *words, size_t x) {
+						return (words[x / BitsPerWord] >> (x % BitsPerWord)) & 1;
+					}
+			};
 			class Maze {
 					friend Maze Generate(size_t, size_t, BlockID, BlockID, Method, const Core::Collections::List<BlockID>&);
 				public:
@@ -148,15 +191,7 @@ namespace DE {
 						return bk;
 					}
 					void ClearWallInRegion(const Core::Collections::List<BlockID> &region) {
-						Core::Collections::BitSet bs;
-						unsigned char x = 0;
-						size_t tarnum = _w * _h;
-						for (size_t i = 0; i < (tarnum>>3); ++i) {
-							bs.PushBackBits(&x, (1<<3));
-						}
-						for (size_t i = 0; i < (tarnum & Core::Collections::BitSet::Mask); ++i) {
-							bs.PushBack(false);
-						}
+						Core::Collections::BitSet bs(false, _w * _h);
 						for (size_t i = 0; i < region.Count(); ++i) {
 							BlockID cid = region[i];
 							if (!IsValidBlockID(cid)) {
@@ -209,15 +244,8 @@ namespace DE {
 							throw Core::InvalidArgumentException(_TEXT("invalid maze size"));
 						}
 						size_t x = (w + 1) * (h + 1);
-						unsigned char n = 0xFF;
-						for (size_t i = 0; i < (x>>3); ++i) {
-							_l.PushBackBits(&n, (1<<3));
-							_t.PushBackBits(&n, (1<<3));
-						}
-						for (size_t i = 0; i < (x & Core::Collections::BitSet::Mask); ++i) {
-							_l.PushBack(true);
-							_t.PushBack(true);
-						}
+						_l.Resize(x, true);
+						_t.Resize(x, true);
 					}
 
 					size_t _w = 0, _h = 0;
@@ -8,8 +8,6 @@ namespace DE {
 	namespace Core {
 		using namespace Math;
 
-		int allocn = 0;
-
 		ObjectAllocator::ObjectAllocator(size_t chunkSize, size_t minSize, size_t zoomLevel, double zoom) :
 			_levels(new LevelData[zoomLevel]), _levelNum(zoomLevel)
 		{
@@ -26,13 +24,21 @@ namespace DE {
 			double curSize = minSize;
 			for (size_t i = 0; i < zoomLevel; ++i, curSize *= zoom) {
 				LevelData &curData = _levels[i];
+				curData._owner = this;
 				curData._level = i;
-				curData._blockSize = (size_t)curSize;
-				curData._blockNum =
-					(size_t)ceil((chunkSize - sizeof(ChunkData)) / (curData._blockSize + sizeof(void*)));
+				curData._blockSize = ((size_t)curSize + sizeof(void*) - 1) & ~(sizeof(void*) - 1); // keeps the slots aligned
+				curData._blockNum = Max<size_t>(
+					1, (size_t)ceil((chunkSize - sizeof(ChunkData)) / (curData._blockSize + sizeof(void*)))
+				);
 				curData._allocSize =
 					sizeof(ChunkData) + curData._blockNum * (curData._blockSize + sizeof(void*));
 			}
+			// sizes whose highest bit is bit b - 1 are larger than 2^(b - 1), so levels that are no larger can be skipped
+			for (size_t b = 0, lvl = 0; b < sizeof(_sizeClasses) / sizeof(size_t); ++b) {
+				for (size_t least = (b == 0 ? 0 : (size_t(1)<<(b - 1)) + 1); lvl < _levelNum && _levels[lvl]._blockSize < least; ++lvl) {
+				}
+				_sizeClasses[b] = lvl;
+			}
 		}
 		ObjectAllocator::~ObjectAllocator() {
 #ifdef DEBUG
@@ -40,13 +46,14 @@ namespace DE {
 				DumpAsText("dump.txt");
 			}
 #endif
+			FreeRemote();
 			for (size_t lvl = 0; lvl < _levelNum; ++lvl) {
 				for (ChunkData *curData = _levels[lvl]._firstChunk, *nextData = nullptr; curData; curData = nextData) {
 					nextData = curData->_next;
 					free(curData);
 				}
 			}
-			free(_levels);
+			delete[] _levels;
 			if (_totUse > 0) {
 				throw InvalidOperationException(_TEXT("some memory was not freed"));
 			}
@@ -57,87 +64,172 @@ namespace DE {
 			return Allocate(targetSize, mxSz);
 		}
 		void *ObjectAllocator::Allocate(size_t targetSize, size_t &maxSize) {
-			size_t tarLvl = 0;
-			for (; tarLvl < _levelNum && _levels[tarLvl]._blockSize < targetSize; ++tarLvl) {
+			if (_remote.load(std::memory_order_relaxed)) {
+				FreeRemote();
 			}
-			++allocn;
-			if (tarLvl >= _levelNum) { // allocate from system memory
+			if (_levelNum == 0 || targetSize > _levels[_levelNum - 1]._blockSize) { // allocate from system memory
 				maxSize = targetSize;
 				size_t sz = sizeof(SizeTPtr2) + targetSize;
 				SizeTPtr2 *mem = static_cast<SizeTPtr2*>(malloc(sz));
 				if (!mem) {
 					throw SystemException(_TEXT("cannot allocate memory"));
 				}
-				_totUse += sz;
-				_totAlloc += sz;
+				Add(_totUse, sz);
+				Add(_totAlloc, sz);
 				mem->_size = sz;
-				mem->_pre = this;
+				mem->_pre = SystemTag();
 				return mem + 1;
 			}
+			size_t tarLvl = (targetSize == 0 ? 0 : _sizeClasses[HighestBit(static_cast<unsigned long>(targetSize - 1))]);
+			for (; _levels[tarLvl]._blockSize < targetSize; ++tarLvl) { // only when the levels are less than twice apart
+			}
 			LevelData &lvlData = _levels[tarLvl];
 			maxSize = lvlData._blockSize;
 			size_t allocSz = lvlData._blockSize + sizeof(void*);
-			_totUse += allocSz;
-			if (lvlData._recycle) { // recycled memory
-				Ptr3 &p3 = *static_cast<Ptr3*>(lvlData._recycle);
-				lvlData._recycle = p3._post;
-				p3._pre = p3._pos;
-				++(static_cast<ChunkData*>(p3._pre)->_allocedSlotNum);
-				return &p3._pos;
-			}
-			if (lvlData._remains == 0) { // allocate new chunk
-				ChunkData *data = new (malloc(lvlData._allocSize)) ChunkData();
-				if (!data) {
-					throw SystemException(_TEXT("cannot allocate memory"));
-				}
-				_totAlloc += lvlData._allocSize;
-				memset(data + 1, 0, lvlData._allocSize - sizeof(ChunkData));
-				data->_next = lvlData._firstChunk;
-				data->_data = &lvlData;
-				lvlData._firstChunk = data;
-				if (data->_next) {
-					data->_next->_prev = data;
-				}
-				lvlData._remains = lvlData._blockNum;
-				Ptr3 &p3 = *reinterpret_cast<Ptr3*>(data + 1);
-				lvlData._remain = data + 1;
-				p3._pos = data;
-			}
-			Ptr3 &p3 = *static_cast<Ptr3*>(lvlData._remain);
-			--(lvlData._remains);
-			lvlData._remain = (void***)((size_t)lvlData._remain + allocSz);
-			p3._pre = p3._pos;
-			++(static_cast<ChunkData*>(p3._pre)->_allocedSlotNum);
-			if (lvlData._remains > 0) {
-				Ptr3 &ap3 = *static_cast<Ptr3*>(lvlData._remain);
-				ap3._pos = p3._pre;
-			}
-			return &p3._pos;
+			ChunkData *data = lvlData._firstFree;
+			if (!data) {
+				data = NewChunk(lvlData);
+			} else if (data->_allocedSlotNum == 0) {
+				_emptySize -= lvlData._allocSize;
+			}
+			Ptr3 *p3;
+			if (data->_recycle) { // recycled memory
+				p3 = static_cast<Ptr3*>(data->_recycle);
+				data->_recycle = p3->_pos;
+			} else { // the slot is initialized the first time it's used
+				p3 = reinterpret_cast<Ptr3*>(reinterpret_cast<char*>(data + 1) + data->_carvedSlotNum * allocSz);
+				++(data->_carvedSlotNum);
+			}
+			p3->_pre = data;
+			if (++(data->_allocedSlotNum) == lvlData._blockNum) {
+				UnlinkFree(data);
+			}
+			Add(_totUse, allocSz);
+			return &p3->_pos;
 		}
 		void ObjectAllocator::Free(void *ptr) {
 			if (ptr == nullptr) {
 				return;
 			}
 			Ptr3 &p3 = *(Ptr3*)((size_t)ptr - sizeof(void*));
-			--allocn;
-			if (p3._pre == nullptr) {
+			if (p3._pre == nullptr) { // recycled slot; memory that was given back can't be checked
 				throw InvalidArgumentException(_TEXT("the memory was freed or wasn't allocated from this allocator"));
 			}
-			if (p3._pre == this) { // allocated from system memory
+			if (p3._pre == SystemTag()) { // allocated from system memory
 				SizeTPtr2 &p2 = *(SizeTPtr2*)(((size_t)ptr) - sizeof(SizeTPtr2));
-				_totUse -= p2._size;
-				_totAlloc -= p2._size;
+				Subtract(_totUse, p2._size);
+				Subtract(_totAlloc, p2._size);
 				free(&p2);
 				return;
 			}
 			ChunkData &data = *static_cast<ChunkData*>(p3._pre); // link it to recycle
-			size_t allocSz = data._data->_blockSize + sizeof(void*);
-			_totUse -= allocSz;
-			p3._pos = p3._pre;
+			LevelData &lvlData = *data._data;
+			Subtract(_totUse, lvlData._blockSize + sizeof(void*));
 			p3._pre = nullptr;
-			p3._post = data._data->_recycle;
-			data._data->_recycle = &p3;
-			--(data._allocedSlotNum);
+			p3._pos = data._recycle;
+			data._recycle = &p3;
+			if ((data._allocedSlotNum)-- == lvlData._blockNum) {
+				LinkFree(&data, true);
+			}
+			if (data._allocedSlotNum == 0) { // kept as the last choice for new memory, or given back
+				if (_emptySize + lvlData._allocSize > _retained) {
+					ReleaseChunk(&data);
+				} else {
+					_emptySize += lvlData._allocSize;
+					UnlinkFree(&data);
+					LinkFree(&data, false);
+				}
+			}
+		}
+
+		ObjectAllocator::ChunkData *ObjectAllocator::NewChunk(LevelData &lvlData) {
+			void *mem = malloc(lvlData._allocSize);
+			if (!mem) {
+				throw SystemException(_TEXT("cannot allocate memory"));
+			}
+			ChunkData *data = new (mem) ChunkData();
+			Add(_totAlloc, lvlData._allocSize);
+			data->_data = &lvlData;
+			data->_next = lvlData._firstChunk;
+			if (data->_next) {
+				data->_next->_prev = data;
+			}
+			lvlData._firstChunk = data;
+			LinkFree(data, true);
+			return data;
+		}
+		void ObjectAllocator::ReleaseChunk(ChunkData *data) {
+			LevelData &lvlData = *data->_data;
+			UnlinkFree(data);
+			if (data->_prev) {
+				data->_prev->_next = data->_next;
+			} else {
+				lvlData._firstChunk = data->_next;
+			}
+			if (data->_next) {
+				data->_next->_prev = data->_prev;
+			}
+			Subtract(_totAlloc, lvlData._allocSize);
+			free(data);
+		}
+		void ObjectAllocator::LinkFree(ChunkData *data, bool front) {
+			LevelData &lvlData = *data->_data;
+			if (front) {
+				data->_prevFree = nullptr;
+				data->_nextFree = lvlData._firstFree;
+				(data->_nextFree ? data->_nextFree->_prevFree : lvlData._lastFree) = data;
+				lvlData._firstFree = data;
+			} else {
+				data->_nextFree = nullptr;
+				data->_prevFree = lvlData._lastFree;
+				(data->_prevFree ? data->_prevFree->_nextFree : lvlData._firstFree) = data;
+				lvlData._lastFree = data;
+			}
+		}
+		void ObjectAllocator::UnlinkFree(ChunkData *data) {
+			LevelData &lvlData = *data->_data;
+			(data->_prevFree ? data->_prevFree->_nextFree : lvlData._firstFree) = data->_nextFree;
+			(data->_nextFree ? data->_nextFree->_prevFree : lvlData._lastFree) = data->_prevFree;
+			data->_nextFree = data->_prevFree = nullptr;
+		}
+
+		void ObjectAllocator::SetRetainedSize(size_t size) {
+			_retained = size;
+			if (_emptySize > _retained) {
+				Trim();
+			}
+		}
+		void ObjectAllocator::Trim() {
+			for (size_t lvl = 0; lvl < _levelNum; ++lvl) { // the empty chunks are at the end of the list
+				LevelData &lvlData = _levels[lvl];
+				while (lvlData._lastFree && lvlData._lastFree->_allocedSlotNum == 0) {
+					ReleaseChunk(lvlData._lastFree);
+				}
+			}
+			_emptySize = 0;
+		}
+
+		void ObjectAllocator::PushRemote(void *ptr) { // the first word of the memory links the list
+			void *head = _remote.load(std::memory_order_relaxed);
+			do {
+				*static_cast<void**>(ptr) = head;
+			} while (!_remote.compare_exchange_weak(head, ptr, std::memory_order_release, std::memory_order_relaxed));
+		}
+		void ObjectAllocator::FreeRemote() {
+			for (void *cur = _remote.exchange(nullptr, std::memory_order_acquire), *next; cur; cur = next) {
+				next = *static_cast<void**>(cur);
+				Free(cur);
+			}
+		}
+		ObjectAllocator &ObjectAllocator::GetOwner(void *ptr) {
+			void *pre = static_cast<Ptr3*>(static_cast<void*>(static_cast<void**>(ptr) - 1))->_pre;
+			if (pre == nullptr) {
+				throw InvalidArgumentException(_TEXT("the memory was freed or wasn't allocated from an ObjectAllocator"));
+			}
+			if (reinterpret_cast<size_t>(pre) & 1) { // system memory, tagged with the allocator
+				return *reinterpret_cast<ObjectAllocator*>(static_cast<char*>(pre) - 1);
+			}
+			return *static_cast<ChunkData*>(pre)->_data->_owner;
 		}
 
 		void ObjectAllocator::Dump(const char *fileName) const {
@@ -155,15 +247,16 @@ namespace DE {
 				fprintf(out, "LEVEL %u\n", _levels[i]._level);
 				for (const ChunkData *cd = _levels[i]._firstChunk; cd; cd = cd->_next) {
 					fprintf(
-						out, "  CHUNK 0x%p\n    ALLOCATED SLOTS = %u\n    PREV = 0x%p\n    NEXT = 0x%p\n",
-						static_cast<const void*>(cd), cd->_allocedSlotNum, static_cast<void*>(cd->_prev), static_cast<void*>(cd->_next)
+						out, "  CHUNK 0x%p\n    ALLOCATED SLOTS = %u\n    CARVED SLOTS = %u\n    PREV = 0x%p\n    NEXT = 0x%p\n",
+						static_cast<const void*>(cd), cd->_allocedSlotNum, static_cast<unsigned>(cd->_carvedSlotNum), static_cast<void*>(cd->_prev),
+						static_cast<void*>(cd->_next)
 					);
 					const Ptr3 *p3 = (const Ptr3*)(cd + 1);
-					for (size_t j = 0; j < _levels[i]._blockNum; ++j, p3 = reinterpret_cast<const Ptr3*>(reinterpret_cast<size_t>(p3) + sizeof(void*) + _levels[i]._blockSize)) {
+					for (size_t j = 0; j < cd->_carvedSlotNum; ++j, p3 = reinterpret_cast<const Ptr3*>(reinterpret_cast<size_t>(p3) + sizeof(void*) + _levels[i]._blockSize)) {
 						if (p3->_pre) {
 							fprintf(out, "      ALLOCATED 0x%p\n        PRE=0x%p\n         ", static_cast<const void*>(&(p3->_pos)), p3->_pre);
 						} else {
-							fprintf(out, "      UNALLOCED 0x%p\n        POS=0x%p\n        POST=0x%p\n         ", static_cast<const void*>(&(p3->_pos)), p3->_pos, p3->_post);
+							fprintf(out, "      UNALLOCED 0x%p\n        NEXT=0x%p\n         ", static_cast<const void*>(&(p3->_pos)), p3->_pos);
 						}
 						const unsigned char *arr = reinterpret_cast<const unsigned char *const>(&(p3->_pos));
 
@@ -217,9 +310,106 @@ namespace DE {
 			fclose(out);
 		}
 
-		ObjectAllocator &GlobalAllocator::GetAlloc() {
-			static ObjectAllocator _alloc;
-			return _alloc;
+		// the allocators of all threads that have allocated, kept until the program exits since memory may outlive the
+		// threads that allocated it
+		struct HeapList {
+			struct Heap {
+				ObjectAllocator Allocator;
+				Heap *Next = nullptr;
+				bool InUse = false;
+			};
+
+			std::mutex Lock;
+			Heap *First = nullptr;
+
+			// frees what other threads have freed into the allocators of exited threads, which would otherwise wait
+			// for a thread to take them over. must be called with the lock held
+			void FreeOrphaned() {
+				for (Heap *cur = First; cur; cur = cur->Next) {
+					if (!cur->InUse) {
+						cur->Allocator.FreeRemote();
+						cur->Allocator.Trim();
+					}
+				}
+			}
+
+			~HeapList() {
+				for (Heap *cur = First; cur; cur = cur->Next) {
+					cur->Allocator.FreeRemote();
+				}
+				for (Heap *cur = First, *next; cur; cur = next) {
+					next = cur->Next;
+					delete cur;
+				}
+			}
+		};
+		HeapList &GetHeaps() {
+			static HeapList _heaps;
+			return _heaps;
+		}
+
+		thread_local ObjectAllocator *GlobalAllocator::_heap = nullptr;
+
+		ObjectAllocator &GlobalAllocator::AcquireHeap() {
+			static thread_local HeapOwner _owner;
+			HeapList &heaps = GetHeaps();
+			std::lock_guard<std::mutex> guard(heaps.Lock);
+			heaps.FreeOrphaned();
+			HeapList::Heap *heap = heaps.First;
+			for (; heap && heap->InUse; heap = heap->Next) {
+			}
+			if (!heap) {
+				heap = new HeapList::Heap();
+				heap->Next = heaps.First;
+				heaps.First = heap;
+			}
+			heap->InUse = true;
+			_heap = &heap->Allocator;
+			return *_heap;
+		}
+		GlobalAllocator::HeapOwner::~HeapOwner() {
+			if (!_heap) {
+				return;
+			}
+			_heap->FreeRemote();
+			_heap->Trim();
+			HeapList &heaps = GetHeaps();
+			std::lock_guard<std::mutex> guard(heaps.Lock);
+			for (HeapList::Heap *cur = heaps.First; cur; cur = cur->Next) {
+				if (&cur->Allocator == _heap) {
+					cur->InUse = false;
+				}
+			}
+			heaps.FreeOrphaned(); // also catches what was freed into this one after FreeRemote()
+			_heap = nullptr;
+		}
+
+		void GlobalAllocator::Trim() {
+			ObjectAllocator &heap = GetHeap();
+			heap.FreeRemote();
+			heap.Trim();
+			HeapList &heaps = GetHeaps();
+			std::lock_guard<std::mutex> guard(heaps.Lock);
+			heaps.FreeOrphaned();
+		}
+
+		size_t GlobalAllocator::UsedSize() {
+			HeapList &heaps = GetHeaps();
+			std::lock_guard<std::mutex> guard(heaps.Lock);
+			size_t res = 0;
+			for (HeapList::Heap *cur = heaps.First; cur; cur = cur->Next) {
+				res += cur->Allocator.UsedSize();
+			}
+			return res;
+		}
+		size_t GlobalAllocator::AllocatedSize() {
+			HeapList &heaps = GetHeaps();
+			std::lock_guard<std::mutex> guard(heaps.Lock);
+			size_t res = 0;
+			for (HeapList::Heap *cur = heaps.First; cur; cur = cur->Next) {
+				res += cur->Allocator.AllocatedSize();
+			}
+			return res;
 		}
 //		std::map<void*, size_t> GlobalAllocator::_map;
 //		size_t GlobalAllocator::_sztot = 0;
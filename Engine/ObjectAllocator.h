@@ -4,9 +4,10 @@
 #include <cstddef>
 #include <cstdlib>
 #include <cmath>
-#include <tchar.h>
 
 #include <map>
+#include <mutex>
+#include <atomic>
 
 #include "Common.h"
 
@@ -26,14 +27,33 @@ namespace DE {
 
 				void *Allocate(size_t);
 				void *Allocate(size_t, size_t&);
+				// throws InvalidArgumentException on a second free of memory whose chunk is still kept. once the chunk
+				// is given back to the system, or for memory too large for any level, a second free is undefined
 				void Free(void*);
+				// frees memory from a thread other than the one using this allocator: the memory is linked to a lock-free
+				// list, which is freed on the next allocation, or by FreeRemote()
+				void PushRemote(void*);
+				void FreeRemote();
 
+				// the allocator the memory came from. like Free(), only detects freed memory whose chunk is still kept
+				static ObjectAllocator &GetOwner(void*);
+
+				// may be read from any thread
 				size_t AllocatedSize() const {
-					return _totAlloc;
+					return _totAlloc.load(std::memory_order_relaxed);
 				}
 				size_t UsedSize() const {
-					return _totUse;
+					return _totUse.load(std::memory_order_relaxed);
+				}
+
+				// chunks that become empty are kept for reuse while the empty chunks take up no more than the retained
+				// size, and are given back to the system past it
+				size_t GetRetainedSize() const {
+					return _retained;
 				}
+				void SetRetainedSize(size_t);
+				// gives all empty chunks back to the system
+				void Trim();
 
 				void Dump(const char*) const;
 				void DumpAsText(const char*, size_t = 30) const;
@@ -41,18 +61,21 @@ namespace DE {
 				constexpr static size_t
 					DefaultChunkSize = (1<<16), // 65536
 					DefaultMinimumSize = 16,
-					DefaultZoomLevel = 10; // 8192
+					DefaultZoomLevel = 10, // 8192
+					DefaultRetainedSize = (1<<20);
 				constexpr static double DefaultZoom = 2.0;
 			private:
 				struct ChunkData;
 				struct LevelData {
-					size_t _allocSize, _blockSize, _blockNum, _remains = 0, _level;
+					ObjectAllocator *_owner;
+					size_t _allocSize, _blockSize, _blockNum, _level;
 					ChunkData *_firstChunk = nullptr;
-					void *_recycle = nullptr, *_remain = nullptr;
+					ChunkData *_firstFree = nullptr, *_lastFree = nullptr; // chunks that aren't full, the empty ones last
 				};
 				struct ChunkData {
-					ChunkData *_next = nullptr, *_prev = nullptr;
-					size_t _allocedSlotNum = 0;
+					ChunkData *_next = nullptr, *_prev = nullptr, *_nextFree = nullptr, *_prevFree = nullptr;
+					size_t _allocedSlotNum = 0, _carvedSlotNum = 0; // slots past the carved ones have never been used
+					void *_recycle = nullptr;
 					LevelData *_data;
 				};
 				struct Ptr3 {
@@ -64,45 +87,89 @@ namespace DE {
 				};
 
 				LevelData *_levels;
-				size_t _levelNum, _totUse = 0, _totAlloc = 0;
+				size_t _levelNum, _retained = DefaultRetainedSize, _emptySize = 0;
+				// the first level that may fit a size, indexed by HighestBit(size - 1)
+				size_t _sizeClasses[sizeof(unsigned long) * 8 + 1];
+				std::atomic<size_t> _totUse {0}, _totAlloc {0}; // only changed by the thread using the allocator
+				std::atomic<void*> _remote {nullptr};
+
+				static void Add(std::atomic<size_t> &counter, size_t delta) {
+					counter.store(counter.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+				}
+				static void Subtract(std::atomic<size_t> &counter, size_t delta) {
+					counter.store(counter.load(std::memory_order_relaxed) - delta, std::memory_order_relaxed);
+				}
+				// marks memory allocated from system memory, telling it from a pointer to ChunkData
+				void *SystemTag() {
+					return reinterpret_cast<char*>(this) + 1;
+				}
+				ChunkData *NewChunk(LevelData&);
+				void ReleaseChunk(ChunkData*);
+				static void LinkFree(ChunkData*, bool front);
+				static void UnlinkFree(ChunkData*);
 				/****** MEMORY ARRANGEMENT ******
 				 *				+-------------------------+------------------------------------------------------------------+
 				 *				|1     sizeof(void*)      |2                  sizeof(_levelBlockSizes[i])                    |
-				 *				|                         |3     sizeof(void*)      |4        sizeof(void*)         |5 other |
-				 *  usage:		|-------------------------+-------------------------+-------------------------------+--------|
-				 *    recycled:	|         nullptr         | points to the chunkData | points to next recycled chunk |  none  |
-				 *    remain:	|         nullptr         | points to the chunkData |                  none                  |
+				 *				|                         |3        sizeof(void*)          |4           other                |
+				 *  usage:		|-------------------------+--------------------------------+---------------------------------|
+				 *    recycled:	|         nullptr         | points to next recycled slot   |              none               |
+				 *    uncarved:	|                           uninitialized                                                    |
 				 *    using:	| points to the chunkData |                               using                              |
 				 *				+-------------------------+------------------------------------------------------------------+
 				 ********************************/
 		};
+		// every thread allocates from an ObjectAllocator of its own, without locks. memory freed on another thread than the
+		// one it was allocated on goes back to its allocator through a lock-free list. the allocator of a thread that has
+		// exited is taken over by the next thread that needs one, together with whatever is still allocated from it
+		// NOTE containers still can't be shared between threads, since their reference counts aren't atomic
 		class GlobalAllocator {
 			public:
                 static void *Allocate(size_t sz) {
-                	return GetAlloc().Allocate(sz);
+                	return GetHeap().Allocate(sz);
                 }
                 static void *Allocate(size_t sz, size_t &actualSz) {
-                	return GetAlloc().Allocate(sz, actualSz);
+                	return GetHeap().Allocate(sz, actualSz);
                 }
                 static void Free(void *ptr) {
-					GetAlloc().Free(ptr);
+					if (ptr == nullptr) {
+						return;
+					}
+					ObjectAllocator &owner = ObjectAllocator::GetOwner(ptr), &heap = GetHeap();
+					if (&owner == &heap) {
+						heap.Free(ptr);
+					} else {
+						owner.PushRemote(ptr);
+					}
                 }
 
-                static size_t UsedSize() {
-                	return GetAlloc().UsedSize();
-                }
-                static size_t AllocatedSize() {
-                	return GetAlloc().AllocatedSize();
-                }
+				// summed over the allocators of all threads. memory freed on another thread counts as used until its
+				// allocator allocates again, or, if its thread has exited, until a thread starts, exits or calls Trim()
+                static size_t UsedSize();
+                static size_t AllocatedSize();
 
+				// the allocator of the calling thread. the allocators of threads that exit are trimmed
+                static void SetRetainedSize(size_t size) {
+                	GetHeap().SetRetainedSize(size);
+                }
+				// also frees what was freed into the allocators of threads that have exited
+                static void Trim();
                 static void Dump(const char *fileName) {
-                	GetAlloc().Dump(fileName);
+                	GetHeap().Dump(fileName);
                 }
                 static void DumpAsText(const char *fileName) {
-                	GetAlloc().DumpAsText(fileName);
+                	GetHeap().DumpAsText(fileName);
                 }
 			private:
-				static ObjectAllocator &GetAlloc();
+				struct HeapOwner { // gives the allocator back when the thread exits
+					~HeapOwner();
+				};
+
+				static thread_local ObjectAllocator *_heap;
+
+				static ObjectAllocator &GetHeap() {
+					return _heap ? *_heap : AcquireHeap();
+				}
+				static ObjectAllocator &AcquireHeap();
 		};
 //		class GlobalAllocator { // for memory test
 //			public:
@@ -48,7 +48,7 @@ namespace DE {
 				virtual void Render(Graphics::Renderer &r) override {
 					Control::Render(r);
 					_col.ForEach([&](Control *c) {
-						if (c->_vis == Visibility::Visible || c->_vis == Visibility::Ghost) {
+						if ((c->_vis == Visibility::Visible || c->_vis == Visibility::Ghost) && c->IsInRenderRegion()) {
 							c->BeginRendering(r);
 							c->Render(r);
 							c->EndRendering(r);
@@ -171,6 +171,29 @@ namespace DE {
 				virtual void OnChildrenChanged(const CollectionChangeInfo<Control*>&) {
 				}
 
+				virtual void InvalidateOnInput() override { // the children invalidate themselves
+				}
+				// panels don't clip their children, so they cover whatever their children draw on
+				virtual Core::Math::Rectangle GetVisualBounds() const override {
+					Core::Math::Rectangle bounds = _actualLayout;
+					_col.ForEach([&](const Control *c) {
+						if (c->GetVisibility() == Visibility::Visible || c->GetVisibility() == Visibility::Ghost) {
+							bounds = Core::Math::Rectangle::Union(bounds, c->GetVisualBounds());
+						}
+						return true;
+					});
+					return bounds;
+				}
+				virtual void DetectVisualChanges() override {
+					Control::DetectVisualChanges();
+					if (_vis == Visibility::Visible || _vis == Visibility::Ghost) {
+						_col.ForEach([](Control *c) {
+							c->DetectVisualChanges();
+							return true;
+						});
+					}
+				}
+
 #ifdef DEBUG
                 virtual void DumpData(std::ostream &out, Core::Collections::List<bool> &hnl) override {
                 	for (size_t i = 0; i + 1 < hnl.Count(); ++i) {
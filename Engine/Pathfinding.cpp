@@ -0,0 +1,152 @@
+#include "Pathfinding.h"
+
+namespace DE {
+	namespace Utils {
+		namespace Pathfinding {
+			using namespace Core;
+			using namespace Core::Collections;
+
+			constexpr unsigned TreeRouter::Unreached, Pathfinder::Closed;
+
+			bool TreeRouter::FindPath(BlockID from, BlockID to, List<Direction> &path) const {
+				if (from.X >= _w || from.Y >= _h || to.X >= _w || to.Y >= _h) {
+					throw OverflowException(_TEXT("index overflow"));
+				}
+				const unsigned *depth = *_depth;
+				const unsigned char *up = *_up;
+				unsigned a = static_cast<unsigned>(from.Y * _w + from.X), b = static_cast<unsigned>(to.Y * _w + to.X);
+				size_t na = 0, nb = 0; // find where the two ends meet first, so that the path can be written in place
+				for (unsigned x = a, y = b; x != y; ) {
+					if (depth[x] == 0 && depth[y] == 0) { // different trees
+						return false;
+					}
+					if (depth[x] >= depth[y]) {
+						x = Go(x, static_cast<Direction>(up[x]));
+						++na;
+					} else {
+						y = Go(y, static_cast<Direction>(up[y]));
+						++nb;
+					}
+				}
+				if (na + nb == 0) {
+					return true;
+				}
+				size_t start = path.Count();
+				path.PushBack(Direction::Left, na + nb);
+				Direction *ps = &path.At(start);
+				for (size_t i = 0; i < na; ++i, a = Go(a, static_cast<Direction>(up[a]))) {
+					ps[i] = static_cast<Direction>(up[a]);
+				}
+				for (size_t i = na + nb; i > na; --i, b = Go(b, static_cast<Direction>(up[b]))) { // backwards from the end
+					ps[i - 1] = Reverse(static_cast<Direction>(up[b]));
+				}
+				return true;
+			}
+
+			Pathfinder::NodeData *Pathfinder::Prepare(size_t w, size_t h, BlockID to) {
+				size_t cells = w * h;
+				if (cells / h != w || cells >= Closed) { // the cells, and the lengths of paths, must fit in an unsigned
+					throw OverflowException(_TEXT("the grid is too large"));
+				}
+				if (_nodes.Count() < cells) {
+					_nodes.PushBack(NodeData(), cells - _nodes.Count());
+				}
+				NodeData *nodes = &_nodes.At(0);
+				if (++_stamp == 0) { // once in 2^32 searches
+					for (size_t i = 0; i < _nodes.Count(); ++i) {
+						nodes[i].Stamp = 0;
+					}
+					_stamp = 1;
+				}
+				_open.Clear();
+				_open.Tracker().Nodes = nodes;
+				_w = w;
+				_goalX = to.X;
+				_goalY = to.Y;
+				_expanded = 0;
+				return nodes;
+			}
+			void Pathfinder::Open(size_t x, size_t y, unsigned g, unsigned parent) {
+				unsigned cell = static_cast<unsigned>(y * _w + x);
+				size_t h = (x > _goalX ? x - _goalX : _goalX - x) + (y > _goalY ? y - _goalY : _goalY - y);
+				OpenNode open {g + static_cast<unsigned>(h), g, cell};
+				NodeData &node = _open.Tracker().Nodes[cell];
+				if (node.Stamp != _stamp) {
+					node.G = g;
+					node.Parent = parent;
+					node.Stamp = _stamp;
+					_open.Insert(open);
+				} else if (node.HeapPos != Closed && g < node.G) {
+					node.G = g;
+					node.Parent = parent;
+					_open.ChangeKey(node.HeapPos, open);
+				}
+			}
+			void Pathfinder::Trace(unsigned start, unsigned goal, List<Direction> &path) {
+				const NodeData *nodes = _open.Tracker().Nodes;
+				_trace.Remove(0, _trace.Count());
+				for (unsigned cell = goal; cell != start; cell = nodes[cell].Parent) {
+					_trace.PushBack(cell);
+				}
+				_trace.PushBack(start);
+				for (size_t i = _trace.Count() - 1; i > 0; --i) {
+					unsigned from = _trace[i], to = _trace[i - 1];
+					if (to / _w == from / _w) {
+						path.PushBack(to > from ? Direction::Right : Direction::Left, to > from ? to - from : from - to);
+					} else if (to > from) {
+						path.PushBack(Direction::Down, (to - from) / _w);
+					} else {
+						path.PushBack(Direction::Up, (from - to) / _w);
+					}
+				}
+			}
+
+			void BatchPathfinder::Prepare(size_t threads, size_t n, List<size_t, true> &offsets, List<bool, true> &found) {
+				if (_finders.Count() < threads) {
+					_finders.PushBack(Pathfinder(), threads - _finders.Count());
+					_threadSteps.PushBack(List<Direction>(), threads - _threadSteps.Count());
+				}
+				if (_starts.Count() < n * 2) {
+					_starts.PushBack(0, n * 2 - _starts.Count());
+				}
+				if (offsets.Count() > n + 1) {
+					offsets.Remove(n + 1, offsets.Count() - n - 1);
+				} else if (offsets.Count() < n + 1) {
+					offsets.PushBack(0, n + 1 - offsets.Count());
+				}
+				if (found.Count() > n) {
+					found.Remove(n, found.Count() - n);
+				} else if (found.Count() < n) {
+					found.PushBack(false, n - found.Count());
+				}
+				offsets.At(0) = 0; // At() makes sure that the storage isn't shared with another list
+				if (n > 0) {
+					found.At(0) = false;
+				}
+			}
+			void BatchPathfinder::Gather(size_t n, List<Direction> &steps, List<size_t, true> &offsets, ThreadPool &p) {
+				size_t *os = *offsets; // the lengths of the paths until here
+				for (size_t i = 0; i < n; ++i) {
+					os[i + 1] += os[i];
+				}
+				if (steps.Count() > os[n]) {
+					steps.Remove(os[n], steps.Count() - os[n]);
+				} else if (steps.Count() < os[n]) {
+					steps.PushBack(Direction::Left, os[n] - steps.Count());
+				}
+				if (os[n] == 0) {
+					return;
+				}
+				Direction *ss = &steps.At(0);
+				const size_t *starts = *_starts;
+				const List<Direction> *threadSteps = *_threadSteps;
+				p.ParallelFor(n, [&](size_t i) {
+					const Direction *src = *threadSteps[starts[i * 2]] + starts[i * 2 + 1];
+					for (size_t j = os[i], k = 0; j < os[i + 1]; ++j, ++k) {
+						ss[j] = src[k];
+					}
+				});
+			}
+		}
+	}
+}
@@ -0,0 +1,462 @@
+#pragma once
+
+#include <atomic>
+
+#include "List.h"
+#include "BitSet.h"
+#include "PriorityQueue.h"
+#include "ThreadPool.h"
+#include "UtilsCommon.h"
+#include "MazeGenerator.h"
+
+namespace DE {
+	namespace Utils {
+		namespace Pathfinding {
+			using MazeGenerator::BlockID;
+
+			enum class Algorithm {
+				AStar,
+				JumpPoint
+			};
+
+			// a grid that paths are searched on only has to tell its size, and whether one can move from a block to the
+			// next one in some direction, which must be false when that'd leave the grid
+			class MazeGrid {
+				public:
+					explicit MazeGrid(const MazeGenerator::Maze &maze) : _maze(&maze) {
+					}
+
+					size_t Width() const {
+						return _maze->Width();
+					}
+					size_t Height() const {
+						return _maze->Height();
+					}
+					bool CanMove(size_t x, size_t y, Direction dir) const {
+						switch (dir) {
+							case Direction::Left: {
+								return x > 0 && !_maze->IsWall(BlockID(x, y), dir);
+							}
+							case Direction::Right: {
+								return x + 1 < _maze->Width() && !_maze->IsWall(BlockID(x, y), dir);
+							}
+							case Direction::Up: {
+								return y > 0 && !_maze->IsWall(BlockID(x, y), dir);
+							}
+							case Direction::Down: {
+								return y + 1 < _maze->Height() && !_maze->IsWall(BlockID(x, y), dir);
+							}
+						}
+						return false;
+					}
+				private:
+					const MazeGenerator::Maze *_maze;
+			};
+			// blocks are either free or blocked, and one can move between free blocks next to each other
+			class OccupancyGrid {
+				public:
+					OccupancyGrid(size_t w, size_t h) : _w(w), _h(h), _blocked(false, w * h) {
+					}
+
+					size_t Width() const {
+						return _w;
+					}
+					size_t Height() const {
+						return _h;
+					}
+					bool IsBlocked(size_t x, size_t y) const {
+						return _blocked.GetAt(y * _w + x);
+					}
+					void SetBlocked(size_t x, size_t y, bool blocked) {
+						_blocked.SetAt(y * _w + x, blocked);
+					}
+					bool CanMove(size_t x, size_t y, Direction dir) const {
+						if (IsBlocked(x, y)) {
+							return false;
+						}
+						switch (dir) {
+							case Direction::Left: {
+								return x > 0 && !IsBlocked(x - 1, y);
+							}
+							case Direction::Right: {
+								return x + 1 < _w && !IsBlocked(x + 1, y);
+							}
+							case Direction::Up: {
+								return y > 0 && !IsBlocked(x, y - 1);
+							}
+							case Direction::Down: {
+								return y + 1 < _h && !IsBlocked(x, y + 1);
+							}
+						}
+						return false;
+					}
+				private:
+					size_t _w, _h;
+					Core::Collections::BitSet _blocked;
+			};
+
+			// the moves out of each block of another grid, four bits for each block, so that they're looked up without any
+			// calls. making one takes a pass over the grid, which pays for itself when many paths are searched on it
+			class PackedGrid {
+				public:
+					template <typename Grid> explicit PackedGrid(const Grid &grid) : _w(grid.Width()), _h(grid.Height()) {
+						size_t cells = _w * _h;
+						if (cells == 0) {
+							return;
+						}
+						_moves.PushBack(0, (cells + 1)>>1);
+						unsigned char *ms = *_moves;
+						for (size_t y = 0, i = 0; y < _h; ++y) {
+							for (size_t x = 0; x < _w; ++x, ++i) {
+								unsigned m = 0;
+								for (unsigned d = 1; d < 0x10; d <<= 1) {
+									if (grid.CanMove(x, y, static_cast<Direction>(d))) {
+										m |= d;
+									}
+								}
+								ms[i>>1] |= static_cast<unsigned char>(m << ((i & 1)<<2));
+							}
+						}
+					}
+
+					size_t Width() const {
+						return _w;
+					}
+					size_t Height() const {
+						return _h;
+					}
+					bool CanMove(size_t x, size_t y, Direction dir) const {
+						return (GetMoves(x, y) & static_cast<unsigned>(dir)) != 0;
+					}
+					// the directions that one can move in, or-ed together
+					unsigned GetMoves(size_t x, size_t y) const {
+						size_t i = y * _w + x;
+						return (_moves[i>>1] >> ((i & 1)<<2)) & 0xF;
+					}
+				private:
+					size_t _w, _h;
+					Core::Collections::List<unsigned char, true> _moves;
+			};
+			// routes on grids without loops, like the perfect mazes made by MazeGenerator, where there's only one path
+			// between two blocks. the grid is made into a forest once, and then a path is found by walking up from both
+			// ends until they meet, in time linear in its length and without any search. nothing is changed by routing,
+			// so any number of threads may use a router at once
+			class TreeRouter {
+				public:
+					// throws InvalidArgumentException if there's a loop in the grid
+					template <typename Grid> explicit TreeRouter(const Grid &grid) : _w(grid.Width()), _h(grid.Height()) {
+						size_t cells = _w * _h;
+						if ((_h != 0 && cells / _h != _w) || cells >= Unreached) {
+							throw Core::OverflowException(_TEXT("the grid is too large"));
+						}
+						if (cells == 0) {
+							return;
+						}
+						_depth.PushBack(Unreached, cells);
+						_up.PushBack(0, cells);
+						unsigned *depth = *_depth;
+						unsigned char *up = *_up;
+						Core::Collections::List<unsigned, true> queue;
+						for (unsigned root = 0; root < cells; ++root) {
+							if (depth[root] != Unreached) {
+								continue;
+							}
+							depth[root] = 0;
+							queue.PushBack(root);
+							for (size_t head = queue.Count() - 1; head < queue.Count(); ++head) {
+								unsigned cell = queue[head];
+								size_t x = cell % _w, y = cell / _w;
+								for (unsigned d = 1; d < 0x10; d <<= 1) {
+									if (d == up[cell] || !grid.CanMove(x, y, static_cast<Direction>(d))) {
+										continue;
+									}
+									unsigned next = Go(cell, static_cast<Direction>(d));
+									if (depth[next] != Unreached) {
+										throw Core::InvalidArgumentException(_TEXT("the grid has loops"));
+									}
+									depth[next] = depth[cell] + 1;
+									up[next] = static_cast<unsigned char>(Reverse(static_cast<Direction>(d)));
+									queue.PushBack(next);
+								}
+							}
+						}
+					}
+
+					size_t Width() const {
+						return _w;
+					}
+					size_t Height() const {
+						return _h;
+					}
+					// appends the steps of the path between the blocks to the list, or returns false if there's none
+					bool FindPath(BlockID, BlockID, Core::Collections::List<Direction>&) const;
+				private:
+					constexpr static unsigned Unreached = ~0u;
+
+					size_t _w, _h;
+					Core::Collections::List<unsigned, true> _depth; // the number of steps to the root
+					Core::Collections::List<unsigned char, true> _up; // the direction of the father, 0 for roots
+
+					unsigned Go(unsigned cell, Direction dir) const {
+						switch (dir) {
+							case Direction::Left: {
+								return cell - 1;
+							}
+							case Direction::Right: {
+								return cell + 1;
+							}
+							case Direction::Up: {
+								return cell - static_cast<unsigned>(_w);
+							}
+							case Direction::Down: {
+								return cell + static_cast<unsigned>(_w);
+							}
+						}
+						return cell;
+					}
+			};
+
+			// the buffers of a search, which are kept from one search to the next so that they're only allocated once for
+			// each size of the grid. a pathfinder runs one search at a time, so there should be one for each thread
+			class Pathfinder {
+				public:
+					Pathfinder() = default;
+					Pathfinder(const Pathfinder&) : Pathfinder() { // the buffers are scratch, so copies start out empty
+					}
+					Pathfinder &operator =(const Pathfinder&) {
+						return *this;
+					}
+
+					// appends the steps of a shortest path between the blocks to the list, or returns false if there's none.
+					// jump point search only puts the blocks where the path may turn into the open list, and is much faster
+					// on mazes and on grids with large open areas
+					template <typename Grid> bool FindPath(
+						const Grid &grid, BlockID from, BlockID to, Core::Collections::List<Direction> &path,
+						Algorithm alg = Algorithm::JumpPoint
+					) {
+						size_t w = grid.Width(), h = grid.Height();
+						if (from.X >= w || from.Y >= h || to.X >= w || to.Y >= h) {
+							throw Core::OverflowException(_TEXT("index overflow"));
+						}
+						NodeData *nodes = Prepare(w, h, to);
+						if (from == to) {
+							return true;
+						}
+						unsigned start = static_cast<unsigned>(from.Y * w + from.X), goal = static_cast<unsigned>(to.Y * w + to.X);
+						Open(from.X, from.Y, 0, start);
+						while (_open.Count() > 0) {
+							unsigned cell = _open.ExtractMax().Cell, g = nodes[cell].G;
+							nodes[cell].HeapPos = Closed;
+							if (cell == goal) {
+								Trace(start, goal, path);
+								return true;
+							}
+							++_expanded;
+							size_t x = cell % w, y = cell / w;
+							if (alg == Algorithm::AStar) {
+								if (grid.CanMove(x, y, Direction::Left)) {
+									Open(x - 1, y, g + 1, cell);
+								}
+								if (grid.CanMove(x, y, Direction::Up)) {
+									Open(x, y - 1, g + 1, cell);
+								}
+								if (grid.CanMove(x, y, Direction::Right)) {
+									Open(x + 1, y, g + 1, cell);
+								}
+								if (grid.CanMove(x, y, Direction::Down)) {
+									Open(x, y + 1, g + 1, cell);
+								}
+							} else {
+								ExpandJumpPoint(grid, x, y, g, cell, nodes[cell].Parent);
+							}
+						}
+						return false;
+					}
+
+					// the number of nodes that the last search took out of the open list
+					size_t GetExpandedCount() const {
+						return _expanded;
+					}
+				private:
+					constexpr static unsigned Closed = ~0u;
+
+					struct NodeData { // valid only if Stamp is that of the current search
+						unsigned G, Parent, HeapPos, Stamp;
+					};
+					struct OpenNode {
+						unsigned F, G, Cell;
+					};
+					class OpenComparer { // the lowest estimate first, and of those, the one farthest from the start
+						public:
+							static int Compare(const OpenNode &lhs, const OpenNode &rhs) {
+								if (lhs.F != rhs.F) {
+									return lhs.F < rhs.F ? 1 : -1;
+								}
+								return lhs.G == rhs.G ? 0 : (lhs.G > rhs.G ? 1 : -1);
+							}
+					};
+					class OpenTracker {
+						public:
+							NodeData *Nodes = nullptr;
+
+							void operator ()(const OpenNode &node, size_t index) const {
+								Nodes[node.Cell].HeapPos = static_cast<unsigned>(index);
+							}
+					};
+
+					Core::Collections::List<NodeData, true> _nodes;
+					Core::Collections::PriorityQueue<OpenNode, true, OpenComparer, OpenTracker> _open;
+					Core::Collections::List<unsigned, true> _trace;
+					unsigned _stamp = 0;
+					size_t _w = 0, _goalX = 0, _goalY = 0, _expanded = 0;
+
+					NodeData *Prepare(size_t, size_t, BlockID);
+					void Open(size_t, size_t, unsigned, unsigned);
+					void Trace(unsigned, unsigned, Core::Collections::List<Direction>&);
+
+					// jumps are made horizontally first: a horizontal jump may turn up or down anywhere, so it stops where a
+					// vertical jump would find something, while a vertical jump only turns where it has to
+					template <typename Grid> void ExpandJumpPoint(
+						const Grid &grid, size_t x, size_t y, unsigned g, unsigned cell, unsigned parent
+					) {
+						size_t px = parent % _w, py = parent / _w;
+						unsigned dirs;
+						if (parent == cell) { // the start
+							dirs = 0xF;
+						} else if (py == y) {
+							dirs = static_cast<unsigned>(px < x ? Direction::Right : Direction::Left);
+							dirs |= static_cast<unsigned>(Direction::Up) | static_cast<unsigned>(Direction::Down);
+						} else {
+							Direction dir = (py < y ? Direction::Down : Direction::Up);
+							size_t by = (py < y ? y - 1 : y + 1);
+							dirs = static_cast<unsigned>(dir);
+							if (IsForced(grid, x, y, by, Direction::Left, dir)) {
+								dirs |= static_cast<unsigned>(Direction::Left);
+							}
+							if (IsForced(grid, x, y, by, Direction::Right, dir)) {
+								dirs |= static_cast<unsigned>(Direction::Right);
+							}
+						}
+						for (unsigned d = 1; d < 0x10; d <<= 1) {
+							if (dirs & d) {
+								Direction dir = static_cast<Direction>(d);
+								size_t jx = x, jy = y;
+								bool found = (
+									dir == Direction::Left || dir == Direction::Right ?
+									JumpHorizontal(grid, jx, y, dir) :
+									JumpVertical(grid, x, jy, dir)
+								);
+								if (found) {
+									size_t dist = (jx > x ? jx - x : x - jx) + (jy > y ? jy - y : y - jy);
+									Open(jx, jy, g + static_cast<unsigned>(dist), cell);
+								}
+							}
+						}
+					}
+					template <typename Grid> bool JumpHorizontal(const Grid &grid, size_t &x, size_t y, Direction dir) const {
+						while (grid.CanMove(x, y, dir)) {
+							x = (dir == Direction::Right ? x + 1 : x - 1);
+							size_t uy = y, dy = y;
+							if (
+								(x == _goalX && y == _goalY) ||
+								JumpVertical(grid, x, uy, Direction::Up) || JumpVertical(grid, x, dy, Direction::Down)
+							) {
+								return true;
+							}
+						}
+						return false;
+					}
+					template <typename Grid> bool JumpVertical(const Grid &grid, size_t x, size_t &y, Direction dir) const {
+						while (grid.CanMove(x, y, dir)) {
+							size_t by = y;
+							y = (dir == Direction::Down ? y + 1 : y - 1);
+							if (
+								(x == _goalX && y == _goalY) ||
+								IsForced(grid, x, y, by, Direction::Left, dir) || IsForced(grid, x, y, by, Direction::Right, dir)
+							) {
+								return true;
+							}
+						}
+						return false;
+					}
+					// whether a vertical move from (x, by) to (x, y) has to turn to the side at y, because the path that
+					// turns at by first is blocked
+					template <typename Grid> static bool IsForced(
+						const Grid &grid, size_t x, size_t y, size_t by, Direction side, Direction dir
+					) {
+						return grid.CanMove(x, y, side) && !(
+							grid.CanMove(x, by, side) && grid.CanMove(side == Direction::Left ? x - 1 : x + 1, by, dir)
+						);
+					}
+			};
+
+			struct PathQuery {
+				BlockID From, To;
+			};
+			class BatchPathfinder {
+				public:
+					// finds the paths of the queries on the threads of the pool (ThreadPool::Default() if none). the steps of
+					// queries[i] are steps[offsets[i]] to steps[offsets[i + 1] - 1], and found[i] tells whether there's a
+					// path at all. the pathfinders of the threads are kept for the next call, as are the storage of the lists
+					// NOTE not to be called from more than one thread at once
+					template <typename Grid> void FindPaths(
+						const Grid &grid, const Core::Collections::List<PathQuery> &queries,
+						Core::Collections::List<Direction> &steps, Core::Collections::List<size_t, true> &offsets,
+						Core::Collections::List<bool, true> &found, Algorithm alg = Algorithm::JumpPoint,
+						Core::ThreadPool *pool = nullptr
+					) {
+						Core::ThreadPool &p = (pool ? *pool : Core::ThreadPool::Default());
+						Prepare(p.GetThreadCount(), queries.Count(), offsets, found);
+						Pathfinder *finders = &_finders.At(0);
+						Run(queries, steps, offsets, found, p, [&](size_t t, const PathQuery &q, Core::Collections::List<Direction> &out) {
+							return finders[t].FindPath(grid, q.From, q.To, out, alg);
+						});
+					}
+					void FindPaths(
+						const TreeRouter &router, const Core::Collections::List<PathQuery> &queries,
+						Core::Collections::List<Direction> &steps, Core::Collections::List<size_t, true> &offsets,
+						Core::Collections::List<bool, true> &found, Core::ThreadPool *pool = nullptr
+					) {
+						Core::ThreadPool &p = (pool ? *pool : Core::ThreadPool::Default());
+						Prepare(p.GetThreadCount(), queries.Count(), offsets, found);
+						Run(queries, steps, offsets, found, p, [&](size_t, const PathQuery &q, Core::Collections::List<Direction> &out) {
+							return router.FindPath(q.From, q.To, out);
+						});
+					}
+				private:
+					Core::Collections::List<Pathfinder> _finders;
+					Core::Collections::List<Core::Collections::List<Direction>> _threadSteps;
+					Core::Collections::List<size_t, true> _starts; // the thread of each query, and where its steps start there
+
+					// the threads take the queries one by one, appending their steps to lists of their own, and the lengths of
+					// the paths are summed into the offsets afterwards
+					template <typename Search> void Run(
+						const Core::Collections::List<PathQuery> &queries, Core::Collections::List<Direction> &steps,
+						Core::Collections::List<size_t, true> &offsets, Core::Collections::List<bool, true> &found,
+						Core::ThreadPool &p, const Search &search
+					) {
+						size_t n = queries.Count();
+						Core::Collections::List<Direction> *threadSteps = &_threadSteps.At(0);
+						size_t *starts = *_starts, *os = *offsets;
+						bool *fs = *found;
+						const PathQuery *qs = *queries;
+						std::atomic<size_t> next(0);
+						p.ParallelFor(p.GetThreadCount(), [&](size_t t) {
+							Core::Collections::List<Direction> &out = threadSteps[t];
+							out.Remove(0, out.Count());
+							for (size_t i; (i = next.fetch_add(1)) < n; ) {
+								size_t start = out.Count();
+								fs[i] = search(t, qs[i], out);
+								starts[i * 2] = t;
+								starts[i * 2 + 1] = start;
+								os[i + 1] = out.Count() - start;
+							}
+						});
+						Gather(n, steps, offsets, p);
+					}
+					void Prepare(size_t, size_t, Core::Collections::List<size_t, true>&, Core::Collections::List<bool, true>&);
+					void Gather(size_t, Core::Collections::List<Direction>&, Core::Collections::List<size_t, true>&, Core::ThreadPool&);
+			};
+		}
+	}
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "ContentControl.h"
+#include "FrameArena.h"
 
 namespace DE {
 	namespace UI {
@@ -22,6 +23,14 @@ namespace DE {
 					return _muPen;
 				}
 
+				// the allocations served by the FrameArena of the ui thread in the last frame
+				const Graphics::Pen *const &ArenaAllocationPen() const {
+					return _aaPen;
+				}
+				const Graphics::Pen *&ArenaAllocationPen() {
+					return _aaPen;
+				}
+
 				const double &TimeLimit() const {
 					return _tLim;
 				}
@@ -29,22 +38,27 @@ namespace DE {
 					return _tLim;
 				}
 			protected:
-				constexpr static size_t FrameTimeID = 0, MemoryID = 1, MonitoredItemCount = 2, TimeID = MonitoredItemCount;
+				constexpr static size_t
+					FrameTimeID = 0, MemoryID = 1, ArenaAllocationID = 2, MonitoredItemCount = 3, TimeID = MonitoredItemCount;
 				struct FrameRecord {
 					FrameRecord() = default;
-					FrameRecord(double time, double frameTime, size_t mem) : Values {frameTime, static_cast<double>(mem), time} {
+					FrameRecord(double time, double frameTime, size_t mem, size_t arenaAllocs) :
+						Values {frameTime, static_cast<double>(mem), static_cast<double>(arenaAllocs), time}
+					{
 					}
 
 					double Values[MonitoredItemCount + 1];
 				};
 
 				Core::Collections::Queue<FrameRecord> _rec;
-				const Graphics::Pen *_ftPen = nullptr, *_muPen = nullptr;
+				const Graphics::Pen *_ftPen = nullptr, *_muPen = nullptr, *_aaPen = nullptr;
 				double _tLim = DefaultTimeLimit, _timeTot = 0.0;
 
 				virtual void Update(double dt) override {
 					_timeTot += dt;
-					_rec.PushTail(FrameRecord(_timeTot, dt, Core::GlobalAllocator::UsedSize()));
+					_rec.PushTail(FrameRecord(
+						_timeTot, dt, Core::GlobalAllocator::UsedSize(), Core::FrameArena::Current().GetLastFrameAllocationCount()
+					));
 					FrameRecord tmpRec;
 					bool popped = false;
 					while (_rec.PeekHead().Values[TimeID] + _tLim < _timeTot) {
@@ -54,6 +68,7 @@ namespace DE {
 					if (popped) {
 						_rec.PushHead(tmpRec);
 					}
+					Invalidate();
 				}
 
 				void RenderTrack(
@@ -99,6 +114,7 @@ namespace DE {
 					GetMaxValues(maxV);
 					RenderTrack(r, FrameTimeID, _ftPen, maxV[FrameTimeID]);
 					RenderTrack(r, MemoryID, _muPen, maxV[MemoryID]);
+					RenderTrack(r, ArenaAllocationID, _aaPen, maxV[ArenaAllocationID]);
 				}
 		};
 	}
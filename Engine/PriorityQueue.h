@@ -6,29 +6,41 @@
 namespace DE {
 	namespace Core {
 		namespace Collections {
-			template <typename T, bool DirectMemoryAccess = !IsClass<T>::Result, class Comparer = DefaultComparer<T>> class PriorityQueue :
-				protected List<T, DirectMemoryAccess>
-			{
+			// the tracker of a PriorityQueue is told the index of every element that's inserted or moved, so that the
+			// caller can find an element again to change its key or remove it
+			template <typename T> class NoPositionTracker {
 				public:
+					void operator ()(const T&, size_t) const {
+					}
+			};
+			template <
+				typename T, bool DirectMemoryAccess = !IsClass<T>::Result, class Comparer = DefaultComparer<T>,
+				class PositionTracker = NoPositionTracker<T>
+			> class PriorityQueue : protected List<T, DirectMemoryAccess> {
+				public:
+					PriorityQueue() = default;
+					explicit PriorityQueue(const PositionTracker &tracker) : _tracker(tracker) {
+					}
+
 					void Insert(const T &obj) {
 						Base::PushBack(obj);
-						AdjustUp(Count() - 1);
+						AdjustUp(Count() - 1, obj);
 					}
 					using List<T, DirectMemoryAccess>::FindFirst;
 					using List<T, DirectMemoryAccess>::FindLast;
 					void ChangeKey(size_t index, const T &newV) {
 						int x = Comparer::Compare(Base::At(index), newV);
-						Base::At(index) = newV;
 						if (x > 0) {
-							AdjustDown(index, Count());
-						} else if (x < 0) {
-							AdjustUp(index);
+							AdjustDown(index, newV);
+						} else {
+							AdjustUp(index, newV);
 						}
 					}
 					void Remove(size_t index) {
-						Base::SwapToBack(index);
-						Base::PopBack();
-						AdjustDown(index, Count());
+						T last = Base::PopBack();
+						if (index < Count()) {
+							ChangeKey(index, last);
+						}
 					}
 					using List<T, DirectMemoryAccess>::Clear;
 
@@ -36,43 +48,54 @@ namespace DE {
 						return Base::First();
 					}
 					T ExtractMax() {
-						Base::SwapToBack(0);
-						AdjustDown(0, Base::Count() - 1);
-						return Base::PopBack();
+						T result = Base::First(), last = Base::PopBack();
+						if (Count() > 0) {
+							AdjustDown(0, last);
+						}
+						return result;
 					}
 
 					using List<T, DirectMemoryAccess>::Count;
 					using List<T, DirectMemoryAccess>::Capicy;
 					using List<T, DirectMemoryAccess>::MinCapicy;
+
+					PositionTracker &Tracker() {
+						return _tracker;
+					}
+					const PositionTracker &Tracker() const {
+						return _tracker;
+					}
 				protected:
-					void AdjustDown(size_t index, size_t realCount) {
-						for (size_t maxi, t; index < realCount; index = maxi) {
-							maxi = index;
-							t = (index<<1) + 1;
-							if (t < realCount && Comparer::Compare(Base::At(maxi), Base::At(t)) < 0) {
-								maxi = t;
-							}
-							t = (index + 1)<<1;
-							if (t < realCount && Comparer::Compare(Base::At(maxi), Base::At(t)) < 0) {
-								maxi = t;
+					PositionTracker _tracker;
+
+					// these move the hole at index, instead of swapping, until obj can be put into it
+					void AdjustDown(size_t index, const T &obj) {
+						T *arr = &Base::At(0);
+						for (size_t count = Count(), t; (t = (index<<1) + 1) < count; index = t) {
+							if (t + 1 < count && Comparer::Compare(arr[t], arr[t + 1]) < 0) {
+								++t;
 							}
-							if (maxi == index) {
+							if (Comparer::Compare(obj, arr[t]) >= 0) {
 								break;
 							}
-							Base::Swap(maxi, index);
+							Place(arr, index, arr[t]);
 						}
+						Place(arr, index, obj);
 					}
-					void AdjustUp(size_t index) {
-						for (
-							size_t t = (index - 1)>>1;
-							index > 0 && Comparer::Compare(Base::At(index), Base::At(t)) > 0;
-							index = t, t = (t - 1)>>1
-						) {
-							Base::Swap(index, t);
+					void AdjustUp(size_t index, const T &obj) {
+						T *arr = &Base::At(0);
+						for (size_t t; index > 0 && Comparer::Compare(obj, arr[t = (index - 1)>>1]) > 0; index = t) {
+							Place(arr, index, arr[t]);
 						}
+						Place(arr, index, obj);
 					}
 				private:
 					typedef List<T, DirectMemoryAccess> Base;
+
+					void Place(T *arr, size_t index, const T &obj) {
+						arr[index] = obj;
+						_tracker(obj, index);
+					}
 			};
 		}
 	}
@@ -25,6 +25,7 @@ namespace DE {
 					}
 					_progress = p;
 					ResetLayout();
+					Invalidate();
 				}
 
 				double GetMaxProgress() const {
@@ -36,6 +37,7 @@ namespace DE {
 					}
 					_maxProgress = maxProg;
 					ResetLayout();
+					Invalidate();
 				}
 
 				const Graphics::Brush *&FinishedBrush() {
@@ -57,6 +59,7 @@ namespace DE {
 				void SetLayoutDirection(LayoutDirection newDir) {
 					_dir = newDir;
 					ResetLayout();
+					Invalidate();
 				}
 
 				const static Graphics::SolidBrush DefaultFinishedBrush, DefaultUnfinishedBrush;
@@ -6,7 +6,10 @@
 namespace DE {
 	namespace Core {
 		namespace Collections {
-			template <typename T, size_t ChunkSize = 100, bool DirectMemoryAccess = !IsClass<T>::Result> class Queue {
+			// the memory comes from the Allocator, which has static Allocate(size_t) and Free(void*) like GlobalAllocator
+			template <
+				typename T, size_t ChunkSize = 100, bool DirectMemoryAccess = !IsClass<T>::Result, typename Allocator = GlobalAllocator
+			> class Queue {
 					// +---------------+ next +-+ next +-+ next +---------------+
 					// |     _head     | ---> | | ---> | | ---> |     _tail     |
 					// | unused | used | <--- | | <--- | | <--- | used | unused |
@@ -24,10 +27,10 @@ namespace DE {
 					Queue() {
 						StaticAssert(ChunkSize > 0, "chunk size must not be zero");
 					}
-					Queue(const Queue<T, ChunkSize, DirectMemoryAccess> &src) {
+					Queue(const Queue &src) {
 						CopyContentFrom(src);
 					}
-					Queue &operator =(const Queue<T, ChunkSize, DirectMemoryAccess> &src) {
+					Queue &operator =(const Queue &src) {
 						if (this == &src) {
 							return *this;
 						}
@@ -42,12 +45,12 @@ namespace DE {
 					void PushHead(const T &obj) {
 						T *position = nullptr;
 						if (_head == nullptr) { // no objects here, checks are omitted
-							_head = _tail = new (GlobalAllocator::Allocate(sizeof(Chunk))) Chunk();
+							_head = _tail = new (Allocator::Allocate(sizeof(Chunk))) Chunk();
 							_headPtr = ChunkSize - 1;
 							_pastTailPtr = ChunkSize;
 							position = _head->Objects + _headPtr;
 						} else if (_headPtr == 0) { // the first chunk is full, create new chunk
-							Chunk *newChunk = new (GlobalAllocator::Allocate(sizeof(Chunk))) Chunk();
+							Chunk *newChunk = new (Allocator::Allocate(sizeof(Chunk))) Chunk();
 							_head->Previous = newChunk;
 							newChunk->Next = _head;
 							_headPtr = ChunkSize - 1;
@@ -67,12 +70,12 @@ namespace DE {
 					void PushTail(const T &obj) {
 						T *position = nullptr;
 						if (_tail == nullptr) { // no objects here, checks are omitted
-							_head = _tail = new (GlobalAllocator::Allocate(sizeof(Chunk))) Chunk();
+							_head = _tail = new (Allocator::Allocate(sizeof(Chunk))) Chunk();
 							_headPtr = ChunkSize - 1;
 							_pastTailPtr = ChunkSize;
 							position = _tail->Objects + _headPtr;
 						} else if (_pastTailPtr == ChunkSize) { // the last chunk is full, create new chunk
-							Chunk *newChunk = new (GlobalAllocator::Allocate(sizeof(Chunk))) Chunk();
+							Chunk *newChunk = new (Allocator::Allocate(sizeof(Chunk))) Chunk();
 							_tail->Next = newChunk;
 							newChunk->Previous = _tail;
 							_pastTailPtr = 1;
@@ -101,7 +104,7 @@ namespace DE {
 							Chunk *next = _head->Next;
 							_headPtr = 0;
 							_head->~Chunk();
-							GlobalAllocator::Free(_head);
+							Allocator::Free(_head);
 							if (next != nullptr) {
 								next->Previous = nullptr;
 								_head = next;
@@ -124,7 +127,7 @@ namespace DE {
 							Chunk *prev = _tail->Previous;
 							_pastTailPtr = ChunkSize;
 							_tail->~Chunk();
-							GlobalAllocator::Free(_tail);
+							Allocator::Free(_tail);
 							if (prev != nullptr) {
 								prev->Next = nullptr;
 								_tail = prev;
@@ -165,7 +168,7 @@ namespace DE {
 						if (_count == 0) {
 							if (_head != nullptr) {
 								_head->~Chunk();
-								GlobalAllocator::Free(_head);
+								Allocator::Free(_head);
 								_head = _tail = nullptr;
 							}
 							return;
@@ -178,7 +181,7 @@ namespace DE {
 								}
 							}
 							_tail->~Chunk();
-							GlobalAllocator::Free(_tail);
+							Allocator::Free(_tail);
 							_head = _tail = nullptr;
 							return;
 						}
@@ -189,7 +192,7 @@ namespace DE {
 						}
 						Chunk *prev = _tail->Previous;
 						_tail->~Chunk();
-						GlobalAllocator::Free(_tail);
+						Allocator::Free(_tail);
 						for (Chunk *ck = prev; ck != _head; ck = prev) {
 							prev = ck->Previous;
 							if (!DirectMemoryAccess) {
@@ -198,7 +201,7 @@ namespace DE {
 								}
 							}
 							ck->~Chunk();
-							GlobalAllocator::Free(ck);
+							Allocator::Free(ck);
 						}
 						if (!DirectMemoryAccess) {
 							for (; _headPtr < ChunkSize; ++_headPtr) {
@@ -206,7 +209,7 @@ namespace DE {
 							}
 						}
 						_head->~Chunk();
-						GlobalAllocator::Free(_head);
+						Allocator::Free(_head);
 						_head = _tail = nullptr;
 					}
 
@@ -355,23 +358,23 @@ namespace DE {
 					}
 				protected:
 					struct Chunk {
-						Chunk() : Objects((T*)GlobalAllocator::Allocate(sizeof(T) * ChunkSize)) {
+						Chunk() : Objects((T*)Allocator::Allocate(sizeof(T) * ChunkSize)) {
 						}
 						~Chunk() {
-							GlobalAllocator::Free(Objects);
+							Allocator::Free(Objects);
 						}
 
 						T *Objects;
 						Chunk *Next = nullptr, *Previous = nullptr;
 					};
 
-					void CopyContentFrom(const Queue<T, ChunkSize, DirectMemoryAccess> &src) {
+					void CopyContentFrom(const Queue &src) {
 						if (src._count == 0) {
 							return;
 						}
 						_count = src._count;
 						if (src._head == src._tail) {
-							_head = _tail = new (GlobalAllocator::Allocate(sizeof(Chunk))) Chunk();
+							_head = _tail = new (Allocator::Allocate(sizeof(Chunk))) Chunk();
 							if (DirectMemoryAccess) {
 								memcpy(_head->Objects, src._head->Objects, sizeof(T) * ChunkSize);
 								_headPtr = src._headPtr;
@@ -384,7 +387,7 @@ namespace DE {
 							}
 							return;
 						}
-						_tail = new (GlobalAllocator::Allocate(sizeof(Chunk))) Chunk();
+						_tail = new (Allocator::Allocate(sizeof(Chunk))) Chunk();
 						if (DirectMemoryAccess) {
 							memcpy(_tail->Objects, src._tail->Objects, sizeof(T) * ChunkSize);
 							_headPtr = src._headPtr;
@@ -396,7 +399,7 @@ namespace DE {
 						}
 						Chunk *cur = _tail;
 						for (Chunk *srcCur = src._tail->Previous; srcCur; srcCur = srcCur->Previous) {
-							cur->Previous = new (GlobalAllocator::Allocate(sizeof(Chunk))) Chunk();
+							cur->Previous = new (Allocator::Allocate(sizeof(Chunk))) Chunk();
 							cur->Previous->Next = cur;
 							cur = cur->Previous;
 							if (DirectMemoryAccess) {
@@ -1,15 +1,16 @@
 #include "Renderer.h"
 
 #include "List.h"
-#include "Queue.h"
 
 namespace DE {
 	namespace Graphics {
-		using namespace Gdiplus;
 		using namespace Core::Math;
 		using namespace Core::Collections;
 		using namespace RenderingContexts;
 
+#ifndef DE_HEADLESS
+		using namespace Gdiplus;
+
 		GdiPlusAccess::Initializer::Initializer() {
 			if (_token == 0) {
 				GdiplusStartupInput input;
@@ -49,212 +50,328 @@ namespace DE {
 			AssertGDIPlusSuccess(bmp.Save(*fileName, &encoder, nullptr), "cannot save bitmap");
 		}
 
-		template <size_t sz> struct DArr {
-			DArr() {
-				memset(V, 0, sizeof(V));
+		ImageView GdiPlusAccess::GetImageView(Gdiplus::BitmapData &data) {
+			if (data.PixelFormat != PixelFormat32bppARGB && data.PixelFormat != PixelFormat32bppPARGB && data.PixelFormat != PixelFormat32bppRGB) {
+				throw Core::InvalidArgumentException(_TEXT("only 32bpp bitmaps are supported"));
 			}
-			DArr<sz> &operator +=(const DArr<sz> &rhs) {
-				for (size_t i = 0; i < sz; ++i) {
-					V[i] += rhs.V[i];
-				}
-				return *this;
+			return ImageView(data.Scan0, data.Width, data.Height, data.Stride, PixelLayout::BGRA32);
+		}
+		void GdiPlusAccess::GaussianBlur(Gdiplus::BitmapData &data, size_t xRadius, size_t yRadius) {
+			ImageFilters::GaussianBlur(GetImageView(data), xRadius / 3.0, yRadius / 3.0);
+		}
+		void GdiPlusAccess::AverageBlur(Gdiplus::BitmapData &data, size_t xRadius, size_t yRadius) {
+			ImageFilters::BoxBlur(GetImageView(data), xRadius, yRadius);
+		}
+		void GdiPlusAccess::Pixelate(Gdiplus::BitmapData &data, size_t xLen, size_t yLen) {
+			ImageFilters::Pixelate(GetImageView(data), xLen, yLen);
+		}
+#endif
+
+		void Renderer::SetViewport(const Core::Math::Rectangle &vp) {
+			if (_ctx) {
+				FlushBatch();
+				_ctx->SetViewport(vp);
 			}
-			DArr<sz> operator +(const DArr<sz> &rhs) const {
-				DArr<sz> result = (*this);
-				result += rhs;
-				return result;
+		}
+
+		void CommandBuffer::SetBatching(bool batch) {
+			if (batch == _batching) {
+				return;
 			}
-			DArr<sz> &operator -=(const DArr<sz> &rhs) {
-				for (size_t i = 0; i < sz; ++i) {
-					V[i] -= rhs.V[i];
-				}
-				return *this;
+			if (_clips.Count() > 0) {
+				throw Core::InvalidOperationException(_TEXT("cannot switch batching with clips pushed"));
 			}
-			DArr<sz> operator -(const DArr<sz> &rhs) const {
-				DArr<sz> result = (*this);
-				result += rhs;
-				return result;
+			if (_batching) {
+				Flush();
 			}
-			DArr<sz> &operator *=(double rhs) {
-				for (size_t i = 0; i < sz; ++i) {
-					V[i] *= rhs;
-				}
-				return *this;
+			_batching = batch;
+		}
+		void CommandBuffer::Flush() {
+			_known = false;
+			_applied.LineWidth = _applied.PointSize = -1.0; // batches that don't care won't set them
+			for (size_t i = 0; i < _batches.Count(); ++i) {
+				const Batch &b = _batches[i];
+				Apply(b.State);
+				_ctx.DrawVertices(*b.Vertices, b.Vertices.Count(), b.Mode);
+				++Statistics.DrawCalls;
 			}
-			DArr<sz> operator *(double rhs) {
-				DArr<sz> result = (*this);
-				result *= rhs;
-				return result;
+			_batches.Clear();
+			Apply(_state);
+		}
+		void CommandBuffer::Apply(const RenderState &st) {
+			if (!_known || st.Texture != _applied.Texture) {
+				_ctx.BindTexture(st.Texture);
+				_applied.Texture = st.Texture;
+				++Statistics.StateChanges;
 			}
-			DArr<sz> &operator /=(double rhs) {
-				for (size_t i = 0; i < sz; ++i) {
-					V[i] /= rhs;
-				}
-				return *this;
+			if (!_known || st.Source != _applied.Source || st.Target != _applied.Target) {
+				_ctx.SetBlendFunction(st.Source, st.Target);
+				_applied.Source = st.Source;
+				_applied.Target = st.Target;
+				++Statistics.StateChanges;
+			}
+			if (
+				!_known || st.StencilFunction != _applied.StencilFunction ||
+				st.StencilReference != _applied.StencilReference || st.StencilMask != _applied.StencilMask
+			) {
+				_ctx.SetStencilFunction(st.StencilFunction, st.StencilReference, st.StencilMask);
+				_applied.StencilFunction = st.StencilFunction;
+				_applied.StencilReference = st.StencilReference;
+				_applied.StencilMask = st.StencilMask;
+				++Statistics.StateChanges;
 			}
-			DArr<sz> operator /(double rhs) {
-				DArr<sz> result = (*this);
-				result /= rhs;
-				return result;
+			if (
+				!_known || st.StencilFail != _applied.StencilFail ||
+				st.StencilDepthFail != _applied.StencilDepthFail || st.StencilPass != _applied.StencilPass
+			) {
+				_ctx.SetStencilOperation(st.StencilFail, st.StencilDepthFail, st.StencilPass);
+				_applied.StencilFail = st.StencilFail;
+				_applied.StencilDepthFail = st.StencilDepthFail;
+				_applied.StencilPass = st.StencilPass;
+				++Statistics.StateChanges;
 			}
+			if (st.LineWidth > 0.0 && st.LineWidth != _applied.LineWidth) {
+				_ctx.SetLineWidth(st.LineWidth);
+				_applied.LineWidth = st.LineWidth;
+				++Statistics.StateChanges;
+			}
+			if (st.PointSize > 0.0 && st.PointSize != _applied.PointSize) {
+				_ctx.SetPointSize(st.PointSize);
+				_applied.PointSize = st.PointSize;
+				++Statistics.StateChanges;
+			}
+			// the clip of a batch is the intersection of the whole stack, so at most one is pushed onto the context
+			bool clipChanged = st.Clipped != _applied.Clipped || (st.Clipped && (
+				st.Clip.Left != _applied.Clip.Left || st.Clip.Top != _applied.Clip.Top ||
+				st.Clip.Right != _applied.Clip.Right || st.Clip.Bottom != _applied.Clip.Bottom
+			));
+			if (clipChanged) {
+				if (_clipPushed) {
+					_ctx.PopRectangularClip();
+					_clipPushed = false;
+				}
+				if (st.Clipped) {
+					_ctx.PushRectangularClip(st.Clip);
+					_clipPushed = true;
+				}
+				_applied.Clipped = st.Clipped;
+				_applied.Clip = st.Clip;
+				++Statistics.StateChanges;
+			}
+			_known = true;
+		}
 
-			double V[sz];
-		};
-		Core::Color &GetColor(Gdiplus::BitmapData &data, size_t x, size_t y) {
-			// NOTE default pixel format ARGB
-			return *reinterpret_cast<Core::Color*>(reinterpret_cast<size_t>(data.Scan0) + y * Abs(data.Stride) + x * sizeof(Core::Color));
+		void CommandBuffer::SetTexture(const TextureID &tex) {
+			_state.Texture = tex;
+			if (!_batching) {
+				_ctx.BindTexture(tex);
+				++Statistics.StateChanges;
+			}
 		}
-		DArr<4> ColorToDArr(const Core::Color &c) {
-			DArr<4> result;
-			result.V[0] = static_cast<double>(c.R);
-			result.V[1] = static_cast<double>(c.G);
-			result.V[2] = static_cast<double>(c.B);
-			result.V[3] = static_cast<double>(c.A);
-			return result;
+		void CommandBuffer::SetBlendFunction(BlendFactor src, BlendFactor dst) {
+			_state.Source = src;
+			_state.Target = dst;
+			if (!_batching) {
+				_ctx.SetBlendFunction(src, dst);
+				++Statistics.StateChanges;
+			}
 		}
-		Core::Color DArrToColor(const DArr<4> &arr) {
-			Core::Color result;
-			result.R = static_cast<unsigned char>(round(arr.V[0]));
-			result.G = static_cast<unsigned char>(round(arr.V[1]));
-			result.B = static_cast<unsigned char>(round(arr.V[2]));
-			result.A = static_cast<unsigned char>(round(arr.V[3]));
-			return result;
+		void CommandBuffer::SetStencilFunction(StencilComparisonFunction func, unsigned ref, unsigned mask) {
+			_state.StencilFunction = func;
+			_state.StencilReference = ref;
+			_state.StencilMask = mask;
+			if (!_batching) {
+				_ctx.SetStencilFunction(func, ref, mask);
+				++Statistics.StateChanges;
+			}
 		}
-		void GdiPlusAccess::GaussianBlur(Gdiplus::BitmapData &data, size_t xRadius, size_t yRadius) {
-			List<List<double>> lds;
-			double tot = 0.0;
-			int ixrad = static_cast<int>(xRadius), iyrad = static_cast<int>(yRadius);
-			for (int x = -ixrad; x <= ixrad; ++x) {
-				lds.PushBack(List<double>());
-				List<double> &tarList = lds.Last();
-				for (int y = -iyrad; y <= iyrad; ++y) {
-					double dt = 0.0;
-					if (xRadius != 0) {
-						dt += Square(x / static_cast<double>(xRadius));
-					}
-					if (yRadius != 0) {
-						dt += Square(y / static_cast<double>(yRadius));
-					}
-					double dis = 1.0 - sqrt(dt);
-					if (dis < 0.0) {
-						dis = 0.0;
-					}
-					tarList.PushBack(dis);
-					tot += dis;
-				}
+		void CommandBuffer::SetStencilOperation(StencilOperation fail, StencilOperation zfail, StencilOperation zpass) {
+			_state.StencilFail = fail;
+			_state.StencilDepthFail = zfail;
+			_state.StencilPass = zpass;
+			if (!_batching) {
+				_ctx.SetStencilOperation(fail, zfail, zpass);
+				++Statistics.StateChanges;
 			}
-			for (int y = -iyrad; y <= iyrad; ++y) {
-				for (int x = -ixrad; x <= ixrad; ++x) {
-					lds[x + ixrad][y + iyrad] /= tot;
-				}
+		}
+		void CommandBuffer::SetLineWidth(double width) {
+			_state.LineWidth = width;
+			if (!_batching) {
+				_ctx.SetLineWidth(width);
+				++Statistics.StateChanges;
 			}
-			List<List<Core::Color>> result;
-			for (size_t x = 0; x < data.Width; ++x) {
-				result.PushBack(List<Core::Color>());
-				List<Core::Color> &tarList = result.Last();
-				for (size_t y = 0; y < data.Height; ++y) {
-					DArr<4> curPx;
-					for (int dx = -ixrad; dx <= ixrad; ++dx) {
-						size_t px = ((-dx) > static_cast<int>(x) ? 0 : static_cast<size_t>(static_cast<int>(x) + dx));
-						if (px >= data.Width) {
-							px = data.Width - 1;
-						}
-						for (int dy = -iyrad; dy <= iyrad; ++dy) {
-							size_t py = ((-dy) > static_cast<int>(y) ? 0 : static_cast<size_t>(static_cast<int>(y) + dy));
-							if (py >= data.Height) {
-								py = data.Height - 1;
-							}
-							double mult = lds[dx + ixrad][dy + iyrad];
-							curPx += ColorToDArr(GetColor(data, px, py)) * mult;
-						}
-					}
-					tarList.PushBack(DArrToColor(curPx));
+		}
+		void CommandBuffer::SetPointSize(double size) {
+			_state.PointSize = size;
+			if (!_batching) {
+				_ctx.SetPointSize(size);
+				++Statistics.StateChanges;
+			}
+		}
+		void CommandBuffer::PushClip(const Rectangle &rect) {
+			Rectangle tarclip = rect; // same as RenderingContext::PushRectangularClip
+			if (_clips.Count() > 0) {
+				if (Rectangle::Intersect(rect, _clips.Last(), tarclip) == IntersectionType::None) {
+					tarclip = Rectangle(rect.Left, rect.Top, 0.0, 0.0);
 				}
 			}
-			for (size_t x = 0; x < data.Width; ++x) {
-				for (size_t y = 0; y < data.Height; ++y) {
-					GetColor(data, x, y) = result[x][y];
+			_clips.PushBack(tarclip);
+			UpdateClipState();
+			if (!_batching) {
+				_ctx.PushRectangularClip(rect);
+				++Statistics.StateChanges;
+			}
+		}
+		void CommandBuffer::PopClip() {
+			if (_clips.Count() == 0) {
+				throw Core::InvalidOperationException(_TEXT("no clip to pop"));
+			}
+			_clips.PopBack();
+			UpdateClipState();
+			if (!_batching) {
+				_ctx.PopRectangularClip();
+				++Statistics.StateChanges;
+			}
+		}
+
+		bool CommandBuffer::Batch::Overlaps(const Rectangle &rect) const {
+			Rectangle dummy;
+			for (size_t i = 0; i < BoundCount; ++i) {
+				if (Rectangle::Intersect(Bounds[i], rect, dummy) == IntersectionType::Full) { // touching is fine
+					return true;
 				}
 			}
+			return false;
 		}
-		void GdiPlusAccess::AverageBlur(Gdiplus::BitmapData &data, size_t xRadius, size_t yRadius) {
-			struct ColumnCache {
-				List<DArr<4>> Content;
-				size_t Index = 0;
-			};
-			Queue<ColumnCache> cache;
-			List<List<DArr<4>>> result;
-			for (size_t x = 0; x < data.Width; ++x) {
-				for (size_t cx = (cache.Count() == 0 ? 0 : x + xRadius); cx < data.Width && cx <= x + xRadius; ++cx) {
-					ColumnCache curCol;
-					curCol.Index = cx;
-					curCol.Content.PushBack(ColorToDArr(GetColor(data, cx, 0)) * static_cast<double>(yRadius + 1));
-					for (size_t ay = 1; ay <= yRadius; ++ay) {
-						curCol.Content.Last() += ColorToDArr(GetColor(data, cx, (ay >= data.Height ? data.Height - 1 : ay)));
-					}
-					for (size_t cy = 1; cy < data.Height; ++cy) {
-						DArr<4> lpx = curCol.Content.Last();
-						curCol.Content.PushBack(lpx);
-						DArr<4> &curPx = curCol.Content.Last();
-						curPx -= ColorToDArr(GetColor(data, cx, (cy < yRadius + 1 ? 0 : cy - yRadius - 1)));
-						curPx += ColorToDArr(GetColor(data, cx, Core::Math::Min(cy + yRadius, static_cast<size_t>(data.Height) - 1)));
+		void CommandBuffer::Batch::AddBounds(const Rectangle &rect) {
+			if (BoundCount < MaxBounds) {
+				Bounds[BoundCount++] = rect;
+				return;
+			}
+			// merge the two rectangles (the new one included) whose union wastes the least area
+			Rectangle all[MaxBounds + 1];
+			for (size_t i = 0; i < MaxBounds; ++i) {
+				all[i] = Bounds[i];
+			}
+			all[MaxBounds] = rect;
+			size_t bestA = 0, bestB = 1;
+			double minWaste = 0.0;
+			for (size_t i = 0; i < MaxBounds; ++i) {
+				for (size_t j = i + 1; j <= MaxBounds; ++j) {
+					double waste = Rectangle::Union(all[i], all[j]).Area() - all[i].Area() - all[j].Area();
+					if ((i == 0 && j == 1) || waste < minWaste) {
+						bestA = i;
+						bestB = j;
+						minWaste = waste;
 					}
-					cache.PushHead(curCol);
 				}
-				while (cache.PeekTail().Index + xRadius < x) {
-					cache.PopTail();
+			}
+			all[bestA] = Rectangle::Union(all[bestA], all[bestB]);
+			all[bestB] = all[MaxBounds];
+			for (size_t i = 0; i < MaxBounds; ++i) {
+				Bounds[i] = all[i];
+			}
+		}
+
+		void CommandBuffer::Draw(const Vertex *vs, size_t count, RenderMode mode) {
+			++Statistics.SubmittedDraws;
+			if (!_batching) {
+				_ctx.DrawVertices(vs, count, mode);
+				++Statistics.DrawCalls;
+				return;
+			}
+			RenderMode listMode;
+			size_t minCount;
+			switch (mode) {
+				case RenderMode::Triangles:
+				case RenderMode::TriangleStrip:
+				case RenderMode::TriangleFan:
+					listMode = RenderMode::Triangles;
+					minCount = 3;
+					break;
+				case RenderMode::Lines:
+				case RenderMode::LineStrip:
+					listMode = RenderMode::Lines;
+					minCount = 2;
+					break;
+				default:
+					listMode = RenderMode::Points;
+					minCount = 1;
+					break;
+			}
+			if (count < minCount) {
+				return;
+			}
+			RenderState key = _state;
+			if (listMode != RenderMode::Lines) {
+				key.LineWidth = 0.0;
+			}
+			if (listMode != RenderMode::Points) {
+				key.PointSize = 0.0;
+			}
+			Rectangle bounds(vs[0].Position.X, vs[0].Position.Y, 0.0, 0.0);
+			for (size_t i = 1; i < count; ++i) {
+				bounds.Left = Min(bounds.Left, vs[i].Position.X);
+				bounds.Top = Min(bounds.Top, vs[i].Position.Y);
+				bounds.Right = Max(bounds.Right, vs[i].Position.X);
+				bounds.Bottom = Max(bounds.Bottom, vs[i].Position.Y);
+			}
+			// find a batch to append to; a triangle draw may be moved before triangle batches it doesn't overlap,
+			// everything else can only be appended to the last batch
+			Batch *target = nullptr;
+			for (size_t i = _batches.Count(), searched = 0; i > 0 && searched < MaxLookBack; --i, ++searched) {
+				Batch &b = _batches[i - 1];
+				if (b.Mode == listMode && b.State == key) {
+					target = &b;
+					break;
 				}
-				result.PushBack(List<DArr<4>>());
-				List<DArr<4>> &curList = result.Last();
-				for (size_t y = 0; y < data.Height; ++y) {
-					curList.PushBack(DArr<4>());
-					DArr<4> &curPx = curList.Last();
-					cache.ForEachTailToHead([&](const ColumnCache &cc) {
-						size_t repeat = 1;
-						if (cc.Index == 0) {
-							repeat = xRadius + 1 - x;
-						} else if (cc.Index == data.Width - 1) {
-							repeat = x + xRadius + 2 - data.Width;
-						}
-						for (size_t i = 0; i < repeat; ++i) {
-							curPx += cc.Content[static_cast<size_t>(y)];
-						}
-						return true;
-					});
+				if (listMode != RenderMode::Triangles || b.Mode != RenderMode::Triangles || b.Overlaps(bounds)) {
+					break;
 				}
 			}
-			for (size_t x = 0; x < data.Width; ++x) {
-				for (size_t y = 0; y < data.Height; ++y) {
-					GetColor(data, x, y) = DArrToColor(result[x][y] / ((2 * xRadius + 1) * (2 * yRadius + 1)));
-				}
+			if (!target) {
+				_batches.PushBack(Batch());
+				target = &_batches.Last();
+				target->State = key;
+				target->Mode = listMode;
 			}
-		}
-		void GdiPlusAccess::Pixelate(Gdiplus::BitmapData &data, size_t xLen, size_t yLen) {
-			size_t nsx = (data.Width - 1) / xLen, nsy = (data.Height - 1) / yLen, cbxs = 0, nbxs = xLen;
-			for (size_t x = 0; x < nsx; ++x, cbxs += xLen, nbxs += xLen) {
-				size_t cbys = 0, nbys = yLen;
-				for (size_t y = 0; y < nsy; ++y, cbys += yLen, nbys += yLen) {
-					DArr<4> curPx;
-					size_t samc = 0;
-					for (size_t ys = cbys; ys < data.Height && ys < nbys; ++ys) {
-						for (size_t xs = cbxs; xs < data.Width && xs < nbxs; ++xs) {
-							curPx += ColorToDArr(GetColor(data, xs, ys));
-							++samc;
+			target->AddBounds(bounds);
+			List<Vertex> &out = target->Vertices;
+			switch (mode) {
+				case RenderMode::Triangles:
+					out.PushBackRange(vs, count - count % 3);
+					break;
+				case RenderMode::TriangleStrip:
+					for (size_t i = 2; i < count; ++i) { // keeps the winding of every triangle
+						if (i % 2 == 0) {
+							out.PushBack(vs[i - 2]);
+							out.PushBack(vs[i - 1]);
+						} else {
+							out.PushBack(vs[i - 1]);
+							out.PushBack(vs[i - 2]);
 						}
+						out.PushBack(vs[i]);
 					}
-					Core::Color acc = DArrToColor(curPx / samc);
-					for (size_t ys = cbys; ys < data.Height && ys < nbys; ++ys) {
-						for (size_t xs = cbxs; xs < data.Width && xs < nbxs; ++xs) {
-							GetColor(data, xs, ys) = acc;
-						}
+					break;
+				case RenderMode::TriangleFan:
+					for (size_t i = 2; i < count; ++i) {
+						out.PushBack(vs[0]);
+						out.PushBack(vs[i - 1]);
+						out.PushBack(vs[i]);
 					}
-				}
-			}
-		}
-
-		void Renderer::SetViewport(const Core::Math::Rectangle &vp) {
-			if (_ctx) {
-				_ctx->SetViewport(vp);
+					break;
+				case RenderMode::Lines:
+					out.PushBackRange(vs, count - count % 2);
+					break;
+				case RenderMode::LineStrip:
+					for (size_t i = 1; i < count; ++i) {
+						out.PushBack(vs[i - 1]);
+						out.PushBack(vs[i]);
+					}
+					break;
+				default:
+					out.PushBackRange(vs, count);
+					break;
 			}
 		}
 	}
@@ -4,6 +4,7 @@
 #include "Color.h"
 #include "RenderingContext.h"
 #include "ReferenceCounter.h"
+#include "ImageFilters.h"
 
 namespace DE {
 	namespace Graphics {
@@ -15,6 +16,7 @@ namespace DE {
 			class RenderingContext;
 			class GLContext;
 			class DirectDraw9Context;
+			class SoftwareContext;
 		}
 
 	    struct LineWidth {
@@ -33,6 +35,7 @@ namespace DE {
             private:
                 double s;
 	    };
+#ifndef DE_HEADLESS
 		class GdiPlusAccess {
 #define AssertGDIPlusSuccess(OP, MSG) \
 	if ((OP) != ::Gdiplus::Ok) { \
@@ -42,6 +45,9 @@ namespace DE {
 				static void GetEncoderCLSID(const GUID&, CLSID&);
 				static void SaveBitmap(Gdiplus::Bitmap&, const Core::String&, const GUID&);
 
+				// the pixels of a locked 32bpp bitmap
+				static ImageView GetImageView(Gdiplus::BitmapData&);
+				// these work on 32bpp bitmaps through ImageFilters, the gaussian reaches 3 sigma at the radius
 				static void GaussianBlur(Gdiplus::BitmapData&, size_t, size_t);
 				static void AverageBlur(Gdiplus::BitmapData&, size_t, size_t);
 				static void Pixelate(Gdiplus::BitmapData&, size_t, size_t);
@@ -55,22 +61,122 @@ namespace DE {
 				};
 				static Initializer _initObj;
 		};
+#endif
+
+		struct RenderStatistics {
+			size_t
+				SubmittedDraws = 0, // DrawVertices calls made on the Renderer
+				DrawCalls = 0, // DrawVertices calls that reached the context
+				StateChanges = 0; // texture, blend, stencil, clip, line width, point size and wrap changes that reached the context
+		};
+		// the draw states tracked by a Renderer; batched draws are recorded together with them
+		struct RenderState {
+			TextureID Texture;
+			BlendFactor Source = BlendFactor::SourceAlpha, Target = BlendFactor::InvertedSourceAlpha;
+			StencilComparisonFunction StencilFunction = StencilComparisonFunction::Always;
+			unsigned StencilReference = 0, StencilMask = ~0u;
+			StencilOperation StencilFail = StencilOperation::Keep, StencilDepthFail = StencilOperation::Keep, StencilPass = StencilOperation::Keep;
+			bool Clipped = false;
+			Core::Math::Rectangle Clip;
+			double LineWidth = 1.0, PointSize = 1.0; // non-positive means that the draw doesn't care
+
+			friend bool operator ==(const RenderState &lhs, const RenderState &rhs) {
+				return
+					lhs.Texture == rhs.Texture && lhs.Source == rhs.Source && lhs.Target == rhs.Target &&
+					lhs.StencilFunction == rhs.StencilFunction && lhs.StencilReference == rhs.StencilReference &&
+					lhs.StencilMask == rhs.StencilMask && lhs.StencilFail == rhs.StencilFail &&
+					lhs.StencilDepthFail == rhs.StencilDepthFail && lhs.StencilPass == rhs.StencilPass &&
+					lhs.Clipped == rhs.Clipped && (!lhs.Clipped || (
+						lhs.Clip.Left == rhs.Clip.Left && lhs.Clip.Top == rhs.Clip.Top &&
+						lhs.Clip.Right == rhs.Clip.Right && lhs.Clip.Bottom == rhs.Clip.Bottom
+					)) &&
+					lhs.LineWidth == rhs.LineWidth && lhs.PointSize == rhs.PointSize;
+			}
+			friend bool operator !=(const RenderState &lhs, const RenderState &rhs) {
+				return !(lhs == rhs);
+			}
+		};
+		// tracks the draw states of a context, and, when batching, records draws instead of issuing them
+		// draws are converted to triangle, line or point lists, and are appended to an earlier batch with the same
+		// states if they don't overlap any triangles drawn in between; only the last MaxLookBack batches are searched,
+		// so the drawing order of overlapping draws is kept
+		// the batches are replayed with redundant state changes left out when the buffer is flushed
+		// all states are set once at the start of each flush, since other Renderers may share the context
+		// when not batching, all calls are passed on to the context as they are
+		class CommandBuffer {
+			public:
+				constexpr static size_t MaxLookBack = 16;
+
+				explicit CommandBuffer(RenderingContexts::RenderingContext &ctx) : _ctx(ctx) {
+				}
+
+				void SetBatching(bool);
+				bool IsBatching() const {
+					return _batching;
+				}
+				void Flush(); // replays the recorded batches, then applies the current states
+
+				const RenderState &GetState() const {
+					return _state;
+				}
+				void SetTexture(const TextureID&);
+				void SetBlendFunction(BlendFactor, BlendFactor);
+				void SetStencilFunction(StencilComparisonFunction, unsigned, unsigned);
+				void SetStencilOperation(StencilOperation, StencilOperation, StencilOperation);
+				void SetLineWidth(double);
+				void SetPointSize(double);
+				void PushClip(const Core::Math::Rectangle&);
+				void PopClip();
+
+				void Draw(const Vertex*, size_t, RenderMode);
+
+				RenderStatistics Statistics;
+			private:
+				struct Batch {
+					constexpr static size_t MaxBounds = 4;
+
+					RenderState State;
+					RenderMode Mode; // Triangles, Lines or Points
+					Core::Collections::List<Vertex> Vertices;
+					// a few rectangles that cover all draws, so that one big bounding box doesn't block the merging
+					Core::Math::Rectangle Bounds[MaxBounds];
+					size_t BoundCount = 0;
+
+					bool Overlaps(const Core::Math::Rectangle&) const;
+					void AddBounds(const Core::Math::Rectangle&);
+				};
+
+				RenderingContexts::RenderingContext &_ctx;
+				RenderState _state, _applied;
+				bool _batching = false, _known = false, _clipPushed = false; // _known: whether _applied matches the context
+				Core::Collections::List<Core::Math::Rectangle> _clips;
+				Core::Collections::List<Batch> _batches;
+
+				void Apply(const RenderState&);
+				void UpdateClipState() {
+					_state.Clipped = _clips.Count() > 0;
+					_state.Clip = (_state.Clipped ? _clips.Last() : Core::Math::Rectangle());
+				}
+		};
 
 		class Renderer {
 				friend class RenderingContexts::RenderingContext;
 				friend class RenderingContexts::GLContext;
 				friend class RenderingContexts::DirectDraw9Context;
+				friend class RenderingContexts::SoftwareContext;
 			public:
 				Renderer() = default;
 
 				void Begin() {
 					if (_ctx) {
+						FlushBatch();
 						_ctx->Begin();
 					}
 				}
 				void SetViewport(const Core::Math::Rectangle&);
 				void SetViewbox(const Core::Math::Rectangle &box) {
 					if (_ctx) {
+						FlushBatch();
 						_ctx->SetViewbox(box);
 					}
 				}
@@ -81,6 +187,7 @@ namespace DE {
 				}
 				void End() {
 					if (_ctx) {
+						FlushBatch();
 						_ctx->End();
 					}
 				}
@@ -89,35 +196,67 @@ namespace DE {
 					return _ctx != nullptr;
 				}
 
+				// when batching, draws are recorded and handed to the context in as few calls as possible
+				// at End(), at frame buffer switches, or when Flush() is called
+				// the clip stack must be empty when batching is switched on or off
+				void SetBatching(bool batch) {
+					if (_ctx) {
+						_cmds->SetBatching(batch);
+					}
+				}
+				bool IsBatching() const {
+					return _ctx && _cmds->IsBatching();
+				}
+				void Flush() {
+					FlushBatch();
+				}
+				RenderStatistics GetStatistics() const {
+					if (_ctx) {
+						return _cmds->Statistics;
+					}
+					return RenderStatistics();
+				}
+				void ResetStatistics() {
+					if (_ctx) {
+						_cmds->Statistics = RenderStatistics();
+					}
+				}
+
 				void SetBlendFunction(BlendFactor src, BlendFactor dst) {
 					if (_ctx) {
-						_ctx->SetBlendFunction(src, dst);
+						_cmds->SetBlendFunction(src, dst);
 					}
 				}
 
+#ifndef DE_HEADLESS
 				TextureID LoadTextureFromFile(const Core::String &fileName) {
 					Gdiplus::Bitmap b(*fileName);
 					return LoadTextureFromBitmap(b);
 				}
+#endif
 				TextureID LoadTextureFromBitmap(Gdiplus::Bitmap &bmp) {
 					if (_ctx) {
+						FlushBatch();
 						return _ctx->LoadTextureFromBitmap(bmp);
 					}
 					return TextureID();
 				}
 				void UnloadTexture(const TextureID &tex) {
 					if (_ctx) {
+						FlushBatch();
 						_ctx->DeleteTexture(tex);
 					}
 				}
 				Gdiplus::Bitmap *GetTextureImage(const TextureID &tex) {
 					if (_ctx) {
+						FlushBatch();
 						return _ctx->GetTextureImage(tex);
 					}
 					return nullptr;
 				}
 				void SetTextureImage(const TextureID &tex, Gdiplus::Bitmap &bmp) {
 					if (_ctx) {
+						FlushBatch();
 						TextureID curTex = _ctx->GetBoundTexture();
 						_ctx->SetTextureImage(tex, bmp);
 						_ctx->BindTexture(curTex);
@@ -125,7 +264,7 @@ namespace DE {
 				}
 				void BindTexture(const TextureID &tex) {
 					if (_ctx) {
-						_ctx->BindTexture(tex);
+						_cmds->SetTexture(tex);
 					}
 				}
 
@@ -135,23 +274,23 @@ namespace DE {
 
 				void SetLineWidth(double width) {
 					if (_ctx) {
-						_ctx->SetLineWidth(width);
+						_cmds->SetLineWidth(width);
 					}
 				}
 				void SetPointSize(double size) {
 					if (_ctx) {
-						_ctx->SetPointSize(size);
+						_cmds->SetPointSize(size);
 					}
 				}
 
 				void SetStencilFunction(StencilComparisonFunction func, unsigned ref, unsigned mask) {
 					if (_ctx) {
-						_ctx->SetStencilFunction(func, ref, mask);
+						_cmds->SetStencilFunction(func, ref, mask);
 					}
 				}
 				void SetStencilOperation(StencilOperation fail, StencilOperation zfail, StencilOperation zpass) {
 					if (_ctx) {
-						_ctx->SetStencilOperation(fail, zfail, zpass);
+						_cmds->SetStencilOperation(fail, zfail, zpass);
 					}
 				}
 				void SetClearStencilValue(unsigned v) {
@@ -161,6 +300,7 @@ namespace DE {
 				}
 				void ClearStencil() {
 					if (_ctx) {
+						FlushBatch();
 						_ctx->ClearStencil();
 					}
 				}
@@ -169,33 +309,40 @@ namespace DE {
 
 				void PushRectangularClip(const Core::Math::Rectangle &rect) {
 					if (_ctx) {
-						_ctx->PushRectangularClip(rect);
+						_cmds->PushClip(rect);
 					}
 				}
 				void PopRectangularClip() {
 					if (_ctx) {
-						_ctx->PopRectangularClip();
+						_cmds->PopClip();
 					}
 				}
 
+				// texture wraps belong to the bound texture, so they're not batched
 				void SetVerticalTextureWrap(TextureWrap wrap) {
 					if (_ctx) {
+						FlushBatch();
+						++_cmds->Statistics.StateChanges;
 						_ctx->SetVerticalTextureWrap(wrap);
 					}
 				}
 				void SetHorizontalTextureWrap(TextureWrap wrap) {
 					if (_ctx) {
+						FlushBatch();
+						++_cmds->Statistics.StateChanges;
 						_ctx->SetHorizontalTextureWrap(wrap);
 					}
 				}
 				TextureWrap GetVerticalTextureWrap() const {
 					if (_ctx) {
+						FlushBatch();
 						return _ctx->GetVerticalTextureWrap();
 					}
 					return TextureWrap::None;
 				}
 				TextureWrap GetHorizontalTextureWrap() const {
 					if (_ctx) {
+						FlushBatch();
 						return _ctx->GetHorizontalTextureWrap();
 					}
 					return TextureWrap::None;
@@ -203,34 +350,39 @@ namespace DE {
 
 				FrameBuffer CreateFrameBuffer(const Core::Math::Rectangle &rect) {
 					if (_ctx) {
+						FlushBatch();
 						return _ctx->CreateFrameBuffer(rect);
 					}
 					return FrameBuffer();
 				}
 				void BeginFrameBuffer(const FrameBuffer &buf) {
 					if (_ctx) {
+						FlushBatch();
 						_ctx->BeginFrameBuffer(buf);
 					}
 				}
 				void ContinueFrameBuffer(const FrameBuffer &buf) {
 					if (_ctx) {
+						FlushBatch();
 						_ctx->ContinueFrameBuffer(buf);
 					}
 				}
 				void BackToDefaultFrameBuffer() {
 					if (_ctx) {
+						FlushBatch();
 						_ctx->BackToDefaultFrameBuffer();
 					}
 				}
 				void DeleteFrameBuffer(const FrameBuffer &buf) {
 					if (_ctx) {
+						FlushBatch();
 						_ctx->DeleteFrameBuffer(buf);
 					}
 				}
 
 				void DrawVertices(const Vertex *vs, size_t count, RenderMode mode) {
 					if (_ctx) {
-						_ctx->DrawVertices(vs, count, mode);
+						_cmds->Draw(vs, count, mode);
 					}
 				}
 				template <bool DMA> void DrawVertices(const Core::Collections::List<Vertex, DMA> &vxs, RenderMode mode) {
@@ -239,16 +391,24 @@ namespace DE {
 
 				Gdiplus::Bitmap *GetScreenShot(const Core::Math::Rectangle &rect) {
 					if (_ctx) {
+						FlushBatch();
 						return _ctx->GetScreenShot(rect);
 					}
 					return nullptr;
 				}
 
 			private:
-				Renderer(RenderingContexts::RenderingContext *c) : _ctx(c) {
+				Renderer(RenderingContexts::RenderingContext *c) : _ctx(c), _cmds(Core::CreateSharedObject<CommandBuffer>(*c)) {
+				}
+
+				void FlushBatch() const {
+					if (_ctx && _cmds->IsBatching()) {
+						_cmds->Flush();
+					}
 				}
 
-                RenderingContexts::RenderingContext *_ctx = nullptr;
+				RenderingContexts::RenderingContext *_ctx = nullptr;
+				Core::SharedPointer<CommandBuffer> _cmds; // shared by copies of the Renderer
 		};
 	}
 }
@@ -1,17 +1,8 @@
 #pragma once
 
-#ifdef DE_NO_GLEW
-#	include <gl/gl.h>
-#	include <gl/glu.h>
-#	include <gl/glext.h>
-#else
-#	include <gl/glew.h>
-#endif
-
-#include <windows.h>
-#include <gdiplus.h>
-
-#include "Window.h"
+#include <cstring>
+
+#include "RenderingPlatform.h"
 #include "List.h"
 #include "Color.h"
 #include "Vector2.h"
@@ -24,6 +15,7 @@ namespace DE {
 		namespace RenderingContexts {
 			class RenderingContext;
 			class GLContext;
+			class SoftwareContext;
 		}
 
 		struct Vertex {
@@ -95,19 +87,29 @@ namespace DE {
 		struct TextureID {
 				friend class RenderingContexts::RenderingContext;
 				friend class RenderingContexts::GLContext;
+				friend class RenderingContexts::SoftwareContext;
 				friend class Renderer;
 			public:
 				TextureID() {
 					std::memset(&_id, 0, sizeof(_id));
 				}
+
+				friend bool operator ==(const TextureID &lhs, const TextureID &rhs) {
+					return std::memcmp(&lhs._id, &rhs._id, sizeof(lhs._id)) == 0;
+				}
+				friend bool operator !=(const TextureID &lhs, const TextureID &rhs) {
+					return !(lhs == rhs);
+				}
 			protected:
 				union {
 					GLuint GLID;
+					size_t SoftwareID;
 				} _id;
 		};
 		struct FrameBufferID {
 				friend class RenderingContexts::RenderingContext;
 				friend class RenderingContexts::GLContext;
+				friend class RenderingContexts::SoftwareContext;
 				friend class Renderer;
 			public:
 				FrameBufferID() {
@@ -118,11 +120,12 @@ namespace DE {
 					struct {
 						GLuint BufID, StencilBufID;
 					} GLID;
+					size_t SoftwareID;
 				} _id;
 		};
 		struct FrameBuffer {
 			FrameBufferID BufferID;
-			TextureID TextureID;
+			Graphics::TextureID TextureID;
 			Core::Math::Rectangle Region;
 		};
 		namespace RenderingContexts {
@@ -0,0 +1,25 @@
+#pragma once
+
+// the window system, gdiplus and opengl headers that the rendering contexts are built on
+// with DE_HEADLESS defined none of them are included, and only contexts that don't need them (the SoftwareContext)
+// can be used; the gdiplus types of the interface are only declared
+#ifdef DE_HEADLESS
+namespace Gdiplus {
+	class Bitmap;
+	class BitmapData;
+}
+typedef unsigned int GLuint;
+#else
+#	ifdef DE_NO_GLEW
+#		include <gl/gl.h>
+#		include <gl/glu.h>
+#		include <gl/glext.h>
+#	else
+#		include <gl/glew.h>
+#	endif
+
+#	include <windows.h>
+#	include <gdiplus.h>
+
+#	include "Window.h"
+#endif
@@ -0,0 +1,807 @@
+#include "RigidBody.h"
+
+#include <atomic>
+
+namespace DE {
+	namespace Utils {
+		namespace RigidBody {
+			using namespace Core;
+			using namespace Core::Math;
+			using namespace Core::Collections;
+
+			constexpr static double
+				Baumgarte = 0.2, // the part of the overlap that is removed in each position iteration
+				Slop = 0.005, // the overlap that is left alone, so that resting contacts stay touching
+				MaxCorrection = 0.2, // the farthest a contact point is moved in one position iteration
+				ContactMargin = 0.02, // bodies this close get contacts that only keep them from overlapping in the next step
+				RestitutionThreshold = 1.0, // slower collisions don't bounce
+				EdgeTolerance = 0.1 * Slop; // prefer the first body's edge as the reference
+			constexpr static unsigned FlippedFeature = 0x80000000u, ClippedFeature = 0x8000u;
+
+			void Body::UpdateTransform() {
+				size_t n = Shape.Points.Count();
+				if (
+					_transform.Points.Count() == n && _transform.Offset.X == Offset.X && _transform.Offset.Y == Offset.Y &&
+					_transform.Rotation == Rotation
+				) {
+					return;
+				}
+				if (_transform.Points.Count() != n) {
+					_transform.Points.Clear();
+					_transform.Points.PushBack(Vector2(), n);
+				}
+				_transform.Offset = Offset;
+				_transform.Rotation = Rotation;
+				_transform.Cos = std::cos(Rotation);
+				_transform.Sin = std::sin(Rotation);
+				const Vector2 *src = *Shape.Points;
+				Vector2 *dst = *_transform.Points;
+				for (size_t i = 0; i < n; ++i) {
+					dst[i] = _transform.Direction(src[i]) + Offset;
+				}
+				_transform.MassCenter = _transform.Direction(MassCenter) + Offset;
+			}
+			Rectangle Body::GetBounds() const {
+				Rectangle res(Offset, Offset);
+				const Vector2 *pts = *_transform.Points;
+				for (size_t i = 0, n = _transform.Points.Count(); i < n; ++i) {
+					res.Left = Min(res.Left, pts[i].X);
+					res.Right = Max(res.Right, pts[i].X);
+					res.Top = Min(res.Top, pts[i].Y);
+					res.Bottom = Max(res.Bottom, pts[i].Y);
+				}
+				return res;
+			}
+			size_t Body::SupportPoint(const Vector2 &dir, size_t pt) const {
+				// the projections of the points of a convex polygon only rise once and fall once along its boundary,
+				// so the farthest point is found by walking uphill
+				const Vector2 *pts = *_transform.Points;
+				size_t n = _transform.Points.Count();
+				if (pt >= n) {
+					pt = 0;
+				}
+				double p = Vector2::Dot(pts[pt], dir);
+				size_t next = (pt + 1 < n ? pt + 1 : 0);
+				double np = Vector2::Dot(pts[next], dir);
+				if (np > p) {
+					do {
+						pt = next;
+						p = np;
+						next = (pt + 1 < n ? pt + 1 : 0);
+						np = Vector2::Dot(pts[next], dir);
+					} while (np > p);
+				} else {
+					size_t prev = (pt > 0 ? pt : n) - 1;
+					double pp = Vector2::Dot(pts[prev], dir);
+					while (pp > p) {
+						pt = prev;
+						p = pp;
+						prev = (pt > 0 ? pt : n) - 1;
+						pp = Vector2::Dot(pts[prev], dir);
+					}
+				}
+				return pt;
+			}
+			void Body::ComputeMassInfo() {
+				double totf = 0.0, totine = 0.0;
+				Vector2 tp;
+				for (size_t i = 2; i < Shape.Points.Count(); ++i) {
+					Vector2 dprv = Shape.Points[i - 1] - Shape.Points[0], dcur = Shape.Points[i] - Shape.Points[0];
+					double v = Vector2::Cross(dprv, dcur);
+					totine += (dprv.LengthSquared() + dcur.LengthSquared() + Vector2::Dot(dprv, dcur)) * v;
+					tp += (Shape.Points[0] + Shape.Points[i - 1] + Shape.Points[i]) * v;
+					totf += v;
+				}
+				MassCenter = tp / (totf * 3.0);
+				Mass = Abs(totf) * 0.5 * Density;
+				Inertia = Abs(totine * Density / 12.0) - Mass * (MassCenter - Shape.Points[0]).LengthSquared();
+				if (totf < 0.0) { // the contact code relies on the winding
+					Shape.Points.Reverse();
+				}
+				// points on the edges would stop the walks of SupportPoint halfway
+				for (size_t i = 0; i < Shape.Points.Count() && Shape.Points.Count() > 3; ) {
+					size_t n = Shape.Points.Count();
+					const Vector2 &prev = Shape.Points[(i > 0 ? i : n) - 1], &cur = Shape.Points[i], &next = Shape.Points[(i + 1) % n];
+					if (Vector2::Cross(cur - prev, next - cur) == 0.0) {
+						Shape.Points.Remove(i);
+					} else {
+						++i;
+					}
+				}
+				_normals.Clear();
+				for (size_t i = 0; i < Shape.Points.Count(); ++i) {
+					Vector2 e = Shape.Points[i + 1 < Shape.Points.Count() ? i + 1 : 0] - Shape.Points[i];
+					double len = e.Length();
+					_normals.PushBack(len > 0.0 ? Vector2(e.Y / len, -e.X / len) : Vector2()); // e turned right
+				}
+				_transform.Points.Clear();
+				UpdateTransform();
+			}
+
+			NodeInfo GetNode(const Body &p1, const Body &p2, const Vector2 &dir, size_t hint1, size_t hint2) {
+				NodeInfo ni;
+				ni.ID1 = p1.SupportPoint(dir, hint1);
+				ni.ID2 = p2.SupportPoint(-dir, hint2);
+				ni.Position = p1.GetTransform().Points[ni.ID1] - p2.GetTransform().Points[ni.ID2];
+				return ni;
+			}
+			bool GJK(const Body &p1, const Body &p2, Simplex &res) {
+				NodeInfo (&v)[3] = res.Points;
+				size_t hint1 = (res.Count > 0 ? v[0].ID1 : 0), hint2 = (res.Count > 0 ? v[0].ID2 : 0);
+				v[0] = GetNode(p1, p2, Vector2(1.0, 0.0), hint1, hint2);
+				size_t vn = 1;
+				res.Count = 0;
+				for (int x = 0; x < 100; ++x) { // NOTE an arbitary number of max iterations
+					Vector2 spdir;
+					size_t excl = vn;
+					bool fin = false;
+					switch (vn) {
+						case 1: {
+							spdir = -v[0].Position;
+							break;
+						}
+						case 2: {
+							spdir = v[1].Position - v[0].Position;
+							spdir.RotateLeft90();
+							if (Vector2::Dot(spdir, v[1].Position) > 0.0) {
+								spdir = -spdir;
+							}
+							break;
+						}
+						case 3: {
+							spdir = v[1].Position - v[0].Position;
+							spdir.RotateLeft90();
+							if (Vector2::Dot(spdir, v[1].Position) > 0.0) {
+								spdir = v[2].Position - v[1].Position;
+								spdir.RotateLeft90();
+								if (Vector2::Dot(spdir, v[1].Position) > 0.0) {
+									spdir = v[0].Position - v[2].Position;
+									spdir.RotateLeft90();
+									if (Vector2::Dot(spdir, v[0].Position) > 0.0) {
+										fin = true;
+									}
+									excl = 1;
+								} else {
+									excl = 0;
+								}
+							} else {
+								excl = 2;
+							}
+							break;
+						}
+					}
+					if (fin) {
+						res.Count = 3;
+						return true;
+					}
+					if (spdir.X == 0.0 && spdir.Y == 0.0) { // the origin is on the boundary, which counts as touching only
+						break;
+					}
+					const NodeInfo &last = v[vn - 1]; // the support points of the last direction are close to the new ones
+					NodeInfo ni = GetNode(p1, p2, spdir, last.ID1, last.ID2);
+					if (Vector2::Dot(spdir, ni.Position) < 0.0) { // no intersection
+						break;
+					}
+					v[excl] = ni;
+					if (vn < 3) {
+						++vn;
+					}
+					if (vn == 3) {
+						if (Vector2::Cross(v[1].Position - v[0].Position, v[2].Position - v[0].Position) > 0.0) {
+							Swap(v[0], v[1]);
+						}
+					}
+				}
+				res.Count = vn; // keeps the points as starting points of the next call
+				return false;
+			}
+			Segment EPAClockwise(const Simplex &gjkRes, const Body &p1, const Body &p2) { // assuming gjkRes comes clockwise
+				constexpr size_t MaxSegments = 64; // more than enough for the shapes of a game
+				Segment segments[MaxSegments];
+				double dists[MaxSegments]; // squared distances from the origin to the lines of the segments
+				size_t count = 0;
+				auto addSegment = [&](const NodeInfo &a, const NodeInfo &b) {
+					segments[count] = Segment(a, b);
+					dists[count] = ProjectionX(a.Position, a.Position - b.Position).LengthSquared();
+					++count;
+				};
+				for (size_t i = 0; i < gjkRes.Count; ++i) {
+					addSegment(gjkRes.Points[i], gjkRes.Points[i > 0 ? i - 1 : gjkRes.Count - 1]);
+				}
+				for (size_t z = 0; z < 100; ++z) { // NOTE an arbitrary number of iterations
+					size_t id = 0;
+					for (size_t i = 1; i < count; ++i) {
+						if (dists[id] > dists[i]) {
+							id = i;
+						}
+					}
+					const Segment &curseg = segments[id];
+					if (count == MaxSegments) {
+						return curseg;
+					}
+					Vector2 axis = curseg.P1.Position - curseg.P2.Position;
+					axis.RotateLeft90();
+					NodeInfo ni = GetNode(p1, p2, axis, curseg.P1.ID1, curseg.P1.ID2);
+					if ((ni.ID1 == curseg.P1.ID1 && ni.ID2 == curseg.P1.ID2) || (ni.ID1 == curseg.P2.ID1 && ni.ID2 == curseg.P2.ID2)) {
+						return curseg;
+					}
+					// a point on the edge itself, which happens when both bodies have an edge facing this direction
+					if (Vector2::Dot(axis, ni.Position - curseg.P1.Position) <= Epsilon * axis.Length()) {
+						return curseg;
+					}
+					NodeInfo p2Node = curseg.P2;
+					addSegment(ni, p2Node);
+					Segment &split = segments[id];
+					split.P2 = ni;
+					dists[id] = ProjectionX(split.P1.Position, split.P1.Position - ni.Position).LengthSquared();
+				}
+				return Segment(); // this should never happen
+			}
+
+			struct Transform { // a transform of a body other than the one it's at
+				Transform(const Body &b, const Vector2 &center) : Cos(std::cos(b.Rotation)), Sin(std::sin(b.Rotation)) {
+					Offset = center - Direction(b.MassCenter);
+				}
+
+				Vector2 Offset;
+				double Cos, Sin;
+
+				Vector2 Point(const Vector2 &p) const {
+					return Vector2(p.X * Cos - p.Y * Sin + Offset.X, p.X * Sin + p.Y * Cos + Offset.Y);
+				}
+				Vector2 Direction(const Vector2 &p) const {
+					return Vector2(p.X * Cos - p.Y * Sin, p.X * Sin + p.Y * Cos);
+				}
+			};
+			struct ClipVertex {
+				Vector2 Position;
+				unsigned ID;
+			};
+			// keeps the part of the segment where Dot(normal, p) <= offset
+			size_t ClipSegment(ClipVertex (&out)[2], const ClipVertex (&in)[2], const Vector2 &normal, double offset, unsigned clipID) {
+				size_t count = 0;
+				double d0 = Vector2::Dot(normal, in[0].Position) - offset, d1 = Vector2::Dot(normal, in[1].Position) - offset;
+				if (d0 <= 0.0) {
+					out[count++] = in[0];
+				}
+				if (d1 <= 0.0) {
+					out[count++] = in[1];
+				}
+				if (d0 * d1 < 0.0) {
+					out[count].Position = in[0].Position + (in[1].Position - in[0].Position) * (d0 / (d0 - d1));
+					out[count].ID = clipID;
+					++count;
+				}
+				return count;
+			}
+			// the edge of b1 that b2 is the farthest in front of, how far (negative if they overlap), and the point of b2
+			// that is the deepest behind it; for overlapping polygons its normal is the one that EPA finds, but this
+			// also works for bodies that are apart
+			// the normals of consecutive edges turn the same way, and so do the deepest points, which makes this O(n + m)
+			double FindMaxSeparation(const Body &b1, const Body &b2, size_t &edge, size_t &deepest) {
+				const List<Vector2> &pts1 = b1.GetTransform().Points, &pts2 = b2.GetTransform().Points;
+				const List<Vector2> &normals = b1.GetEdgeNormals();
+				double maxSep = 0.0;
+				size_t pt = 0;
+				edge = pts1.Count();
+				for (size_t i = 0; i < pts1.Count(); ++i) {
+					if (normals[i].X == 0.0 && normals[i].Y == 0.0) {
+						continue;
+					}
+					Vector2 n = b1.GetWorldNormal(i);
+					pt = b2.SupportPoint(-n, pt);
+					double sep = Vector2::Dot(n, pts2[pt] - pts1[i]);
+					if (edge == pts1.Count() || sep > maxSep) {
+						edge = i;
+						deepest = pt;
+						maxSep = sep;
+						if (maxSep > ContactMargin) {
+							break;
+						}
+					}
+				}
+				return maxSep;
+			}
+			// clips the incident edge against the sides of the reference edge, which is the edge of either body that
+			// separates them the most; points that are apart by no more than ContactMargin are kept
+			void World::UpdateManifold(const Body &b1, const Body &b2, Contact &c) {
+				ContactPoint old[2] = {c.Points[0], c.Points[1]};
+				size_t oldCount = c.PointCount;
+				c.PointCount = 0;
+				if (b1.Shape.Points.Count() < 2 || b2.Shape.Points.Count() < 2) {
+					return;
+				}
+				size_t e1, e2, d1, d2;
+				double s1 = FindMaxSeparation(b1, b2, e1, d2);
+				if (e1 == b1.Shape.Points.Count() || s1 > ContactMargin) {
+					return;
+				}
+				double s2 = FindMaxSeparation(b2, b1, e2, d1);
+				if (e2 == b2.Shape.Points.Count() || s2 > ContactMargin) {
+					return;
+				}
+				bool flip = s2 > s1 + EdgeTolerance;
+				const Body &ref = (flip ? b2 : b1), &inc = (flip ? b1 : b2);
+				const List<Vector2> &refPts = ref.GetTransform().Points, &incPts = inc.GetTransform().Points;
+				size_t refEdge = (flip ? e2 : e1), refCount = refPts.Count(), incCount = incPts.Count();
+				Vector2
+					v1 = refPts[refEdge],
+					v2 = refPts[refEdge + 1 < refCount ? refEdge + 1 : 0],
+					refNormal = ref.GetWorldNormal(refEdge),
+					tangent(-refNormal.Y, refNormal.X);
+				// the incident edge is the one next to the deepest point that faces the reference edge the most
+				size_t
+					deep = (flip ? d1 : d2), prev = (deep > 0 ? deep : incCount) - 1,
+					incEdge = (
+						Vector2::Dot(inc.GetWorldNormal(prev), refNormal) < Vector2::Dot(inc.GetWorldNormal(deep), refNormal) ?
+						prev : deep
+					),
+					incNext = (incEdge + 1 < incCount ? incEdge + 1 : 0);
+				unsigned feature = (flip ? FlippedFeature : 0u) | (static_cast<unsigned>(refEdge) << 16);
+				ClipVertex
+					incident[2] = {
+						{incPts[incEdge], feature | static_cast<unsigned>(incEdge)},
+						{incPts[incNext], feature | static_cast<unsigned>(incNext)}
+					},
+					side[2], clipped[2];
+				if (ClipSegment(side, incident, -tangent, -Vector2::Dot(tangent, v1), feature | ClippedFeature) < 2) {
+					return;
+				}
+				if (ClipSegment(clipped, side, tangent, Vector2::Dot(tangent, v2), feature | ClippedFeature | 1u) < 2) {
+					return;
+				}
+
+				c.Normal = (flip ? -refNormal : refNormal);
+				c._flipped = flip;
+				c._localNormal = ref.GetEdgeNormals()[refEdge];
+				c._localPlane = ref.Shape.Points[refEdge];
+				const BodyTransform &incT = inc.GetTransform();
+				double front = Vector2::Dot(refNormal, v1);
+				for (size_t i = 0; i < 2; ++i) {
+					double sep = Vector2::Dot(refNormal, clipped[i].Position) - front;
+					if (sep <= ContactMargin) {
+						ContactPoint &cp = c.Points[c.PointCount++];
+						cp.Position = clipped[i].Position;
+						cp.Separation = sep;
+						cp.ID = clipped[i].ID;
+						cp._localPoint = incT.InverseDirection(clipped[i].Position - incT.Offset);
+						cp.NormalImpulse = cp.TangentImpulse = 0.0;
+						for (size_t j = 0; j < oldCount; ++j) {
+							if (old[j].ID == cp.ID) {
+								cp.NormalImpulse = old[j].NormalImpulse;
+								cp.TangentImpulse = old[j].TangentImpulse;
+								break;
+							}
+						}
+					}
+				}
+			}
+
+			bool Overlap(const Rectangle &a, const Rectangle &b, double margin) {
+				return a.Left <= b.Right + margin && b.Left <= a.Right + margin && a.Top <= b.Bottom + margin && b.Top <= a.Bottom + margin;
+			}
+			bool IsAwakeAndDynamic(const Body &b) {
+				return b.Awake && b.Type == BodyType::Dynamic;
+			}
+			void WakeUpDynamic(Body &b) {
+				if (b.Type == BodyType::Dynamic) {
+					b.WakeUp();
+				}
+			}
+
+			size_t World::GetAwakeCount() const {
+				size_t res = 0;
+				for (size_t i = 0; i < _bodies.Count(); ++i) {
+					res += (IsAwakeAndDynamic(_bodies[i]) ? 1 : 0);
+				}
+				return res;
+			}
+
+			size_t NewBodyID() { // unique among all worlds, since bodies may be copied from one to another
+				static std::atomic<size_t> _next(0);
+				return ++_next;
+			}
+
+			void World::DoUpdate() {
+				SyncProxies();
+				for (size_t i = 0; i < _bodies.Count(); ++i) { // in case they've been moved by hand
+					Body &cb = _bodies[i];
+					if (IsAwakeAndDynamic(cb)) {
+						cb.UpdateTransform();
+					}
+				}
+				Collide();
+				SolveIslands();
+				for (size_t i = 0; i < _bodies.Count(); ++i) { // static bodies only need to update their boxes once
+					const Body &cb = static_cast<const List<Body>&>(_bodies)[i];
+					if (cb.Type == BodyType::Static && cb.Awake) {
+						UpdateProxy(i);
+						_bodies[i].Awake = false;
+					}
+				}
+				FindNewPairs();
+				const Body *bodies = *static_cast<const List<Body>&>(_bodies);
+				Placement *ps = *_placements;
+				for (size_t i = 0; i < _bodies.Count(); ++i) {
+					ps[i].Offset = bodies[i].Offset;
+					ps[i].Rotation = bodies[i].Rotation;
+				}
+			}
+
+			void World::SyncProxies() {
+				_tree.Margin() = _margin;
+				const List<Body> &bodies = _bodies;
+				bool rebuild = (_placements.Count() != bodies.Count() || _tree.GetRoot() == AABBNode::Null);
+				for (size_t i = 0; !rebuild && i < bodies.Count(); ++i) {
+					rebuild = (bodies[i]._id != _placements[i].ID);
+				}
+				if (!rebuild) {
+					// the bodies moved by hand get new boxes, and their contacts aren't warm started from where they were
+					bool moved = false;
+					for (size_t i = 0; i < bodies.Count(); ++i) {
+						if (IsMovedByHand(i)) {
+							moved = true;
+							UpdateProxy(i);
+							WakeUpDynamic(_bodies[i]);
+						}
+					}
+					if (!moved) {
+						return;
+					}
+					for (size_t i = 0; i < _contacts.Count(); ++i) {
+						Contact &c = _contacts[i];
+						if (IsMovedByHand(c.Body1) || IsMovedByHand(c.Body2)) {
+							c.PointCount = 0;
+							WakeUpDynamic(_bodies[c.Body1]);
+							WakeUpDynamic(_bodies[c.Body2]);
+						}
+					}
+					FindNewPairs();
+					return;
+				}
+				// the bodies that touched a body that is gone may have been resting on it
+				HashTable<size_t> present, touched;
+				for (size_t i = 0; i < bodies.Count(); ++i) {
+					present.Insert(bodies[i]._id);
+				}
+				for (size_t i = 0; i < _contacts.Count(); ++i) {
+					const Contact &c = _contacts[i];
+					if (c.PointCount > 0 && c.Body2 < _placements.Count()) {
+						size_t id1 = _placements[c.Body1].ID, id2 = _placements[c.Body2].ID;
+						if (!present.Exists(id1)) {
+							touched.Insert(id2);
+						}
+						if (!present.Exists(id2)) {
+							touched.Insert(id1);
+						}
+					}
+				}
+				Clear();
+				_bounds.Clear();
+				_moved.Clear();
+				_placements.Clear();
+				for (size_t i = 0; i < _bodies.Count(); ++i) {
+					Body &b = _bodies[i];
+					if (touched.Exists(b._id)) {
+						WakeUpDynamic(b);
+					}
+					b._id = NewBodyID();
+					b.UpdateTransform();
+					_bounds.PushBack(b.GetBounds());
+					_moved.PushBack(i);
+					Placement p;
+					p.ID = b._id;
+					_placements.PushBack(p);
+				}
+				_tree.Build(*static_cast<const List<Rectangle>&>(_bounds), _bounds.Count());
+				FindNewPairs();
+			}
+			bool World::IsMovedByHand(size_t id) const {
+				const Body &b = _bodies[id];
+				const Placement &p = _placements[id];
+				return b.Offset.X != p.Offset.X || b.Offset.Y != p.Offset.Y || b.Rotation != p.Rotation;
+			}
+			void World::UpdateProxy(size_t id) {
+				Body &b = _bodies[id];
+				b.UpdateTransform();
+				Rectangle bound = b.GetBounds();
+				_bounds[id] = bound;
+				if (_tree.MoveAABB(id, bound, b.Speed * (2.0 * _oohz))) { // the box also covers where the body is going in the next two steps
+					_moved.PushBack(id);
+				}
+			}
+			void World::FindNewPairs() {
+				const List<Body> &bodies = _bodies;
+				auto addPair = [&](size_t a, size_t b) {
+					if (a == b || (bodies[a].Type == BodyType::Static && bodies[b].Type == BodyType::Static)) {
+						return true;
+					}
+					if (_pairs.Insert(GetPairKey(Min(a, b), Max(a, b)))) {
+						Contact c;
+						c.Body1 = Min(a, b);
+						c.Body2 = Max(a, b);
+						_contacts.PushBack(c);
+					}
+					return true;
+				};
+				if (_moved.Count() == bodies.Count()) { // right after the tree is built, all pairs are found in one walk
+					_tree.QueryPairs(addPair);
+				} else {
+					for (size_t i = 0; i < _moved.Count(); ++i) {
+						size_t id = _moved[i];
+						_tree.QueryRegion(_tree.GetNode(id).Region, [&](size_t other) {
+							return addPair(id, other);
+						});
+					}
+				}
+				_moved.Clear();
+			}
+
+			void World::Collide() {
+				size_t n = _contacts.Count();
+				if (n == 0) {
+					return;
+				}
+				ThreadPool &pool = (_pool ? *_pool : ThreadPool::Default());
+				const Body *bodies = *static_cast<const List<Body>&>(_bodies);
+				const Rectangle *bounds = *static_cast<const List<Rectangle>&>(_bounds);
+				Contact *contacts = *_contacts;
+				pool.ParallelFor((n + NarrowphaseBatch - 1) / NarrowphaseBatch, [&](size_t batch) {
+					for (size_t i = batch * NarrowphaseBatch, end = Min(i + NarrowphaseBatch, n); i < end; ++i) {
+						Contact &c = contacts[i];
+						c._keep = Overlap(_tree.GetNode(c.Body1).Region, _tree.GetNode(c.Body2).Region, 0.0);
+						const Body &b1 = bodies[c.Body1], &b2 = bodies[c.Body2];
+						if (!c._keep || !(IsAwakeAndDynamic(b1) || IsAwakeAndDynamic(b2))) { // sleeping pairs keep their manifolds
+							continue;
+						}
+						c.Friction = std::sqrt(b1.Friction * b2.Friction);
+						c.Restitution = Max(b1.Restitution, b2.Restitution);
+						if (Overlap(bounds[c.Body1], bounds[c.Body2], ContactMargin)) {
+							UpdateManifold(b1, b2, c);
+						} else {
+							c.PointCount = 0;
+						}
+					}
+				});
+				size_t kept = 0;
+				for (size_t i = 0; i < n; ++i) {
+					if (contacts[i]._keep) {
+						contacts[kept++] = contacts[i];
+					} else {
+						_pairs.Erase(GetPairKey(contacts[i].Body1, contacts[i].Body2));
+					}
+				}
+				if (kept < n) {
+					_contacts.Remove(kept, n - kept);
+				}
+			}
+
+			// builds the islands of awake bodies by a depth first search over the touching contacts
+			// static bodies are part of the islands of all bodies that touch them, but don't connect them
+			void World::SolveIslands() {
+				size_t n = _bodies.Count();
+				_adjStart.Clear();
+				_adjStart.PushBack(0, n + 2);
+				size_t *start = *_adjStart;
+				for (size_t i = 0; i < _contacts.Count(); ++i) {
+					Contact &c = _contacts[i];
+					c._visited = false;
+					if (c.PointCount > 0) {
+						++start[c.Body1 + 2];
+						++start[c.Body2 + 2];
+					}
+				}
+				for (size_t i = 3; i < n + 2; ++i) {
+					start[i] += start[i - 1];
+				}
+				_adj.Clear();
+				if (start[n + 1] > 0) {
+					_adj.PushBack(0, start[n + 1]);
+				}
+				size_t *adj = *_adj;
+				for (size_t i = 0; i < _contacts.Count(); ++i) { // start[b + 1] points to the next free slot of b
+					const Contact &c = _contacts[i];
+					if (c.PointCount > 0) {
+						adj[start[c.Body1 + 1]++] = i;
+						adj[start[c.Body2 + 1]++] = i;
+					}
+				}
+				_visited.Clear();
+				_visited.PushBack(false, n);
+				if (_centers.Count() < n) {
+					_centers.PushBack(Vector2(), n - _centers.Count());
+				}
+				_islandBodies.Clear();
+				_islandContacts.Clear();
+				for (size_t seed = 0; seed < n; ++seed) {
+					const Body &sb = static_cast<const List<Body>&>(_bodies)[seed];
+					if (_visited[seed] || !IsAwakeAndDynamic(sb)) {
+						continue;
+					}
+					size_t bodyStart = _islandBodies.Count(), contactStart = _islandContacts.Count();
+					_visited[seed] = true;
+					_stack.PushBack(seed);
+					while (_stack.Count() > 0) {
+						size_t id = _stack.PopBack();
+						_islandBodies.PushBack(id);
+						Body &cb = _bodies[id];
+						if (!cb.Awake) {
+							cb.WakeUp();
+						}
+						for (size_t i = start[id], end = start[id + 1]; i < end; ++i) {
+							Contact &c = _contacts[_adj[i]];
+							if (c._visited) {
+								continue;
+							}
+							c._visited = true;
+							_islandContacts.PushBack(_adj[i]);
+							size_t other = (c.Body1 == id ? c.Body2 : c.Body1);
+							if (!_visited[other] && _bodies[other].Type == BodyType::Dynamic) {
+								_visited[other] = true;
+								_stack.PushBack(other);
+							}
+						}
+					}
+					SolveIsland(bodyStart, contactStart);
+				}
+			}
+			void World::SolveIsland(size_t bodyStart, size_t contactStart) {
+				double dt = _oohz, invDt = _hz;
+				for (size_t i = bodyStart; i < _islandBodies.Count(); ++i) {
+					_bodies[_islandBodies[i]].Speed += _gravity * dt;
+				}
+				for (size_t i = contactStart; i < _islandContacts.Count(); ++i) {
+					Contact &c = _contacts[_islandContacts[i]];
+					Body &b1 = _bodies[c.Body1], &b2 = _bodies[c.Body2];
+					c._invMass1 = c._invInertia1 = c._invMass2 = c._invInertia2 = 0.0;
+					if (b1.Type == BodyType::Dynamic) {
+						c._invMass1 = 1.0 / b1.Mass;
+						c._invInertia1 = 1.0 / b1.Inertia;
+					}
+					if (b2.Type == BodyType::Dynamic) {
+						c._invMass2 = 1.0 / b2.Mass;
+						c._invInertia2 = 1.0 / b2.Inertia;
+					}
+					Vector2
+						c1 = b1.GetTransform().MassCenter, c2 = b2.GetTransform().MassCenter,
+						tangent(c.Normal.Y, -c.Normal.X);
+					for (size_t j = 0; j < c.PointCount; ++j) {
+						ContactPoint &cp = c.Points[j];
+						cp._r1 = cp.Position - c1;
+						cp._r2 = cp.Position - c2;
+						double
+							rn1 = Vector2::Cross(cp._r1, c.Normal), rn2 = Vector2::Cross(cp._r2, c.Normal),
+							rt1 = Vector2::Cross(cp._r1, tangent), rt2 = Vector2::Cross(cp._r2, tangent);
+						cp._normalMass = 1.0 / (c._invMass1 + c._invMass2 + c._invInertia1 * rn1 * rn1 + c._invInertia2 * rn2 * rn2);
+						cp._tangentMass = 1.0 / (c._invMass1 + c._invMass2 + c._invInertia1 * rt1 * rt1 + c._invInertia2 * rt2 * rt2);
+						Vector2
+							w1 = cp._r1, w2 = cp._r2;
+						w1.RotateLeft90();
+						w2.RotateLeft90();
+						double vn = Vector2::Dot(b2.Speed + w2 * b2.AngularSpeed - b1.Speed - w1 * b1.AngularSpeed, c.Normal);
+						// allows the bodies to close the gap, but not more; overlaps are left to the position iterations
+						cp._bias = (cp.Separation > 0.0 ? -cp.Separation * invDt : 0.0);
+						if (c.Restitution > 0.0 && vn < -RestitutionThreshold) {
+							cp._bias = Max(cp._bias, -c.Restitution * vn);
+						}
+						Vector2 impl = c.Normal * cp.NormalImpulse + tangent * cp.TangentImpulse;
+						b1.Speed -= impl * c._invMass1;
+						b1.AngularSpeed -= c._invInertia1 * Vector2::Cross(cp._r1, impl);
+						b2.Speed += impl * c._invMass2;
+						b2.AngularSpeed += c._invInertia2 * Vector2::Cross(cp._r2, impl);
+					}
+				}
+				for (size_t it = 0; it < _iters; ++it) {
+					for (size_t i = contactStart; i < _islandContacts.Count(); ++i) {
+						Contact &c = _contacts[_islandContacts[i]];
+						Body &b1 = _bodies[c.Body1], &b2 = _bodies[c.Body2];
+						Vector2 tangent(c.Normal.Y, -c.Normal.X);
+						for (size_t j = 0; j < c.PointCount; ++j) {
+							ContactPoint &cp = c.Points[j];
+							Vector2 w1 = cp._r1, w2 = cp._r2;
+							w1.RotateLeft90();
+							w2.RotateLeft90();
+
+							Vector2 dv = b2.Speed + w2 * b2.AngularSpeed - b1.Speed - w1 * b1.AngularSpeed;
+							double
+								maxFriction = c.Friction * cp.NormalImpulse,
+								newImpl = Clamp(cp.TangentImpulse - cp._tangentMass * Vector2::Dot(dv, tangent), -maxFriction, maxFriction);
+							Vector2 impl = tangent * (newImpl - cp.TangentImpulse);
+							cp.TangentImpulse = newImpl;
+							b1.Speed -= impl * c._invMass1;
+							b1.AngularSpeed -= c._invInertia1 * Vector2::Cross(cp._r1, impl);
+							b2.Speed += impl * c._invMass2;
+							b2.AngularSpeed += c._invInertia2 * Vector2::Cross(cp._r2, impl);
+
+							dv = b2.Speed + w2 * b2.AngularSpeed - b1.Speed - w1 * b1.AngularSpeed;
+							newImpl = Max(cp.NormalImpulse + cp._normalMass * (cp._bias - Vector2::Dot(dv, c.Normal)), 0.0);
+							impl = c.Normal * (newImpl - cp.NormalImpulse);
+							cp.NormalImpulse = newImpl;
+							b1.Speed -= impl * c._invMass1;
+							b1.AngularSpeed -= c._invInertia1 * Vector2::Cross(cp._r1, impl);
+							b2.Speed += impl * c._invMass2;
+							b2.AngularSpeed += c._invInertia2 * Vector2::Cross(cp._r2, impl);
+						}
+					}
+				}
+				// the bodies are moved by their mass centers and rotations, and their offsets are set afterwards
+				Vector2 *centers = *_centers;
+				for (size_t i = bodyStart; i < _islandBodies.Count(); ++i) {
+					size_t id = _islandBodies[i];
+					Body &cb = _bodies[id];
+					centers[id] = cb.GetTransform().MassCenter + cb.Speed * dt;
+					cb.Rotation += cb.AngularSpeed * dt;
+				}
+				for (size_t i = contactStart; i < _islandContacts.Count(); ++i) { // static bodies aren't moved in this step
+					const Contact &c = _contacts[_islandContacts[i]];
+					const List<Body> &bodies = _bodies;
+					if (bodies[c.Body1].Type == BodyType::Static) {
+						centers[c.Body1] = bodies[c.Body1].GetTransform().MassCenter;
+					}
+					if (bodies[c.Body2].Type == BodyType::Static) {
+						centers[c.Body2] = bodies[c.Body2].GetTransform().MassCenter;
+					}
+				}
+				for (size_t it = 0; it < _posIters; ++it) { // the nonlinear gauss-seidel of Box2D, on the points found by UpdateManifold
+					double minSep = 0.0;
+					for (size_t i = contactStart; i < _islandContacts.Count(); ++i) {
+						Contact &c = _contacts[_islandContacts[i]];
+						Body &b1 = _bodies[c.Body1], &b2 = _bodies[c.Body2];
+						Vector2 &c1 = centers[c.Body1], &c2 = centers[c.Body2];
+						for (size_t j = 0; j < c.PointCount; ++j) {
+							Transform t1(b1, c1), t2(b2, c2);
+							const Transform &refT = (c._flipped ? t2 : t1), &incT = (c._flipped ? t1 : t2);
+							Vector2
+								normal = refT.Direction(c._localNormal),
+								pt = incT.Point(c.Points[j]._localPoint),
+								r1 = pt - c1, r2 = pt - c2;
+							double sep = Vector2::Dot(pt - refT.Point(c._localPlane), normal);
+							minSep = Min(minSep, sep);
+							if (c._flipped) {
+								normal = -normal;
+							}
+							double
+								rn1 = Vector2::Cross(r1, normal), rn2 = Vector2::Cross(r2, normal),
+								k = c._invMass1 + c._invMass2 + c._invInertia1 * rn1 * rn1 + c._invInertia2 * rn2 * rn2,
+								corr = Clamp(Baumgarte * (sep + Slop), -MaxCorrection, 0.0);
+							if (k > 0.0 && corr < 0.0) {
+								Vector2 impl = normal * (-corr / k);
+								c1 -= impl * c._invMass1;
+								b1.Rotation -= c._invInertia1 * Vector2::Cross(r1, impl);
+								c2 += impl * c._invMass2;
+								b2.Rotation += c._invInertia2 * Vector2::Cross(r2, impl);
+							}
+						}
+					}
+					if (minSep >= -3.0 * Slop) {
+						break;
+					}
+				}
+				double minSleep = TimeToSleep;
+				for (size_t i = bodyStart; i < _islandBodies.Count(); ++i) {
+					size_t id = _islandBodies[i];
+					Body &cb = _bodies[id];
+					cb.Offset = centers[id] - cb.DirectionToWorldCoordinates(cb.MassCenter);
+					UpdateProxy(id);
+					if (
+						cb.Speed.LengthSquared() > LinearSleepTolerance * LinearSleepTolerance ||
+						Abs(cb.AngularSpeed) > AngularSleepTolerance
+					) {
+						cb.SleepTime = 0.0;
+					} else {
+						cb.SleepTime += dt;
+					}
+					minSleep = Min(minSleep, cb.SleepTime);
+				}
+				if (_sleep && minSleep >= TimeToSleep) {
+					for (size_t i = bodyStart; i < _islandBodies.Count(); ++i) {
+						Body &cb = _bodies[_islandBodies[i]];
+						cb.Awake = false;
+						cb.Speed = Vector2();
+						cb.AngularSpeed = 0.0;
+					}
+				}
+			}
+		}
+	}
+}
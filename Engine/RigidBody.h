@@ -0,0 +1,355 @@
+#pragma once
+
+#include <cmath>
+
+#include "Math.h"
+#include "Vector2.h"
+#include "List.h"
+#include "Rectangle.h"
+#include "HashTable.h"
+#include "AABBTree.h"
+#include "ThreadPool.h"
+
+namespace DE {
+	namespace Utils {
+		namespace RigidBody {
+			struct Polygon {
+				// convex, made counterclockwise (y up) by ComputeMassInfo, which also removes repeated and collinear points
+				Core::Collections::List<Core::Math::Vector2> Points;
+			};
+			// where a body is, computed once per step by Body::UpdateTransform
+			// copies start empty, since copies of a List share their elements
+			struct BodyTransform {
+				BodyTransform() = default;
+				BodyTransform(const BodyTransform&) : BodyTransform() {
+				}
+				BodyTransform &operator =(const BodyTransform&) {
+					Points.Clear();
+					return *this;
+				}
+
+				Core::Math::Vector2 Offset, MassCenter; // the mass center in world coordinates
+				double Rotation = 0.0, Cos = 1.0, Sin = 0.0;
+				Core::Collections::List<Core::Math::Vector2> Points; // the points of the shape in world coordinates
+
+				Core::Math::Vector2 Direction(const Core::Math::Vector2 &v) const {
+					return Core::Math::Vector2(v.X * Cos - v.Y * Sin, v.X * Sin + v.Y * Cos);
+				}
+				Core::Math::Vector2 InverseDirection(const Core::Math::Vector2 &v) const {
+					return Core::Math::Vector2(v.X * Cos + v.Y * Sin, v.Y * Cos - v.X * Sin);
+				}
+			};
+			enum class BodyType {
+				Dynamic,
+				Static
+			};
+			class World;
+			struct Body {
+					friend class World;
+				public:
+					Polygon Shape;
+					Core::Math::Vector2 Offset;
+					double Rotation = 0.0;
+
+					BodyType Type = BodyType::Dynamic;
+					double Density = 7.0, Mass = 0.0, Inertia = 0.0;
+					Core::Math::Vector2 MassCenter;
+					double Friction = 0.5, Restitution = 0.0; // mixed as sqrt(f1 * f2) and max(r1, r2)
+
+					Core::Math::Vector2 Speed; // of the mass center
+					double AngularSpeed = 0.0;
+
+					// sleeping bodies are neither moved nor tested against each other; the world puts whole islands to sleep,
+					// and wakes them up when an awake body touches them, or when they are moved by hand
+					bool Awake = true;
+					double SleepTime = 0.0; // how long the body has been almost still, managed by the world
+
+					// stuff about shape
+					// the world calls UpdateTransform() for the bodies it moves; the functions below that use the transform
+					// need it to be up to date, and bodies moved by hand should call it themselves
+					void UpdateTransform(); // does nothing if Offset and Rotation haven't changed
+					const BodyTransform &GetTransform() const {
+						return _transform;
+					}
+					// the outward normal of the edge from point i to point i + 1, in shape coordinates
+					const Core::Collections::List<Core::Math::Vector2> &GetEdgeNormals() const {
+						return _normals;
+					}
+					Core::Math::Vector2 GetWorldNormal(size_t i) const { // uses the transform
+						return _transform.Direction(_normals[i]);
+					}
+					Core::Math::Rectangle GetBounds() const; // Top and Bottom are the smallest and the largest y, uses the transform
+					Core::Math::Vector2 PointToShapeCoordinates(const Core::Math::Vector2 &pos) const {
+						return DirectionToShapeCoordinates(pos - Offset);
+					}
+					Core::Math::Vector2 DirectionToShapeCoordinates(const Core::Math::Vector2 &dir) const {
+						Core::Math::Vector2 rotv(std::cos(Rotation), -std::sin(Rotation));
+						return Core::Math::Vector2(dir.X * rotv.X - dir.Y * rotv.Y, dir.X * rotv.Y + dir.Y * rotv.X);
+					}
+					Core::Math::Vector2 PointToWorldCoordinates(const Core::Math::Vector2 &pos) const {
+						return DirectionToWorldCoordinates(pos) + Offset;
+					}
+					Core::Math::Vector2 DirectionToWorldCoordinates(const Core::Math::Vector2 &dir) const {
+						Core::Math::Vector2 rotv(std::cos(Rotation), std::sin(Rotation));
+						return Core::Math::Vector2(dir.X * rotv.X - dir.Y * rotv.Y, dir.X * rotv.Y + dir.Y * rotv.X);
+					}
+
+					// the index of the farthest point in the given world direction, found by walking from the given point
+					// to its neighbors, which takes few steps if the point was the answer to a close direction; uses the transform
+					size_t SupportPoint(const Core::Math::Vector2&, size_t = 0) const;
+
+					bool HitTest(const Core::Math::Vector2 &v) const {
+						return Core::Math::PolygonPointIntersect(Shape.Points, PointToShapeCoordinates(v)) == Core::Math::IntersectionType::Full;
+					}
+
+					// stuff about dynamics
+					void ComputeMassInfo();
+
+					void Update(double dt) {
+						Core::Math::Vector2 nmc = Offset + DirectionToWorldCoordinates(MassCenter) + Speed * dt;
+						Rotation += AngularSpeed * dt;
+						Offset = nmc - DirectionToWorldCoordinates(MassCenter);
+					}
+					void ApplyImpulse(const Core::Math::Vector2 &shapePos, const Core::Math::Vector2 &shapeImpl) {
+						if (Type == BodyType::Dynamic) {
+							Speed += DirectionToWorldCoordinates(shapeImpl) / Mass;
+							AngularSpeed += Core::Math::Vector2::Cross(shapePos - MassCenter, shapeImpl) / Inertia;
+							WakeUp();
+						}
+					}
+					void WakeUp() {
+						Awake = true;
+						SleepTime = 0.0;
+					}
+
+					double GetEnergy() const {
+						if (Type == BodyType::Dynamic) {
+							return 0.5 * (Mass * Speed.LengthSquared() + AngularSpeed * AngularSpeed * Inertia);
+						}
+						return 0.0;
+					}
+				protected:
+					BodyTransform _transform;
+					Core::Collections::List<Core::Math::Vector2> _normals;
+					size_t _id = 0; // given by the world, which tells from it that bodies have been added, removed or replaced
+			};
+
+			// a point of the minkowski difference of two bodies, and the points of the bodies it comes from
+			struct NodeInfo {
+				NodeInfo() = default;
+				NodeInfo(size_t id1, size_t id2, const Core::Math::Vector2 &pos) : ID1(id1), ID2(id2), Position(pos) {
+				}
+
+				size_t ID1 = 0, ID2 = 0;
+				Core::Math::Vector2 Position;
+			};
+			struct Segment {
+				Segment() = default;
+				Segment(const NodeInfo &i1, const NodeInfo &i2) : P1(i1), P2(i2) {
+				}
+
+				NodeInfo P1, P2;
+			};
+			struct Simplex {
+				NodeInfo Points[3];
+				size_t Count = 0;
+			};
+			// finds a clockwise triangle of the minkowski difference that contains the origin, and returns false if the
+			// bodies don't overlap; the points that are already in the simplex are where the support searches start
+			// both use the transforms of the bodies
+			bool GJK(const Body&, const Body&, Simplex&);
+			// the edge of the minkowski difference that is the nearest to the origin, starting from the triangle found by GJK
+			Segment EPAClockwise(const Simplex&, const Body&, const Body&);
+
+			struct ContactPoint {
+					friend class World;
+				public:
+					Core::Math::Vector2 Position; // on the surface of the incident body
+					double Separation = 0.0; // along the normal, negative when the bodies overlap
+					// accumulated during the last step, and used to warm start the next one
+					double NormalImpulse = 0.0, TangentImpulse = 0.0;
+					unsigned ID = 0; // the features the point comes from, used to match points of consecutive steps
+				protected:
+					Core::Math::Vector2 _r1, _r2, _localPoint; // _localPoint is on the incident body, in its shape coordinates
+					double _normalMass = 0.0, _tangentMass = 0.0, _bias = 0.0;
+			};
+			struct Contact {
+					friend class World;
+				public:
+					size_t Body1 = 0, Body2 = 0; // indices in World::Bodies(), Body1 < Body2
+					Core::Math::Vector2 Normal; // from body 1 to body 2
+					ContactPoint Points[2];
+					size_t PointCount = 0; // zero if the bodies are near but don't touch
+					double Friction = 0.0, Restitution = 0.0;
+				protected:
+					double _invMass1 = 0.0, _invMass2 = 0.0, _invInertia1 = 0.0, _invInertia2 = 0.0;
+					// the reference edge in the shape coordinates of its body, which is body 2 if flipped
+					Core::Math::Vector2 _localNormal, _localPlane;
+					bool _flipped = false, _keep = true, _visited = false;
+			};
+
+			// simulates convex bodies with a fixed time step
+			// pairs of bodies are found by an AABBTree of slightly enlarged bounds, which are only moved when a body
+			// leaves its box; each pair that touches gets a manifold of up to two points, clipped from the edges that
+			// face each other, and the impulses of these points are solved by sequential impulses with warm starting
+			// overlaps are then removed by moving the bodies directly, so that deep piles don't gain speed from it
+			// bodies linked by touching contacts form islands, which fall asleep together when all of them are still
+			class World {
+				public:
+					constexpr static double
+						DefaultFrequency = 60.0,
+						DefaultMargin = 0.1, // how much the boxes in the tree are enlarged
+						LinearSleepTolerance = 0.01, AngularSleepTolerance = 0.035, // about 2 degrees per second
+						TimeToSleep = 0.5;
+
+					World() = default;
+					World(const World &src) : World() {
+						*this = src;
+					}
+					World &operator =(const World &src) { // only the bodies and settings are copied
+						if (this != &src) {
+							Clear();
+							_bodies = src._bodies;
+							_gravity = src._gravity;
+							_hz = src._hz;
+							_intv = src._intv;
+							_oohz = src._oohz;
+							_iters = src._iters;
+							_posIters = src._posIters;
+							_margin = src._margin;
+							_sleep = src._sleep;
+							_pool = src._pool;
+						}
+						return *this;
+					}
+
+					// the contacts and boxes are rebuilt in the next update after bodies are added, removed or replaced, and
+					// the bodies moved by hand are woken up, together with the bodies they touch
+					Core::Collections::List<Body> &Bodies() {
+						return _bodies;
+					}
+					const Core::Collections::List<Body> &Bodies() const {
+						return _bodies;
+					}
+					// the manifolds of all pairs of bodies whose enlarged boxes overlap
+					const Core::Collections::List<Contact, true> &Contacts() const {
+						return _contacts;
+					}
+
+					Core::Math::Vector2 &Gravity() {
+						return _gravity;
+					}
+					const Core::Math::Vector2 &Gravity() const {
+						return _gravity;
+					}
+					double GetHertz() const {
+						return _hz;
+					}
+					void SetHertz(double hz) {
+						_hz = hz;
+						_oohz = 1.0 / _hz;
+					}
+					size_t &Iterations() {
+						return _iters;
+					}
+					const size_t &Iterations() const {
+						return _iters;
+					}
+					size_t &PositionIterations() {
+						return _posIters;
+					}
+					const size_t &PositionIterations() const {
+						return _posIters;
+					}
+					double &Margin() {
+						return _margin;
+					}
+					const double &Margin() const {
+						return _margin;
+					}
+					bool &AllowSleeping() {
+						return _sleep;
+					}
+					const bool &AllowSleeping() const {
+						return _sleep;
+					}
+					// the pool used to update manifolds, ThreadPool::Default() if nullptr
+					Core::ThreadPool *&Pool() {
+						return _pool;
+					}
+					Core::ThreadPool *const &Pool() const {
+						return _pool;
+					}
+
+					size_t GetAwakeCount() const; // dynamic bodies only
+
+					// forgets all contacts and boxes, which are rebuilt in the next update
+					void Clear() {
+						_tree.Clear();
+						_pairs.Clear();
+						_contacts.Clear();
+					}
+
+					void Update(double dt) {
+						_intv += dt;
+						while (_intv >= _oohz) {
+							_intv -= _oohz;
+							DoUpdate();
+						}
+					}
+				private:
+					// keys of pairs of bodies, hashed since consecutive keys share their upper bits
+					class PairHashFunc {
+						public:
+							inline static size_t Hash(const unsigned long long &key) {
+								unsigned long long h = key ^ (key >> 33);
+								h *= 0xFF51AFD7ED558CCDull;
+								return static_cast<size_t>(h ^ (h >> 33));
+							}
+					};
+					constexpr static size_t NarrowphaseBatch = 256; // the number of contacts handled by one iteration of the pool
+
+					struct Placement { // where the last update left a body
+						Core::Math::Vector2 Offset;
+						double Rotation = 0.0;
+						size_t ID = 0;
+					};
+
+					Core::Collections::List<Body> _bodies;
+					Core::Math::Vector2 _gravity {0.0, -10.0};
+					double _hz = DefaultFrequency, _intv = 0.0, _oohz = 1.0 / DefaultFrequency, _margin = DefaultMargin;
+					size_t _iters = 10, _posIters = 3;
+					bool _sleep = true;
+					Core::ThreadPool *_pool = nullptr;
+
+					Core::Collections::AABBTree _tree; // built from the bounds of all bodies, so that leaf i is body i
+					Core::Collections::List<Core::Math::Rectangle> _bounds; // the exact boxes of the bodies when they were last awake
+					Core::Collections::HashTable<unsigned long long, PairHashFunc> _pairs; // the pairs that have a contact
+					Core::Collections::List<Contact, true> _contacts;
+					Core::Collections::List<Placement, true> _placements; // used to find the bodies changed by hand
+					Core::Collections::List<size_t, true> _moved; // bodies whose boxes have been moved in this update
+					// touching contacts of each body, and the bodies of the island being built
+					Core::Collections::List<size_t, true> _adjStart, _adj, _stack, _islandBodies, _islandContacts;
+					Core::Collections::List<bool, true> _visited;
+					Core::Collections::List<Core::Math::Vector2, true> _centers; // the mass centers of the bodies during position iterations
+
+					static unsigned long long GetPairKey(size_t a, size_t b) {
+						return (static_cast<unsigned long long>(a) << 32) | static_cast<unsigned long long>(b);
+					}
+
+					void DoUpdate();
+					void SyncProxies();
+					bool IsMovedByHand(size_t) const;
+					void UpdateProxy(size_t);
+					void FindNewPairs();
+					void Collide();
+					void SolveIslands();
+					void SolveIsland(size_t, size_t); // solves the last island, the bodies and contacts from the given positions
+
+					// clips the incident edge against the sides of the reference edge, which is the edge of either body that
+					// separates them the most; points that are apart by no more than ContactMargin are kept
+					static void UpdateManifold(const Body&, const Body&, Contact&);
+			};
+		}
+	}
+}
@@ -0,0 +1,387 @@
+#pragma once
+
+#include <cstring>
+
+#include "ObjectAllocator.h"
+#include "Exceptions.h"
+#include "String.h"
+
+namespace DE {
+	namespace Core {
+		// text storage for large, frequently edited documents
+		// a treap of character chunks ordered by position, where removing characters joins the chunks around them that fit
+		// in one; insertions, deletions and operator[] take O(log n + ChunkSize), and GetChunk() reads long runs of characters
+		template <typename Char> class RopeBase {
+			public:
+				constexpr static size_t ChunkSize = 256;
+
+				RopeBase() = default;
+				RopeBase(const Char *str) {
+					Insert(0, str, StringBase<Char>::GetLength(str));
+				}
+				RopeBase(const StringBase<Char> &str) {
+					Insert(0, *str, str.Length());
+				}
+				RopeBase(const RopeBase &src) : _root(CloneTree(src._root)), _seed(src._seed) {
+				}
+				RopeBase &operator =(const RopeBase &src) {
+					if (this != &src) {
+						FreeTree(_root);
+						_root = CloneTree(src._root);
+					}
+					return *this;
+				}
+				RopeBase &operator =(const StringBase<Char> &str) {
+					Clear();
+					Insert(0, *str, str.Length());
+					return *this;
+				}
+				RopeBase &operator =(const Char *str) {
+					Clear();
+					Insert(0, str, StringBase<Char>::GetLength(str));
+					return *this;
+				}
+				~RopeBase() {
+					FreeTree(_root);
+				}
+
+				RopeBase &operator +=(const StringBase<Char> &str) {
+					Insert(Length(), *str, str.Length());
+					return *this;
+				}
+				RopeBase &operator +=(const Char *str) {
+					Insert(Length(), str, StringBase<Char>::GetLength(str));
+					return *this;
+				}
+				RopeBase &operator +=(Char c) {
+					Insert(Length(), &c, 1);
+					return *this;
+				}
+
+				const Char &At(size_t index) const {
+					if (index >= Length()) {
+						throw OverflowException(_TEXT("index overflow"));
+					}
+					size_t begin;
+					return FindChunk(index, begin)->Chars[index - begin];
+				}
+				const Char &operator [](size_t index) const {
+					return At(index);
+				}
+
+				// the chunk that contains the character at index, for reading long runs of characters
+				const Char *GetChunk(size_t index, size_t &begin, size_t &count) const {
+					if (index >= Length()) {
+						throw OverflowException(_TEXT("index overflow"));
+					}
+					const Node *n = FindChunk(index, begin);
+					count = n->Count;
+					return n->Chars;
+				}
+
+				void Insert(size_t index, Char c) {
+					Insert(index, &c, 1);
+				}
+				void Insert(size_t index, const StringBase<Char> &str) {
+					Insert(index, *str, str.Length());
+				}
+				void Insert(size_t index, const Char *chars) {
+					Insert(index, chars, StringBase<Char>::GetLength(chars));
+				}
+				void Insert(size_t index, const Char *chars, size_t count) {
+					if (index > Length()) {
+						throw OverflowException(_TEXT("index overflow"));
+					}
+					if (count == 0) {
+						return;
+					}
+					if (count <= ChunkSize && InsertIntoChunk(_root, index, chars, count)) {
+						return;
+					}
+					Node *l, *r, *mid = nullptr;
+					Split(_root, index, l, r);
+					for (size_t i = 0; i < count; i += ChunkSize) {
+						mid = Merge(mid, CreateNode(chars + i, (count - i < ChunkSize ? count - i : ChunkSize), NextPriority()));
+					}
+					_root = Merge(Merge(l, mid), r);
+				}
+				void Remove(size_t index, size_t count = 1) {
+					if (index + count > Length()) {
+						throw OverflowException(_TEXT("index overflow"));
+					}
+					if (count == 0) {
+						return;
+					}
+					if (!RemoveFromChunk(_root, index, count)) {
+						Node *l, *mid, *r;
+						Split(_root, index, l, mid);
+						Split(mid, count, mid, r);
+						FreeTree(mid);
+						_root = Merge(l, r);
+					}
+					if (_root) {
+						JoinChunks(index < Length() ? index : index - 1);
+					}
+				}
+				void Clear() {
+					FreeTree(_root);
+					_root = nullptr;
+				}
+
+				size_t Length() const {
+					return _root ? _root->Length : 0;
+				}
+				bool Empty() const {
+					return _root == nullptr;
+				}
+
+				StringBase<Char> SubString(size_t start) const {
+					if (start > Length()) {
+						throw OverflowException(_TEXT("index overflow"));
+					}
+					return SubString(start, Length() - start);
+				}
+				StringBase<Char> SubString(size_t start, size_t count) const {
+					if (start + count > Length()) {
+						throw OverflowException(_TEXT("index overflow"));
+					}
+					if (count == 0) {
+						return StringBase<Char>();
+					}
+					StringBase<Char> res(static_cast<Char>(0), count);
+					CopyRange(_root, start, count, *res);
+					return res;
+				}
+				StringBase<Char> ToString() const {
+					return SubString(0, Length());
+				}
+
+				friend bool operator ==(const RopeBase &lhs, const StringBase<Char> &rhs) {
+					return lhs.Length() == rhs.Length() && lhs.ToString() == rhs;
+				}
+				friend bool operator ==(const StringBase<Char> &lhs, const RopeBase &rhs) {
+					return rhs == lhs;
+				}
+				friend bool operator !=(const RopeBase &lhs, const StringBase<Char> &rhs) {
+					return !(lhs == rhs);
+				}
+				friend bool operator !=(const StringBase<Char> &lhs, const RopeBase &rhs) {
+					return !(rhs == lhs);
+				}
+			protected:
+				struct Node {
+					Node *Left = nullptr, *Right = nullptr;
+					size_t Length = 0; // of the whole subtree
+					size_t Count = 0; // of this node only
+					unsigned Priority = 0;
+					Char Chars[ChunkSize];
+				};
+
+				Node *_root = nullptr;
+				unsigned _seed = 2463534242u;
+
+				unsigned NextPriority() { // xorshift
+					_seed ^= _seed << 13;
+					_seed ^= _seed >> 17;
+					_seed ^= _seed << 5;
+					return _seed;
+				}
+
+				inline static size_t LengthOf(const Node *n) {
+					return n ? n->Length : 0;
+				}
+				inline static void Update(Node *n) {
+					n->Length = LengthOf(n->Left) + n->Count + LengthOf(n->Right);
+				}
+
+				static Node *CreateNode(const Char *chars, size_t count, unsigned priority) {
+					Node *n = new (GlobalAllocator::Allocate(sizeof(Node))) Node();
+					memcpy(n->Chars, chars, sizeof(Char) * count);
+					n->Count = count;
+					n->Priority = priority;
+					Update(n);
+					return n;
+				}
+				static void FreeTree(Node *n) {
+					if (n) {
+						FreeTree(n->Left);
+						FreeTree(n->Right);
+						n->~Node();
+						GlobalAllocator::Free(n);
+					}
+				}
+				static Node *CloneTree(const Node *n) {
+					if (!n) {
+						return nullptr;
+					}
+					Node *res = new (GlobalAllocator::Allocate(sizeof(Node))) Node(*n);
+					res->Left = CloneTree(n->Left);
+					res->Right = CloneTree(n->Right);
+					return res;
+				}
+
+				static Node *Merge(Node *l, Node *r) {
+					if (!l) {
+						return r;
+					}
+					if (!r) {
+						return l;
+					}
+					if (l->Priority > r->Priority) {
+						l->Right = Merge(l->Right, r);
+						Update(l);
+						return l;
+					}
+					r->Left = Merge(l, r->Left);
+					Update(r);
+					return r;
+				}
+				// splits the first pos characters from the rest, cutting the chunk that contains pos if necessary
+				static void Split(Node *n, size_t pos, Node *&l, Node *&r) {
+					if (!n) {
+						l = r = nullptr;
+						return;
+					}
+					size_t ll = LengthOf(n->Left);
+					if (pos <= ll) {
+						Split(n->Left, pos, l, n->Left);
+						Update(n);
+						r = n;
+					} else if (pos >= ll + n->Count) {
+						Split(n->Right, pos - ll - n->Count, n->Right, r);
+						Update(n);
+						l = n;
+					} else { // the tail of the chunk takes n's place in the right tree
+						size_t off = pos - ll;
+						Node *tail = CreateNode(n->Chars + off, n->Count - off, n->Priority);
+						tail->Right = n->Right;
+						n->Right = nullptr;
+						n->Count = off;
+						Update(n);
+						Update(tail);
+						l = n;
+						r = tail;
+					}
+				}
+
+				// fast paths that only touch one chunk, return false without changing anything if that's not possible
+				static bool InsertIntoChunk(Node *n, size_t pos, const Char *chars, size_t count) {
+					if (!n) {
+						return false;
+					}
+					size_t ll = LengthOf(n->Left);
+					if (pos < ll || (pos == ll && n->Left && n->Count + count > ChunkSize)) {
+						if (!InsertIntoChunk(n->Left, pos, chars, count)) {
+							return false;
+						}
+					} else if (pos > ll + n->Count) {
+						if (!InsertIntoChunk(n->Right, pos - ll - n->Count, chars, count)) {
+							return false;
+						}
+					} else {
+						if (n->Count + count > ChunkSize) {
+							return false;
+						}
+						size_t off = pos - ll;
+						memmove(n->Chars + off + count, n->Chars + off, sizeof(Char) * (n->Count - off));
+						memcpy(n->Chars + off, chars, sizeof(Char) * count);
+						n->Count += count;
+					}
+					Update(n);
+					return true;
+				}
+				static bool RemoveFromChunk(Node *n, size_t pos, size_t count) {
+					if (!n) {
+						return false;
+					}
+					size_t ll = LengthOf(n->Left);
+					if (pos < ll) {
+						if (!RemoveFromChunk(n->Left, pos, count)) {
+							return false;
+						}
+					} else if (pos >= ll + n->Count) {
+						if (!RemoveFromChunk(n->Right, pos - ll - n->Count, count)) {
+							return false;
+						}
+					} else {
+						size_t off = pos - ll;
+						if (off + count > n->Count || count == n->Count) { // spans several chunks, or would leave an empty one
+							return false;
+						}
+						memmove(n->Chars + off, n->Chars + off + count, sizeof(Char) * (n->Count - off - count));
+						n->Count -= count;
+					}
+					Update(n);
+					return true;
+				}
+
+				// joins the chunk that contains index with the chunks next to it, as long as they fit in one
+				void JoinChunks(size_t index) {
+					size_t begin, otherBegin;
+					const Node *n = FindChunk(index, begin);
+					if (begin > 0) {
+						const Node *prev = FindChunk(begin - 1, otherBegin);
+						if (prev->Count + n->Count <= ChunkSize) {
+							JoinRange(otherBegin, prev->Count + n->Count);
+							n = FindChunk(otherBegin, begin);
+						}
+					}
+					if (begin + n->Count < Length()) {
+						const Node *next = FindChunk(begin + n->Count, otherBegin);
+						if (n->Count + next->Count <= ChunkSize) {
+							JoinRange(begin, n->Count + next->Count);
+						}
+					}
+				}
+				// replaces the chunks that make up the range with one, which the range must fit in
+				void JoinRange(size_t begin, size_t count) {
+					Node *l, *mid, *r;
+					Split(_root, begin, l, mid);
+					Split(mid, count, mid, r);
+					Char chars[ChunkSize];
+					CopyRange(mid, 0, count, chars);
+					FreeTree(mid);
+					_root = Merge(Merge(l, CreateNode(chars, count, NextPriority())), r);
+				}
+
+				const Node *FindChunk(size_t index, size_t &begin) const {
+					begin = 0;
+					for (const Node *n = _root; ; ) {
+						size_t ll = LengthOf(n->Left);
+						if (index < ll) {
+							n = n->Left;
+						} else if (index < ll + n->Count) {
+							begin += ll;
+							return n;
+						} else {
+							begin += ll + n->Count;
+							index -= ll + n->Count;
+							n = n->Right;
+						}
+					}
+				}
+				static void CopyRange(const Node *n, size_t start, size_t count, Char *dst) {
+					if (!n || count == 0) {
+						return;
+					}
+					size_t ll = LengthOf(n->Left);
+					if (start < ll) {
+						size_t c = Math::Min(count, ll - start);
+						CopyRange(n->Left, start, c, dst);
+						dst += c;
+						count -= c;
+						start = ll;
+					}
+					if (count > 0 && start < ll + n->Count) {
+						size_t off = start - ll, c = Math::Min(count, n->Count - off);
+						memcpy(dst, n->Chars + off, sizeof(Char) * c);
+						dst += c;
+						count -= c;
+						start = ll + n->Count;
+					}
+					CopyRange(n->Right, start - ll - n->Count, count, dst);
+				}
+		};
+		typedef RopeBase<TCHAR> Rope;
+	}
+}
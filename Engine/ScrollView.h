@@ -183,6 +183,11 @@ namespace DE {
 					}
 				}
 
+				// the child is clipped, and the scroll bars are inside
+				virtual Core::Math::Rectangle GetVisualBounds() const override {
+					return _actualLayout;
+				}
+
 				virtual void Render(Graphics::Renderer &r) override {
 					Control::Render(r);
 					Control *c = GetChild();
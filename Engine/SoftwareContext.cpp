@@ -0,0 +1,815 @@
+#include "SoftwareContext.h"
+
+#include <algorithm>
+
+namespace DE {
+	namespace Graphics {
+		namespace RenderingContexts {
+			using namespace Core;
+			using namespace Core::Math;
+			using namespace Core::Collections;
+
+			const int _SubPixelBits = 8, _SubPixelOne = 1 << _SubPixelBits;
+			const double _GuardBand = 1 << 19; // keeps the fixed point edge functions from overflowing
+
+			inline long long _FloorDivide(long long a, long long b) { // b > 0
+				return a >= 0 ? a / b : -((-a + b - 1) / b);
+			}
+			inline float _Clamp01(float v) {
+				return v < 0.0f ? 0.0f : (v > 1.0f ? 1.0f : v);
+			}
+
+			SoftwareContext::SoftwareContext(size_t width, size_t height, ThreadPool *pool) :
+				_pool(pool ? *pool : ThreadPool::Default())
+			{
+				SetSize(width, height);
+			}
+			SoftwareContext::~SoftwareContext() {
+				for (size_t i = 0; i < _images.Count(); ++i) {
+					if (_images[i]) {
+						FreeImage(*_images[i]);
+						_images[i]->~Image();
+						GlobalAllocator::Free(_images[i]);
+					}
+				}
+				FreeImage(_screen);
+			}
+
+			void SoftwareContext::Begin() {
+				BackToDefaultFrameBuffer();
+				Flush(); // the target may be the same one, which SwitchTarget() doesn't flush
+				ClearTarget(true, _back, true);
+			}
+			void SoftwareContext::ClearStencil() {
+				Flush();
+				ClearTarget(false, Color(), true);
+			}
+
+			void SoftwareContext::SetSize(size_t width, size_t height) {
+				if (width == 0 || height == 0) {
+					throw InvalidArgumentException(_TEXT("the size is invalid"));
+				}
+				Flush();
+				FreeImage(_screen);
+				AllocateImage(_screen, width, height, true);
+				_vp = Rectangle(0.0, 0.0, width, height);
+			}
+
+			size_t SoftwareContext::CreateImage(size_t width, size_t height, bool stencil) {
+				Image *img = new (GlobalAllocator::Allocate(sizeof(Image))) Image();
+				AllocateImage(*img, width, height, stencil);
+				if (_freeImages.Count() > 0) {
+					size_t id = _freeImages.PopBack();
+					_images[id] = img;
+					return id + 1;
+				}
+				_images.PushBack(img);
+				return _images.Count();
+			}
+			void SoftwareContext::DeleteImage(size_t id) {
+				Image &img = GetImage(id);
+				Flush();
+				if (_bound == id) {
+					_bound = 0;
+					_stateChanged = true;
+				}
+				FreeImage(img);
+				img.~Image();
+				GlobalAllocator::Free(&img);
+				_images[id - 1] = nullptr;
+				_freeImages.PushBack(id - 1);
+			}
+			void SoftwareContext::AllocateImage(Image &img, size_t width, size_t height, bool stencil) {
+				img.Width = width;
+				img.Height = height;
+				img.Pixels = static_cast<Color*>(GlobalAllocator::Allocate(sizeof(Color) * width * height));
+				std::fill_n(img.Pixels, width * height, Color(0, 0, 0, 0));
+				if (stencil) {
+					img.Stencil = static_cast<unsigned char*>(GlobalAllocator::Allocate(width * height));
+					std::memset(img.Stencil, 0, width * height);
+				}
+			}
+			void SoftwareContext::FreeImage(Image &img) {
+				if (img.Pixels) {
+					GlobalAllocator::Free(img.Pixels);
+					img.Pixels = nullptr;
+				}
+				if (img.Stencil) {
+					GlobalAllocator::Free(img.Stencil);
+					img.Stencil = nullptr;
+				}
+				img.Width = img.Height = 0;
+			}
+
+			TextureID SoftwareContext::LoadTextureFromPixels(const Color *pixels, size_t width, size_t height) {
+				if (width == 0 || height == 0 || pixels == nullptr) {
+					throw InvalidArgumentException(_TEXT("the image is invalid"));
+				}
+				TextureID id;
+				id._id.SoftwareID = CreateImage(width, height, false);
+				std::memcpy(GetImage(id._id.SoftwareID).Pixels, pixels, sizeof(Color) * width * height);
+				return id;
+			}
+			void SoftwareContext::DeleteTexture(TextureID id) {
+				DeleteImage(id._id.SoftwareID);
+			}
+
+			FrameBuffer SoftwareContext::CreateFrameBuffer(const Rectangle &rect) {
+				FrameBuffer fbi;
+				fbi.Region = rect;
+				size_t
+					w = static_cast<size_t>(rect.Width() > 1.0 ? rect.Width() : 1.0),
+					h = static_cast<size_t>(rect.Height() > 1.0 ? rect.Height() : 1.0);
+				fbi.BufferID._id.SoftwareID = fbi.TextureID._id.SoftwareID = CreateImage(w, h, true);
+				Image &img = GetImage(fbi.TextureID._id.SoftwareID);
+				img.HorizontalWrap = img.VerticalWrap = TextureWrap::RepeatBorder;
+				return fbi;
+			}
+			void SoftwareContext::BeginFrameBuffer(const FrameBuffer &buf) {
+				if (buf.BufferID._id.SoftwareID == 0) {
+					BackToDefaultFrameBuffer();
+					return;
+				}
+				SwitchTarget(&GetImage(buf.BufferID._id.SoftwareID));
+				Flush();
+				ClearTarget(true, Color(0, 0, 0, 0), true);
+			}
+			void SoftwareContext::ContinueFrameBuffer(const FrameBuffer &buf) {
+				if (buf.BufferID._id.SoftwareID == 0) {
+					BackToDefaultFrameBuffer();
+					return;
+				}
+				SwitchTarget(&GetImage(buf.BufferID._id.SoftwareID));
+			}
+			void SoftwareContext::BackToDefaultFrameBuffer() {
+				SwitchTarget(&_screen);
+			}
+			void SoftwareContext::DeleteFrameBuffer(const FrameBuffer &buf) {
+				if (_target == &GetImage(buf.BufferID._id.SoftwareID)) {
+					BackToDefaultFrameBuffer();
+				}
+				DeleteImage(buf.BufferID._id.SoftwareID);
+			}
+			void SoftwareContext::SwitchTarget(Image *target) {
+				if (target != _target) {
+					Flush();
+					_target = target;
+				}
+			}
+
+			void SoftwareContext::SetRectangularClip(const Rectangle &rect) { // in pixels of the target, like glScissor
+				_clipped = true;
+				_clipLeft = static_cast<int>(std::floor(rect.Left));
+				_clipTop = static_cast<int>(std::floor(rect.Top));
+				_clipRight = static_cast<int>(std::ceil(rect.Right));
+				_clipBottom = static_cast<int>(std::ceil(rect.Bottom));
+			}
+			void SoftwareContext::ClearTarget(bool clearColor, const Color &color, bool clearStencil) { // respects the clip, like glClear
+				int
+					left = 0, top = 0,
+					right = static_cast<int>(_target->Width), bottom = static_cast<int>(_target->Height);
+				if (_clipped) {
+					left = Max(left, _clipLeft);
+					top = Max(top, _clipTop);
+					right = Min(right, _clipRight);
+					bottom = Min(bottom, _clipBottom);
+				}
+				for (int y = top; y < bottom; ++y) {
+					size_t row = y * _target->Width;
+					if (clearColor) {
+						for (Color *cur = _target->Pixels + row + left, *end = _target->Pixels + row + right; cur < end; ++cur) {
+							*cur = color;
+						}
+					}
+					if (clearStencil && _target->Stencil && right > left) {
+						std::memset(_target->Stencil + row + left, _clearStencil, right - left);
+					}
+				}
+			}
+
+			void SoftwareContext::DrawVertices(const Vertex *vs, size_t count, RenderMode mode) {
+				if (count == 0) {
+					return;
+				}
+				if (vs == nullptr) {
+					throw InvalidArgumentException(_TEXT("the vertex list is null"));
+				}
+				PrepareDraw();
+				List<PixelVertex, true> pvs;
+				for (size_t i = 0; i < count; ++i) {
+					pvs.PushBack(TransformVertex(vs[i].Position, vs[i].Color, vs[i].UV));
+				}
+				SubmitPrimitives(*pvs, count, mode);
+			}
+			void SoftwareContext::DrawVertices(const Vector2 *poss, const Color *clrs, const Vector2 *uvs, size_t count, RenderMode mode) {
+				if (count == 0) {
+					return;
+				}
+				if (poss == nullptr) {
+					throw InvalidArgumentException(_TEXT("the vertex list is null"));
+				}
+				PrepareDraw();
+				List<PixelVertex, true> pvs;
+				for (size_t i = 0; i < count; ++i) {
+					pvs.PushBack(TransformVertex(poss[i], clrs ? clrs[i] : Color(), uvs ? uvs[i] : Vector2()));
+				}
+				SubmitPrimitives(*pvs, count, mode);
+			}
+			void SoftwareContext::PrepareDraw() {
+				if (_stateChanged) {
+					_state.Texture = (_bound ? &GetImage(_bound) : nullptr);
+					if (_state.Texture) {
+						_state.HorizontalWrap = _state.Texture->HorizontalWrap;
+						_state.VerticalWrap = _state.Texture->VerticalWrap;
+					}
+					_states.PushBack(_state);
+					_stateChanged = false;
+				}
+				// maps the viewbox onto the viewport, or onto the whole frame buffer
+				Rectangle vp = (_target == &_screen ? _vp : Rectangle(0.0, 0.0, _target->Width, _target->Height));
+				_scaleX = vp.Width() / _vbox.Width();
+				_scaleY = vp.Height() / _vbox.Height();
+				_offsetX = vp.Left - _vbox.Left * _scaleX;
+				_offsetY = vp.Top - _vbox.Top * _scaleY;
+			}
+			SoftwareContext::PixelVertex SoftwareContext::TransformVertex(const Vector2 &pos, const Color &c, const Vector2 &uv) const {
+				PixelVertex v;
+				v.X = Clamp(pos.X * _scaleX + _offsetX, -_GuardBand, _GuardBand);
+				v.Y = Clamp(pos.Y * _scaleY + _offsetY, -_GuardBand, _GuardBand);
+				v.Attributes[0] = c.R / 255.0f;
+				v.Attributes[1] = c.G / 255.0f;
+				v.Attributes[2] = c.B / 255.0f;
+				v.Attributes[3] = c.A / 255.0f;
+				v.Attributes[4] = static_cast<float>(uv.X);
+				v.Attributes[5] = static_cast<float>(uv.Y);
+				return v;
+			}
+
+			void SoftwareContext::SubmitPrimitives(const PixelVertex *vs, size_t count, RenderMode mode) {
+				switch (mode) {
+					case RenderMode::Triangles: {
+						for (size_t i = 2; i < count; i += 3) {
+							SubmitTriangle(vs[i - 2], vs[i - 1], vs[i]);
+						}
+						break;
+					}
+					case RenderMode::TriangleStrip: {
+						for (size_t i = 2; i < count; ++i) {
+							SubmitTriangle(vs[i - 2], vs[i - 1], vs[i]);
+						}
+						break;
+					}
+					case RenderMode::TriangleFan: {
+						for (size_t i = 2; i < count; ++i) {
+							SubmitTriangle(vs[0], vs[i - 1], vs[i]);
+						}
+						break;
+					}
+					case RenderMode::Lines: {
+						for (size_t i = 1; i < count; i += 2) {
+							SubmitLine(vs[i - 1], vs[i]);
+						}
+						break;
+					}
+					case RenderMode::LineStrip: {
+						for (size_t i = 1; i < count; ++i) {
+							SubmitLine(vs[i - 1], vs[i]);
+						}
+						break;
+					}
+					case RenderMode::Points: {
+						for (size_t i = 0; i < count; ++i) {
+							SubmitPoint(vs[i]);
+						}
+						break;
+					}
+				}
+			}
+			void SoftwareContext::SubmitLine(const PixelVertex &p1, const PixelVertex &p2) { // a quad that's _lineWidth pixels wide
+				double ddx = p2.X - p1.X, ddy = p2.Y - p1.Y, len = std::sqrt(ddx * ddx + ddy * ddy);
+				if (len <= 0.0) {
+					return;
+				}
+				double hw = 0.5 * (_lineWidth > 1.0 ? _lineWidth : 1.0) / len, nx = -ddy * hw, ny = ddx * hw;
+				PixelVertex a = p1, b = p1, c = p2, d = p2;
+				a.X += nx;
+				a.Y += ny;
+				b.X -= nx;
+				b.Y -= ny;
+				c.X += nx;
+				c.Y += ny;
+				d.X -= nx;
+				d.Y -= ny;
+				SubmitTriangle(a, b, c);
+				SubmitTriangle(b, d, c);
+			}
+			void SoftwareContext::SubmitPoint(const PixelVertex &p) { // a square that's _pointSize pixels wide
+				double hs = 0.5 * (_pointSize > 1.0 ? _pointSize : 1.0);
+				PixelVertex a = p, b = p, c = p, d = p;
+				a.X -= hs;
+				a.Y -= hs;
+				b.X += hs;
+				b.Y -= hs;
+				c.X -= hs;
+				c.Y += hs;
+				d.X += hs;
+				d.Y += hs;
+				SubmitTriangle(a, b, c);
+				SubmitTriangle(b, d, c);
+			}
+			void SoftwareContext::SubmitTriangle(const PixelVertex &v0, const PixelVertex &v1, const PixelVertex &v2) {
+				const PixelVertex *vs[3] {&v0, &v1, &v2};
+				long long fx[3], fy[3];
+				for (size_t i = 0; i < 3; ++i) {
+					fx[i] = std::llround(vs[i]->X * _SubPixelOne);
+					fy[i] = std::llround(vs[i]->Y * _SubPixelOne);
+				}
+				long long area = (fx[1] - fx[0]) * (fy[2] - fy[0]) - (fy[1] - fy[0]) * (fx[2] - fx[0]);
+				if (area == 0) {
+					return;
+				}
+				if (area < 0) { // no culling, just make the winding consistent
+					Swap(vs[1], vs[2]);
+					Swap(fx[1], fx[2]);
+					Swap(fy[1], fy[2]);
+					area = -area;
+				}
+				Triangle tri;
+				// bounds, clipped by the target and the clip rectangle
+				long long
+					minX = Min(fx[0], Min(fx[1], fx[2])), maxX = Max(fx[0], Max(fx[1], fx[2])),
+					minY = Min(fy[0], Min(fy[1], fy[2])), maxY = Max(fy[0], Max(fy[1], fy[2]));
+				tri.MinX = static_cast<int>(_FloorDivide(minX, _SubPixelOne));
+				tri.MinY = static_cast<int>(_FloorDivide(minY, _SubPixelOne));
+				tri.MaxX = static_cast<int>(_FloorDivide(maxX, _SubPixelOne));
+				tri.MaxY = static_cast<int>(_FloorDivide(maxY, _SubPixelOne));
+				int
+					clipL = 0, clipT = 0,
+					clipR = static_cast<int>(_target->Width) - 1, clipB = static_cast<int>(_target->Height) - 1;
+				if (_clipped) {
+					clipL = Max(clipL, _clipLeft);
+					clipT = Max(clipT, _clipTop);
+					clipR = Min(clipR, _clipRight - 1);
+					clipB = Min(clipB, _clipBottom - 1);
+				}
+				tri.MinX = Max(tri.MinX, clipL);
+				tri.MinY = Max(tri.MinY, clipT);
+				tri.MaxX = Min(tri.MaxX, clipR);
+				tri.MaxY = Min(tri.MaxY, clipB);
+				if (tri.MinX > tri.MaxX || tri.MinY > tri.MaxY) {
+					return;
+				}
+				// edge i goes from vertex i to vertex i + 1, and is positive on the side of the remaining vertex
+				// exactly one of two triangles sharing an edge sees it as a top-left edge, which keeps shared edges
+				// from being drawn twice
+				for (size_t i = 0; i < 3; ++i) {
+					size_t j = (i + 1) % 3;
+					tri.EdgeA[i] = fy[i] - fy[j];
+					tri.EdgeB[i] = fx[j] - fx[i];
+					tri.EdgeC[i] = -(tri.EdgeA[i] * fx[i] + tri.EdgeB[i] * fy[i]);
+					bool topLeft = tri.EdgeA[i] > 0 || (tri.EdgeA[i] == 0 && tri.EdgeB[i] < 0);
+					tri.EdgeBias[i] = (topLeft ? 0 : -1);
+				}
+				// attribute planes in pixel units, from the snapped positions
+				double
+					x0 = fx[0] / static_cast<double>(_SubPixelOne), y0 = fy[0] / static_cast<double>(_SubPixelOne),
+					x1 = fx[1] / static_cast<double>(_SubPixelOne) - x0, y1 = fy[1] / static_cast<double>(_SubPixelOne) - y0,
+					x2 = fx[2] / static_cast<double>(_SubPixelOne) - x0, y2 = fy[2] / static_cast<double>(_SubPixelOne) - y0,
+					invArea = 1.0 / (x1 * y2 - x2 * y1);
+				for (size_t i = 0; i < Triangle::AttributeCount; ++i) {
+					double
+						a0 = vs[0]->Attributes[i],
+						a1 = vs[1]->Attributes[i] - a0, a2 = vs[2]->Attributes[i] - a0,
+						ddx = (a1 * y2 - a2 * y1) * invArea, ddy = (a2 * x1 - a1 * x2) * invArea;
+					tri.Attributes[i][0] = static_cast<float>(a0 - ddx * x0 - ddy * y0);
+					tri.Attributes[i][1] = static_cast<float>(ddx);
+					tri.Attributes[i][2] = static_cast<float>(ddy);
+				}
+				tri.State = _states.Count() - 1;
+				_tris.PushBack(tri);
+			}
+
+			void SoftwareContext::Flush() {
+				if (_tris.Count() == 0) {
+					return;
+				}
+				// bin the triangles into tiles, counting first so that all bins share one array
+				_tilesX = (_target->Width + TileSize - 1) / TileSize;
+				_tilesY = (_target->Height + TileSize - 1) / TileSize;
+				size_t tileCount = _tilesX * _tilesY, usedTiles = 0;
+				_binStarts = List<size_t, true>(0, tileCount + 1);
+				size_t *starts = *_binStarts;
+				const Triangle *tris = *_tris;
+				for (size_t i = 0; i < _tris.Count(); ++i) {
+					for (size_t ty = tris[i].MinY / TileSize; ty <= tris[i].MaxY / TileSize; ++ty) {
+						for (size_t tx = tris[i].MinX / TileSize; tx <= tris[i].MaxX / TileSize; ++tx) {
+							++starts[ty * _tilesX + tx + 1];
+						}
+					}
+				}
+				for (size_t i = 1; i <= tileCount; ++i) {
+					usedTiles += (starts[i] > 0 ? 1 : 0);
+					starts[i] += starts[i - 1];
+				}
+				List<size_t, true> fill = _binStarts.SubSequence(0, tileCount);
+				_binTris = List<size_t, true>(0, starts[tileCount]);
+				size_t *binTris = *_binTris, *fillPtr = *fill;
+				for (size_t i = 0; i < _tris.Count(); ++i) {
+					for (size_t ty = tris[i].MinY / TileSize; ty <= tris[i].MaxY / TileSize; ++ty) {
+						for (size_t tx = tris[i].MinX / TileSize; tx <= tris[i].MaxX / TileSize; ++tx) {
+							binTris[fillPtr[ty * _tilesX + tx]++] = i;
+						}
+					}
+				}
+				// rasterize, on this thread alone if there's too little work to share
+				if (_pool.GetThreadCount() == 1 || usedTiles < 2) {
+					for (size_t i = 0; i < tileCount; ++i) {
+						RasterizeTile(i);
+					}
+				} else {
+					_pool.ParallelFor(tileCount, [this](size_t tile) {
+						RasterizeTile(tile);
+					});
+				}
+				_tris.Clear();
+				_binStarts.Clear();
+				_binTris.Clear();
+				_states.Clear();
+				_stateChanged = true;
+			}
+			inline float _GetBlendFactor(BlendFactor f, float src, float srcA, float dst, float dstA) {
+				switch (f) {
+					case BlendFactor::Zero: {
+						return 0.0f;
+					}
+					case BlendFactor::One: {
+						return 1.0f;
+					}
+					case BlendFactor::SourceAlpha: {
+						return srcA;
+					}
+					case BlendFactor::TargetAlpha: {
+						return dstA;
+					}
+					case BlendFactor::InvertedSourceAlpha: {
+						return 1.0f - srcA;
+					}
+					case BlendFactor::InvertedTargetAlpha: {
+						return 1.0f - dstA;
+					}
+					case BlendFactor::SourceColor: {
+						return src;
+					}
+					case BlendFactor::TargetColor: {
+						return dst;
+					}
+					case BlendFactor::InvertedSourceColor: {
+						return 1.0f - src;
+					}
+					case BlendFactor::InvertedTargetColor: {
+						return 1.0f - dst;
+					}
+				}
+				return 0.0f;
+			}
+			inline bool _StencilTest(StencilComparisonFunction func, unsigned char ref, unsigned char val) {
+				switch (func) {
+					case StencilComparisonFunction::Never: {
+						return false;
+					}
+					case StencilComparisonFunction::Always: {
+						return true;
+					}
+					case StencilComparisonFunction::Equal: {
+						return ref == val;
+					}
+					case StencilComparisonFunction::NotEqual: {
+						return ref != val;
+					}
+					case StencilComparisonFunction::Less: {
+						return ref < val;
+					}
+					case StencilComparisonFunction::LessOrEqual: {
+						return ref <= val;
+					}
+					case StencilComparisonFunction::Greater: {
+						return ref > val;
+					}
+					case StencilComparisonFunction::GreaterOrEqual: {
+						return ref >= val;
+					}
+				}
+				return true;
+			}
+			inline unsigned char _StencilOperate(StencilOperation op, unsigned char ref, unsigned char val) {
+				switch (op) {
+					case StencilOperation::Keep: {
+						return val;
+					}
+					case StencilOperation::Zero: {
+						return 0;
+					}
+					case StencilOperation::Replace: {
+						return ref;
+					}
+					case StencilOperation::ClampedIncrease: {
+						return val == 0xFF ? val : val + 1;
+					}
+					case StencilOperation::ClampedDecrease: {
+						return val == 0 ? val : val - 1;
+					}
+					case StencilOperation::WrappedIncrease: {
+						return static_cast<unsigned char>(val + 1);
+					}
+					case StencilOperation::WrappedDecrease: {
+						return static_cast<unsigned char>(val - 1);
+					}
+					case StencilOperation::BitwiseInvert: {
+						return static_cast<unsigned char>(~val);
+					}
+				}
+				return val;
+			}
+			inline bool _WrapTexel(TextureWrap wrap, long long &v, size_t size) { // false if the border color should be used
+				switch (wrap) {
+					case TextureWrap::Repeat: {
+						v %= static_cast<long long>(size);
+						if (v < 0) {
+							v += size;
+						}
+						return true;
+					}
+					case TextureWrap::RepeatBorder: {
+						v = (v < 0 ? 0 : (v >= static_cast<long long>(size) ? size - 1 : v));
+						return true;
+					}
+					case TextureWrap::None: {
+						return v >= 0 && v < static_cast<long long>(size);
+					}
+				}
+				return false;
+			}
+			inline void _AccumulateTexel(const Color *c, float w, float (&res)[4]) {
+				if (c) {
+					res[0] += c->R * w;
+					res[1] += c->G * w;
+					res[2] += c->B * w;
+					res[3] += c->A * w;
+				}
+			}
+			inline void _SampleTexture(const Color *pixels, size_t width, size_t height, TextureWrap hw, TextureWrap vw, float u, float v, float (&res)[4]) {
+				// bilinear, the border color is transparent black
+				float tx = u * width - 0.5f, ty = v * height - 0.5f, flx = std::floor(tx), fly = std::floor(ty), fx = tx - flx, fy = ty - fly;
+				long long x0 = static_cast<long long>(flx), y0 = static_cast<long long>(fly), x1 = x0 + 1, y1 = y0 + 1;
+				const Color *c00, *c10, *c01, *c11;
+				if (x0 >= 0 && y0 >= 0 && x1 < static_cast<long long>(width) && y1 < static_cast<long long>(height)) { // no wrapping needed
+					c00 = pixels + y0 * width + x0;
+					c10 = c00 + 1;
+					c01 = c00 + width;
+					c11 = c01 + 1;
+				} else {
+					bool hx0 = _WrapTexel(hw, x0, width), hx1 = _WrapTexel(hw, x1, width);
+					bool hy0 = _WrapTexel(vw, y0, height), hy1 = _WrapTexel(vw, y1, height);
+					c00 = (hx0 && hy0 ? pixels + y0 * width + x0 : nullptr);
+					c10 = (hx1 && hy0 ? pixels + y0 * width + x1 : nullptr);
+					c01 = (hx0 && hy1 ? pixels + y1 * width + x0 : nullptr);
+					c11 = (hx1 && hy1 ? pixels + y1 * width + x1 : nullptr);
+				}
+				res[0] = res[1] = res[2] = res[3] = 0.0f;
+				_AccumulateTexel(c00, (1.0f - fx) * (1.0f - fy) * (1.0f / 255.0f), res);
+				_AccumulateTexel(c10, fx * (1.0f - fy) * (1.0f / 255.0f), res);
+				_AccumulateTexel(c01, (1.0f - fx) * fy * (1.0f / 255.0f), res);
+				_AccumulateTexel(c11, fx * fy * (1.0f / 255.0f), res);
+			}
+			inline unsigned char _ToByte(float v) {
+				return static_cast<unsigned char>(_Clamp01(v) * 255.0f + 0.5f);
+			}
+			inline float _ToUnit(unsigned char v) {
+				return v * (1.0f / 255.0f);
+			}
+
+			// the common blend functions get their own branch-free loops so that they can be vectorized
+			template <bool Masked> inline void _BlendSpan(
+				Color *pixels, const float *r, const float *g, const float *b, const float *a,
+				const unsigned char *mask, int count, BlendFactor sf, BlendFactor df
+			) {
+				if (sf == BlendFactor::One && df == BlendFactor::Zero) {
+					for (int x = 0; x < count; ++x) {
+						if (!Masked || mask[x]) {
+							pixels[x] = Color(_ToByte(r[x]), _ToByte(g[x]), _ToByte(b[x]), _ToByte(a[x]));
+						}
+					}
+				} else if (sf == BlendFactor::SourceAlpha && df == BlendFactor::InvertedSourceAlpha) {
+					for (int x = 0; x < count; ++x) {
+						if (!Masked || mask[x]) {
+							float sa = _Clamp01(a[x]), da = 1.0f - sa;
+							Color &p = pixels[x];
+							p = Color(
+								_ToByte(r[x] * sa + _ToUnit(p.R) * da),
+								_ToByte(g[x] * sa + _ToUnit(p.G) * da),
+								_ToByte(b[x] * sa + _ToUnit(p.B) * da),
+								_ToByte(a[x] * sa + _ToUnit(p.A) * da)
+							);
+						}
+					}
+				} else {
+					for (int x = 0; x < count; ++x) {
+						if (!Masked || mask[x]) {
+							Color &p = pixels[x];
+							float
+								src[4] {r[x], g[x], b[x], a[x]},
+								dst[4] {_ToUnit(p.R), _ToUnit(p.G), _ToUnit(p.B), _ToUnit(p.A)}, res[4];
+							for (size_t c = 0; c < 4; ++c) {
+								res[c] =
+									src[c] * _GetBlendFactor(sf, src[c], src[3], dst[c], dst[3]) +
+									dst[c] * _GetBlendFactor(df, src[c], src[3], dst[c], dst[3]);
+							}
+							p = Color(_ToByte(res[0]), _ToByte(res[1]), _ToByte(res[2]), _ToByte(res[3]));
+						}
+					}
+				}
+			}
+
+			void SoftwareContext::RasterizeTile(size_t tile) {
+				const size_t *begin = *_binTris + _binStarts[tile], *end = *_binTris + _binStarts[tile + 1];
+				if (begin == end) {
+					return;
+				}
+				int
+					tileL = static_cast<int>((tile % _tilesX) * TileSize), tileT = static_cast<int>((tile / _tilesX) * TileSize),
+					tileR = Min(tileL + static_cast<int>(TileSize), static_cast<int>(_target->Width)) - 1,
+					tileB = Min(tileT + static_cast<int>(TileSize), static_cast<int>(_target->Height)) - 1;
+				const Triangle *tris = *_tris;
+				const DrawState *states = *_states;
+				float attrs[Triangle::AttributeCount][TileSize]; // one span of interpolated attributes
+				for (const size_t *cur = begin; cur != end; ++cur) {
+					const Triangle &tri = tris[*cur];
+					const DrawState &state = states[tri.State];
+					bool
+						stencil = _target->Stencil && !(
+							state.StencilFunction == StencilComparisonFunction::Always &&
+							state.StencilPass == StencilOperation::Keep
+						);
+					unsigned char sref = state.StencilReference & state.StencilMask;
+					int
+						minX = Max(tri.MinX, tileL), maxX = Min(tri.MaxX, tileR),
+						minY = Max(tri.MinY, tileT), maxY = Min(tri.MaxY, tileB);
+					for (int y = minY; y <= maxY; ++y) {
+						// find the covered span by solving each edge function for x
+						long long py = static_cast<long long>(y) * _SubPixelOne + _SubPixelOne / 2;
+						long long px = static_cast<long long>(minX) * _SubPixelOne + _SubPixelOne / 2;
+						int left = minX, right = maxX;
+						for (size_t i = 0; i < 3 && left <= right; ++i) {
+							long long
+								e = tri.EdgeA[i] * px + tri.EdgeB[i] * py + tri.EdgeC[i] + tri.EdgeBias[i],
+								step = tri.EdgeA[i] * _SubPixelOne;
+							if (step > 0) {
+								if (e < 0) {
+									long long skip = _FloorDivide(-e + step - 1, step);
+									left = static_cast<int>(Max<long long>(left, minX + skip));
+								}
+							} else if (step < 0) {
+								if (e < 0) {
+									right = left - 1;
+								} else {
+									right = static_cast<int>(Min<long long>(right, minX + e / -step));
+								}
+							} else if (e < 0) {
+								right = left - 1;
+							}
+						}
+						if (left > right) {
+							continue;
+						}
+						int count = right - left + 1;
+						float fy = y + 0.5f;
+						for (size_t a = 0, attrCount = (state.Texture ? Triangle::AttributeCount : 4); a < attrCount; ++a) { // vectorizable
+							float base = tri.Attributes[a][0] + tri.Attributes[a][2] * fy, ddx = tri.Attributes[a][1];
+							float *out = attrs[a];
+							for (int x = 0; x < count; ++x) {
+								out[x] = base + ddx * (left + x + 0.5f);
+							}
+						}
+						if (state.Texture) { // modulate the vertex color
+							for (int x = 0; x < count; ++x) {
+								float texel[4];
+								_SampleTexture(
+									state.Texture->Pixels, state.Texture->Width, state.Texture->Height,
+									state.HorizontalWrap, state.VerticalWrap, attrs[4][x], attrs[5][x], texel
+								);
+								for (size_t c = 0; c < 4; ++c) {
+									attrs[c][x] *= texel[c];
+								}
+							}
+						}
+						size_t offset = static_cast<size_t>(y) * _target->Width + left;
+						Color *pixels = _target->Pixels + offset;
+						if (stencil) {
+							unsigned char *sval = _target->Stencil + offset, mask[TileSize];
+							for (int x = 0; x < count; ++x) {
+								bool pass = _StencilTest(state.StencilFunction, sref, sval[x] & state.StencilMask);
+								sval[x] = _StencilOperate(pass ? state.StencilPass : state.StencilFail, state.StencilReference, sval[x]);
+								mask[x] = pass;
+							}
+							_BlendSpan<true>(pixels, attrs[0], attrs[1], attrs[2], attrs[3], mask, count, state.Source, state.Target);
+						} else {
+							_BlendSpan<false>(pixels, attrs[0], attrs[1], attrs[2], attrs[3], nullptr, count, state.Source, state.Target);
+						}
+					}
+				}
+			}
+
+#ifndef DE_HEADLESS
+			// gdiplus interop, bitmaps are 32bpp BGRA
+			TextureID SoftwareContext::LoadTextureFromBitmap(Gdiplus::Bitmap &bmp) {
+				UINT w = bmp.GetWidth(), h = bmp.GetHeight();
+				if (w == 0 || h == 0) {
+					throw InvalidArgumentException(_TEXT("the bitmap is invalid"));
+				}
+				TextureID id;
+				id._id.SoftwareID = CreateImage(w, h, false);
+				SetTextureImage(id, bmp);
+				return id;
+			}
+			void SoftwareContext::SetTextureImage(TextureID id, Gdiplus::Bitmap &bmp) const {
+				const_cast<SoftwareContext*>(this)->Flush();
+				Image &img = GetImage(id._id.SoftwareID);
+				UINT w = bmp.GetWidth(), h = bmp.GetHeight();
+				if (w == 0 || h == 0) {
+					throw InvalidArgumentException(_TEXT("the bitmap is invalid"));
+				}
+				if (w != img.Width || h != img.Height) {
+					TextureWrap hw = img.HorizontalWrap, vw = img.VerticalWrap;
+					bool stencil = (img.Stencil != nullptr);
+					FreeImage(img);
+					AllocateImage(img, w, h, stencil);
+					img.HorizontalWrap = hw;
+					img.VerticalWrap = vw;
+				}
+				Gdiplus::Rect r(0, 0, w, h);
+				Gdiplus::BitmapData data;
+				ZeroMemory(&data, sizeof(data));
+				AssertGDIPlusSuccess(bmp.LockBits(&r, Gdiplus::ImageLockModeRead, PixelFormat32bppARGB, &data), "cannot lock the bitmap");
+				for (size_t y = 0; y < h; ++y) {
+					const unsigned char *src = static_cast<const unsigned char*>(data.Scan0) + static_cast<ptrdiff_t>(y) * data.Stride;
+					Color *dst = img.Pixels + y * w;
+					for (size_t x = 0; x < w; ++x, src += 4, ++dst) {
+						*dst = Color(src[2], src[1], src[0], src[3]);
+					}
+				}
+				AssertGDIPlusSuccess(bmp.UnlockBits(&data), "cannot unlock the bitmap");
+			}
+			Gdiplus::Bitmap *_CreateBitmap(const Color *pixels, size_t stride, size_t w, size_t h) {
+				Gdiplus::Bitmap *bmp = new Gdiplus::Bitmap(w, h, PixelFormat32bppARGB);
+				Gdiplus::Rect r(0, 0, w, h);
+				Gdiplus::BitmapData data;
+				ZeroMemory(&data, sizeof(data));
+				AssertGDIPlusSuccess(bmp->LockBits(&r, Gdiplus::ImageLockModeWrite, PixelFormat32bppARGB, &data), "cannot lock the bitmap");
+				for (size_t y = 0; y < h; ++y) {
+					unsigned char *dst = static_cast<unsigned char*>(data.Scan0) + static_cast<ptrdiff_t>(y) * data.Stride;
+					const Color *src = pixels + y * stride;
+					for (size_t x = 0; x < w; ++x, dst += 4, ++src) {
+						dst[0] = src->B;
+						dst[1] = src->G;
+						dst[2] = src->R;
+						dst[3] = src->A;
+					}
+				}
+				AssertGDIPlusSuccess(bmp->UnlockBits(&data), "cannot unlock the bitmap");
+				return bmp;
+			}
+			Gdiplus::Bitmap *SoftwareContext::GetTextureImage(TextureID id) const {
+				const_cast<SoftwareContext*>(this)->Flush();
+				const Image &img = GetImage(id._id.SoftwareID);
+				return _CreateBitmap(img.Pixels, img.Width, img.Width, img.Height);
+			}
+			Gdiplus::Bitmap *SoftwareContext::GetScreenShot(const Rectangle &region) {
+				Flush();
+				size_t
+					l = static_cast<size_t>(Clamp(region.Left, 0.0, static_cast<double>(_screen.Width))),
+					t = static_cast<size_t>(Clamp(region.Top, 0.0, static_cast<double>(_screen.Height))),
+					r = static_cast<size_t>(Clamp(region.Right, static_cast<double>(l), static_cast<double>(_screen.Width))),
+					b = static_cast<size_t>(Clamp(region.Bottom, static_cast<double>(t), static_cast<double>(_screen.Height)));
+				if (r == l || b == t) {
+					throw InvalidArgumentException(_TEXT("the region is empty"));
+				}
+				return _CreateBitmap(_screen.Pixels + t * _screen.Width + l, _screen.Width, r - l, b - t);
+			}
+#else
+			// there's no gdiplus without a window system, LoadTextureFromPixels(), GetTexturePixels() and GetPixels() take its place
+			TextureID SoftwareContext::LoadTextureFromBitmap(Gdiplus::Bitmap&) {
+				throw InvalidOperationException(_TEXT("gdiplus isn't available in headless builds"));
+			}
+			void SoftwareContext::SetTextureImage(TextureID, Gdiplus::Bitmap&) const {
+				throw InvalidOperationException(_TEXT("gdiplus isn't available in headless builds"));
+			}
+			Gdiplus::Bitmap *SoftwareContext::GetTextureImage(TextureID) const {
+				throw InvalidOperationException(_TEXT("gdiplus isn't available in headless builds"));
+			}
+			Gdiplus::Bitmap *SoftwareContext::GetScreenShot(const Rectangle&) {
+				throw InvalidOperationException(_TEXT("gdiplus isn't available in headless builds"));
+			}
+#endif
+		}
+	}
+}
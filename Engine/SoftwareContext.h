@@ -0,0 +1,235 @@
+#pragma once
+
+#include "Renderer.h"
+#include "ThreadPool.h"
+
+namespace DE {
+	namespace Graphics {
+		namespace RenderingContexts {
+			// renders into an in-memory RGBA buffer on the cpu, no window or gpu needed
+			// triangles are set up and queued together with the state they're drawn with, and are rasterized
+			// in square tiles when the queue is flushed; tiles are distributed over the threads of a ThreadPool,
+			// and within each tile the triangles are drawn in submission order, so the results are deterministic
+			// the queue is flushed automatically when the render target changes or pixels are read back
+			class SoftwareContext : public RenderingContext {
+				public:
+					constexpr static size_t TileSize = 64;
+
+					// the tiles are rasterized on the threads of the pool, ThreadPool::Default() if none is given
+					SoftwareContext(size_t width, size_t height, Core::ThreadPool *pool = nullptr);
+					virtual ~SoftwareContext();
+
+					virtual Renderer CreateRenderer() override {
+						return Renderer(this);
+					}
+
+					virtual void Begin() override;
+					virtual void End() override {
+						Flush();
+					}
+
+					virtual void SetViewport(const Core::Math::Rectangle &vp) override {
+						_vp = vp;
+					}
+
+					virtual void SetViewbox(const Core::Math::Rectangle &box) override {
+						_vbox = box;
+					}
+					virtual void SetBackground(const Core::Color &color) override {
+						_back = color;
+					}
+					virtual Core::Color GetBackground() const override {
+						return _back;
+					}
+					virtual Gdiplus::Bitmap *GetScreenShot(const Core::Math::Rectangle&) override;
+
+					virtual void SetBlendFunction(BlendFactor src, BlendFactor dst) override {
+						_state.Source = src;
+						_state.Target = dst;
+						_stateChanged = true;
+					}
+
+					virtual void SetStencilFunction(StencilComparisonFunction func, unsigned ref, unsigned mask) override {
+						_state.StencilFunction = func;
+						_state.StencilReference = static_cast<unsigned char>(ref);
+						_state.StencilMask = static_cast<unsigned char>(mask);
+						_stateChanged = true;
+					}
+					virtual void SetStencilOperation(StencilOperation fail, StencilOperation, StencilOperation pass) override { // there's no depth buffer
+						_state.StencilFail = fail;
+						_state.StencilPass = pass;
+						_stateChanged = true;
+					}
+					virtual void SetClearStencilValue(unsigned val) override {
+						_clearStencil = static_cast<unsigned char>(val);
+					}
+					virtual void ClearStencil() override;
+
+					virtual void SetPointSize(double size) override {
+						_pointSize = size;
+					}
+					virtual double GetPointSize() const override {
+						return _pointSize;
+					}
+					virtual void SetLineWidth(double width) override {
+						_lineWidth = width;
+					}
+					virtual double GetLineWidth() const override {
+						return _lineWidth;
+					}
+
+					virtual TextureID LoadTextureFromBitmap(Gdiplus::Bitmap&) override;
+					virtual void DeleteTexture(TextureID) override;
+					virtual void BindTexture(TextureID id) override {
+						_bound = id._id.SoftwareID;
+						_stateChanged = true;
+					}
+					virtual void UnbindTexture() override {
+						_bound = 0;
+						_stateChanged = true;
+					}
+					virtual TextureID GetBoundTexture() const override {
+						TextureID id;
+						id._id.SoftwareID = _bound;
+						return id;
+					}
+					virtual double GetTextureHeight(TextureID id) const override {
+						return GetImage(id._id.SoftwareID).Height;
+					}
+					virtual double GetTextureWidth(TextureID id) const override {
+						return GetImage(id._id.SoftwareID).Width;
+					}
+					virtual TextureWrap GetHorizontalTextureWrap() const override {
+						return _bound ? GetImage(_bound).HorizontalWrap : TextureWrap::None;
+					}
+					virtual void SetHorizontalTextureWrap(TextureWrap wrap) override {
+						if (_bound) {
+							GetImage(_bound).HorizontalWrap = wrap;
+							_stateChanged = true;
+						}
+					}
+					virtual TextureWrap GetVerticalTextureWrap() const override {
+						return _bound ? GetImage(_bound).VerticalWrap : TextureWrap::None;
+					}
+					virtual void SetVerticalTextureWrap(TextureWrap wrap) override {
+						if (_bound) {
+							GetImage(_bound).VerticalWrap = wrap;
+							_stateChanged = true;
+						}
+					}
+					virtual Gdiplus::Bitmap *GetTextureImage(TextureID) const override;
+					virtual void SetTextureImage(TextureID, Gdiplus::Bitmap&) const override;
+
+					virtual FrameBuffer CreateFrameBuffer(const Core::Math::Rectangle&) override;
+					virtual void BeginFrameBuffer(const FrameBuffer&) override;
+					virtual void ContinueFrameBuffer(const FrameBuffer&) override;
+					virtual void BackToDefaultFrameBuffer() override;
+					virtual void DeleteFrameBuffer(const FrameBuffer&) override;
+
+					virtual void DrawVertices(const Vertex*, size_t, RenderMode) override;
+					virtual void DrawVertices(const Core::Math::Vector2*, const Core::Color*, const Core::Math::Vector2*, size_t, RenderMode) override;
+
+					// software-specific functions, these don't depend on gdiplus
+					void Flush(); // rasterizes all queued triangles
+					void SetSize(size_t, size_t); // resizes the default buffer, its content is lost
+					size_t GetWidth() const {
+						return _screen.Width;
+					}
+					size_t GetHeight() const {
+						return _screen.Height;
+					}
+					size_t GetThreadCount() const {
+						return _pool.GetThreadCount();
+					}
+					const Core::Color *GetPixels() { // row-major, top row first
+						Flush();
+						return _screen.Pixels;
+					}
+					TextureID LoadTextureFromPixels(const Core::Color*, size_t, size_t);
+					const Core::Color *GetTexturePixels(TextureID id) {
+						Flush();
+						return GetImage(id._id.SoftwareID).Pixels;
+					}
+				protected:
+					struct Image {
+						size_t Width = 0, Height = 0;
+						Core::Color *Pixels = nullptr;
+						unsigned char *Stencil = nullptr; // only for render targets
+						TextureWrap HorizontalWrap = TextureWrap::Repeat, VerticalWrap = TextureWrap::Repeat;
+					};
+					struct DrawState {
+						const Image *Texture = nullptr;
+						TextureWrap HorizontalWrap = TextureWrap::None, VerticalWrap = TextureWrap::None;
+						BlendFactor Source = BlendFactor::SourceAlpha, Target = BlendFactor::InvertedSourceAlpha;
+						StencilComparisonFunction StencilFunction = StencilComparisonFunction::Always;
+						unsigned char StencilReference = 0, StencilMask = 0xFF;
+						StencilOperation StencilFail = StencilOperation::Keep, StencilPass = StencilOperation::Keep;
+					};
+					struct PixelVertex { // in pixels of the current target
+						double X, Y;
+						float Attributes[6]; // r, g, b, a, u, v
+					};
+					struct Triangle {
+						constexpr static size_t AttributeCount = 6;
+
+						int MinX, MinY, MaxX, MaxY; // inclusive, already clipped
+						// edge functions in fixed point, non-negative inside after adding the bias
+						long long EdgeA[3], EdgeB[3], EdgeC[3], EdgeBias[3];
+						// attribute planes, value = [0] + [1] * x + [2] * y at pixel centers
+						float Attributes[AttributeCount][3];
+						size_t State;
+					};
+
+					virtual void SetRectangularClip(const Core::Math::Rectangle&) override;
+					virtual void ClearClip() override {
+						_clipped = false;
+					}
+
+					Image &GetImage(size_t id) const {
+						if (id == 0 || id > _images.Count() || _images[id - 1] == nullptr) {
+							throw Core::InvalidArgumentException(_TEXT("invalid texture"));
+						}
+						return *_images[id - 1];
+					}
+					size_t CreateImage(size_t, size_t, bool);
+					void DeleteImage(size_t);
+					static void AllocateImage(Image&, size_t, size_t, bool);
+					static void FreeImage(Image&);
+
+					void ClearTarget(bool, const Core::Color&, bool);
+					void SwitchTarget(Image*);
+
+					void PrepareDraw();
+					PixelVertex TransformVertex(const Core::Math::Vector2&, const Core::Color&, const Core::Math::Vector2&) const;
+					void SubmitTriangle(const PixelVertex&, const PixelVertex&, const PixelVertex&);
+					void SubmitLine(const PixelVertex&, const PixelVertex&);
+					void SubmitPoint(const PixelVertex&);
+					void SubmitPrimitives(const PixelVertex*, size_t, RenderMode);
+
+					void RasterizeTile(size_t);
+				private:
+					Core::ThreadPool &_pool;
+					Image _screen, *_target = &_screen;
+					Core::Collections::List<Image*> _images;
+					Core::Collections::List<size_t> _freeImages;
+
+					Core::Math::Rectangle _vp, _vbox {0.0, 0.0, 1.0, 1.0};
+					double _scaleX = 1.0, _scaleY = 1.0, _offsetX = 0.0, _offsetY = 0.0;
+					Core::Color _back {0, 0, 0, 255};
+					unsigned char _clearStencil = 0;
+					double _pointSize = 1.0, _lineWidth = 1.0;
+					size_t _bound = 0;
+					bool _clipped = false;
+					int _clipLeft = 0, _clipTop = 0, _clipRight = 0, _clipBottom = 0;
+
+					DrawState _state;
+					bool _stateChanged = true;
+					// queued work for the current target
+					Core::Collections::List<DrawState, true> _states;
+					Core::Collections::List<Triangle, true> _tris;
+					Core::Collections::List<size_t, true> _binStarts, _binTris;
+					size_t _tilesX = 0, _tilesY = 0;
+			};
+		}
+	}
+}
@@ -48,6 +48,76 @@ namespace DE {
 				}
 			}
 
+			size_t _FindFirstNotBefore(const LineBreakList &sorted, size_t val) { // index of the first element that's not less than val
+				size_t beg = 0, end = sorted.Count();
+				while (beg < end) {
+					size_t mid = (beg + end) / 2;
+					if (sorted[mid] < val) {
+						beg = mid + 1;
+					} else {
+						end = mid;
+					}
+				}
+				return beg;
+			}
+
+			void _CountLineLength(double length, double &widest, size_t &widestCount) {
+				if (length > widest) {
+					widest = length;
+					widestCount = 1;
+				} else if (length == widest) {
+					++widestCount;
+				}
+			}
+			void _CountLineLengths(const GapList<double> &lengths, double &widest, size_t &widestCount) {
+				widest = 0.0;
+				widestCount = 0;
+				for (size_t i = 0; i < lengths.Count(); ++i) {
+					_CountLineLength(lengths[i], widest, widestCount);
+				}
+			}
+			// replaces count line lengths from line, keeping the widest length up to date
+			// the other lines are only looked at when all the widest ones are gone
+			void _ReplaceLineLengths(
+				GapList<double> &lengths, size_t line, size_t count, const List<double> &newLengths, double &widest, size_t &widestCount
+			) {
+				for (size_t i = line; i < line + count; ++i) {
+					if (lengths[i] == widest) {
+						--widestCount;
+					}
+				}
+				lengths.Replace(line, count, newLengths);
+				for (size_t i = 0; i < newLengths.Count(); ++i) {
+					_CountLineLength(newLengths[i], widest, widestCount);
+				}
+				if (widestCount == 0) {
+					_CountLineLengths(lengths, widest, widestCount);
+				}
+			}
+
+			struct _ContentReader { // caches the chunk of the content that's being read
+				explicit _ContentReader(const Rope &content) : Content(content), Length(content.Length()) {
+				}
+
+				TCHAR operator [](size_t i) {
+					if (i - _begin >= _count) {
+						Fetch(i);
+					}
+					return _chunk[i - _begin];
+				}
+
+				const Rope &Content;
+				const size_t Length;
+			private:
+				const TCHAR *_chunk = nullptr;
+				size_t _begin = 0, _count = 0;
+
+				void Fetch(size_t); // kept out of operator[], which is called for every character
+			};
+			void _ContentReader::Fetch(size_t i) {
+				_chunk = Content.GetChunk(i, _begin, _count);
+			}
+
 			void _AddRectangleToListWithClip(List<Math::Rectangle> &list, const Math::Rectangle &r, const Math::Rectangle &clip, bool useClip) {
 				if (useClip) {
 					Math::Rectangle isect;
@@ -95,30 +165,83 @@ namespace DE {
 				const BasicText &txt,
 				BasicTextFormatCache &cache
 			) {
-#define BASICTEXT_SET_LASTBREAK_TO_CURRENT { lbw = curw; lbid = i; }
-#define BASICTEXT_ON_NEWLINE(WIDTH) { cache.LineLengths.PushBack(WIDTH); if (WIDTH > cache.Size.X) { cache.Size.X = WIDTH; } }
-				cache.LineBreaks.Clear();
+				cache.LineBreaks.Clear(txt.Content.Length());
 				cache.LineLengths.Clear();
 				cache.Size = Vector2();
+				cache.WidestLineCount = 0;
+				cache.Font = txt.Font;
+				cache.Scale = txt.Scale;
+				cache.WrapWidth = txt.LayoutRectangle.Width() - txt.Padding.Width();
+				cache.WrapType = txt.WrapType;
 
 				if (!txt.Font) {
 					return;
 				}
-				double lbw = 0.0, curw = 0.0;
+				double lastw = 0.0;
+				DoLayoutLines(txt, 0, [&cache](size_t lbid, double lbw) {
+					cache.LineBreaks.PushBack(lbid);
+					cache.LineLengths.PushBack(lbw);
+					return true;
+				}, lastw);
+				cache.LineLengths.PushBack(lastw);
+				DoFinishCache(txt, cache);
+			}
+			void BasicText::DoUpdateCache(const BasicText &txt, BasicTextFormatCache &cache, size_t pos, size_t removed, size_t inserted) {
+				if (!txt.Font) {
+					DoCache(txt, cache);
+					return;
+				}
+				// start from the line before the edit, since words may move back to it
+				size_t line = _FindFirstNotBefore(cache.LineBreaks, pos), oldBreak, syncID = cache.LineBreaks.Count();
+				if (line > 0) {
+					--line;
+				}
+				oldBreak = line;
+				List<size_t> breaks;
+				List<double> lengths;
+				double lastw = 0.0;
+				bool toEnd = DoLayoutLines(txt, (line > 0 ? cache.LineBreaks[line - 1] + 1 : 0), [&](size_t lbid, double lbw) {
+					breaks.PushBack(lbid);
+					lengths.PushBack(lbw);
+					if (lbid + 1 >= pos + inserted && lbid + removed >= inserted) { // the next line starts in unchanged text
+						size_t oldPos = lbid + removed - inserted;
+						for (; oldBreak < cache.LineBreaks.Count() && cache.LineBreaks[oldBreak] < oldPos; ++oldBreak) {
+						}
+						if (oldBreak < cache.LineBreaks.Count() && cache.LineBreaks[oldBreak] == oldPos) { // the rest of the layout is unchanged
+							syncID = oldBreak;
+							return false;
+						}
+					}
+					return true;
+				}, lastw);
+				// replace lines [line, syncID]
+				size_t oldLines = syncID + 1 - line;
+				if (toEnd) {
+					lengths.PushBack(lastw);
+				}
+				cache.LineBreaks.Replace(line, toEnd ? oldLines - 1 : oldLines, breaks, txt.Content.Length());
+				_ReplaceLineLengths(cache.LineLengths, line, oldLines, lengths, cache.Size.X, cache.WidestLineCount);
+				cache.Size.Y = cache.LineLengths.Count() * txt.Font->GetHeight() * txt.Scale;
+			}
+			bool BasicText::DoLayoutLines(const BasicText &txt, size_t begin, const std::function<bool(size_t, double)> &onBreak, double &lastw) {
+#define BASICTEXT_SET_LASTBREAK_TO_CURRENT { lbw = curw; lbid = i; }
+				double lbw = 0.0, curw = 0.0, maxw = txt.LayoutRectangle.Width() - txt.Padding.Width();
 				bool hasBreakable = false, hasBreakableChar = false;
 				size_t lbid = 0;
-				for (size_t i = 0; i < txt.Content.Length(); ++i) {
-					TCHAR curc = txt.Content[i];
+				_ContentReader content(txt.Content);
+				for (size_t i = begin; i < content.Length; ++i) {
+					TCHAR curc = content[i];
 					const CharData &cData = txt.Font->GetData(curc);
 					curw += cData.Advance * txt.Scale;
-					bool breaknow = curw > txt.LayoutRectangle.Width() - txt.Padding.Width() && hasBreakable;
+					bool breaknow = curw > maxw && hasBreakable;
 					if (curc == _TEXT('\n') && !breaknow) {
 						breaknow = true;
 						BASICTEXT_SET_LASTBREAK_TO_CURRENT;
 					}
 					if (breaknow) {
-						cache.LineBreaks.PushBack(lbid);
-						BASICTEXT_ON_NEWLINE(lbw);
+						if (!onBreak(lbid, lbw)) {
+							return false;
+						}
 						// restore last break scene
 						i = lbid;
 						hasBreakable = hasBreakableChar = false;
@@ -128,8 +251,8 @@ namespace DE {
 					// curc != '\n'
 					bool curBreakable = (txt.WrapType == LineWrapType::Wrap);
 					if ( // TODO formality
-						(txt.Content[i] >= _TEXT('a') && txt.Content[i] <= _TEXT('z')) ||
-						(txt.Content[i] >= _TEXT('A') && txt.Content[i] <= _TEXT('Z'))
+						(content[i] >= _TEXT('a') && content[i] <= _TEXT('z')) ||
+						(content[i] >= _TEXT('A') && content[i] <= _TEXT('Z'))
 					) { // not a breakable character
 						if (!hasBreakableChar && txt.WrapType == LineWrapType::WrapWordsNoOverflow) {
 							curBreakable = true;
@@ -140,7 +263,7 @@ namespace DE {
 							hasBreakableChar = true;
 						}
 					}
-					if (i + 1 < txt.Content.Length() && txt.Content[i + 1] == _TEXT('\n')) {
+					if (i + 1 < content.Length && content[i + 1] == _TEXT('\n')) {
 						curBreakable = false;
 					}
 					if (curBreakable) {
@@ -148,10 +271,13 @@ namespace DE {
 						BASICTEXT_SET_LASTBREAK_TO_CURRENT;
 					}
 				}
-				BASICTEXT_ON_NEWLINE(curw);
-				cache.Size.Y = cache.LineLengths.Count() * txt.Font->GetHeight() * txt.Scale;
+				lastw = curw;
+				return true;
 #undef BASICTEXT_SET_LASTBREAK_TO_CURRENT
-#undef BASICTEXT_ON_NEWLINE
+			}
+			void BasicText::DoFinishCache(const BasicText &txt, BasicTextFormatCache &cache) {
+				_CountLineLengths(cache.LineLengths, cache.Size.X, cache.WidestLineCount);
+				cache.Size.Y = cache.LineLengths.Count() * txt.Font->GetHeight() * txt.Scale;
 			}
 			void BasicText::DoRender(const BasicTextFormatCache &cc, const BasicText &txt, Renderer &r) {
 				if (txt.Content.Empty() || txt.Font == nullptr || cc.LineLengths.Count() == 0) {
@@ -160,9 +286,10 @@ namespace DE {
 				size_t curB = 0;
 				Vector2 pos(_GetLineBegin(cc.LineLengths[0], txt), _GetLayoutTop(cc, txt));
 				List<Vertex> vs;
-				size_t lstpg = txt.Font->GetTextureInfo(txt.Content[0]).Page;
+				_ContentReader content(txt.Content);
+				size_t lstpg = txt.Font->GetTextureInfo(content[0]).Page;
 				for (size_t i = 0; i < txt.Content.Length(); ++i) {
-					const CharData &data = txt.Font->GetData(txt.Content[i]);
+					const CharData &data = txt.Font->GetData(content[i]);
 					AtlasTexture ctex = txt.Font->GetTextureInfo(data.Character);
 					Vector2 aRPos = pos;
 					if (txt.RoundToInteger) {
@@ -224,11 +351,12 @@ namespace DE {
 					ell = _GetLineBegin(cc.LineLengths[el], txt);
 					elc = (el > 0 ? cc.LineBreaks[el - 1] + 1 : 0);
 				}
+				_ContentReader content(txt.Content);
 				for (; slc < start; ++slc) {
-					sll += txt.Font->GetData(txt.Content[slc]).Advance * txt.Scale;
+					sll += txt.Font->GetData(content[slc]).Advance * txt.Scale;
 				}
 				for (; elc < end; ++elc) {
-					ell += txt.Font->GetData(txt.Content[elc]).Advance * txt.Scale;
+					ell += txt.Font->GetData(content[elc]).Advance * txt.Scale;
 				}
 				List<Math::Rectangle> result;
 				if (sl == el) {
@@ -282,8 +410,9 @@ namespace DE {
 					over = caret = lbeg;
 					return;
 				}
+				_ContentReader content(txt.Content);
 				for (; lbeg < lend; ++lbeg) {
-					TCHAR c = txt.Content[lbeg];
+					TCHAR c = content[lbeg];
 					double adv = txt.Font->GetData(c).Advance * txt.Scale;
 					if (pos.X <= sx + adv) {
 						over = lbeg;
@@ -308,8 +437,9 @@ namespace DE {
 					throw InvalidArgumentException(_TEXT("caret index overflow"));
 				}
 				Vector2 pos(0.0, line * text.Font->GetHeight()); // no need to multiply Scale, for it's done later
+				_ContentReader content(text.Content);
 				for (size_t ls = (line == 0 ? 0 : cache.LineBreaks[line - 1] + 1); ls < caret; ++ls) {
-					pos.X += text.Font->GetData(text.Content[ls]).Advance;
+					pos.X += text.Font->GetData(content[ls]).Advance;
 				}
 				return Vector2(
 					_GetRelativeLineBegin(cache.LineLengths[line], text),
@@ -333,20 +463,8 @@ namespace DE {
 				size_t caret,
 				double baselinePos
 			) {
-				size_t line = 0;
-				bool end = false;
-				cache.LineBreaks.ForEach([&](size_t breakpos) {
-					if (breakpos < caret) {
-						++line;
-						if (breakpos + 1 == caret) {
-							end = true;
-							return false;
-						}
-						return true;
-					}
-					return false;
-				});
-				if (end && text.Content[caret - 1] != _TEXT('\n')) { // very suspicious
+				size_t line = _FindFirstNotBefore(cache.LineBreaks, caret);
+				if (line > 0 && cache.LineBreaks[line - 1] + 1 == caret && text.Content[caret - 1] != _TEXT('\n')) { // very suspicious
 					double midpvt = cache.LineLengths[line - 1];
 					midpvt = _GetLineBegin(midpvt, text) + 0.5 * midpvt;
 					if (baselinePos > midpvt) {
@@ -356,15 +474,7 @@ namespace DE {
 				return line;
 			}
 			size_t BasicText::DoGetLineOfCaret(const BasicTextFormatCache &cache, const BasicText&, size_t caret) {
-				size_t line = 0;
-				cache.LineBreaks.ForEach([&](size_t pos) {
-					if (pos < caret) {
-						++line;
-						return true;
-					}
-					return false;
-				});
-				return line;
+				return _FindFirstNotBefore(cache.LineBreaks, caret);
 			}
 			size_t BasicText::DoGetLineNumber(const BasicTextFormatCache &cache, const BasicText&) {
 				return cache.LineLengths.Count();
@@ -411,11 +521,30 @@ namespace DE {
 			void BasicText::CacheFormat() {
 				DoCache(*this, FormatCache);
 				FormatCached = true;
+				++FormatVersion;
+			}
+			bool BasicText::IsFormatCacheValid() const {
+				return
+					FormatCache.Font == Font &&
+					FormatCache.Scale == Scale &&
+					FormatCache.WrapType == WrapType &&
+					(WrapType == LineWrapType::NoWrap || FormatCache.WrapWidth == LayoutRectangle.Width() - Padding.Width());
+			}
+			void BasicText::OnContentChanged(size_t pos, size_t removed, size_t inserted) {
+				++FormatVersion;
+				if (!FormatCached) {
+					return;
+				}
+				if (IsFormatCacheValid()) {
+					DoUpdateCache(*this, FormatCache, pos, removed, inserted);
+				} else {
+					CacheFormat();
+				}
 			}
 
 #define BASICTEXT_NEEDCACHE_FUNC_IMPL_BASE(FUNC, ...)   \
 	if (Font) {                                         \
-		if (FormatCached) {                             \
+		if (FormatCached && IsFormatCacheValid()) {     \
 			FUNC(FormatCache, __VA_ARGS__);             \
 		} else {                                        \
 			BasicTextFormatCache cc;                    \
@@ -521,19 +650,103 @@ namespace DE {
 			}
 
 			void StreamedRichText::DoCache(const StreamedRichText &txt, StreamedRichTextFormatCache &cache) { // idea: update lastBreak to make sure it's always valid
-				cache.LineBreaks.Clear();
+				cache.LineBreaks.Clear(txt.Content.Length());
 				cache.LineHeights.Clear();
 				cache.LineLengths.Clear();
 				cache.LineEndFormat.Clear();
 				cache.LineEndChangeIDs.Clear();
-				cache.Size = Vector2();
+				cache.WrapWidth = txt.LayoutRectangle.Width() - txt.Padding.Width();
+				cache.WrapType = txt.WrapType;
 
-				TextFormatInfo curInfo, lastBreakInfo;
-				double lbw = 0.0, lbh = 0.0, curw = 0.0, curh = 0.0, maxh = 0.0;
+				double lastw = 0.0, lasth = 0.0;
+				TextFormatInfo lastInfo;
+				DoLayoutLines(txt, 0, TextFormatInfo(), 0, [&cache](size_t lbid, double lbw, double lbh, const TextFormatInfo &info, size_t markID) {
+					cache.LineBreaks.PushBack(lbid);
+					cache.LineHeights.PushBack(lbh);
+					cache.LineLengths.PushBack(lbw);
+					cache.LineEndFormat.PushBack(info);
+					cache.LineEndChangeIDs.PushBack(markID);
+					return true;
+				}, lastw, lasth, lastInfo);
+				cache.LineHeights.PushBack(lasth);
+				cache.LineLengths.PushBack(lastw);
+				cache.LineEndFormat.PushBack(lastInfo);
+				DoFinishCache(txt, cache);
+			}
+			void StreamedRichText::DoUpdateCache(const StreamedRichText &txt, StreamedRichTextFormatCache &cache, size_t pos, size_t removed, size_t inserted) {
+				// start from the line before the edit, since words may move back to it
+				size_t line = _FindFirstNotBefore(cache.LineBreaks, pos), oldBreak, syncID = cache.LineBreaks.Count();
+				if (line > 0) {
+					--line;
+				}
+				oldBreak = line;
+				List<double> lengths, heights;
+				List<size_t> breaks, changeIDs;
+				List<TextFormatInfo> formats;
+				double lastw = 0.0, lasth = 0.0;
+				TextFormatInfo lastInfo;
+				bool toEnd = DoLayoutLines(
+					txt,
+					(line > 0 ? cache.LineBreaks[line - 1] + 1 : 0),
+					(line > 0 ? cache.LineEndFormat[line - 1] : TextFormatInfo()),
+					(line > 0 ? cache.LineEndChangeIDs[line - 1] : 0),
+					[&](size_t lbid, double lbw, double lbh, const TextFormatInfo &info, size_t markID) {
+						breaks.PushBack(lbid);
+						heights.PushBack(lbh);
+						lengths.PushBack(lbw);
+						formats.PushBack(info);
+						changeIDs.PushBack(markID);
+						if (lbid + 1 >= pos + inserted && lbid + removed >= inserted) { // the next line starts in unchanged text
+							size_t oldPos = lbid + removed - inserted;
+							for (; oldBreak < cache.LineBreaks.Count() && cache.LineBreaks[oldBreak] < oldPos; ++oldBreak) {
+							}
+							if (
+								oldBreak < cache.LineBreaks.Count() &&
+								cache.LineBreaks[oldBreak] == oldPos &&
+								cache.LineEndChangeIDs[oldBreak] == markID
+							) { // the rest of the layout is unchanged
+								syncID = oldBreak;
+								return false;
+							}
+						}
+						return true;
+					},
+					lastw, lasth, lastInfo
+				);
+				// replace lines [line, syncID]
+				size_t oldLines = syncID + 1 - line;
+				if (toEnd) {
+					heights.PushBack(lasth);
+					lengths.PushBack(lastw);
+					formats.PushBack(lastInfo);
+				}
+				for (size_t i = line; i < line + oldLines; ++i) {
+					cache.Size.Y -= cache.LineHeights[i];
+				}
+				for (size_t i = 0; i < heights.Count(); ++i) {
+					cache.Size.Y += heights[i];
+				}
+				cache.LineBreaks.Replace(line, toEnd ? oldLines - 1 : oldLines, breaks, txt.Content.Length());
+				cache.LineEndChangeIDs.Replace(line, toEnd ? oldLines - 1 : oldLines, changeIDs);
+				cache.LineHeights.Replace(line, oldLines, heights);
+				_ReplaceLineLengths(cache.LineLengths, line, oldLines, lengths, cache.Size.X, cache.WidestLineCount);
+				cache.LineEndFormat.Replace(line, oldLines, formats);
+			}
+			bool StreamedRichText::DoLayoutLines(
+				const StreamedRichText &txt, size_t begin, const TextFormatInfo &beginInfo, size_t beginMarkID,
+				const std::function<bool(size_t, double, double, const TextFormatInfo&, size_t)> &onBreak,
+				double &lastw, double &lasth, TextFormatInfo &lastInfo
+			) {
+				TextFormatInfo curInfo = beginInfo, lastBreakInfo;
+				double
+					lbw = 0.0, lbh = 0.0, curw = 0.0, maxh = 0.0,
+					curh = (curInfo.Font ? curInfo.Font->GetHeight() * curInfo.Scale : 0.0),
+					maxw = txt.LayoutRectangle.Width() - txt.Padding.Width();
 				bool hasBreakable = false, hasBreakableChar = false;
-				size_t markID = 0, breakMarkID = 0, lbid = 0;
-				for (size_t i = 0; i < txt.Content.Length(); ++i) {
-					TCHAR curc = txt.Content[i];
+				size_t markID = beginMarkID, breakMarkID = 0, lbid = 0;
+				_ContentReader content(txt.Content);
+				for (size_t i = begin; i < content.Length; ++i) {
+					TCHAR curc = content[i];
 					if (markID < txt.Changes.Count() && txt.Changes[markID].Position == i) {
 						do {
 							const ChangeInfo &ci = txt.Changes[markID];
@@ -553,7 +766,7 @@ namespace DE {
 					}
 					const CharData &cData = curInfo.Font->GetData(curc);
 					curw += cData.Advance * curInfo.Scale;
-					bool breaknow = curw > txt.LayoutRectangle.Width() - txt.Padding.Width() && hasBreakable;
+					bool breaknow = curw > maxw && hasBreakable;
 					if (curc == _TEXT('\n') && !breaknow) {
 						breaknow = true;
 						lastBreakInfo = curInfo;
@@ -563,14 +776,8 @@ namespace DE {
 						lbid = i;
 					}
 					if (breaknow) {
-						cache.LineBreaks.PushBack(lbid);
-						cache.LineHeights.PushBack(lbh);
-						cache.LineLengths.PushBack(lbw);
-						cache.LineEndFormat.PushBack(lastBreakInfo);
-						cache.LineEndChangeIDs.PushBack(breakMarkID);
-						cache.Size.Y += lbh;
-						if (lbw > cache.Size.X) {
-							cache.Size.X = lbw;
+						if (!onBreak(lbid, lbw, lbh, lastBreakInfo, breakMarkID)) {
+							return false;
 						}
 						// restore last break scene
 						i = lbid;
@@ -585,8 +792,8 @@ namespace DE {
 					// curc != '\n'
 					bool curBreakable = (txt.WrapType == LineWrapType::Wrap);
 					if (
-						(txt.Content[i] >= _TEXT('a') && txt.Content[i] <= _TEXT('z')) ||
-						(txt.Content[i] >= _TEXT('A') && txt.Content[i] <= _TEXT('Z'))
+						(content[i] >= _TEXT('a') && content[i] <= _TEXT('z')) ||
+						(content[i] >= _TEXT('A') && content[i] <= _TEXT('Z'))
 					) { // not a breakable character
 						if (!hasBreakableChar && txt.WrapType == LineWrapType::WrapWordsNoOverflow) {
 							curBreakable = true;
@@ -597,7 +804,7 @@ namespace DE {
 							hasBreakableChar = true;
 						}
 					}
-					if (i + 1 < txt.Content.Length() && txt.Content[i + 1] == _TEXT('\n')) {
+					if (i + 1 < content.Length && content[i + 1] == _TEXT('\n')) {
 						curBreakable = false;
 					}
 					if (curBreakable) {
@@ -609,13 +816,17 @@ namespace DE {
 						lbid = i;
 					}
 				}
-				cache.Size.Y += maxh;
-				if (curw > cache.Size.X) {
-					cache.Size.X = curw;
+				lastw = curw;
+				lasth = maxh;
+				lastInfo = curInfo;
+				return true;
+			}
+			void StreamedRichText::DoFinishCache(const StreamedRichText&, StreamedRichTextFormatCache &cache) {
+				cache.Size.Y = 0.0;
+				for (size_t i = 0; i < cache.LineHeights.Count(); ++i) {
+					cache.Size.Y += cache.LineHeights[i];
 				}
-				cache.LineHeights.PushBack(maxh);
-				cache.LineLengths.PushBack(curw);
-				cache.LineEndFormat.PushBack(curInfo);
+				_CountLineLengths(cache.LineLengths, cache.Size.X, cache.WidestLineCount);
 			}
 			Vector2 StreamedRichText::DoGetSize(const StreamedRichTextFormatCache &cache, const StreamedRichText &txt) {
 				return cache.Size + txt.Padding.Size();
@@ -628,6 +839,7 @@ namespace DE {
 				size_t lastPage = 0, changeID = 0, curLine = 0;
 				Vector2 topLeft(_GetLineBegin(cache.LineLengths[curLine], txt), _GetLayoutTop(cache, txt));
 				TextFormatInfo ti;
+				_ContentReader content(txt.Content);
 				for (size_t i = 0; i < txt.Content.Length(); ++i) {
 					while (changeID < txt.Changes.Count() && i == txt.Changes[changeID].Position) {
 						if (txt.Changes[changeID].Type == ChangeType::Font) {
@@ -641,8 +853,8 @@ namespace DE {
 						++changeID;
 					}
 					if (ti.Font) {
-						const CharData &cd = ti.Font->GetData(txt.Content[i]);
-						const AtlasTexture &atex = ti.Font->GetTextureInfo(txt.Content[i]);
+						const CharData &cd = ti.Font->GetData(content[i]);
+						const AtlasTexture &atex = ti.Font->GetTextureInfo(content[i]);
 						if (atex.Page != lastPage) {
 							if (vxs.Count() > 0) {
 								r.BindTexture(ti.Font->GetTexture(lastPage));
@@ -692,13 +904,14 @@ namespace DE {
 				}
 				size_t lastend = beg, cur = leb;
 				double lastX = _GetLineBegin(cache.LineLengths[line], txt);
+				_ContentReader content(txt.Content);
 				for (; cur < beg; ++cur) {
 					while (markID < txt.Changes.Count() && cur == txt.Changes[markID].Position) {
 						format.ApplyChange(txt.Changes[markID]);
 						++markID;
 					}
 					if (format.Font) {
-						lastX += format.Font->GetData(txt.Content[cur]).Advance * format.Scale;
+						lastX += format.Font->GetData(content[cur]).Advance * format.Scale;
 					}
 				}
 				double curX = lastX, lineTop = DoGetLineTop(cache, txt, line);
@@ -730,7 +943,7 @@ namespace DE {
 						} while (markID < txt.Changes.Count() && cur == txt.Changes[markID].Position);
 					}
 					if (format.Font) {
-						curX += format.Font->GetData(txt.Content[cur]).Advance * format.Scale;
+						curX += format.Font->GetData(content[cur]).Advance * format.Scale;
 					}
 				}
 				if (format.Font) {
@@ -752,13 +965,8 @@ namespace DE {
 					return;
 				}
 				size_t line = 0;
-				cache.LineHeights.ForEach([&](double h) {
-					if ((relPos.Y -= h) < 0.0) {
-						return false;
-					}
-					++line;
-					return true;
-				});
+				for (; line < cache.LineHeights.Count() && (relPos.Y -= cache.LineHeights[line]) >= 0.0; ++line) {
+				}
 				if (line >= cache.LineLengths.Count()) {
 					over = caret = txt.Content.Length();
 					return;
@@ -778,16 +986,17 @@ namespace DE {
 					over = caret = beg;
 					return;
 				}
+				_ContentReader content(txt.Content);
 				for (size_t i = beg; i < end; ++i) {
 					while (mark < txt.Changes.Count() && txt.Changes[mark].Position == i) {
 						info.ApplyChange(txt.Changes[mark]);
 						++mark;
 					}
 					if (info.Font) {
-						double adv = info.Font->GetData(txt.Content[i]).Advance * info.Scale;
+						double adv = info.Font->GetData(content[i]).Advance * info.Scale;
 						if ((relPos.X -= adv) < 0.0) {
 							over = i;
-							caret = (txt.Content[i] != _TEXT('\n') && relPos.X > -0.5 * adv ? i + 1 : i);
+							caret = (content[i] != _TEXT('\n') && relPos.X > -0.5 * adv ? i + 1 : i);
 							return;
 						}
 					}
@@ -815,13 +1024,14 @@ namespace DE {
 				for (size_t i = 0; i < line; ++i) {
 					pos.Y += cache.LineHeights[i];
 				}
+				_ContentReader content(txt.Content);
 				for (size_t cur = beg; cur < caret; ++cur) {
 					while (changeID < txt.Changes.Count() && txt.Changes[changeID].Position == cur) {
 						ti.ApplyChange(txt.Changes[changeID]);
 						++changeID;
 					}
 					if (ti.Font) {
-						pos.X += ti.Font->GetData(txt.Content[cur]).Advance * ti.Scale;
+						pos.X += ti.Font->GetData(content[cur]).Advance * ti.Scale;
 					}
 				}
 				TCHAR gc = _TEXT('\n');
@@ -841,20 +1051,8 @@ namespace DE {
 				return Math::Rectangle(pos.X, pos.Y, sz.X, sz.Y);
 			}
 			size_t StreamedRichText::DoGetLineOfCaret(const StreamedRichTextFormatCache &cache, const StreamedRichText &txt, size_t caret, double baseline) {
-				size_t line = 0;
-				bool end = false;
-				cache.LineBreaks.ForEach([&](size_t bpos) {
-					if (bpos < caret) {
-						++line;
-						if (bpos + 1 == caret) {
-							end = true;
-							return false;
-						}
-						return true;
-					}
-					return false;
-				});
-				if (end && txt.Content[caret - 1] != _TEXT('\n')) { // very suspicious
+				size_t line = _FindFirstNotBefore(cache.LineBreaks, caret);
+				if (line > 0 && cache.LineBreaks[line - 1] + 1 == caret && txt.Content[caret - 1] != _TEXT('\n')) { // very suspicious
 					double midpvt = cache.LineLengths[line - 1];
 					midpvt = _GetLineBegin(midpvt, txt) + 0.5 * midpvt;
 					if (baseline > midpvt) {
@@ -864,15 +1062,7 @@ namespace DE {
 				return line;
 			}
 			size_t StreamedRichText::DoGetLineOfCaret(const StreamedRichTextFormatCache &cache, const StreamedRichText&, size_t caret) {
-				size_t line = 0;
-				cache.LineBreaks.ForEach([&](size_t bpos) {
-					if (bpos < caret) {
-						++line;
-						return true;
-					}
-					return false;
-				});
-				return line;
+				return _FindFirstNotBefore(cache.LineBreaks, caret);
 			}
 			size_t StreamedRichText::DoGetLineNumber(const StreamedRichTextFormatCache &cache, const StreamedRichText&) {
 				return cache.LineLengths.Count();
@@ -905,8 +1095,32 @@ namespace DE {
 				return cache.LineHeights[line];
 			}
 
+			bool StreamedRichText::IsFormatCacheValid() const {
+				return
+					CachedFormat.WrapType == WrapType &&
+					(WrapType == LineWrapType::NoWrap || CachedFormat.WrapWidth == LayoutRectangle.Width() - Padding.Width());
+			}
+			void StreamedRichText::OnContentChanged(size_t pos, size_t removed, size_t inserted) {
+				++FormatVersion;
+				// changes inside the removed range collapse to its beginning, changes after it are shifted
+				for (size_t i = 0; i < Changes.Count(); ++i) {
+					ChangeInfo &ci = Changes[i];
+					if (ci.Position > pos) {
+						ci.Position = (ci.Position >= pos + removed ? ci.Position - removed + inserted : pos);
+					}
+				}
+				if (!FormatCached) {
+					return;
+				}
+				if (IsFormatCacheValid()) {
+					DoUpdateCache(*this, CachedFormat, pos, removed, inserted);
+				} else {
+					CacheFormat();
+				}
+			}
+
 #define STREAMEDRICHTEXT_NEEDCACHE_FUNC_IMPL_BASE(FUNC, ...)    \
-	if (FormatCached) {                                         \
+	if (FormatCached && IsFormatCacheValid()) {                 \
 		FUNC(CachedFormat, __VA_ARGS__);                        \
 	} else {                                                    \
 		StreamedRichTextFormatCache cache;                      \
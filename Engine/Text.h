@@ -23,11 +23,48 @@ namespace DE {
 				Wrap
 			};
 
+			// the line breaks of a cached format, with room kept at the last edited line. the breaks after it are stored as
+			// distances from the end of the content, so an edit only changes the breaks around it and those between it
+			// and the edit before it
+			class LineBreakList {
+				public:
+					size_t Count() const {
+						return _breaks.Count();
+					}
+					size_t operator [](size_t index) const {
+						return (index < _breaks.GetGapPosition() ? _breaks[index] : _length - _breaks[index]);
+					}
+
+					// length is the length of the content that the breaks will be pushed for
+					void Clear(size_t length) {
+						_breaks.Clear();
+						_length = length;
+					}
+					void PushBack(size_t pos) {
+						_breaks.PushBack(pos, [this](size_t &p) { // from the end
+							p = _length - p;
+						});
+					}
+					// replaces count breaks from index with the given ones after the content has been edited, which has
+					// changed its length to newLength; the breaks after them have to be in the unchanged text at its end
+					void Replace(size_t index, size_t count, const Core::Collections::List<size_t> &breaks, size_t newLength) {
+						_breaks.Replace(index, count, breaks, [this](size_t &p) { // to or from the end
+							p = _length - p;
+						});
+						_length = newLength;
+					}
+				private:
+					Core::Collections::GapList<size_t> _breaks;
+					size_t _length = 0;
+			};
+
 			class Text {
 				public:
 					virtual ~Text() {
 					}
 
+					size_t FormatVersion = 0; // changes whenever the format is cached or the content changes
+
 					virtual Core::Math::Vector2 GetSize() const = 0;
 
 					virtual Core::Collections::List<Core::Math::Rectangle> GetSelectionRegion(size_t, size_t) const = 0;
@@ -69,13 +106,19 @@ namespace DE {
 				public:
 					struct BasicTextFormatCache {
 						BasicTextFormatCache() = default;
-						Core::Collections::List<size_t> LineBreaks;
-						Core::Collections::List<double> LineLengths;
+						LineBreakList LineBreaks;
+						Core::Collections::GapList<double> LineLengths;
 						Core::Math::Vector2 Size;
+						size_t WidestLineCount = 0; // the number of lines as long as Size.X
+
+						// the parameters that the format was computed with
+						const TextRendering::Font *Font = nullptr;
+						double Scale = 1.0, WrapWidth = 0.0;
+						LineWrapType WrapType = LineWrapType::NoWrap;
 					};
 
 					LineWrapType WrapType = LineWrapType::NoWrap;
-					Core::String Content;
+					Core::Rope Content;
 					double Scale = 1.0;
 					BasicTextFormatCache FormatCache;
 					bool FormatCached = false;
@@ -88,9 +131,14 @@ namespace DE {
 					Core::Color TextColor;
 
 					void CacheFormat();
+					// false if the font, scale or wrapping parameters have changed since the format was cached
+					bool IsFormatCacheValid() const;
+					// to be called after Content[pos, pos + removed) has been replaced by inserted characters
+					// if the format is cached, only the lines around the edit are laid out again
+					void OnContentChanged(size_t pos, size_t removed, size_t inserted);
 
 					Core::Math::Vector2 GetSize() const override {
-						if (FormatCached) {
+						if (FormatCached && IsFormatCacheValid()) {
 							return FormatCache.Size + Padding.Size();
 						} else {
 							BasicTextFormatCache t;
@@ -145,6 +193,11 @@ namespace DE {
 					double GetLineBottom(size_t) const override;
 				private:
 					static void DoCache(const BasicText&, BasicTextFormatCache&);
+					static void DoUpdateCache(const BasicText&, BasicTextFormatCache&, size_t, size_t, size_t);
+					// lays out the lines starting from the given line beginning, reporting each line break and its line length
+					// stops when the callback returns false, otherwise returns true with the length of the last line
+					static bool DoLayoutLines(const BasicText&, size_t, const std::function<bool(size_t, double)>&, double&);
+					static void DoFinishCache(const BasicText&, BasicTextFormatCache&);
 					static void DoRender(const BasicTextFormatCache&, const BasicText&, Renderer&);
 					static Core::Collections::List<Core::Math::Rectangle> DoGetSelectionRegion(const BasicTextFormatCache&, const BasicText&, size_t, size_t);
 					static void DoHitTest(const BasicTextFormatCache&, const BasicText&, const Core::Math::Vector2&, size_t&, size_t&);
@@ -252,13 +305,19 @@ namespace DE {
 					};
 
 					struct StreamedRichTextFormatCache {
-						Core::Collections::List<double> LineLengths, LineHeights;
-						Core::Collections::List<size_t> LineBreaks, LineEndChangeIDs;
-						Core::Collections::List<TextFormatInfo> LineEndFormat;
+						Core::Collections::GapList<double> LineLengths, LineHeights;
+						LineBreakList LineBreaks;
+						Core::Collections::GapList<size_t> LineEndChangeIDs;
+						Core::Collections::GapList<TextFormatInfo> LineEndFormat;
 						Core::Math::Vector2 Size;
+						size_t WidestLineCount = 0; // the number of lines as long as Size.X
+
+						// the parameters that the format was computed with
+						double WrapWidth = 0.0;
+						LineWrapType WrapType = LineWrapType::NoWrap;
 					};
 
-					Core::String Content;
+					Core::Rope Content;
 					Core::Math::Rectangle LayoutRectangle, Padding {-4.0, -4.0, 8.0, 8.0};
 					Core::Collections::List<ChangeInfo> Changes;
 					LineWrapType WrapType = LineWrapType::NoWrap;
@@ -318,7 +377,15 @@ namespace DE {
 					virtual void CacheFormat() {
 						DoCache(*this, CachedFormat);
 						FormatCached = true;
-					}
+						++FormatVersion;
+					}
+					// false if the wrapping parameters have changed since the format was cached
+					// changes to Changes are not tracked
+					bool IsFormatCacheValid() const;
+					// to be called after Content[pos, pos + removed) has been replaced by inserted characters
+					// positions of changes after the edit are adjusted, and if the format is cached,
+					// only the lines around the edit are laid out again
+					virtual void OnContentChanged(size_t pos, size_t removed, size_t inserted);
 					Core::Math::Vector2 GetSize() const override;
 
 					Core::Collections::List<Core::Math::Rectangle> GetSelectionRegion(size_t, size_t) const override;
@@ -363,6 +430,16 @@ namespace DE {
 					void Render(Renderer&) const override;
 				protected:
 					static void DoCache(const StreamedRichText&, StreamedRichTextFormatCache&);
+					static void DoUpdateCache(const StreamedRichText&, StreamedRichTextFormatCache&, size_t, size_t, size_t);
+					// lays out the lines starting from the given line beginning, with the given format and change id
+					// reports each line break with the line's length, height, and the format and change id at the break
+					// stops when the callback returns false, otherwise returns true with the information of the last line
+					static bool DoLayoutLines(
+						const StreamedRichText&, size_t, const TextFormatInfo&, size_t,
+						const std::function<bool(size_t, double, double, const TextFormatInfo&, size_t)>&,
+						double&, double&, TextFormatInfo&
+					);
+					static void DoFinishCache(const StreamedRichText&, StreamedRichTextFormatCache&);
 					static Core::Math::Vector2 DoGetSize(const StreamedRichTextFormatCache&, const StreamedRichText&);
 					static void DoRender(const StreamedRichTextFormatCache&, const StreamedRichText&, Renderer&);
 					static Core::Collections::List<Core::Math::Rectangle> DoGetSelectionRegion(const StreamedRichTextFormatCache&, const StreamedRichText&, size_t, size_t);
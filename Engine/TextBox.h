@@ -38,6 +38,7 @@ namespace DE {
 				}
 				void SetText(const Core::String &text) {
 					_lbl.Content().Content = text;
+					_lbl.Content().CacheFormat();
 					_lbl.FitContent();
 					SetCaretPositionInfo(0, CaretMoveType::SetBaseLineAndCancelSelection);
 					MakePointInView(Core::Math::Vector2());
@@ -123,6 +124,7 @@ namespace DE {
 								}
 							}
 							_lbl.Content().Content = newContent;
+							_lbl.Content().CacheFormat();
 							_lbl.FitContent();
 							SetCaretPositionInfo(tarC, CaretMoveType::SetBaseLineAndCancelSelection);
 							OnTextChanged(Core::Info());
@@ -137,6 +139,7 @@ namespace DE {
 							_wrapText = v;
 							if (!_wrapText) {
 								_lbl.Content().WrapType = Graphics::TextRendering::LineWrapType::NoWrap;
+								_lbl.Content().CacheFormat();
 								_lbl.FitContent();
 							} else {
 								_lbl.Content().WrapType = Graphics::TextRendering::LineWrapType::WrapWordsNoOverflow;
@@ -150,7 +153,15 @@ namespace DE {
 				};
 			protected:
 				class LabelWrapper : public Label<T> {
-					friend class TextBox;
+						friend class TextBox;
+					protected:
+						// the format is kept cached and updated on each edit, it's only rebuilt when the layout parameters change
+						void FinishLayoutChange() override {
+							Label<T>::FinishLayoutChange();
+							if (!this->_content.FormatCached || !this->_content.IsFormatCacheValid()) {
+								this->_content.CacheFormat();
+							}
+						}
 				};
 
 				size_t _caret = 0, _selectS = 0, _selectE = 0;
@@ -194,6 +205,7 @@ namespace DE {
 						_selectE = _caret;
 					} // otherwise you MUST handle the selection region yourself
 					MakeCaretInView();
+					Invalidate(_visibleRgn);
 				}
 				virtual void SetCaretPositionInfo(size_t newPosition, CaretMoveType type) {
 					SetCaretPositionInfo(newPosition, type, _lbl.Content().GetCaretPosition(newPosition).X - _lbl.Content().LayoutRectangle.Left);
@@ -201,10 +213,14 @@ namespace DE {
 
 				virtual void Update(double dt) override {
 					ScrollViewBase::Update(dt);
+					bool caretShown = _blink < _period * 0.5;
 					_blink += dt;
 					while (_blink > _period) {
 						_blink -= _period;
 					}
+					if (Focused() && caretShown != (_blink < _period * 0.5)) {
+						Invalidate(_visibleRgn);
+					}
 					if (_selecting) {
 						if (GetWorld()) {
 							size_t caretP = _lbl.Content().HitTestForCaret(
@@ -277,6 +293,7 @@ namespace DE {
 						Core::Math::Swap(rrs, rre);
 					}
 					_lbl.Content().Content.Remove(rrs, rre - rrs);
+					_lbl.Content().OnContentChanged(rrs, rre - rrs, 0);
 					_lbl.FitContent();
 					SetCaretPositionInfo(rrs, CaretMoveType::SetBaseLineAndCancelSelection);
 					OnTextChanged(Core::Info());
@@ -352,6 +369,7 @@ namespace DE {
 							if (!DeleteSelectedBlock() && !_readOnly) {
 								if (_caret < _lbl.Content().Content.Length()) {
 									_lbl.Content().Content.Remove(_caret);
+									_lbl.Content().OnContentChanged(_caret, 1, 0);
 									_lbl.FitContent();
 									SetCaretPositionInfo(_caret, CaretMoveType::SetBaseLineAndCancelSelection);
 									OnTextChanged(Core::Info());
@@ -434,6 +452,7 @@ namespace DE {
 								if (_caret > 0) {
 									target = _caret - 1;
 									_lbl.Content().Content.Remove(target);
+									_lbl.Content().OnContentChanged(target, 1, 0);
 								} else {
 									changed = false;
 								}
@@ -455,6 +474,7 @@ namespace DE {
 									}
 								}
 								_lbl.Content().Content.Insert(_caret, str);
+								_lbl.Content().OnContentChanged(_caret, 0, str.Length());
 								_selectS = _caret;
 								_selectE = target = _caret + str.Length();
 								noClearSelection = true;
@@ -473,11 +493,15 @@ namespace DE {
 							}
 							if (_insert) {
 								_lbl.Content().Content.Insert(_caret, tgc);
+								_lbl.Content().OnContentChanged(_caret, 0, 1);
 							} else {
 								if (_caret < _lbl.Content().Content.Length() && _lbl.Content().Content[_caret] != _TEXT('\n')) {
-									_lbl.Content().Content[_caret] = tgc;
+									_lbl.Content().Content.Remove(_caret);
+									_lbl.Content().Content.Insert(_caret, tgc);
+									_lbl.Content().OnContentChanged(_caret, 1, 1);
 								} else {
 									_lbl.Content().Content.Insert(_caret, tgc);
+									_lbl.Content().OnContentChanged(_caret, 0, 1);
 								}
 							}
 							break;
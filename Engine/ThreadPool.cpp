@@ -0,0 +1,112 @@
+#include "ThreadPool.h"
+
+namespace DE {
+	namespace Core {
+		thread_local bool _InPoolTask = false;
+
+		ThreadPool::ThreadPool(size_t threads) {
+			if (threads == 0) {
+				threads = std::thread::hardware_concurrency();
+			}
+			_workerCount = (threads > 1 ? threads - 1 : 0);
+			if (_workerCount > 0) {
+				_workers = static_cast<std::thread*>(GlobalAllocator::Allocate(sizeof(std::thread) * _workerCount));
+				for (size_t i = 0; i < _workerCount; ++i) {
+					new (_workers + i) std::thread([this]() {
+						WorkerMain();
+					});
+				}
+			}
+		}
+		ThreadPool::~ThreadPool() {
+			if (_workers) {
+				{
+					std::lock_guard<std::mutex> guard(_poolLock);
+					_quit = true;
+				}
+				_startCond.notify_all();
+				for (size_t i = 0; i < _workerCount; ++i) {
+					_workers[i].join();
+					_workers[i].~thread();
+				}
+				GlobalAllocator::Free(_workers);
+			}
+		}
+
+		ThreadPool &ThreadPool::Default() {
+			static ThreadPool pool;
+			return pool;
+		}
+
+		void ThreadPool::ParallelFor(size_t count, const std::function<void(size_t)> &func) {
+			if (count == 0) {
+				return;
+			}
+			std::unique_lock<std::mutex> dispatch(_dispatchLock, std::defer_lock);
+			if (_workerCount == 0 || count == 1 || _InPoolTask || !dispatch.try_lock()) {
+				for (size_t i = 0; i < count; ++i) {
+					func(i);
+				}
+				return;
+			}
+			{
+				std::lock_guard<std::mutex> guard(_poolLock);
+				_func = &func;
+				_count = count;
+				_next = 0;
+				_failed = false;
+				_error = nullptr;
+				_working = _workerCount;
+				++_generation;
+			}
+			_startCond.notify_all();
+			RunIterations();
+			std::unique_lock<std::mutex> lock(_poolLock);
+			_doneCond.wait(lock, [this]() {
+				return _working == 0;
+			});
+			_func = nullptr;
+			if (_error) {
+				std::exception_ptr error = _error;
+				_error = nullptr;
+				lock.unlock();
+				std::rethrow_exception(error);
+			}
+		}
+
+		void ThreadPool::RunIterations() {
+			_InPoolTask = true;
+			for (size_t i = _next++; i < _count && !_failed; i = _next++) {
+				try {
+					(*_func)(i);
+				} catch (...) {
+					std::lock_guard<std::mutex> guard(_poolLock);
+					if (!_error) {
+						_error = std::current_exception();
+					}
+					_failed = true;
+				}
+			}
+			_InPoolTask = false;
+		}
+		void ThreadPool::WorkerMain() {
+			size_t seen = 0;
+			std::unique_lock<std::mutex> lock(_poolLock);
+			while (true) {
+				_startCond.wait(lock, [this, &seen]() {
+					return _quit || _generation != seen;
+				});
+				if (_quit) {
+					return;
+				}
+				seen = _generation;
+				lock.unlock();
+				RunIterations();
+				lock.lock();
+				if (--_working == 0) {
+					_doneCond.notify_one();
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <exception>
+#include <functional>
+
+#include "ObjectAllocator.h"
+
+namespace DE {
+	namespace Core {
+		// a fixed set of worker threads that run the iterations of a loop together with the calling thread
+		// iterations are handed out one by one, so they should be coarse (bands of rows, batches of objects)
+		class ThreadPool {
+			public:
+				// threads == 0 uses one thread per hardware thread; the calling thread counts as one of them
+				explicit ThreadPool(size_t threads = 0);
+				ThreadPool(const ThreadPool&) = delete;
+				ThreadPool &operator =(const ThreadPool&) = delete;
+				~ThreadPool();
+
+				// calls func(i) for every i in [0, count) and returns when all calls have returned
+				// the first exception thrown by func is rethrown here, the remaining iterations are skipped
+				// calls made from inside func, or made while another thread is using the pool, run on the calling thread only
+				void ParallelFor(size_t count, const std::function<void(size_t)> &func);
+
+				size_t GetThreadCount() const {
+					return _workerCount + 1;
+				}
+
+				// a pool shared by the engine, created on first use
+				static ThreadPool &Default();
+			private:
+				std::thread *_workers = nullptr;
+				size_t _workerCount = 0, _generation = 0, _working = 0, _count = 0;
+				bool _quit = false;
+				const std::function<void(size_t)> *_func = nullptr;
+				std::atomic<size_t> _next {0};
+				std::atomic<bool> _failed {false};
+				std::exception_ptr _error;
+				std::mutex _poolLock, _dispatchLock;
+				std::condition_variable _startCond, _doneCond;
+
+				void RunIterations();
+				void WorkerMain();
+		};
+	}
+}
@@ -1,5 +1,7 @@
 #include "UIWorld.h"
 
+#include <cmath>
+
 #include "Control.h"
 
 namespace DE {
@@ -58,13 +60,124 @@ namespace DE {
 			}
 		}
 		void World::Render(Renderer &r) {
-			if (_child && (_child->_vis == Visibility::Visible || _child->_vis == Visibility::Ghost)) {
+			if (!_retained) {
+				RenderChild(r);
+				return;
+			}
+			Math::Rectangle region(0.0, 0.0, std::ceil(_bound.Right), std::ceil(_bound.Bottom));
+			if (_cached && (
+				_cacheOwner.GetContext() != r.GetContext() ||
+				_cache.Region.Right != region.Right || _cache.Region.Bottom != region.Bottom
+			)) {
+				FreeCache();
+			}
+			if (!_cached) {
+				_cache = r.CreateFrameBuffer(region);
+				_cacheOwner = r;
+				_cached = true;
+				InvalidateAll();
+			}
+			if (_child) {
+				_child->DetectVisualChanges();
+			}
+			_redrawnArea = 0.0;
+			if (_dirty.Count() > 0) {
+				Collections::List<Math::Rectangle> dirty = _dirty;
+				_dirty.Clear();
+				r.ContinueFrameBuffer(_cache);
+				_redrawing = true;
+				for (size_t i = 0; i < dirty.Count(); ++i) {
+					_redrawRegion = dirty[i];
+					_redrawnArea += _redrawRegion.Area();
+					r.PushRectangularClip(_redrawRegion);
+					Vertex back[4] {
+						Vertex(_redrawRegion.TopLeft(), _retainedBack),
+						Vertex(_redrawRegion.TopRight(), _retainedBack),
+						Vertex(_redrawRegion.BottomRight(), _retainedBack),
+						Vertex(_redrawRegion.BottomLeft(), _retainedBack)
+					};
+					r.SetBlendFunction(BlendFactor::One, BlendFactor::Zero);
+					r.BindTexture(TextureID());
+					r.DrawVertices(back, 4, RenderMode::TriangleFan);
+					r.SetBlendFunction(BlendFactor::SourceAlpha, BlendFactor::InvertedSourceAlpha);
+					RenderChild(r);
+					r.PopRectangularClip();
+				}
+				_redrawing = false;
+				r.BackToDefaultFrameBuffer();
+			}
+			// the cache is opaque, so it replaces what's below
+			double w = region.Width(), h = region.Height();
+			Vertex vs[4] {
+				Vertex(_bound.TopLeft(), Color(255, 255, 255, 255), Vector2(_bound.Left / w, _bound.Top / h)),
+				Vertex(_bound.TopRight(), Color(255, 255, 255, 255), Vector2(_bound.Right / w, _bound.Top / h)),
+				Vertex(_bound.BottomRight(), Color(255, 255, 255, 255), Vector2(_bound.Right / w, _bound.Bottom / h)),
+				Vertex(_bound.BottomLeft(), Color(255, 255, 255, 255), Vector2(_bound.Left / w, _bound.Bottom / h))
+			};
+			r.SetBlendFunction(BlendFactor::One, BlendFactor::Zero);
+			r.BindTexture(_cache.TextureID);
+			r.DrawVertices(vs, 4, RenderMode::TriangleFan);
+			r.BindTexture(TextureID());
+			r.SetBlendFunction(BlendFactor::SourceAlpha, BlendFactor::InvertedSourceAlpha);
+		}
+		void World::RenderChild(Renderer &r) {
+			if (_child && (_child->_vis == Visibility::Visible || _child->_vis == Visibility::Ghost) && _child->IsInRenderRegion()) {
 				_child->BeginRendering(r);
 				_child->Render(r);
 				_child->EndRendering(r);
 			}
 		}
 
+		void World::SetRetainedRendering(bool retained) {
+			if (retained == _retained) {
+				return;
+			}
+			_retained = retained;
+			if (!_retained) {
+				FreeCache();
+				_dirty.Clear();
+			}
+		}
+		void World::Invalidate(const Math::Rectangle &rect) {
+			if (!_retained) {
+				return;
+			}
+			Math::Rectangle px;
+			if (Math::Rectangle::Intersect(rect, _bound, px) != IntersectionType::Full) {
+				return;
+			}
+			px.Left = std::floor(px.Left);
+			px.Top = std::floor(px.Top);
+			px.Right = std::ceil(px.Right);
+			px.Bottom = std::ceil(px.Bottom);
+			// merge with the regions it touches until it touches none
+			for (size_t i = 0; i < _dirty.Count(); ) {
+				Math::Rectangle dummy;
+				if (Math::Rectangle::Intersect(_dirty[i], px, dummy) != IntersectionType::None) {
+					px = Math::Rectangle::Union(_dirty[i], px);
+					_dirty.Remove(i);
+					i = 0;
+				} else {
+					++i;
+				}
+			}
+			_dirty.PushBack(px);
+			if (_dirty.Count() > MaxDirtyRegions) {
+				for (size_t i = 1; i < _dirty.Count(); ++i) {
+					px = Math::Rectangle::Union(px, _dirty[i - 1]);
+				}
+				_dirty.Clear();
+				_dirty.PushBack(px);
+			}
+		}
+		void World::FreeCache() {
+			if (_cached) {
+				_cacheOwner.DeleteFrameBuffer(_cache);
+				_cacheOwner = Renderer();
+				_cached = false;
+			}
+		}
+
 		void World::OnKeyDown(const KeyInfo &info) {
 			InputElement::OnKeyDown(info);
 			if (_focus) {
@@ -18,6 +18,7 @@ namespace DE {
 				}
 				~World() {
 					SetFather(nullptr);
+					FreeCache();
 				}
 
 				Core::Math::Rectangle GetBounds() const {
@@ -43,6 +44,31 @@ namespace DE {
 				virtual void Update(double);
 				virtual void Render(Graphics::Renderer&);
 
+				// when retained, the output is kept in a frame buffer, and only the regions that have been invalidated
+				// are drawn again, each with a clip; the world is assumed to be drawn over a background of
+				// the given color, with a viewbox that starts at the origin and has one unit per pixel
+				// the frame buffer is freed when retained rendering is disabled or the world is destroyed,
+				// which must happen before the rendering context is disposed
+				void SetRetainedRendering(bool);
+				bool IsRetainedRendering() const {
+					return _retained;
+				}
+				void SetRetainedBackground(const Core::Color &color) {
+					_retainedBack = color;
+					InvalidateAll();
+				}
+				const Core::Color &GetRetainedBackground() const {
+					return _retainedBack;
+				}
+				void Invalidate(const Core::Math::Rectangle&);
+				void InvalidateAll() {
+					Invalidate(_bound);
+				}
+				// the area that has been drawn again by the last call to Render()
+				double GetRedrawnArea() const {
+					return _redrawnArea;
+				}
+
 				virtual void OnKeyDown(const Core::Input::KeyInfo&) override;
 				virtual void OnKeyUp(const Core::Input::KeyInfo&) override;
 				virtual bool OnMouseDown(const Core::Input::MouseButtonInfo&) override;
@@ -88,11 +114,24 @@ namespace DE {
 						MouseEnterListener, MouseLeaveListener, GotFocusListener, LostFocusListener, SetCursorListener;
 				};
 
+				constexpr static size_t MaxDirtyRegions = 8;
+
 				Core::Math::Rectangle _bound;
 				Control *_child = nullptr, *_focus = nullptr;
 				Core::Window *_father = nullptr;
 				bool _focused = false;
 				ListenerAttachments *_listeners = nullptr;
+
+				bool _retained = false, _cached = false, _redrawing = false;
+				Core::Color _retainedBack {0, 0, 0, 255};
+				Graphics::Renderer _cacheOwner; // the renderer that created _cache
+				Graphics::FrameBuffer _cache;
+				Core::Collections::List<Core::Math::Rectangle> _dirty; // disjoint, in pixels
+				Core::Math::Rectangle _redrawRegion;
+				double _redrawnArea = 0.0;
+
+				void RenderChild(Graphics::Renderer&);
+				void FreeCache();
 		};
 	}
 }
@@ -1,161 +1,578 @@
 #include "Zipper.h"
 
+#include <atomic>
+
+#include "Huffman.h"
+#include "FileAccess.h"
+
 namespace DE {
 	namespace IO {
 		using namespace Core;
 		using namespace Core::Collections;
 
-		void Zipper::Node::FreeTree(Node *n) {
-			List<Node*> stk;
-			stk.PushBack(n);
-			while (stk.Count() > 0) {
-				n = stk.PopBack();
-				if (n->_left) {
-					stk.PushBack(n->_left);
-				}
-				if (n->_right) {
-					stk.PushBack(n->_right);
+		constexpr size_t ZipSymbolCount = 256;
+
+		BitSet Zipper::Zip() const {
+			List<unsigned char> out;
+			Zip(*_data, _data.Count(), out);
+			BitSet ret;
+			ret.PushBackBits(*out, out.Count()<<3);
+			return ret;
+		}
+		void Zipper::Zip(const void *dataV, size_t size, List<unsigned char> &out) {
+			const unsigned char *data = static_cast<const unsigned char*>(dataV);
+			size_t freqs[4][ZipSymbolCount] = {}; // four counts, so that repeated bytes don't wait on each other
+			size_t i = 0;
+			for (; i + 4 <= size; i += 4) {
+				++freqs[0][data[i]];
+				++freqs[1][data[i + 1]];
+				++freqs[2][data[i + 2]];
+				++freqs[3][data[i + 3]];
+			}
+			for (; i < size; ++i) {
+				++freqs[0][data[i]];
+			}
+			for (size_t s = 0; s < ZipSymbolCount; ++s) {
+				freqs[0][s] += freqs[1][s] + freqs[2][s] + freqs[3][s];
+			}
+			unsigned char lengths[ZipSymbolCount];
+			Huffman::MakeCodeLengths(freqs[0], ZipSymbolCount, lengths);
+			Huffman::Encoder encoder(lengths, ZipSymbolCount);
+
+			size_t bits = 64 + ZipSymbolCount * 4, start = out.Count();
+			for (size_t s = 0; s < ZipSymbolCount; ++s) {
+				bits += freqs[0][s] * lengths[s];
+			}
+			size_t bytes = (bits + 7)>>3;
+			out.PushBack(0, bytes + sizeof(BitWriter::WordType)); // the writer stores whole words
+			BitWriter writer(&out.At(start));
+			unsigned long long len = size;
+			writer.Write(len & 0xFFFFFFFF, 32);
+			writer.Flush();
+			writer.Write(len>>32, 32);
+			writer.Flush();
+			for (size_t s = 0; s < ZipSymbolCount; ++s) {
+				writer.Write(lengths[s], 4);
+				if ((s & 7) == 7) {
+					writer.Flush();
 				}
-				n->~Node();
-				GlobalAllocator::Free(n);
 			}
+			for (i = 0; i + 3 <= size; i += 3) { // three codes fit between flushes
+				encoder.Encode(writer, data[i]);
+				encoder.Encode(writer, data[i + 1]);
+				encoder.Encode(writer, data[i + 2]);
+				writer.Flush();
+			}
+			for (; i < size; ++i) {
+				encoder.Encode(writer, data[i]);
+				writer.Flush();
+			}
+			writer.Finish();
+			out.Remove(start + bytes, sizeof(BitWriter::WordType));
+		}
+
+		List<unsigned char> Unzipper::Unzip() const {
+			List<unsigned char> ret;
+			Unzip(*_data, (_data.Count() + 7)>>3, ret);
+			return ret;
+		}
+		void Unzipper::Unzip(const void *data, size_t size, List<unsigned char> &out) {
+			BitReader reader(data, size);
+			unsigned long long len = reader.Read(32);
+			len |= reader.Read(32)<<32;
+			unsigned char lengths[ZipSymbolCount];
+			for (size_t s = 0; s < ZipSymbolCount; ++s) {
+				lengths[s] = static_cast<unsigned char>(reader.Read(4));
+			}
+			if (reader.IsOverrun() || len > (static_cast<unsigned long long>(size)<<3)) { // every byte takes a bit at least
+				throw InvalidArgumentException(_TEXT("corrupted data"));
+			}
+			Huffman::Decoder decoder(lengths, ZipSymbolCount);
+			size_t n = static_cast<size_t>(len), start = out.Count();
+			if (n == 0) {
+				return;
+			}
+			out.PushBack(0, n);
+			decoder.Decode(reader, &out.At(start), n);
+			if (reader.IsOverrun()) {
+				throw InvalidArgumentException(_TEXT("corrupted data"));
+			}
+		}
+
+		constexpr size_t BlockZipper::DefaultBlockSize, BlockZipper::MaxBlockSize;
+
+		constexpr size_t BlockHeaderSize = 32, BlockVersion = 1, BatchBlocksPerThread = 4;
+		constexpr unsigned char StoredBlock = 0, CodedBlock = 1;
+		constexpr size_t MinMatch = 4, MaxMatch = 1<<16, NiceMatch = 128, MaxChainLength = 16, HashBits = 15, SkipShift = 6;
+		constexpr unsigned NoPosition = ~0u;
+		// the lengths of matches and their distances are coded as below, for values under 1<<24
+		constexpr size_t ValueCodeCount = 92, LiteralCount = 256, LitLenCount = LiteralCount + ValueCodeCount;
+
+		struct Token {
+			unsigned Length, Distance; // the byte in Length if Distance is 0
+		};
+		struct BlockScratch {
+			List<unsigned, true> Head, Prev;
+			List<Token, true> Tokens;
+		};
+
+		// values under 8 are their own codes. larger ones are coded by their highest bit and the two bits below it, and
+		// the bits below those follow the code
+		inline size_t ValueCode(size_t v, size_t &extraBits) {
+			if (v < 8) {
+				extraBits = 0;
+				return v;
+			}
+			size_t top = Math::HighestBit(static_cast<unsigned long>(v)) - 1;
+			extraBits = top - 2;
+			return 8 + ((top - 3)<<2) + ((v>>extraBits) & 3);
+		}
+		inline size_t ReadValue(BitReader &reader, size_t code) {
+			if (code < 8) {
+				return code;
+			}
+			size_t extraBits = ((code - 8)>>2) + 1, v = ((4 | ((code - 8) & 3))<<extraBits) | reader.Peek(extraBits);
+			reader.Consume(extraBits);
+			return v;
 		}
-		Zipper::Node *Zipper::Node::Combine(Node *lhs, Node *rhs) {
-			Node *n = new (GlobalAllocator::Allocate(sizeof(Node))) Node(0);
-			n->_occ = lhs->_occ + rhs->_occ;
-			lhs->_father = rhs->_father = n;
-			n->_left = lhs;
-			n->_right = rhs;
+
+		inline unsigned Hash(const unsigned char *p) {
+			unsigned v;
+			memcpy(&v, p, sizeof(unsigned));
+			return (v * 2654435761u)>>(32 - HashBits);
+		}
+		inline size_t MatchLength(const unsigned char *a, const unsigned char *b, size_t max) {
+			size_t n = 0;
+			for (; n + 8 <= max; n += 8) {
+				unsigned long long x, y;
+				memcpy(&x, a + n, 8);
+				memcpy(&y, b + n, 8);
+				if (x != y) {
+					for (x ^= y; (x & 0xFF) == 0; x >>= 8) { // little-endian, so the first byte is the lowest
+						++n;
+					}
+					return n;
+				}
+			}
+			for (; n < max && a[n] == b[n]; ++n) {
+			}
 			return n;
 		}
-		void Zipper::Node::GenCodeForTree(Node *n) {
-            List<Node*> stk;
-            n->_code.Clear();
-            if (n->_left) {
-				stk.PushBack(n->_left);
-            }
-            if (n->_right) {
-				stk.PushBack(n->_right);
-            }
-            while (stk.Count() > 0) {
-				n = stk.PopBack();
-				n->_code = n->_father->_code;
-				n->_code.PushBack(n == n->_father->_right);
-				if (n->_left) {
-					stk.PushBack(n->_left);
-				}
-				if (n->_right) {
-					stk.PushBack(n->_right);
-				}
-            }
-		}
-		void Zipper::Node::Insert(Node *root, Node *target) {
-			Node **tar = &root, *father;
-			size_t tcnt = target->_code.Count() - 1;
-            for (size_t i = 0; i < tcnt; ++i) {
-				father = (*tar);
-				if (target->_code.GetAt(i)) {
-					tar = &((*tar)->_right);
+		// greedy matching, with the positions of each block chained by the hash of the 4 bytes they start with. the
+		// positions are tried further apart the longer nothing matches, which keeps data that doesn't compress fast.
+		// returns the number of tokens
+		size_t FindMatches(const unsigned char *src, size_t n, BlockScratch &s) {
+			if (s.Head.Count() == 0) {
+				s.Head.PushBack(NoPosition, size_t(1)<<HashBits);
+			}
+			if (s.Prev.Count() < n) {
+				s.Prev.PushBack(NoPosition, n - s.Prev.Count());
+				s.Tokens.PushBack(Token {0, 0}, n - s.Tokens.Count());
+			}
+			unsigned *head = &s.Head.At(0), *prev = *s.Prev;
+			Token *ts = *s.Tokens;
+			for (size_t i = 0; i < (size_t(1)<<HashBits); ++i) {
+				head[i] = NoPosition;
+			}
+			size_t tn = 0, misses = 0;
+			for (size_t i = 0; i < n; ) {
+				size_t best = 0, dist = 0;
+				if (i + MinMatch <= n) {
+					size_t h = Hash(src + i), max = Math::Min(n - i, MaxMatch), chain = MaxChainLength;
+					for (unsigned c = head[h]; c != NoPosition && chain > 0; c = prev[c], --chain) {
+						if (src[c + best] != src[i + best]) { // can't be longer than the best
+							continue;
+						}
+						size_t len = MatchLength(src + c, src + i, max);
+						if (len > best) {
+							best = len;
+							dist = i - c;
+							if (best >= NiceMatch || best == max) {
+								break;
+							}
+						}
+					}
+					prev[i] = head[h];
+					head[h] = static_cast<unsigned>(i);
+				}
+				if (best < MinMatch) {
+					size_t end = Math::Min(n, i + 1 + (misses++>>SkipShift));
+					for (; i < end; ++i) {
+						ts[tn++] = Token {src[i], 0};
+					}
+					continue;
+				}
+				misses = 0;
+				ts[tn++] = Token {static_cast<unsigned>(best), static_cast<unsigned>(dist)};
+				size_t end = i + best, last = Math::Min(end, n - MinMatch + 1);
+				for (++i; i < last; ++i) {
+					size_t h = Hash(src + i);
+					prev[i] = head[h];
+					head[h] = static_cast<unsigned>(i);
+				}
+				i = end;
+			}
+			return tn;
+		}
+		// a block starts with its type. a coded block has the lengths of the codes of the literals and lengths, and of
+		// the distances, in 4 bits each, and then the matches and literals until the block is full. a block that can't
+		// be made smaller is stored as it is
+		void EncodeBlock(const unsigned char *src, size_t n, BlockScratch &s, List<unsigned char> &out) {
+			size_t tn = FindMatches(src, n, s), freqs[LitLenCount + ValueCodeCount] = {}, *distFreqs = freqs + LitLenCount;
+			size_t bits = (LitLenCount + ValueCodeCount) * 4;
+			const Token *ts = *s.Tokens;
+			for (size_t i = 0; i < tn; ++i) {
+				if (ts[i].Distance == 0) {
+					++freqs[ts[i].Length];
+					continue;
+				}
+				size_t extraBits;
+				++freqs[LiteralCount + ValueCode(ts[i].Length - MinMatch, extraBits)];
+				bits += extraBits;
+				++distFreqs[ValueCode(ts[i].Distance - 1, extraBits)];
+				bits += extraBits;
+			}
+			unsigned char lengths[LitLenCount + ValueCodeCount];
+			Huffman::MakeCodeLengths(freqs, LitLenCount, lengths);
+			Huffman::MakeCodeLengths(distFreqs, ValueCodeCount, lengths + LitLenCount);
+			for (size_t i = 0; i < LitLenCount + ValueCodeCount; ++i) {
+				bits += freqs[i] * lengths[i];
+			}
+			size_t bytes = (bits + 7)>>3, start = out.Count();
+			if (bytes >= n) {
+				out.PushBack(StoredBlock);
+				out.PushBackRange(src, n);
+				return;
+			}
+			out.PushBack(0, 1 + bytes + sizeof(BitWriter::WordType)); // the writer stores whole words
+			unsigned char *os = &out.At(start);
+			os[0] = CodedBlock;
+			BitWriter writer(os + 1);
+			for (size_t i = 0; i < LitLenCount + ValueCodeCount; ++i) {
+				writer.Write(lengths[i], 4);
+				if ((i & 7) == 7) {
+					writer.Flush();
+				}
+			}
+			writer.Flush();
+			Huffman::Encoder litLens(lengths, LitLenCount), dists(lengths + LitLenCount, ValueCodeCount);
+			for (size_t i = 0, pending = 0; i < tn; ++i) { // pending is the bits written since the last flush
+				if (ts[i].Distance == 0) {
+					if (pending + Huffman::MaxCodeLength > BitWriter::MaxBitsBetweenFlushes) {
+						writer.Flush();
+						pending = 0;
+					}
+					litLens.Encode(writer, ts[i].Length);
+					pending += Huffman::MaxCodeLength;
+					continue;
+				}
+				size_t extraBits, v = ts[i].Length - MinMatch, code = ValueCode(v, extraBits);
+				writer.Flush();
+				litLens.Encode(writer, LiteralCount + code);
+				writer.Write(v & ((size_t(1)<<extraBits) - 1), extraBits);
+				writer.Flush();
+				v = ts[i].Distance - 1;
+				code = ValueCode(v, extraBits);
+				dists.Encode(writer, code);
+				writer.Write(v & ((size_t(1)<<extraBits) - 1), extraBits);
+				pending = Huffman::MaxCodeLength + extraBits;
+			}
+			writer.Finish();
+			out.Remove(start + 1 + bytes, sizeof(BitWriter::WordType));
+		}
+		void DecodeBlock(const unsigned char *src, size_t size, unsigned char *out, size_t n) {
+			if (size == 0 || src[0] > CodedBlock || (src[0] == StoredBlock && size - 1 != n)) {
+				throw InvalidArgumentException(_TEXT("corrupted data"));
+			}
+			if (src[0] == StoredBlock) {
+				memcpy(out, src + 1, n);
+				return;
+			}
+			BitReader reader(src + 1, size - 1);
+			unsigned char lengths[LitLenCount + ValueCodeCount];
+			for (size_t i = 0; i < LitLenCount + ValueCodeCount; ++i) {
+				lengths[i] = static_cast<unsigned char>(reader.Read(4));
+			}
+			Huffman::Decoder litLens(lengths, LitLenCount), dists(lengths + LitLenCount, ValueCodeCount);
+			for (size_t o = 0; o < n; ) {
+				reader.Refill();
+				size_t sym = litLens.Decode(reader);
+				if (sym < LiteralCount) {
+					out[o++] = static_cast<unsigned char>(sym);
+					continue;
+				}
+				size_t len = ReadValue(reader, sym - LiteralCount) + MinMatch;
+				reader.Refill();
+				size_t dist = ReadValue(reader, dists.Decode(reader)) + 1;
+				if (dist > o || len > n - o) {
+					throw InvalidArgumentException(_TEXT("corrupted data"));
+				}
+				unsigned char *to = out + o;
+				const unsigned char *from = to - dist;
+				if (dist >= len) {
+					memcpy(to, from, len);
+				} else if (dist == 1) {
+					memset(to, *from, len);
 				} else {
-					tar = &((*tar)->_left);
+					for (size_t i = 0; i < len; ++i) { // the match overlaps what it writes
+						to[i] = from[i];
+					}
 				}
-				if (!(*tar)) {
-					(*tar) = new (GlobalAllocator::Allocate(sizeof(Node))) Node(0);
-					(*tar)->_father = father;
+				o += len;
+			}
+			if (reader.IsOverrun()) {
+				throw InvalidArgumentException(_TEXT("corrupted data"));
+			}
+		}
+
+		void PutNumber(unsigned char *p, unsigned long long v, size_t bytes) {
+			for (size_t i = 0; i < bytes; ++i, v >>= 8) {
+				p[i] = static_cast<unsigned char>(v);
+			}
+		}
+		unsigned long long GetNumber(const unsigned char *p, size_t bytes) {
+			unsigned long long v = 0;
+			for (size_t i = bytes; i > 0; --i) {
+				v = (v<<8) | p[i - 1];
+			}
+			return v;
+		}
+		size_t CountBlocks(unsigned long long size, size_t blockSize) {
+			if (blockSize == 0 || blockSize > BlockZipper::MaxBlockSize) {
+				throw InvalidArgumentException(_TEXT("invalid block size"));
+			}
+			unsigned long long count = (size + blockSize - 1) / blockSize;
+			if (count > (~size_t(0) - BlockHeaderSize) / 8) {
+				throw OverflowException(_TEXT("too many blocks"));
+			}
+			return static_cast<size_t>(count);
+		}
+		void MakeHeader(
+			size_t blockSize, unsigned long long size, const unsigned long long *ends, size_t count, List<unsigned char> &out
+		) {
+			size_t start = out.Count();
+			out.PushBack(0, BlockHeaderSize + count * 8);
+			unsigned char *os = &out.At(start);
+			memcpy(os, "DEZB", 4);
+			PutNumber(os + 4, BlockVersion, 4);
+			PutNumber(os + 8, blockSize, 8);
+			PutNumber(os + 16, size, 8);
+			PutNumber(os + 24, count, 8);
+			for (size_t i = 0; i < count; ++i) {
+				PutNumber(os + BlockHeaderSize + i * 8, ends[i], 8);
+			}
+		}
+		// compresses the blocks of the data into a list for each, with the scratch of a thread for each thread
+		void ZipBlocks(
+			const unsigned char *data, size_t size, size_t blockSize, List<unsigned char> *outs,
+			List<BlockScratch> &scratch, ThreadPool &p
+		) {
+			size_t count = (size + blockSize - 1) / blockSize;
+			BlockScratch *ss = &scratch.At(0);
+			std::atomic<size_t> next {0};
+			p.ParallelFor(Math::Min(scratch.Count(), count), [&](size_t t) {
+				for (size_t i; (i = next++) < count; ) {
+					size_t start = i * blockSize;
+					outs[i].Remove(0, outs[i].Count());
+					EncodeBlock(data + start, Math::Min(blockSize, size - start), ss[t], outs[i]);
 				}
-            }
-            if (target->_code.GetAt(tcnt)) {
-				(*tar)->_right = target;
-            } else {
-            	(*tar)->_left = target;
-            }
+			});
 		}
 
-		BitSet Zipper::Zip() const {
-			Node *ns[256];
-			size_t has = 256;
-			for (size_t i = 0; i < 256; ++i) { // allocate nodes
-				ns[i] = new (GlobalAllocator::Allocate(sizeof(Node))) Node(i);
+		void BlockZipper::Zip(const void *data, size_t size, List<unsigned char> &out, size_t blockSize, ThreadPool *pool) {
+			ThreadPool &p = (pool ? *pool : ThreadPool::Default());
+			size_t count = CountBlocks(size, blockSize);
+			List<unsigned long long, true> ends;
+			if (count > 0) {
+				ends.PushBack(0, count);
+				List<BlockScratch> scratch(BlockScratch(), p.GetThreadCount());
+				List<List<unsigned char>> outs(List<unsigned char>(), count);
+				ZipBlocks(static_cast<const unsigned char*>(data), size, blockSize, &outs.At(0), scratch, p);
+				for (size_t i = 0, end = 0; i < count; ++i) {
+					end += outs[i].Count();
+					ends[i] = end;
+				}
+				MakeHeader(blockSize, size, *ends, count, out);
+				for (size_t i = 0; i < count; ++i) {
+					out.PushBackRange(outs[i]);
+				}
+			} else {
+				MakeHeader(blockSize, size, *ends, count, out);
+			}
+		}
+		void BlockZipper::Zip(FileAccess &in, FileAccess &out, size_t blockSize, ThreadPool *pool) {
+			ThreadPool &p = (pool ? *pool : ThreadPool::Default());
+			unsigned long long size =
+				static_cast<unsigned long long>(in.GetSize()) - static_cast<unsigned long long>(in.GetPosition());
+			size_t count = CountBlocks(size, blockSize), batch = p.GetThreadCount() * BatchBlocksPerThread;
+			List<unsigned long long, true> ends;
+			if (count > 0) {
+				ends.PushBack(0, count);
 			}
-			for (size_t i = 0; i < _data.Count(); ++i) { // frequency of each key
-                ++(ns[_data[i]]->_occ);
+			List<unsigned char> header;
+			MakeHeader(blockSize, size, *ends, count, header); // written again with the ends at the end
+			fpos_t headerPos = out.GetPosition();
+			out.WriteBinaryRaw(*header, header.Count());
+			if (count == 0) {
+				return;
 			}
-			PriorityQueue<Node*, true, NodeComparer> q;
-			for (size_t i = 0; i < 256; ++i) {
-				if (ns[i]->_occ > 0) { // push it into the priority queue
-					q.Insert(ns[i]);
-				} else { // the node is of no use
-					--has;
-					ns[i]->~Node();
-					GlobalAllocator::Free(ns[i]);
-					ns[i] = nullptr;
+			List<BlockScratch> scratch(BlockScratch(), p.GetThreadCount());
+			List<List<unsigned char>> outs(List<unsigned char>(), batch);
+			List<unsigned char> raw(0, static_cast<size_t>(Math::Min<unsigned long long>(size, batch * blockSize)));
+			unsigned long long end = 0;
+			for (size_t first = 0; first < count; first += batch) {
+				size_t n = Math::Min(batch, count - first);
+				size_t bytes = static_cast<size_t>(Math::Min<unsigned long long>(
+					static_cast<unsigned long long>(n) * blockSize, size - static_cast<unsigned long long>(first) * blockSize
+				));
+				if (in.ReadBinaryRaw(*raw, bytes) != bytes) {
+					throw SystemException(_TEXT("cannot read the input"));
+				}
+				ZipBlocks(*raw, bytes, blockSize, &outs.At(0), scratch, p);
+				for (size_t i = 0; i < n; ++i) {
+					const List<unsigned char> &block = outs[i];
+					out.WriteBinaryRaw(*block, block.Count());
+					end += block.Count();
+					ends[first + i] = end;
 				}
 			}
-			while (q.Count() > 1) { // build the tree
-				q.Insert(Node::Combine(q.ExtractMax(), q.ExtractMax()));
+			fpos_t endPos = out.GetPosition();
+			header.Clear();
+			MakeHeader(blockSize, size, *ends, count, header);
+			out.SetPosition(headerPos);
+			out.WriteBinaryRaw(*header, header.Count());
+			out.SetPosition(endPos);
+		}
+
+		BlockUnzipper::BlockUnzipper(const void *dataV, size_t size) {
+			const unsigned char *data = static_cast<const unsigned char*>(dataV);
+			if (size < BlockHeaderSize) {
+				throw InvalidArgumentException(_TEXT("corrupted data"));
+			}
+			size_t count = ReadHeader(data);
+			if (count > (size - BlockHeaderSize) / 8) {
+				throw InvalidArgumentException(_TEXT("corrupted data"));
 			}
-			Node *root = q.ExtractMax();
-			Node::GenCodeForTree(root);
+			ReadEnds(data + BlockHeaderSize, count);
+			_data = data + BlockHeaderSize + count * 8;
+			if (count > 0 && _ends.Last() > size - BlockHeaderSize - count * 8) {
+				throw InvalidArgumentException(_TEXT("corrupted data"));
+			}
+		}
+		BlockUnzipper::BlockUnzipper(FileAccess &file) : _file(&file) {
+			unsigned char header[BlockHeaderSize];
+			if (file.ReadBinaryRaw(header, BlockHeaderSize) != BlockHeaderSize) {
+				throw InvalidArgumentException(_TEXT("corrupted data"));
+			}
+			size_t count = ReadHeader(header);
+			List<unsigned char> ends;
+			if (count > 0) {
+				ends.PushBack(0, count * 8);
+			}
+			if (file.ReadBinaryRaw(*ends, ends.Count()) != ends.Count()) {
+				throw InvalidArgumentException(_TEXT("corrupted data"));
+			}
+			ReadEnds(*ends, count);
+			_base = static_cast<unsigned long long>(file.GetPosition());
+		}
 
-			// generate code
-			BitSet ret;
-			ret.PushBackBits(&has, sizeof(size_t) << 3); // available nodes
-			for (size_t i = 0; i < 256; ++i) {
-				if (ns[i]) {
-					ret.PushBackBits(&(ns[i]->_val), sizeof(unsigned char) << 3); // value of node
-					unsigned char x = ns[i]->_code.Count();
-					ret.PushBackBits(&x, sizeof(unsigned char) << 3); // length of code
-					ret.PushBackBits(ns[i]->_code); // code of node
+		size_t BlockUnzipper::ReadHeader(const unsigned char *header) {
+			if (memcmp(header, "DEZB", 4) != 0 || GetNumber(header + 4, 4) != BlockVersion) {
+				throw InvalidArgumentException(_TEXT("not a block container"));
+			}
+			unsigned long long blockSize = GetNumber(header + 8, 8), count = GetNumber(header + 24, 8);
+			if (blockSize == 0 || blockSize > BlockZipper::MaxBlockSize) {
+				throw InvalidArgumentException(_TEXT("corrupted data"));
+			}
+			_blockSize = static_cast<size_t>(blockSize);
+			_size = GetNumber(header + 16, 8);
+			if (count != CountBlocks(_size, _blockSize)) {
+				throw InvalidArgumentException(_TEXT("corrupted data"));
+			}
+			return static_cast<size_t>(count);
+		}
+		void BlockUnzipper::ReadEnds(const unsigned char *ends, size_t count) {
+			_ends.Clear();
+			for (size_t i = 0; i < count; ++i) {
+				unsigned long long end = GetNumber(ends + i * 8, 8);
+				if (end <= (i > 0 ? _ends[i - 1] : 0)) { // every block takes a byte at least
+					throw InvalidArgumentException(_TEXT("corrupted data"));
 				}
+				_ends.PushBack(end);
 			}
-			size_t len = _data.Count();
-			ret.PushBackBits(&len, sizeof(size_t) << 3);
-			for (size_t i = 0; i < len; ++i) { // data
-				ret.PushBackBits(ns[_data[i]]->_code);
+		}
+		size_t BlockUnzipper::GetBlockLength(size_t i) const {
+			return static_cast<size_t>(Math::Min<unsigned long long>(
+				_blockSize, _size - static_cast<unsigned long long>(i) * _blockSize
+			));
+		}
+
+		const unsigned char *BlockUnzipper::GetBlocks(size_t first, size_t count, List<unsigned char> &buffer) const {
+			unsigned long long start = (first > 0 ? _ends[first - 1] : 0);
+			if (_data) {
+				return _data + start;
 			}
-			Node::FreeTree(root);
-			return ret;
+			size_t size = static_cast<size_t>(_ends[first + count - 1] - start);
+			buffer.Remove(0, buffer.Count());
+			buffer.PushBack(0, size);
+			_file->SetPosition(static_cast<fpos_t>(_base + start));
+			if (_file->ReadBinaryRaw(*buffer, size) != size) {
+				throw InvalidArgumentException(_TEXT("corrupted data"));
+			}
+			return *buffer;
 		}
-		List<unsigned char> Unzipper::Unzip() const {
-			size_t availN, pos = 0;
-			_data.Subsequence(&availN, pos, sizeof(size_t) << 3); // node count
-			pos += sizeof(size_t) << 3;
-			List<Node*> ns;
-			for (size_t i = 0; i < availN; ++i) { // read all nodes
-				unsigned char len;
-				Node *n = new (GlobalAllocator::Allocate(sizeof(Node))) Node(0);
-				_data.Subsequence(&(n->_val), pos, sizeof(unsigned char) << 3);
-				pos += sizeof(unsigned char) << 3;
-				_data.Subsequence(&len, pos, sizeof(unsigned char) << 3);
-				pos += sizeof(unsigned char) << 3;
-				n->_code = _data.Subsequence(pos, len);
-				pos += len;
-				ns.PushBack(n);
-			}
-			// build the tree
-			Node *root = new (GlobalAllocator::Allocate(sizeof(Node))) Node(0);
-			for (size_t i = 0; i < ns.Count(); ++i) {
-				Node::Insert(root, ns[i]);
-			}
-			size_t len;
-			_data.Subsequence(&len, pos, sizeof(size_t) << 3); // length of file
-			pos += sizeof(size_t) << 3;
-			// read the file and convert
-			List<unsigned char> ret;
-			for (size_t i = 0; i < len; ++i) {
-				Node *cur = root;
-                while (cur->_left || cur->_right) {
-					if (_data.GetAt(pos)) {
-						cur = cur->_right;
-					} else {
-						cur = cur->_left;
-					}
-					++pos;
-                }
-                ret.PushBack(cur->_val);
+		void BlockUnzipper::UnzipBlocks(
+			size_t first, size_t count, const unsigned char *src, unsigned char *dst, ThreadPool &p
+		) const {
+			const unsigned long long *ends = *_ends, base = (first > 0 ? ends[first - 1] : 0);
+			p.ParallelFor(count, [&](size_t i) {
+				size_t b = first + i;
+				unsigned long long start = (b > 0 ? ends[b - 1] : 0);
+				DecodeBlock(src + (start - base), static_cast<size_t>(ends[b] - start), dst + i * _blockSize, GetBlockLength(b));
+			});
+		}
+
+		void BlockUnzipper::UnzipBlock(size_t i, List<unsigned char> &out) const {
+			if (i >= _ends.Count()) {
+				throw OverflowException(_TEXT("index overflow"));
+			}
+			List<unsigned char> buffer;
+			const unsigned char *src = GetBlocks(i, 1, buffer);
+			unsigned long long start = (i > 0 ? _ends[i - 1] : 0);
+			size_t n = GetBlockLength(i), outStart = out.Count();
+			out.PushBack(0, n);
+			DecodeBlock(src, static_cast<size_t>(_ends[i] - start), &out.At(outStart), n);
+		}
+		void BlockUnzipper::Unzip(List<unsigned char> &out, ThreadPool *pool) const {
+			ThreadPool &p = (pool ? *pool : ThreadPool::Default());
+			size_t count = _ends.Count(), start = out.Count();
+			if (count == 0) {
+				return;
+			}
+			if (_size > ~size_t(0) - start) {
+				throw OverflowException(_TEXT("the data doesn't fit in memory"));
+			}
+			out.PushBack(0, static_cast<size_t>(_size));
+			unsigned char *os = &out.At(start);
+			size_t batch = (_data ? count : p.GetThreadCount() * BatchBlocksPerThread);
+			List<unsigned char> buffer;
+			for (size_t first = 0; first < count; first += batch) {
+				size_t n = Math::Min(batch, count - first);
+				UnzipBlocks(first, n, GetBlocks(first, n, buffer), os + first * _blockSize, p);
+			}
+		}
+		void BlockUnzipper::Unzip(FileAccess &out, ThreadPool *pool) const {
+			ThreadPool &p = (pool ? *pool : ThreadPool::Default());
+			size_t count = _ends.Count(), batch = p.GetThreadCount() * BatchBlocksPerThread;
+			if (count == 0) {
+				return;
+			}
+			List<unsigned char> buffer, raw(0, static_cast<size_t>(Math::Min<unsigned long long>(_size, batch * _blockSize)));
+			for (size_t first = 0; first < count; first += batch) {
+				size_t n = Math::Min(batch, count - first);
+				UnzipBlocks(first, n, GetBlocks(first, n, buffer), *raw, p);
+				out.WriteBinaryRaw(*raw, (n - 1) * _blockSize + GetBlockLength(first + n - 1));
 			}
-			Node::FreeTree(root);
-			return ret;
 		}
 	}
 }
@@ -1,14 +1,18 @@
 #pragma once
 
+#include <cstdio>
+
 #include "Math.h"
 #include "BitSet.h"
-#include "PriorityQueue.h"
+#include "ThreadPool.h"
 
 namespace DE {
 	namespace IO {
-		class Unzipper;
+		class FileAccess;
+
+		// compresses data with a canonical Huffman code over its bytes. the compressed data starts with its length in 64
+		// bits, followed by the lengths of the codes of the 256 bytes in 4 bits each, and then the codes
 		class Zipper {
-				friend class Unzipper;
 			public:
 				Core::Collections::List<unsigned char> &Data() {
 					return _data;
@@ -22,28 +26,9 @@ namespace DE {
 				}
 
 				Core::Collections::BitSet Zip() const;
+				// appends the compressed data to the list
+				static void Zip(const void*, size_t, Core::Collections::List<unsigned char>&);
 			private:
-				struct Node {
-					Node *_left = nullptr, *_right = nullptr, *_father = nullptr;
-					unsigned char _val;
-					size_t _occ = 0;
-					Core::Collections::BitSet _code;
-
-					explicit Node(unsigned char v) : _val(v) {
-					}
-
-					static void FreeTree(Node*);
-					static Node *Combine(Node*, Node*);
-					static void GenCodeForTree(Node*);
-					static void Insert(Node*, Node*);
-				};
-				class NodeComparer {
-					public:
-						static int Compare(const Node *lhs, const Node *rhs) {
-							return Core::DefaultComparer<size_t>::Compare(rhs->_occ, lhs->_occ);
-						}
-				};
-
 				Core::Collections::List<unsigned char> _data;
 		};
 		class Unzipper {
@@ -60,10 +45,72 @@ namespace DE {
 				}
 
 				Core::Collections::List<unsigned char> Unzip() const;
+				// appends the data compressed by Zipper to the list. throws InvalidArgumentException if it's corrupted
+				static void Unzip(const void*, size_t, Core::Collections::List<unsigned char>&);
 			private:
-				typedef Zipper::Node Node;
-
 				Core::Collections::BitSet _data;
 		};
+
+		// compresses data in blocks that don't depend on each other, each with LZ77 matches found through hash chains and
+		// canonical Huffman codes of its own, so that blocks are compressed and decompressed in parallel and can be read
+		// one at a time. the container starts with "DEZB", the version in 4 bytes, and the block size, the size of the
+		// data and the number of blocks in 8 bytes each, followed by the end of each block in 8 bytes, counted from the end
+		// of the header. all numbers are little-endian
+		class BlockZipper {
+			public:
+				constexpr static size_t DefaultBlockSize = 256<<10, MaxBlockSize = 1<<24;
+
+				// appends the container to the list, using the threads of the pool (ThreadPool::Default() if none)
+				static void Zip(
+					const void*, size_t, Core::Collections::List<unsigned char>&,
+					size_t blockSize = DefaultBlockSize, Core::ThreadPool *pool = nullptr
+				);
+				// compresses the input from its position to its end, holding a few blocks for each thread in memory. the
+				// output must be seekable, as the header is written again once the ends of the blocks are known
+				static void Zip(
+					FileAccess &in, FileAccess &out, size_t blockSize = DefaultBlockSize, Core::ThreadPool *pool = nullptr
+				);
+		};
+		// reads a container written by BlockZipper, from memory or from a file. throws InvalidArgumentException for a header
+		// or a block that BlockZipper can't have written; there are no checksums, so other damage goes unnoticed
+		class BlockUnzipper {
+			public:
+				// the data isn't copied, and must outlive this
+				BlockUnzipper(const void*, size_t);
+				// reads the header from the position of the file, which must stay open while this is used. the blocks are
+				// read when they're needed, so this must not be used from more than one thread at once
+				explicit BlockUnzipper(FileAccess&);
+
+				unsigned long long GetSize() const {
+					return _size;
+				}
+				size_t GetBlockSize() const {
+					return _blockSize;
+				}
+				size_t GetBlockCount() const {
+					return _ends.Count();
+				}
+
+				// appends the data of a single block to the list
+				void UnzipBlock(size_t, Core::Collections::List<unsigned char>&) const;
+				// appends all the data to the list, using the threads of the pool (ThreadPool::Default() if none)
+				void Unzip(Core::Collections::List<unsigned char>&, Core::ThreadPool *pool = nullptr) const;
+				// writes all the data to the file, holding a few blocks for each thread in memory
+				void Unzip(FileAccess&, Core::ThreadPool *pool = nullptr) const;
+			private:
+				const unsigned char *_data = nullptr; // the blocks, if they are in memory
+				FileAccess *_file = nullptr;
+				unsigned long long _base = 0, _size = 0; // where the blocks start in the file
+				size_t _blockSize = 0;
+				Core::Collections::List<unsigned long long, true> _ends;
+
+				// checks the fixed part of the header, and returns the number of blocks
+				size_t ReadHeader(const unsigned char*);
+				void ReadEnds(const unsigned char*, size_t count);
+				size_t GetBlockLength(size_t) const;
+				// the compressed blocks [first, first + count), read into the buffer if they're in a file
+				const unsigned char *GetBlocks(size_t first, size_t count, Core::Collections::List<unsigned char>&) const;
+				void UnzipBlocks(size_t first, size_t count, const unsigned char*, unsigned char*, Core::ThreadPool&) const;
+		};
 	}
 }
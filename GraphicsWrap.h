@@ -2,6 +2,7 @@
 
 #include "Engine/DirectDraw9Context.h"
 #include "Engine/GLContext.h"
+#include "Engine/SoftwareContext.h"
 #include "Engine/RenderingContext.h"
 #include "Engine/BMPFont.h"
 #include "Engine/BMPFontGenerator.h"
@@ -10,4 +11,5 @@
 #include "Engine/Atlas.h"
 #include "Engine/BrushAndPen.h"
 #include "Engine/Renderer.h"
+#include "Engine/ImageFilters.h"
 #include "Engine/AutoFont.h"
@@ -1,5 +1,7 @@
 #pragma once
 
 #include "Engine/FileAccess.h"
+#include "Engine/BitStream.h"
+#include "Engine/Huffman.h"
 #include "Engine/Zipper.h"
 #include "Engine/Clipboard.h"
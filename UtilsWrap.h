@@ -3,4 +3,6 @@
 #include "Engine/Bezier.h"
 #include "Engine/CharacterPhysics.h"
 #include "Engine/LightCaster.h"
-#include "Engine/MazeGenerator.h"
\ No newline at end of file
+#include "Engine/MazeGenerator.h"
+#include "Engine/Pathfinding.h"
+#include "Engine/RigidBody.h"
\ No newline at end of file
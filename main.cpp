@@ -48,6 +48,7 @@ class Test {
 				}
 				Update(stw.TickInSeconds());
 				Render();
+				FrameArena::Current().Reset();
 			}
 		}
 
@@ -67,7 +68,7 @@ class ControlTest : public Test {
 		class RunningBFCommand : public RunningCommand {
 			public:
 				RunningBFCommand(const List<String>&, ControlTest &test) : _father(test) {
-					String rawProg = _father.tBox.Text().Content;
+					String rawProg = _father.tBox.Text().Content.ToString();
 					for (size_t i = 0; i < rawProg.Length(); ++i) {
 						TCHAR c = rawProg[i];
 						if (
@@ -835,7 +836,8 @@ class ControlTest : public Test {
 						_TEXT("FPS:\t\t\t\t") + ToString(counter.GetFPS()) + _TEXT("\n") +
 						_TEXT("Average FPS:\t\t") + ToString(counter.GetAverageFPS()) + _TEXT("\n") +
 						_TEXT("Memory Usage:\t\t") + ToString(GlobalAllocator::UsedSize()) + _TEXT("\n") +
-						_TEXT("Memory Allocated:\t") + ToString(GlobalAllocator::AllocatedSize()) + _TEXT("\n")
+						_TEXT("Memory Allocated:\t") + ToString(GlobalAllocator::AllocatedSize()) + _TEXT("\n") +
+						_TEXT("Arena Allocations:\t") + ToString(FrameArena::Current().GetLastFrameAllocationCount()) + _TEXT("\n")
 					);
 					return 0;
 				});
@@ -850,7 +852,6 @@ class ControlTest : public Test {
 				return new (GlobalAllocator::Allocate(sizeof(SimpleRunningCommand))) SimpleRunningCommand(args, [&](const List<String> &args) {
 					if (args.Count() == 4) {
 						if (args[1] == _TEXT("z")) {
-							Zipper zp;
 							AsciiString
 								from = NarrowString(args[2]),
 								to = NarrowString(args[3]);
@@ -867,15 +868,14 @@ class ControlTest : public Test {
 								runner.WriteLine(_TEXT("cannot read the whole file"));
 								return -1;
 							}
-							zp.SetData(data, sz);
+							List<unsigned char> zipped;
+							Zipper::Zip(data, sz, zipped);
 							GlobalAllocator::Free(data);
-							BitSet bs = zp.Zip();
 							FileAccess w(to, FileAccessType::NewWriteBinary);
-							w.WriteBinaryRaw(*bs, sizeof(BitSet::ChunkType) * bs.ChunkCount());
-							runner.WriteLine(_TEXT("file successfully zipped, zipped size: ") + ToString(bs.ChunkCount()) + _TEXT(" bytes"));
+							w.WriteBinaryRaw(*zipped, zipped.Count());
+							runner.WriteLine(_TEXT("file successfully zipped, zipped size: ") + ToString(zipped.Count()) + _TEXT(" bytes"));
 							return 0;
 						} else if (args[1] == _TEXT("u")) {
-							Unzipper uzp;
 							AsciiString
 								from = NarrowString(args[2]),
 								to = NarrowString(args[3]);
@@ -892,16 +892,34 @@ class ControlTest : public Test {
 								runner.WriteLine(_TEXT("cannot read the whole file"));
 								return -1;
 							}
-							uzp.SetData(data, sz);
+							List<unsigned char> res;
+							Unzipper::Unzip(data, sz, res);
 							GlobalAllocator::Free(data);
-							List<unsigned char> res = uzp.Unzip();
 							FileAccess rt(to, FileAccessType::NewWriteBinary);
 							rt.WriteBinaryRaw(*res, sizeof(unsigned char) * res.Count());
 							runner.WriteLine(_TEXT("file successfully unzipped, unzipped size: ") + ToString(res.Count()) + _TEXT(" bytes"));
 							return 0;
+						} else if (args[1] == _TEXT("bz") || args[1] == _TEXT("bu")) { // block containers, streamed between the files
+							AsciiString
+								from = NarrowString(args[2]),
+								to = NarrowString(args[3]);
+							if (!FileAccess::Exists(from)) {
+								runner.SetCursorColor(Color(255, 0, 0, 255));
+								runner.WriteLine(_TEXT("file ") + args[2] + _TEXT(" does not exist"));
+								return -1;
+							}
+							FileAccess r(from, FileAccessType::ReadBinary), w(to, FileAccessType::NewWriteBinary);
+							if (args[1] == _TEXT("bz")) {
+								BlockZipper::Zip(r, w);
+								runner.WriteLine(_TEXT("file successfully zipped"));
+							} else {
+								BlockUnzipper(r).Unzip(w);
+								runner.WriteLine(_TEXT("file successfully unzipped"));
+							}
+							return 0;
 						}
 					}
-					runner.WriteLine(_TEXT("Usage: zip [z / u] (source file name) (target file name)"));
+					runner.WriteLine(_TEXT("Usage: zip [z / u / bz / bu] (source file name) (target file name)"));
 					return 0;
 				});
 			}));
@@ -1109,7 +1127,7 @@ class LightTest : public Test {
 			vs.Clear();
 			Color c(255, 0, 0, 255);
 			l.Position = phys.Characters()[0].Position;
-			List<LightCaster::CastResult> res = caster.Cast(l);
+			List<LightCaster::CastResult> res = caster.Cast(l, lightCache);
 			if (mode == RenderMode::Lines) {
 //				for (size_t i = 0; i < res.Count(); ++i) {
 //					const LightCaster::CastResult &cRes = res[i];
@@ -1196,9 +1214,10 @@ class LightTest : public Test {
 			if (rw) {
 				List<Vertex> vw;
 				Color c(0, 255, 0, 255);
-				for (size_t i = 0; i < caster.Walls().Count(); ++i) {
-					vw.PushBack(Vertex(caster.Walls()[i].Node1, c));
-					vw.PushBack(Vertex(caster.Walls()[i].Node2, c));
+				const List<LightCaster::Wall> &walls = static_cast<const Caster&>(caster).Walls();
+				for (size_t i = 0; i < walls.Count(); ++i) {
+					vw.PushBack(Vertex(walls[i].Node1, c));
+					vw.PushBack(Vertex(walls[i].Node2, c));
 				}
 				r.SetLineWidth(1.0);
 				r.DrawVertices(vw, RenderMode::Lines);
@@ -1229,11 +1248,16 @@ class LightTest : public Test {
 		int curRN = 0;
 
 		Caster caster;
+		CastCache lightCache; // reused while the character stands still
 		Environment phys;
 
-		void ShuffleWalls() {
+		void ClearWalls() {
 			caster.Walls().Clear();
+			caster.MarkWallsChanged();
 			phys.Walls().Clear();
+		}
+		void ShuffleWalls() {
+			ClearWalls();
 			for (size_t i = 0; i < 20; ++i) {
 				SpawnWall(
 					Vector2(random.NextDouble() * 600, random.NextDouble() * 600),
@@ -1241,8 +1265,7 @@ class LightTest : public Test {
 			}
 		}
 		void GenerateWave(const Vector2 &start, double stretch, double ymult, double lmult, double partl) {
-			caster.Walls().Clear();
-			phys.Walls().Clear();
+			ClearWalls();
 			double lastv = 0.0;
 			for (double x = partl; x < stretch; x += partl) {
 				double curv = sin(x * lmult) * ymult;
@@ -1254,8 +1277,7 @@ class LightTest : public Test {
 			}
 		}
 		void GenerateMaze(size_t w, size_t h, Method met, const Vector2 &pos, double pathThickness) {
-			caster.Walls().Clear();
-			phys.Walls().Clear();
+			ClearWalls();
 			List<BlockID> bs;
 			BlockID ncc;
 			for (ncc.Y = 5; ncc.Y < 15; ++ncc.Y) {
@@ -1321,8 +1343,7 @@ class LightTest : public Test {
 			return pos;
 		}
 		void GenerateHDMaze(size_t w, size_t h, Method met, const Vector2 &pos, double pathThickness, double wallThickess) {
-			caster.Walls().Clear();
-			phys.Walls().Clear();
+			ClearWalls();
 			List<BlockID> bs;
 			BlockID ncc;
 			for (ncc.Y = 5; ncc.Y < 15; ++ncc.Y) {
@@ -1384,8 +1405,7 @@ class LightTest : public Test {
 				Vector2(pos.X - hwt, pos.Y + pathThickness - hwt));
 		}
 		void ShuffleCells(double poss = 0.6) {
-			caster.Walls().Clear();
-			phys.Walls().Clear();
+			ClearWalls();
 			for (double x = 40.0; x <= 400.0; x += 40.0) {
 				for (double y = 40.0; y <= 400.0; y += 40.0) {
 					if (random.NextDouble() < poss) {
@@ -1411,6 +1431,7 @@ class LightTest : public Test {
 			lcw.Node2 = v2;
 //			lcw.IsMirror = true;
 			caster.Walls().PushBack(lcw);
+			caster.MarkWallsChanged();
 			CharacterPhysics::Wall cpw;
 			cpw.Node1 = v1;
 			cpw.Node2 = v2;
@@ -1438,16 +1459,16 @@ class PhysicsTest : public Test {
 
 		PhysicsTest() : Test(), fnt(&context) {
 			fnt.Face = FontFace("Inconsolata.otf", 20.0);
-			for (size_t i = 0; i < 1; ++i) {
+			for (size_t i = 0; i < 10; ++i) {
 				Body p1;
-				size_t splits = 4;
+				size_t splits = 3 + i % 5;
 				double pof = Pi * 2.0 / splits, ang = 0.0;
 				for (size_t i = 0; i < splits; ++i, ang += pof) {
-					p1.Shape.Points.PushBack(0.3 * Vector2(cos(ang), sin(ang)));
+					p1.Shape.Points.PushBack(0.2 * Vector2(cos(ang), sin(ang)));
 				}
-				p1.Offset.Y = 1.0;
+				p1.Offset = Vector2(0.45 * (i % 5) - 0.9, 0.5 + 0.5 * (i / 5));
 				p1.ComputeMassInfo();
-				bs.PushBack(p1);
+				phys.Bodies().PushBack(p1);
 			}
 
 			{
@@ -1459,7 +1480,7 @@ class PhysicsTest : public Test {
 				p2.Offset.Y = -0.3;
 				p2.ComputeMassInfo();
 				p2.Type = BodyType::Static;
-				bs.PushBack(p2);
+				phys.Bodies().PushBack(p2);
 			}
 
 			window.ClientSize = Screen;
@@ -1480,14 +1501,18 @@ class PhysicsTest : public Test {
 			sld.SetMaxValue(1.0);
 			sld.ValueChanged += [&](const Info&) {
 				e = sld.GetValue();
+				phys.Bodies().ForEach([&](Body &b) {
+					b.Restitution = e;
+					return true;
+				});
 			};
 			world.SetChild(&sld);
 
 			window.MouseDown += [&](const MouseButtonInfo&) {
 				focus = nullptr;
-				for (size_t i = 0; i < bs.Count(); ++i) {
-					if (bs[i].HitTest(mpos)) {
-						focus = &bs[i];
+				for (size_t i = 0; i < phys.Bodies().Count(); ++i) {
+					if (phys.Bodies()[i].HitTest(mpos)) {
+						focus = &phys.Bodies()[i];
 						break;
 					}
 				}
@@ -1528,31 +1553,13 @@ class PhysicsTest : public Test {
 				spdat = spdat * focus->AngularSpeed + focus->DirectionToShapeCoordinates(focus->Speed);
 				focus->ApplyImpulse(drpos, ((focus->PointToShapeCoordinates(mpos) - drpos) * 100.0 - spdat * 10.0) * dt);
 			}
-			for (size_t i = 0; i < bs.Count(); ++i) {
-				Correct(bs[i].Offset, bs[i].Speed);
-				bs[i].Update(dt);
-//				if (bs[i].Type == BodyType::Dynamic) {
-//					bs[i].Speed += Vector2(0.0, -10.0) * dt;
-//				}
-			}
-			for (size_t i = 0; i < bs.Count(); ++i) {
-				for (size_t j = i + 1; j < bs.Count(); ++j) {
-					Body &p1 = bs[i], &p2 = bs[j];
-					List<NodeInfo> ni = GJK(p1, p2);
-					if (ni.Count() > 0) {
-						Segment sg = EPAClockwise(ni, p1, p2);
-						Vector2
-							cp = (
-								sg.P1.ID1 == sg.P2.ID1 ?
-								p1.PointToWorldCoordinates(p1.Shape.Points[sg.P1.ID1]) :
-								p2.PointToWorldCoordinates(p2.Shape.Points[sg.P1.ID2])
-							),
-							n = sg.P2.Position - sg.P1.Position;
-						n.RotateRight90();
-						pen = SolveCollision(p1, p2, cp, n, e, 0.5);
-					}
+			phys.Bodies().ForEach([&](Body &b) {
+				if (b.Type == BodyType::Dynamic) {
+					Correct(b.Offset, b.Speed);
 				}
-			}
+				return true;
+			});
+			phys.Update(dt);
 			world.Update(dt);
 		}
 
@@ -1570,21 +1577,22 @@ class PhysicsTest : public Test {
 			t.HorizontalAlignment = HorizontalTextAlignment::Left;
 			t.VerticalAlignment = VerticalTextAlignment::Top;
 			double energy = 0.0;
-			bs.ForEach([&](const Body &b) {
+			phys.Bodies().ForEach([&](const Body &b) {
 				energy += b.GetEnergy();
 				return true;
 			});
 			t.Content =
 				_TEXT("Total Energy: ") + ToString(energy) + _TEXT("\n") +
 				_TEXT("e: ") + ToString(e) + _TEXT("\n") +
+				_TEXT("Awake: ") + ToString(phys.GetAwakeCount()) + _TEXT("\n") +
 				_TEXT("FPS: ") + ToString(counter.GetFPS());
 			t.Render(r);
 
 			r.SetViewbox(Viewbox);
 
 			List<Vertex> vxs;
-			bs.ForEach([&](const Body &b) {
-				DrawPolygon(b, Color(255, 255, 255, 255));
+			phys.Bodies().ForEach([&](const Body &b) {
+				DrawPolygon(b, b.Awake || b.Type == BodyType::Static ? Color(255, 255, 255, 255) : Color(120, 120, 120, 255));
 				return true;
 			});
 			if (focus) {
@@ -1597,7 +1605,7 @@ class PhysicsTest : public Test {
 			vxs.Clear();
 			vxs.PushBack(Vertex(mpos, Color(0, 255, 0, 255)));
 			vxs.PushBack(Vertex(Vector2(), Color(255, 0, 0, 255)));
-			bs.ForEach([&](const Body &b) {
+			phys.Bodies().ForEach([&](const Body &b) {
 				vxs.PushBack(Vertex(b.PointToWorldCoordinates(b.MassCenter), Color(50, 50, 255, 255)));
 				return true;
 			});
@@ -1659,108 +1667,12 @@ class PhysicsTest : public Test {
 			r.End();
 		}
 	protected:
-		struct Polygon {
-			List<Vector2> Points;
-		};
-		enum class BodyType {
-			Dynamic,
-			Static
-		};
-		struct Body {
-			Polygon Shape;
-			Vector2 Offset;
-			double Rotation = 0.0;
-
-			BodyType Type = BodyType::Dynamic;
-			double Density = 7.0, Mass = 0.0, Inertia = 0.0;
-			Vector2 MassCenter;
-
-			Vector2 Speed;
-			double AngularSpeed = 0.0;
-
-			// stuff about shape
-			List<Vector2> GetAllPoints() const {
-				List<Vector2> result = Shape.Points;
-				Vector2 rotv(cos(Rotation), sin(Rotation));
-				result.ForEach([&](Vector2 &v) {
-					v = Vector2(v.X * rotv.X - v.Y * rotv.Y, v.X * rotv.Y + v.Y * rotv.X) + Offset;
-					return true;
-				});
-				return result;
-			}
-			Vector2 PointToShapeCoordinates(const Vector2 &pos) const {
-				return DirectionToShapeCoordinates(pos - Offset);
-			}
-			Vector2 DirectionToShapeCoordinates(const Vector2 &dir) const {
-				Vector2 rotv(std::cos(Rotation), -std::sin(Rotation));
-				return Vector2(dir.X * rotv.X - dir.Y * rotv.Y, dir.X * rotv.Y + dir.Y * rotv.X);
-			}
-			Vector2 PointToWorldCoordinates(const Vector2 &pos) const {
-				return DirectionToWorldCoordinates(pos) + Offset;
-			}
-			Vector2 DirectionToWorldCoordinates(const Vector2 &dir) const {
-				Vector2 rotv(std::cos(Rotation), std::sin(Rotation));
-				return Vector2(dir.X * rotv.X - dir.Y * rotv.Y, dir.X * rotv.Y + dir.Y * rotv.X);
-			}
-
-			size_t SupportPoint(const Vector2 &dir) const {
-				Vector2 mdir = DirectionToShapeCoordinates(dir);
-				size_t pt = 0;
-				Vector2 p = ProjectionY(Shape.Points[0], mdir);
-				for (size_t i = 1; i < Shape.Points.Count(); ++i) {
-					Vector2 cpj = ProjectionY(Shape.Points[i], mdir);
-					if (Vector2::Dot(mdir, cpj - p) > 0.0) {
-						pt = i;
-						p = cpj;
-					}
-				}
-				return pt;
-			}
+		typedef RigidBody::Body Body;
+		typedef RigidBody::BodyType BodyType;
 
-			bool HitTest(const Vector2 &v) const {
-				return PolygonPointIntersect(Shape.Points, PointToShapeCoordinates(v)) == IntersectionType::Full;
-			}
-
-			// stuff about dynamics
-			void ComputeMassInfo() {
-				double totf = 0.0, totine;
-				Vector2 tp;
-				for (size_t i = 2; i < Shape.Points.Count(); ++i) {
-					Vector2 dprv = Shape.Points[i - 1] - Shape.Points[0], dcur = Shape.Points[i] - Shape.Points[0];
-					double v = Vector2::Cross(dprv, dcur);
-					totine += (dprv.LengthSquared() + dcur.LengthSquared() + Vector2::Dot(dprv, dcur)) * v;
-					tp += (Shape.Points[0] + Shape.Points[i - 1] + Shape.Points[i]) * v;
-					totf += v;
-				}
-				MassCenter = tp / (totf * 3.0);
-				Mass = Abs(totf) * 0.5 * Density;
-				Inertia = Abs(totine * Density / 12.0) - Mass * (MassCenter - Shape.Points[0]).LengthSquared();
-			}
-
-			void Update(double dt) {
-				Vector2 nmc = Offset + DirectionToWorldCoordinates(MassCenter) + Speed * dt;
-				Rotation += AngularSpeed * dt;
-				Offset = nmc - DirectionToWorldCoordinates(MassCenter);
-			}
-			void ApplyImpulse(const Vector2 &shapePos, const Vector2 &shapeImpl) {
-				if (Type == BodyType::Dynamic) {
-					Speed += DirectionToWorldCoordinates(shapeImpl) / Mass;
-					AngularSpeed += Vector2::Cross(shapePos - MassCenter, shapeImpl) / Inertia;
-				}
-			}
-
-			double GetEnergy() const {
-				if (Type == BodyType::Dynamic) {
-					return 0.5 * (Mass * Speed.LengthSquared() + AngularSpeed * AngularSpeed * Inertia);
-				}
-				return 0.0;
-			}
-		};
-
-		List<Body> bs;
+		RigidBody::World phys;
 		Body *focus = nullptr;
 		Vector2 mpos, lmpos, drpos;
-		bool pen = false;
 		double e = 0.0;
 
 		AutoFont fnt;
@@ -1771,204 +1683,25 @@ class PhysicsTest : public Test {
 		SolidBrush sldindc;
 
 		List<Vector2> MinusPolygons(const Body &lhs, const Body &rhs) {
-			List<Vector2> vl = lhs.GetAllPoints(), vr = rhs.GetAllPoints(),res;
-			vl.ForEach([&](const Vector2 &v1) {
-				vr.ForEach([&](const Vector2 &v2) {
-					res.PushBack(v1 - v2);
-					return true;
-				});
-				return true;
-			});
+			const List<Vector2> &vl = lhs.GetTransform().Points, &vr = rhs.GetTransform().Points;
+			List<Vector2> res(Vector2(), vl.Count() + vr.Count());
+			size_t count = Math::MinkowskiDifference(*vl, vl.Count(), *vr, vr.Count(), *res);
+			res.Remove(count, res.Count() - count);
 			return res;
 		}
-		List<Vector2> Hull(const List<Vector2> vxs) { // absolutely no optimization, O(n^2)
-			List<Vector2> topop = vxs;
-			for (size_t i = 1; i < topop.Count(); ++i) {
-				if (topop[i - 1].Y < topop[i].Y) {
-					topop.Swap(i - 1, i);
-				}
-			}
-			List<Vector2> result;
-			result.PushBack(topop.PopBack());
-			while (topop.Count() > 0) {
-				size_t id = 0;
-				Vector2 dir = topop[0] - result.Last();
-				for (size_t i = 1; i < topop.Count(); ++i) {
-					Vector2 cv = topop[i] - result.Last();
-					if (Vector2::Cross(dir, cv) < 0.0) {
-						id = i;
-						dir = cv;
-					}
-				}
-				if (Vector2::Cross(dir, result[0] - result.Last()) < 0.0) {
-					break;
-				}
-				topop.SwapToBack(id);
-				result.PushBack(topop.PopBack());
-			}
-			return result;
-		}
-
-		struct NodeInfo {
-			NodeInfo() = default;
-			NodeInfo(size_t id1, size_t id2, const Vector2 &pos) : ID1(id1), ID2(id2), Position(pos) {
-			}
-
-			size_t ID1 = 0, ID2 = 0;
-			Vector2 Position;
-		};
-		List<NodeInfo> GJK(const Body &p1, const Body &p2) {
-			List<NodeInfo> result;
-			NodeInfo v[3];
-			v[0].ID1 = p1.SupportPoint(Vector2(1.0, 0.0));
-			v[0].ID2 = p2.SupportPoint(Vector2(-1.0, 0.0));
-			v[0].Position = p1.PointToWorldCoordinates(p1.Shape.Points[v[0].ID1]) - p2.PointToWorldCoordinates(p2.Shape.Points[v[0].ID2]);
-			size_t vn = 1;
-			for (int x = 0; x < 100; ++x) { // NOTE an arbitary number of max iterations
-				Vector2 spdir;
-				size_t excl = vn;
-				bool fin = false;
-				switch (vn) {
-					case 1: {
-						spdir = -v[0].Position;
-						break;
-					}
-					case 2: {
-						spdir = v[1].Position - v[0].Position;
-						spdir.RotateLeft90();
-						if (Vector2::Dot(spdir, v[1].Position) > 0.0) {
-							spdir = -spdir;
-						}
-						break;
-					}
-					case 3: {
-						spdir = v[1].Position - v[0].Position;
-						spdir.RotateLeft90();
-						if (Vector2::Dot(spdir, v[1].Position) > 0.0) {
-							spdir = v[2].Position - v[1].Position;
-							spdir.RotateLeft90();
-							if (Vector2::Dot(spdir, v[1].Position) > 0.0) {
-								spdir = v[0].Position - v[2].Position;
-								spdir.RotateLeft90();
-								if (Vector2::Dot(spdir, v[0].Position) > 0.0) {
-									fin = true;
-								}
-								excl = 1;
-							} else {
-								excl = 0;
-							}
-						} else {
-							excl = 2;
-						}
-						break;
-					}
-				}
-				if (fin) {
-					result.PushBackRange(v, 3);
-					break;
-				}
-				NodeInfo ni;
-				ni.ID1 = p1.SupportPoint(spdir);
-				ni.ID2 = p2.SupportPoint(-spdir);
-				ni.Position = p1.PointToWorldCoordinates(p1.Shape.Points[ni.ID1]) - p2.PointToWorldCoordinates(p2.Shape.Points[ni.ID2]);
-				if (Vector2::Dot(spdir, ni.Position) < 0.0) { // no intersection
-					return List<NodeInfo>();
-				}
-				v[excl] = ni;
-				if (vn < 3) {
-					++vn;
-				}
-				if (vn == 3) {
-					if (Vector2::Cross(v[1].Position - v[0].Position, v[2].Position - v[0].Position) > 0.0) {
-						Swap(v[0], v[1]);
-					}
-				}
-			}
-			return result;
-		}
-		struct Segment {
-			Segment() = default;
-			Segment(const NodeInfo &i1, const NodeInfo &i2) : P1(i1), P2(i2) {
+		List<Vector2> Hull(const List<Vector2> &vxs) {
+			if (vxs.Count() == 0) {
+				return List<Vector2>();
 			}
-
-			NodeInfo P1, P2;
-		};
-		Segment EPAClockwise(const List<NodeInfo> &gjkRes, const Body &p1, const Body &p2) { // assuming gjkRes comes clockwise
-			List<Segment> segments;
-			NodeInfo last = gjkRes.Last();
-			gjkRes.ForEach([&](const NodeInfo &ni) {
-				segments.PushBack(Segment(ni, last));
-				last = ni;
-				return true;
-			});
-			for (size_t z = 0; z < 100; ++z) { // NOTE an arbitrary number of iterations
-				double minlsq;
-				size_t id = segments.Count();
-				for (size_t i = 0; i < segments.Count(); ++i) { // NOTE heaps can be used to optimize this
-					const Segment &curseg = segments[i];
-					double dsq = ProjectionX(curseg.P1.Position, curseg.P1.Position - curseg.P2.Position).LengthSquared();
-					if (id >= segments.Count() || minlsq > dsq) {
-						id = i;
-						minlsq = dsq;
-					}
-				}
-				Segment &curseg = segments[id];
-				Vector2 axis = curseg.P1.Position - curseg.P2.Position;
-				axis.RotateLeft90();
-				NodeInfo ni;
-				ni.ID1 = p1.SupportPoint(axis);
-				ni.ID2 = p2.SupportPoint(-axis);
-				if ((ni.ID1 == curseg.P1.ID1 && ni.ID2 == curseg.P1.ID2) || (ni.ID1 == curseg.P2.ID1 && ni.ID2 == curseg.P2.ID2)) {
-					return curseg;
-				}
-				ni.Position = p1.PointToWorldCoordinates(p1.Shape.Points[ni.ID1]) - p2.PointToWorldCoordinates(p2.Shape.Points[ni.ID2]);
-				segments.PushBack(Segment(ni, curseg.P2));
-				curseg.P2 = ni;
-			}
-			return Segment(); // this should never happen
-		}
-		bool SolveCollision(Body &b1, Body &b2, const Vector2 &penPt, const Vector2 &normal12, double restitution, double friction) { // TODO friction not working well
-			double invm1 = 0.0, invm2 = 0.0, invi1 = 0.0, invi2 = 0.0;
-			if (b1.Type == BodyType::Dynamic) {
-				invm1 = 1.0 / b1.Mass;
-				invi1 = 1.0 / b1.Inertia;
-			}
-			if (b2.Type == BodyType::Dynamic) {
-				invm2 = 1.0 / b2.Mass;
-				invi2 = 1.0 / b2.Inertia;
-			}
-
-			Vector2
-				r1 = penPt - b1.PointToWorldCoordinates(b1.MassCenter),
-				r2 = penPt - b2.PointToWorldCoordinates(b2.MassCenter),
-				v1 = r1,
-				v2 = r2,
-				rn = normal12;
-			v1.RotateLeft90();
-			v2.RotateLeft90();
-			rn.RotateLeft90();
-			Vector2 vdiff = v2 * b2.AngularSpeed + b2.Speed - (v1 * b1.AngularSpeed + b1.Speed);
-			if (Vector2::Dot(vdiff, normal12) >= 0.0) {
-				return false;
-			}
-			if (Vector2::Dot(vdiff, rn) >= 0.0) {
-				friction = -friction;
-			}
-			double ratio =
-				(1.0 + restitution) * Vector2::Dot(vdiff, normal12) /
-				((invm1 + invm2) * normal12.LengthSquared() + Vector2::Dot(
-					normal12,
-					v2 * (invi2 * (Vector2::Cross(r2, normal12) + friction * Vector2::Cross(r2, rn))) +
-					v1 * (invi1 * (Vector2::Cross(r1, normal12) + friction * Vector2::Cross(r1, rn)))
-				));
-			Vector2 impl = (normal12 + friction * rn) * ratio;
-			b1.ApplyImpulse(b1.PointToShapeCoordinates(penPt), b1.DirectionToShapeCoordinates(impl));
-			b2.ApplyImpulse(b2.PointToShapeCoordinates(penPt), b2.DirectionToShapeCoordinates(-impl));
-			return true;
+			List<Vector2> pts, res(Vector2(), vxs.Count() + 1);
+			pts.PushBackRange(*vxs, vxs.Count()); // ConvexHull reorders the points
+			size_t count = Math::ConvexHull(*pts, pts.Count(), *res);
+			res.Remove(count, res.Count() - count);
+			return res;
 		}
 
 		void DrawPolygon(const Body &p, const Color &c) {
-			List<Vector2> vs = p.GetAllPoints();
+			const List<Vector2> &vs = p.GetTransform().Points;
 			List<Vertex> vxs;
 			Vector2 last = vs.Last();
 			vs.ForEach([&](const Vector2 &v) {
@@ -1979,7 +1712,7 @@ class PhysicsTest : public Test {
 			r.DrawVertices(vxs, RenderMode::Lines);
 		}
 		void FillConvexPolygon(const Body &p, const Color &c) {
-			List<Vector2> vs = p.GetAllPoints();
+			const List<Vector2> &vs = p.GetTransform().Points;
 			List<Vertex> vxs;
 			Vector2 last = vs[1];
 			for (size_t i = 2; i < vs.Count(); ++i) {
@@ -2038,7 +1771,7 @@ class EditorTest : public Test {
 
 			_add.Click += [&](const Info&) {
 				if (_type.Content().Content.Length() > 0) {
-					NodeData *nd = _map[_type.Content().Content]();
+					NodeData *nd = _map[_type.Content().Content.ToString()]();
 					_pnl.InsertNode(nd);
 				}
 			};
@@ -2081,9 +1814,958 @@ class EditorTest : public Test {
 		}
 };
 
+// headless benchmarks, results are written to stdout
+template <typename Dict, typename Key> void TimeDictionary(const char *name, const List<Key> &keys) {
+	Dict dict;
+	double ins = Stopwatch::TimeInSeconds([&]() {
+		for (size_t i = 0; i < keys.Count(); ++i) {
+			dict[keys[i]] = static_cast<int>(i);
+		}
+	});
+	size_t found = 0;
+	double look = Stopwatch::TimeInSeconds([&]() {
+		for (size_t i = 0; i < keys.Count(); ++i) {
+			found += dict.ContainsKey(keys[i]) ? 1 : 0;
+		}
+	});
+	cout<<"  "<<name<<": insert "<<ins * 1000.0<<"ms, lookup "<<look * 1000.0<<"ms ("<<found<<" found)\n";
+}
+void HashTableBenchmark() {
+	Random rand(0);
+	for (size_t n = 1000; n <= 1000000; n *= 10) {
+		List<int> intKeys;
+		List<String> strKeys;
+		for (size_t i = 0; i < n; ++i) {
+			int v = rand.Next() ^ (rand.Next()<<15);
+			intKeys.PushBack(v);
+			strKeys.PushBack(ToString(v));
+		}
+		cout<<n<<" keys\n";
+		TimeDictionary<Dictionary<int, int>>("Dictionary<int>", intKeys);
+		TimeDictionary<HashDictionary<int, int>>("HashDictionary<int>", intKeys);
+		TimeDictionary<Dictionary<String, int>>("Dictionary<String>", strKeys);
+		TimeDictionary<HashDictionary<String, int>>("HashDictionary<String>", strKeys);
+	}
+}
+
+class BenchmarkFont : public Font { // fixed metrics, no textures; for layout only
+	public:
+		BenchmarkFont() {
+			_height = 16.0;
+		}
+
+		const CharData &GetData(TCHAR c) const override {
+			_data.Character = c;
+			_data.Advance = (c == _TEXT('\n') ? 0.0 : (c == _TEXT(' ') ? 4.0 : 7.0));
+			return _data;
+		}
+		const AtlasTexture &GetTextureInfo(TCHAR) const override {
+			return _tex;
+		}
+		const TextureID &GetTexture(size_t) const override {
+			return _id;
+		}
+		bool HasData(TCHAR) const override {
+			return true;
+		}
+	protected:
+		mutable CharData _data;
+		AtlasTexture _tex;
+		TextureID _id;
+};
+template <typename Txt> void TimeKeystrokes(const char *name, Txt &txt, Random &rand) {
+	const size_t fullKeys = 20, incKeys = 1000;
+	txt.CacheFormat();
+	double full = Stopwatch::TimeInSeconds([&]() {
+		for (size_t i = 0; i < fullKeys; ++i) {
+			txt.Content.Insert(static_cast<size_t>(rand.NextDouble() * txt.Content.Length()), _TEXT('x'));
+			txt.CacheFormat();
+		}
+	});
+	double inc = Stopwatch::TimeInSeconds([&]() {
+		for (size_t i = 0; i < incKeys; ++i) {
+			size_t pos = static_cast<size_t>(rand.NextDouble() * txt.Content.Length());
+			txt.Content.Insert(pos, _TEXT('x'));
+			txt.OnContentChanged(pos, 0, 1);
+		}
+	});
+	cout<<"  "<<name<<": full re-layout "<<full * 1000.0 / fullKeys<<"ms/key, incremental "<<inc * 1000.0 / incKeys<<"ms/key\n";
+}
+void TextLayoutBenchmark() {
+	BenchmarkFont fnt;
+	Random rand(0);
+	for (size_t n = 10000; n <= 1000000; n *= 10) {
+		String doc;
+		for (size_t i = 0; i < n; ++i) {
+			doc += (i % 80 == 79 ? _TEXT('\n') : (rand.Next() % 6 == 0 ? _TEXT(' ') : _TEXT('a')));
+		}
+		cout<<n<<" characters\n";
+		BasicText basic;
+		basic.Font = &fnt;
+		basic.WrapType = LineWrapType::WrapWordsNoOverflow;
+		basic.LayoutRectangle = Core::Math::Rectangle(0.0, 0.0, 300.0, 600.0);
+		basic.Content = doc;
+		TimeKeystrokes("BasicText", basic, rand);
+		StreamedRichText rich;
+		rich.WrapType = LineWrapType::WrapWordsNoOverflow;
+		rich.LayoutRectangle = Core::Math::Rectangle(0.0, 0.0, 300.0, 600.0);
+		rich<<&fnt<<doc;
+		TimeKeystrokes("StreamedRichText", rich, rand);
+	}
+}
+
+template <typename Cache> bool IsSameLayout(const Cache &inc, const Cache &full) {
+	if (inc.LineBreaks.Count() != full.LineBreaks.Count() || inc.LineLengths.Count() != full.LineLengths.Count()) {
+		return false;
+	}
+	for (size_t i = 0; i < full.LineBreaks.Count(); ++i) {
+		if (inc.LineBreaks[i] != full.LineBreaks[i]) {
+			return false;
+		}
+	}
+	for (size_t i = 0; i < full.LineLengths.Count(); ++i) {
+		if (inc.LineLengths[i] != full.LineLengths[i]) {
+			return false;
+		}
+	}
+	return inc.Size.X == full.Size.X && abs(inc.Size.Y - full.Size.Y) < 1e-6 * (1.0 + full.Size.Y); // heights are summed up differently
+}
+template <typename Txt, typename Cache> void TestIncrementalLayout(const char *name, Txt &txt, Cache Txt::*cache, Random &rand) {
+	const size_t edits = 2000;
+	const TCHAR chars[] = _TEXT("aaaaaa  \n");
+	txt.CacheFormat();
+	size_t wrong = 0;
+	for (size_t i = 0; i < edits; ++i) {
+		size_t pos = rand.Next() % (txt.Content.Length() + 1), removed = 0, inserted = 0;
+		if (rand.Next() % 2 == 0 && pos < txt.Content.Length()) {
+			removed = Min<size_t>(1 + rand.Next() % 40, txt.Content.Length() - pos);
+			txt.Content.Remove(pos, removed);
+		}
+		if (rand.Next() % 3 != 0) {
+			String ins;
+			for (size_t j = 1 + rand.Next() % 40; j > 0; --j) {
+				ins += chars[rand.Next() % (sizeof(chars) / sizeof(TCHAR) - 1)];
+			}
+			txt.Content.Insert(pos, ins);
+			inserted = ins.Length();
+		}
+		txt.OnContentChanged(pos, removed, inserted);
+		Txt full = txt;
+		full.CacheFormat();
+		if (!IsSameLayout(txt.*cache, full.*cache)) {
+			++wrong;
+		}
+	}
+	cout<<"  "<<name<<": "<<(wrong == 0 ? "matches" : "DOESN'T MATCH")<<" ("<<wrong<<" of "<<edits<<" edits differ)\n";
+}
+void TextLayoutTest() { // random edits, the incremental layout compared with a full one after each
+	BenchmarkFont fnt;
+	Random rand(0);
+	for (size_t wrap = 0; wrap < 4; ++wrap) {
+		String doc;
+		for (size_t i = 0; i < 5000; ++i) {
+			doc += (i % 80 == 79 ? _TEXT('\n') : (rand.Next() % 6 == 0 ? _TEXT(' ') : _TEXT('a')));
+		}
+		cout<<"wrap type "<<wrap<<"\n";
+		BasicText basic;
+		basic.Font = &fnt;
+		basic.WrapType = static_cast<LineWrapType>(wrap);
+		basic.LayoutRectangle = Core::Math::Rectangle(0.0, 0.0, 300.0, 600.0);
+		basic.Content = doc;
+		TestIncrementalLayout("BasicText", basic, &BasicText::FormatCache, rand);
+		StreamedRichText rich;
+		rich.WrapType = static_cast<LineWrapType>(wrap);
+		rich.LayoutRectangle = Core::Math::Rectangle(0.0, 0.0, 300.0, 600.0);
+		rich<<&fnt<<doc.SubString(0, 2000);
+		rich.AppendScaleChange(1.5);
+		rich<<doc.SubString(2000, 1000);
+		rich.AppendScaleChange(0.75);
+		rich<<doc.SubString(3000);
+		TestIncrementalLayout("StreamedRichText", rich, &StreamedRichText::CachedFormat, rand);
+	}
+}
+
+void SoftwareContextGoldenTest() { // quads, a blended quad, a triangle and a clipped quad over a cleared frame, on 1 to 4 threads
+	const char *golden[] {
+		"................",
+		"..rrrr......ggg.",
+		"..rrrr.......gg.",
+		"..rrmmbbbb....g.",
+		"..rrmmbbbb......",
+		"....bbbbbb..yy..",
+		"....bbbbbb..yy..",
+		"................"
+	};
+	auto expected = [](char c) {
+		switch (c) {
+			case 'r': {
+				return Color(255, 0, 0, 255);
+			}
+			case 'g': {
+				return Color(0, 255, 0, 255);
+			}
+			case 'b': {
+				return Color(0, 0, 128, 255);
+			}
+			case 'm': {
+				return Color(127, 0, 128, 255);
+			}
+			case 'y': {
+				return Color(255, 255, 0, 255);
+			}
+		}
+		return Color(0, 0, 0, 255);
+	};
+	auto quad = [](SoftwareContext &ctx, double l, double t, double r, double b, const Color &c) {
+		Vertex vs[4] {Vertex(Vector2(l, t), c), Vertex(Vector2(r, t), c), Vertex(Vector2(r, b), c), Vertex(Vector2(l, b), c)};
+		ctx.DrawVertices(vs, 4, RenderMode::TriangleFan);
+	};
+	for (size_t threads = 1; threads <= 4; ++threads) {
+		ThreadPool pool(threads);
+		SoftwareContext ctx(16, 8, &pool);
+		ctx.SetViewbox(Core::Math::Rectangle(0.0, 0.0, 16.0, 8.0));
+		ctx.Begin();
+		quad(ctx, 0.0, 0.0, 16.0, 8.0, Color(255, 0, 0, 255)); // still queued when the next Begin() clears the screen
+		ctx.Begin();
+		quad(ctx, 2.0, 1.0, 6.0, 5.0, Color(255, 0, 0, 255));
+		quad(ctx, 4.0, 3.0, 10.0, 7.0, Color(0, 0, 255, 128));
+		Vertex tri[3] {
+			Vertex(Vector2(11.0, 1.0), Color(0, 255, 0, 255)),
+			Vertex(Vector2(15.0, 1.0), Color(0, 255, 0, 255)),
+			Vertex(Vector2(15.0, 4.0), Color(0, 255, 0, 255))
+		};
+		ctx.DrawVertices(tri, 3, RenderMode::Triangles);
+		ctx.PushRectangularClip(Core::Math::Rectangle(12.0, 5.0, 2.0, 2.0)); // in pixels of the target
+		quad(ctx, 11.0, 4.0, 15.0, 8.0, Color(255, 255, 0, 255));
+		ctx.PopRectangularClip();
+		ctx.End();
+		const Color *pixels = ctx.GetPixels();
+		size_t wrong = 0;
+		for (size_t y = 0; y < 8; ++y) {
+			for (size_t x = 0; x < 16; ++x) {
+				Color exp = expected(golden[y][x]), got = pixels[y * 16 + x];
+				if (abs(exp.R - got.R) > 1 || abs(exp.G - got.G) > 1 || abs(exp.B - got.B) > 1) {
+					++wrong;
+				}
+			}
+		}
+		cout<<threads<<" threads: "<<(wrong == 0 ? "matches" : "DOESN'T MATCH")<<" ("<<wrong<<" wrong pixels)\n";
+	}
+}
+void DrawBenchmarkFrame(SoftwareContext &ctx, const TextureID &tex, Random &rand) {
+	ctx.Begin();
+	for (size_t i = 0; i < 5000; ++i) {
+		if (i % 100 == 0) {
+			if (i % 200 == 0) {
+				ctx.BindTexture(tex);
+			} else {
+				ctx.UnbindTexture();
+			}
+		}
+		double x = rand.NextDouble() * ctx.GetWidth(), y = rand.NextDouble() * ctx.GetHeight(), w = 20.0 + rand.Next() % 100, h = 10.0 + rand.Next() % 40;
+		Color c(rand.Next() % 256, rand.Next() % 256, rand.Next() % 256, 128 + rand.Next() % 128);
+		Vertex vs[4] {
+			Vertex(Vector2(x, y), c, Vector2(0.0, 0.0)),
+			Vertex(Vector2(x + w, y), c, Vector2(1.0, 0.0)),
+			Vertex(Vector2(x + w, y + h), c, Vector2(1.0, 1.0)),
+			Vertex(Vector2(x, y + h), c, Vector2(0.0, 1.0))
+		};
+		ctx.DrawVertices(vs, 4, RenderMode::TriangleFan);
+	}
+	ctx.End();
+}
+void SoftwareRenderingBenchmark() { // 5000 ui-sized quads at 1080p, half of them textured
+	const size_t frames = 10;
+	List<Color> texPixels;
+	for (size_t i = 0; i < 64; ++i) {
+		texPixels.PushBack(Color(i * 4, 255 - i * 4, 128, 200));
+	}
+	for (size_t threads = 1; threads <= std::thread::hardware_concurrency(); threads *= 2) {
+		ThreadPool pool(threads);
+		SoftwareContext ctx(1920, 1080, &pool);
+		ctx.SetViewbox(Core::Math::Rectangle(0.0, 0.0, 1920.0, 1080.0));
+		TextureID tex = ctx.LoadTextureFromPixels(*texPixels, 8, 8);
+		Random rand(0);
+		double t = Stopwatch::TimeInSeconds([&]() {
+			for (size_t i = 0; i < frames; ++i) {
+				DrawBenchmarkFrame(ctx, tex, rand);
+			}
+		});
+		cout<<threads<<" threads: "<<t * 1000.0 / frames<<"ms/frame\n";
+	}
+}
+void BatchingBenchmark() { // a grid of 2000 labels, each a background quad followed by a textured glyph quad
+	const size_t frames = 10;
+	List<Color> texPixels;
+	for (size_t i = 0; i < 64; ++i) {
+		texPixels.PushBack(Color(255, 255, 255, i * 4));
+	}
+	for (size_t pass = 0; pass < 2; ++pass) {
+		SoftwareContext ctx(1920, 1080);
+		TextureID tex = ctx.LoadTextureFromPixels(*texPixels, 8, 8);
+		Renderer r = ctx.CreateRenderer();
+		r.SetViewbox(Core::Math::Rectangle(0.0, 0.0, 1920.0, 1080.0));
+		r.SetBatching(pass == 1);
+		double t = Stopwatch::TimeInSeconds([&]() {
+			for (size_t f = 0; f < frames; ++f) {
+				r.Begin();
+				for (size_t i = 0; i < 2000; ++i) {
+					double x = (i % 40) * 48.0, y = (i / 40) * 21.0;
+					Vertex back[4] {
+						Vertex(Vector2(x, y), Color(60, 60, 60, 255)),
+						Vertex(Vector2(x + 46.0, y), Color(60, 60, 60, 255)),
+						Vertex(Vector2(x + 46.0, y + 19.0), Color(60, 60, 60, 255)),
+						Vertex(Vector2(x, y + 19.0), Color(60, 60, 60, 255))
+					}, glyph[4] {
+						Vertex(Vector2(x + 4.0, y + 4.0), Color(255, 255, 255, 255), Vector2(0.0, 0.0)),
+						Vertex(Vector2(x + 16.0, y + 4.0), Color(255, 255, 255, 255), Vector2(1.0, 0.0)),
+						Vertex(Vector2(x + 16.0, y + 16.0), Color(255, 255, 255, 255), Vector2(1.0, 1.0)),
+						Vertex(Vector2(x + 4.0, y + 16.0), Color(255, 255, 255, 255), Vector2(0.0, 1.0))
+					};
+					r.BindTexture(TextureID());
+					r.DrawVertices(back, 4, RenderMode::TriangleFan);
+					r.BindTexture(tex);
+					r.DrawVertices(glyph, 4, RenderMode::TriangleFan);
+				}
+				r.End();
+			}
+		});
+		RenderStatistics stat = r.GetStatistics();
+		cout<<(pass == 1 ? "batched: " : "direct: ")<<t * 1000.0 / frames<<"ms/frame, "<<
+			stat.DrawCalls / frames<<" draw calls, "<<stat.StateChanges / frames<<" state changes per frame\n";
+	}
+}
+
+void ImageFilterBenchmark() { // a 4k backdrop, as blurred behind translucent ui
+	const size_t width = 3840, height = 2160, runs = 5;
+	List<Color> pixels;
+	Random rand(0);
+	for (size_t i = 0; i < width * height; ++i) {
+		pixels.PushBack(Color(rand.Next() & 255, rand.Next() & 255, rand.Next() & 255, 255));
+	}
+	ImageView view(*pixels, width, height);
+	for (size_t threads = 1; threads <= std::thread::hardware_concurrency(); threads *= 2) {
+		ThreadPool pool(threads);
+		cout<<threads<<" threads:\n";
+		cout<<"  gaussian, sigma 8: "<<Stopwatch::TimeInSeconds([&]() {
+			for (size_t i = 0; i < runs; ++i) {
+				ImageFilters::GaussianBlur(view, 8.0, 8.0, &pool);
+			}
+		}) * 1000.0 / runs<<"ms\n";
+		cout<<"  3-box gaussian, sigma 8: "<<Stopwatch::TimeInSeconds([&]() {
+			for (size_t i = 0; i < runs; ++i) {
+				ImageFilters::FastGaussianBlur(view, 8.0, 8.0, &pool);
+			}
+		}) * 1000.0 / runs<<"ms\n";
+		cout<<"  box, radius 16: "<<Stopwatch::TimeInSeconds([&]() {
+			for (size_t i = 0; i < runs; ++i) {
+				ImageFilters::BoxBlur(view, 16, 16, &pool);
+			}
+		}) * 1000.0 / runs<<"ms\n";
+		cout<<"  pixelate, 16x16: "<<Stopwatch::TimeInSeconds([&]() {
+			for (size_t i = 0; i < runs; ++i) {
+				ImageFilters::Pixelate(view, 16, 16, &pool);
+			}
+		}) * 1000.0 / runs<<"ms\n";
+	}
+}
+
+Environment MakeCrowd(size_t chars, size_t walls, double side) {
+	Environment env;
+	Random rand(0);
+	for (size_t i = 0; i < chars; ++i) {
+		CharacterPhysics::Character c;
+		c.Position = Vector2(rand.NextDouble() * side, rand.NextDouble() * side);
+		c.Size = 3.0 + rand.NextDouble() * 6.0;
+		c.GoingDirection = static_cast<Direction>(rand.Next() & 15);
+		env.Characters().PushBack(c);
+	}
+	for (size_t i = 0; i < walls; ++i) {
+		CharacterPhysics::Wall w;
+		w.Node1 = Vector2(rand.NextDouble() * side, rand.NextDouble() * side);
+		w.Node2 = w.Node1 + rand.NextDirection() * (20.0 + rand.NextDouble() * 80.0);
+		env.Walls().PushBack(w);
+	}
+	return env;
+}
+void CrowdBenchmark() { // characters spread over a square with one character per 400 square units, and a wall per 10 characters
+	for (size_t n = 1250; n <= 20000; n *= 2) {
+		double side = sqrt(n * 400.0);
+		Environment broad = MakeCrowd(n, n / 10, side), brute = broad;
+		brute.Broadphase() = false;
+		size_t steps = (n > 5000 ? 1 : 10);
+		double tBroad = Stopwatch::TimeInSeconds([&]() {
+			for (size_t i = 0; i < steps; ++i) {
+				broad.Update(1.0 / broad.GetHertz());
+			}
+		}), tBrute = Stopwatch::TimeInSeconds([&]() {
+			for (size_t i = 0; i < steps; ++i) {
+				brute.Update(1.0 / brute.GetHertz());
+			}
+		});
+		size_t diff = 0;
+		for (size_t i = 0; i < n; ++i) {
+			const Vector2 &p1 = broad.Characters()[i].Position, &p2 = brute.Characters()[i].Position;
+			diff += (p1.X != p2.X || p1.Y != p2.Y ? 1 : 0);
+		}
+		cout<<n<<" characters: broadphase "<<tBroad * 1000.0 / steps<<"ms/step, all pairs "<<tBrute * 1000.0 / steps<<"ms/step, "<<
+			diff<<" positions differ\n";
+	}
+}
+void ParallelCrowdBenchmark() { // the same crowds as in CrowdBenchmark, solved by the parallel solver with 1 to 32 threads
+	for (size_t n = 1000; n <= 100000; n *= 10) {
+		double side = sqrt(n * 400.0);
+		size_t steps = (n > 10000 ? 10 : 100);
+		Environment seq = MakeCrowd(n, n / 10, side);
+		double tSeq = Stopwatch::TimeInSeconds([&]() {
+			for (size_t i = 0; i < steps; ++i) {
+				seq.Update(1.0 / seq.GetHertz());
+			}
+		});
+		cout<<n<<" characters: sequential "<<steps / tSeq<<" steps/s\n";
+		List<Vector2> reference;
+		for (size_t threads = 1; threads <= 32; threads *= 2) {
+			ThreadPool pool(threads);
+			Environment par = MakeCrowd(n, n / 10, side);
+			par.Solver() = CharacterPhysics::SolverType::Parallel;
+			par.Pool() = &pool;
+			double t = Stopwatch::TimeInSeconds([&]() {
+				for (size_t i = 0; i < steps; ++i) {
+					par.Update(1.0 / par.GetHertz());
+				}
+			});
+			size_t diff = 0;
+			for (size_t i = 0; i < n; ++i) {
+				const Vector2 &p = par.Characters()[i].Position;
+				if (threads == 1) {
+					reference.PushBack(p);
+				} else {
+					diff += (p.X != reference[i].X || p.Y != reference[i].Y ? 1 : 0);
+				}
+			}
+			cout<<"\t"<<threads<<" threads: "<<steps / t<<" steps/s, "<<diff<<" positions differ from 1 thread\n";
+		}
+	}
+}
+
+bool IsSameCast(const List<CastResult> &lhs, const List<CastResult> &rhs) {
+	auto same = [](const Vector2 &l, const Vector2 &r) {
+		return l.X == r.X && l.Y == r.Y;
+	};
+	if (lhs.Count() != rhs.Count()) {
+		return false;
+	}
+	for (size_t i = 0; i < lhs.Count(); ++i) {
+		const CastResult &l = lhs[i], &r = rhs[i];
+		if (
+			l.Type != r.Type ||
+			!same(l.SourcePoint1, r.SourcePoint1) || !same(l.SourcePoint2, r.SourcePoint2) ||
+			!same(l.TargetPoint1, r.TargetPoint1) || !same(l.TargetPoint2, r.TargetPoint2) ||
+			l.SourceStrength1 != r.SourceStrength1 || l.SourceStrength2 != r.SourceStrength2 ||
+			l.TargetStrength1 != r.TargetStrength1 || l.TargetStrength2 != r.TargetStrength2
+		) {
+			return false;
+		}
+	}
+	return true;
+}
+void LightOverlapTest() { // a mirror and a wall on the same slanted line among a few walls, which are tested for every ray, against the same walls repeated, which are swept
+	Random rand(0);
+	size_t wrong = 0, rounds = 500;
+	for (size_t round = 0; round < rounds; ++round) {
+		Caster few, many;
+		Vector2 mid = rand.NextDirection() * (40.0 + rand.NextDouble() * 60.0), dir = rand.NextDirection();
+		LightCaster::Wall a, b;
+		a.Node1 = mid - dir * 90.0;
+		a.Node2 = mid + dir * (10.0 + rand.NextDouble() * 40.0);
+		b.Node1 = mid - dir * (10.0 + rand.NextDouble() * 40.0);
+		b.Node2 = mid + dir * 90.0;
+		(round % 2 == 0 ? a : b).IsMirror = true;
+		few.Walls().PushBack(a);
+		few.Walls().PushBack(b);
+		many.Walls().PushBack(a);
+		many.Walls().PushBack(b);
+		List<LightCaster::Wall> others;
+		while (others.Count() < 4) { // crossings would be found in a different order once the walls are repeated
+			LightCaster::Wall w;
+			w.Node1 = rand.NextDirection() * (rand.NextDouble() * 150.0);
+			w.Node2 = w.Node1 + rand.NextDirection() * (20.0 + rand.NextDouble() * 60.0);
+			bool crosses = false;
+			for (size_t i = 0; i < few.Walls().Count(); ++i) {
+				const LightCaster::Wall &cur = static_cast<const Caster&>(few).Walls()[i];
+				crosses = crosses || SegmentsIntersect(w.Node1, w.Node2, cur.Node1, cur.Node2) != IntersectionType::None;
+			}
+			if (!crosses) {
+				others.PushBack(w);
+				few.Walls().PushBack(w);
+			}
+		}
+		for (size_t k = 0; k < 5; ++k) {
+			for (size_t i = 0; i < others.Count(); ++i) {
+				many.Walls().PushBack(others[i]);
+			}
+		}
+		few.MarkWallsChanged();
+		many.MarkWallsChanged();
+		Light l;
+		l.Position = Vector2(0.0, 0.0);
+		l.Strength = 200.0;
+		if (!IsSameCast(few.Cast(l), many.Cast(l))) {
+			++wrong;
+		}
+	}
+	cout<<"overlapping walls: "<<(wrong == 0 ? "matches" : "DOESN'T MATCH")<<", "<<wrong<<" of "<<rounds<<" differ\n";
+}
+void LightBatchBenchmark() { // 200 lights among 2000 walls, a fifth of them mirrors, cast one by one or together on 1 to 32 threads
+	Caster caster;
+	Random rand(0);
+	double side = 2000.0;
+	for (size_t i = 0; i < 2000; ++i) {
+		LightCaster::Wall w;
+		w.Node1 = Vector2(rand.NextDouble() * side, rand.NextDouble() * side);
+		w.Node2 = w.Node1 + rand.NextDirection() * (20.0 + rand.NextDouble() * 60.0);
+		w.IsMirror = (i % 5 == 0);
+		caster.Walls().PushBack(w);
+	}
+	caster.MarkWallsChanged();
+	List<Light> lights;
+	for (size_t i = 0; i < 200; ++i) {
+		Light l;
+		l.Position = Vector2(rand.NextDouble() * side, rand.NextDouble() * side);
+		l.Strength = 100.0 + rand.NextDouble() * 200.0;
+		lights.PushBack(l);
+	}
+	const size_t frames = 10;
+	Color c(255, 255, 255, 50);
+	List<Vertex> reference;
+	double tSeq = Stopwatch::TimeInSeconds([&]() {
+		for (size_t f = 0; f < frames; ++f) {
+			reference.Clear();
+			for (size_t i = 0; i < lights.Count(); ++i) {
+				List<CastResult> res = caster.Cast(lights[i]);
+				for (size_t j = 0; j < res.Count(); ++j) {
+					const CastResult &cRes = res[j];
+					reference.PushBack(Vertex(cRes.SourcePoint1, c));
+					if (cRes.Type == SplitType::FromSource) {
+						reference.PushBack(Vertex(cRes.TargetPoint1, c));
+						reference.PushBack(Vertex(cRes.TargetPoint2, c));
+					} else {
+						reference.PushBack(Vertex(cRes.SourcePoint2, c));
+						reference.PushBack(Vertex(cRes.TargetPoint1, c));
+						reference.PushBack(Vertex(cRes.SourcePoint2, c));
+						reference.PushBack(Vertex(cRes.TargetPoint1, c));
+						reference.PushBack(Vertex(cRes.TargetPoint2, c));
+					}
+				}
+			}
+		}
+	});
+	cout<<"one by one: "<<tSeq * 1000.0 / frames<<"ms/frame, "<<reference.Count()<<" vertices\n";
+	List<Vertex> vs;
+	List<size_t, true> offsets;
+	for (size_t threads = 1; threads <= 32; threads *= 2) {
+		ThreadPool pool(threads);
+		double t = Stopwatch::TimeInSeconds([&]() {
+			for (size_t f = 0; f < frames; ++f) {
+				caster.CastAll(lights, vs, offsets, c, 50, &pool);
+			}
+		});
+		size_t diff = (vs.Count() == reference.Count() ? 0 : 1);
+		for (size_t i = 0; diff == 0 && i < vs.Count(); ++i) {
+			diff += (vs[i].Position.X != reference[i].Position.X || vs[i].Position.Y != reference[i].Position.Y ? 1 : 0);
+		}
+		cout<<"\t"<<threads<<" threads: "<<t * 1000.0 / frames<<"ms/frame"<<(diff == 0 ? "" : ", vertices differ")<<"\n";
+	}
+}
+
+RigidBody::Body MakeRigidBox(const Vector2 &pos, double hw, double hh, RigidBody::BodyType type = RigidBody::BodyType::Dynamic) {
+	RigidBody::Body b;
+	b.Shape.Points.PushBack(Vector2(-hw, -hh));
+	b.Shape.Points.PushBack(Vector2(hw, -hh));
+	b.Shape.Points.PushBack(Vector2(hw, hh));
+	b.Shape.Points.PushBack(Vector2(-hw, hh));
+	b.Offset = pos;
+	b.Type = type;
+	b.ComputeMassInfo();
+	return b;
+}
+void RunRigidBodyScene(RigidBody::World &world, size_t seconds) { // reports the speed of each simulated second, which drops as bodies pile up and rises as they fall asleep
+	size_t steps = static_cast<size_t>(world.GetHertz());
+	for (size_t s = 0; s < seconds; ++s) {
+		double t = Stopwatch::TimeInSeconds([&]() {
+			for (size_t i = 0; i < steps; ++i) {
+				world.Update(1.0 / world.GetHertz());
+			}
+		});
+		cout<<"\t"<<s<<"s: "<<steps / t<<" steps/s, "<<world.GetAwakeCount()<<" awake, "<<world.Contacts().Count()<<" pairs\n";
+	}
+}
+void RigidBodyChangeTest() { // a sleeping box moved up by hand, and then its ground replaced by a lower one, must fall onto it again
+	typedef RigidBody::BodyType BodyType;
+	RigidBody::World world;
+	world.Bodies().PushBack(MakeRigidBox(Vector2(0.0, -1.0), 10.0, 1.0, BodyType::Static));
+	world.Bodies().PushBack(MakeRigidBox(Vector2(0.0, 0.5), 0.5, 0.5));
+	auto run = [&](double seconds) {
+		for (size_t i = 0; i < static_cast<size_t>(seconds * world.GetHertz()); ++i) {
+			world.Update(1.0 / world.GetHertz());
+		}
+	};
+	run(3.0);
+	bool asleep = !world.Bodies()[1].Awake;
+	world.Bodies()[1].Offset.Y += 5.0;
+	run(3.0);
+	double y = world.Bodies()[1].Offset.Y;
+	cout<<"moved by hand: "<<(asleep && Abs(y - 0.5) < 0.05 ? "matches" : "DOESN'T MATCH")<<", rests at "<<y<<"\n";
+	run(3.0);
+	asleep = !world.Bodies()[1].Awake;
+	world.Bodies()[0] = MakeRigidBox(Vector2(0.0, -3.0), 10.0, 1.0, BodyType::Static);
+	run(3.0);
+	y = world.Bodies()[1].Offset.Y;
+	cout<<"ground replaced: "<<(asleep && Abs(y + 1.5) < 0.05 ? "matches" : "DOESN'T MATCH")<<", rests at "<<y<<"\n";
+}
+void RigidBodyBenchmark() { // 7 pyramids of 741 boxes, and 5000 polygons with 3 to 8 sides rained into a pit
+	{
+		RigidBody::World world;
+		world.Bodies().PushBack(MakeRigidBox(Vector2(0.0, -1.0), 160.0, 1.0, RigidBody::BodyType::Static));
+		const size_t pyramids = 7, rows = 38;
+		for (size_t p = 0; p < pyramids; ++p) {
+			double center = 45.0 * p - 135.0;
+			for (size_t r = 0; r < rows; ++r) {
+				for (size_t i = 0; i < rows - r; ++i) {
+					world.Bodies().PushBack(MakeRigidBox(Vector2(center + 0.5 + i - 0.5 * (rows - r), 0.5 + r), 0.5, 0.5));
+				}
+			}
+		}
+		cout<<"pyramids, "<<world.Bodies().Count() - 1<<" boxes:\n";
+		RunRigidBodyScene(world, 10);
+		cout<<"\ttop box at "<<world.Bodies().Last().Offset.Y<<", started at "<<rows - 0.5<<"\n";
+	}
+	{
+		RigidBody::World world;
+		Random rand(0);
+		world.Bodies().PushBack(MakeRigidBox(Vector2(0.0, -1.0), 60.0, 1.0, RigidBody::BodyType::Static));
+		world.Bodies().PushBack(MakeRigidBox(Vector2(-61.0, 100.0), 1.0, 100.0, RigidBody::BodyType::Static));
+		world.Bodies().PushBack(MakeRigidBox(Vector2(61.0, 100.0), 1.0, 100.0, RigidBody::BodyType::Static));
+		for (size_t i = 0; i < 5000; ++i) {
+			RigidBody::Body b;
+			size_t sides = 3 + rand.Next() % 6;
+			double radius = 0.3 + rand.NextDouble() * 0.3, ang = rand.NextDouble() * Pi;
+			for (size_t j = 0; j < sides; ++j, ang += 2.0 * Pi / sides) {
+				b.Shape.Points.PushBack(radius * Vector2(cos(ang), sin(ang)));
+			}
+			b.Offset = Vector2(1.2 * (i % 100) - 59.4, 2.0 + 1.5 * (i / 100));
+			b.ComputeMassInfo();
+			world.Bodies().PushBack(b);
+		}
+		cout<<"rain, "<<world.Bodies().Count() - 3<<" polygons:\n";
+		RunRigidBodyScene(world, 10);
+	}
+}
+
+void HullTest() { // threaded hulls against the serial hull, for points in a disc, on a circle and on a grid, with out holding count + 1 points
+	Random rand(1);
+	const size_t count = 131072;
+	for (size_t kind = 0; kind < 3; ++kind) {
+		List<Vector2> points;
+		for (size_t i = 0; i < count; ++i) {
+			double a = 2.0 * Pi * i / count, r = sqrt(rand.NextDouble());
+			if (kind == 0) {
+				points.PushBack(Vector2(r * cos(a), r * sin(a)));
+			} else if (kind == 1) { // every point is on the hull
+				points.PushBack(Vector2(cos(a), sin(a)));
+			} else { // collinear points on the edges
+				points.PushBack(Vector2(static_cast<double>(rand.Next() % 64), static_cast<double>(rand.Next() % 64)));
+			}
+		}
+		List<Vector2> work = points, reference(Vector2(), count + 1);
+		size_t refCount = ConvexHull(&work.At(0), count, &reference.At(0));
+		for (size_t threads = 1; threads <= 8; threads *= 2) {
+			ThreadPool pool(threads);
+			List<Vector2> threaded(Vector2(), count + 1);
+			work = points;
+			size_t res = ConvexHull(&work.At(0), count, &threaded.At(0), pool);
+			bool same = (res == refCount);
+			for (size_t i = 0; same && i < res; ++i) {
+				same = (threaded[i].X == reference[i].X && threaded[i].Y == reference[i].Y);
+			}
+			cout<<"hull "<<kind<<", "<<threads<<" threads: "<<(same ? "matches" : "DOESN'T MATCH")<<"\n";
+		}
+	}
+}
+void HullBenchmark() { // hulls of 4 million points in a disc on 1 to 32 threads, and minkowski differences of two 1000-gons
+	Random rand(0);
+	const size_t count = 4000000;
+	List<Vector2> points;
+	while (points.Count() < count) {
+		Vector2 p(rand.NextDouble() * 2.0 - 1.0, rand.NextDouble() * 2.0 - 1.0);
+		if (p.LengthSquared() <= 1.0) {
+			points.PushBack(p);
+		}
+	}
+	List<Vector2> work(Vector2(), count), hull(Vector2(), count + 1);
+	auto reset = [&]() { // the points are reordered by every hull
+		for (size_t i = 0; i < count; ++i) {
+			work[i] = points[i];
+		}
+	};
+	size_t reference = 0;
+	reset();
+	double t = Stopwatch::TimeInSeconds([&]() {
+		reference = ConvexHull(*work, count, *hull);
+	});
+	cout<<"hull: "<<t * 1000.0<<"ms, "<<reference<<" points\n";
+	for (size_t threads = 1; threads <= 32; threads *= 2) {
+		ThreadPool pool(threads);
+		size_t res = 0;
+		reset();
+		t = Stopwatch::TimeInSeconds([&]() {
+			res = ConvexHull(*work, count, *hull, pool);
+		});
+		cout<<"\t"<<threads<<" threads: "<<t * 1000.0<<"ms"<<(res == reference ? "" : ", hulls differ")<<"\n";
+	}
+	const size_t sides = 1000, reps = 1000;
+	List<Vector2> p1, p2, diff(Vector2(), 2 * sides);
+	for (size_t i = 0; i < sides; ++i) {
+		p1.PushBack(Vector2(cos(2.0 * Pi * i / sides), sin(2.0 * Pi * i / sides)));
+		p2.PushBack(Vector2(2.0 + cos(2.0 * Pi * (i + 0.5) / sides), 0.5 * sin(2.0 * Pi * (i + 0.5) / sides)));
+	}
+	size_t res = 0;
+	t = Stopwatch::TimeInSeconds([&]() {
+		for (size_t i = 0; i < reps; ++i) {
+			res = MinkowskiDifference(*p1, sides, *p2, sides, *diff);
+		}
+	});
+	cout<<"minkowski difference: "<<t * 1000000.0 / reps<<"us, "<<res<<" points\n";
+}
+
+void MazeBenchmark() { // streamed mazes of 1e6, 1e8 and 1e10 blocks, the last taking minutes, and Generate at 1e6 blocks
+	for (size_t side = 1000; side <= 100000; side *= 10) {
+		size_t base = GlobalAllocator::UsedSize(), peak = 0;
+		double t = Stopwatch::TimeInSeconds([&]() {
+			GenerateRows(side, side, [&](const MazeRow&) {
+				peak = Max(peak, GlobalAllocator::UsedSize() - base);
+			}, Random(0));
+		});
+		cout<<side<<"x"<<side<<": "<<t<<"s, "<<side * side / t<<" blocks/s, "<<peak<<" bytes\n";
+	}
+	size_t base = GlobalAllocator::UsedSize();
+	double t = Stopwatch::TimeInSeconds([&]() {
+		Maze m = MazeGenerator::Generate(1000, 1000, BlockID(0, 0), BlockID(999, 999), Method::DFS);
+		cout<<"Generate, 1000x1000: "<<GlobalAllocator::UsedSize() - base<<" bytes for the maze, ";
+	});
+	cout<<t<<"s, "<<1e6 / t<<" blocks/s\n";
+}
+void PathfindingBenchmark() { // batches of paths between random blocks, and between blocks at most 32 apart, on a 1e6 block maze
+	using namespace Pathfinding;
+
+	const size_t side = 1000;
+	Maze m = MazeGenerator::Generate(side, side, BlockID(0, 0), BlockID(side - 1, side - 1), Method::BFS);
+	PackedGrid grid((MazeGrid(m)));
+	TreeRouter router((MazeGrid(m)));
+	BatchPathfinder finder;
+	List<Direction> steps;
+	List<size_t, true> offsets;
+	List<bool, true> found;
+	Random rnd(0);
+	for (size_t reach : {side, size_t(32)}) {
+		List<PathQuery> queries;
+		for (size_t i = 0; i < 10000; ++i) {
+			PathQuery q;
+			q.From = BlockID(rnd.Next() % side, rnd.Next() % side);
+			int r = static_cast<int>(reach);
+			q.To.X = Clamp<long>(long(q.From.X) + rnd.NextBetween(-r, r + 1), 0, long(side) - 1);
+			q.To.Y = Clamp<long>(long(q.From.Y) + rnd.NextBetween(-r, r + 1), 0, long(side) - 1);
+			queries.PushBack(q);
+		}
+		double tree = Stopwatch::TimeInSeconds([&]() {
+			finder.FindPaths(router, queries, steps, offsets, found);
+		});
+		cout<<"reach "<<reach<<", "<<steps.Count() / queries.Count()<<" steps on average\n";
+		cout<<"  TreeRouter: "<<queries.Count() / tree<<" paths/s\n";
+		queries.Remove(1000, queries.Count() - 1000);
+		for (Algorithm alg : {Algorithm::AStar, Algorithm::JumpPoint}) {
+			double t = Stopwatch::TimeInSeconds([&]() {
+				finder.FindPaths(grid, queries, steps, offsets, found, alg);
+			});
+			cout<<(alg == Algorithm::AStar ? "  A*: " : "  jump points: ")<<queries.Count() / t<<" paths/s\n";
+		}
+	}
+}
+void ZipBenchmark() { // 100MB of text-like bytes, of skewed random bytes, and of uniformly random bytes
+	const size_t size = 100 << 20;
+	List<unsigned char> data(0, size), zipped, unzipped;
+	unsigned char *ds = *data;
+	Random rnd(0);
+	const char text[] = "the quick brown fox jumps over the lazy dog, ";
+	for (size_t kind = 0; kind < 3; ++kind) {
+		for (size_t i = 0; i < size; ++i) {
+			if (kind == 0) {
+				ds[i] = static_cast<unsigned char>(i % 100 < 80 ? text[i % (sizeof(text) - 1)] : rnd.Next() & 0x3F);
+			} else if (kind == 1) {
+				ds[i] = static_cast<unsigned char>(HighestBit(static_cast<unsigned>(rnd.Next()) + 1) * 16 + (rnd.Next() & 0xF));
+			} else {
+				ds[i] = static_cast<unsigned char>(rnd.Next());
+			}
+		}
+		zipped.Clear();
+		unzipped.Clear();
+		double zip = Stopwatch::TimeInSeconds([&]() {
+			Zipper::Zip(ds, size, zipped);
+		}), unzip = Stopwatch::TimeInSeconds([&]() {
+			Unzipper::Unzip(*zipped, zipped.Count(), unzipped);
+		});
+		cout<<"kind "<<kind<<": "<<zipped.Count() * 100.0 / size<<"% of the size, zip "<<size / zip / 1e6<<"MB/s, unzip ";
+		cout<<size / unzip / 1e6<<"MB/s, "<<(memcmp(*unzipped, ds, size) == 0 ? "matches" : "DOESN'T MATCH")<<"\n";
+	}
+}
+void BitSetBenchmark() { // 2^30 bits filled bit by bit and at once, whole-set operations, and rank and select queries
+	const size_t size = size_t(1) << 30, queries = 1000000;
+	BitSet bits, mask;
+	double pushes = Stopwatch::TimeInSeconds([&]() {
+		for (size_t i = 0; i < size; ++i) {
+			bits.PushBack((i & 3) == 0);
+		}
+	}), resize = Stopwatch::TimeInSeconds([&]() {
+		mask.Resize(size, true);
+		mask.Fill(size / 4, size / 2, false);
+	}), ops = Stopwatch::TimeInSeconds([&]() {
+		bits ^= mask;
+		bits |= ~mask;
+	});
+	size_t ones = 0;
+	double count = Stopwatch::TimeInSeconds([&]() {
+		ones = bits.PopCount();
+	});
+	RankSelectIndex index;
+	double build = Stopwatch::TimeInSeconds([&]() {
+		index = RankSelectIndex(bits);
+	});
+	Random rnd(0);
+	size_t sum = 0;
+	double query = Stopwatch::TimeInSeconds([&]() {
+		for (size_t i = 0; i < queries; ++i) {
+			size_t r = (static_cast<size_t>(rnd.Next()) << 15) | rnd.Next(); // 30 random bits
+			sum += index.Rank(r % size) + index.Select(r % ones);
+		}
+	});
+	cout<<"push back: "<<pushes<<"s, resize and fill: "<<resize<<"s, xor, or and not: "<<ops<<"s, popcount: "<<count;
+	cout<<"s ("<<ones<<" ones)\nrank index: "<<build<<"s, rank and select: "<<query * 1e9 / queries<<"ns ("<<sum<<")\n";
+}
+void BlockZipBenchmark() { // 256MB of log-like text, zipped and unzipped on 1 to 8 threads, and single blocks read back
+	const size_t size = 256 << 20;
+	List<unsigned char> data(0, size), zipped, unzipped;
+	unsigned char *ds = *data;
+	Random rnd(0);
+	const char *words[] = {"frame ", "player ", "moved ", "to ", "hit ", "spawned ", "at ", "tick ", "entity ", "\n"};
+	for (size_t i = 0; i < size; ) {
+		const char *w = (rnd.Next() % 4 == 0 ? "0123456789" + rnd.Next() % 8 : words[rnd.Next() % 10]);
+		for (size_t j = 0; w[j] && i < size; ++j, ++i) {
+			ds[i] = static_cast<unsigned char>(w[j]);
+		}
+	}
+	for (size_t threads = 1; threads <= 8; threads *= 2) {
+		ThreadPool pool(threads);
+		zipped.Clear();
+		unzipped.Clear();
+		double zip = Stopwatch::TimeInSeconds([&]() {
+			BlockZipper::Zip(ds, size, zipped, BlockZipper::DefaultBlockSize, &pool);
+		}), unzip = Stopwatch::TimeInSeconds([&]() {
+			BlockUnzipper(*zipped, zipped.Count()).Unzip(unzipped, &pool);
+		});
+		cout<<threads<<" threads: "<<zipped.Count() * 100.0 / size<<"% of the size, zip "<<size / zip / 1e6<<"MB/s, unzip ";
+		cout<<size / unzip / 1e6<<"MB/s, "<<(memcmp(*unzipped, ds, size) == 0 ? "matches" : "DOESN'T MATCH")<<"\n";
+	}
+	BlockUnzipper reader(*zipped, zipped.Count());
+	const size_t reads = 1000;
+	double t = Stopwatch::TimeInSeconds([&]() {
+		for (size_t i = 0; i < reads; ++i) {
+			unzipped.Clear();
+			reader.UnzipBlock(rnd.Next() % reader.GetBlockCount(), unzipped);
+		}
+	});
+	cout<<"single block: "<<t * 1000000.0 / reads<<"us\n";
+}
+
+void AllocatorBenchmark() { // small allocations on 1 to 32 threads, freed on the same thread or by another task, against one locked allocator
+	const size_t perTask = 1000000, batch = 256;
+	for (size_t threads = 1; threads <= 32; threads *= 2) {
+		ThreadPool pool(threads);
+		ObjectAllocator shared;
+		std::mutex lock;
+		double local = Stopwatch::TimeInSeconds([&]() {
+			pool.ParallelFor(threads, [&](size_t t) {
+				void *ptrs[batch];
+				for (size_t i = 0; i < perTask; i += batch) {
+					for (size_t j = 0; j < batch; ++j) {
+						ptrs[j] = GlobalAllocator::Allocate(16 + ((i + j + t) & 127));
+					}
+					for (size_t j = 0; j < batch; ++j) {
+						GlobalAllocator::Free(ptrs[j]);
+					}
+				}
+			});
+		}), locked = Stopwatch::TimeInSeconds([&]() {
+			pool.ParallelFor(threads, [&](size_t t) {
+				void *ptrs[batch];
+				for (size_t i = 0; i < perTask; i += batch) {
+					for (size_t j = 0; j < batch; ++j) {
+						std::lock_guard<std::mutex> guard(lock);
+						ptrs[j] = shared.Allocate(16 + ((i + j + t) & 127));
+					}
+					for (size_t j = 0; j < batch; ++j) {
+						std::lock_guard<std::mutex> guard(lock);
+						shared.Free(ptrs[j]);
+					}
+				}
+			});
+		});
+		List<List<void*, true>> handed(List<void*, true>(), threads);
+		List<void*, true> *hs = &handed.At(0);
+		double remote = Stopwatch::TimeInSeconds([&]() { // each task frees what the one before it allocated
+			pool.ParallelFor(threads, [&](size_t t) {
+				List<void*, true> &ptrs = hs[t];
+				for (size_t i = 0; i < perTask; ++i) {
+					ptrs.PushBack(GlobalAllocator::Allocate(16 + ((i + t) & 127)));
+				}
+			});
+			pool.ParallelFor(threads, [&](size_t t) {
+				const List<void*, true> &ptrs = hs[(t + 1) % threads];
+				for (size_t i = 0; i < perTask; ++i) {
+					GlobalAllocator::Free(ptrs[i]);
+				}
+			});
+		});
+		double ops = 2.0 * perTask * threads / 1e6;
+		cout<<threads<<" threads: local "<<ops / local<<"M/s, locked "<<ops / locked<<"M/s, across tasks "<<ops / remote<<"M/s, ";
+		cout<<GlobalAllocator::UsedSize()<<" bytes in use\n";
+	}
+}
+
 int main() {
 	{
 		try {
+//			HashTableBenchmark();
+//			TextLayoutTest();
+//			TextLayoutBenchmark();
+//			SoftwareContextGoldenTest();
+//			SoftwareRenderingBenchmark();
+//			BatchingBenchmark();
+//			ImageFilterBenchmark();
+//			CrowdBenchmark();
+//			ParallelCrowdBenchmark();
+//			LightOverlapTest();
+//			LightBatchBenchmark();
+//			RigidBodyChangeTest();
+//			RigidBodyBenchmark();
+//			HullTest();
+//			HullBenchmark();
+//			MazeBenchmark();
+//			PathfindingBenchmark();
+//			ZipBenchmark();
+//			BlockZipBenchmark();
+//			BitSetBenchmark();
+//			AllocatorBenchmark();
+//			return 0;
 			ControlTest pl;
 //			LightTest pl;
 //			PhysicsTest pl;